@@ -21,6 +21,7 @@
 #include <assert.h>
 
 #include "gdi_private.h"
+#include "winreg.h"
 #include "dibdrv.h"
 
 #include "wine/debug.h"
@@ -581,19 +582,132 @@ static void mask_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+/* Large operations can optionally be split in horizontal bands that are processed in
+ * parallel on the thread pool. This is enabled by setting the number of bands to process
+ * at the same time in the DibBandThreads value of HKCU\Software\Wine\Gdi. Each band is
+ * drawn exactly like the same rows of the whole operation, so the output doesn't change. */
+
+#define MAX_BAND_THREADS  32
+#define MIN_BAND_HEIGHT   32
+#define MIN_BAND_PIXELS   (256 * 256)
+
+struct band_job
+{
+    void (*process)( struct band_job *job, int first, int last );
+    int   count;   /* number of rows, or of iterations for stretching */
+    int   size;    /* rows per band */
+    LONG  next;    /* index of the next band to process */
+};
+
+static LONG band_threads = -1;
+
+static unsigned int get_band_threads(void)
+{
+    static const WCHAR gdi_keyW[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\','G','d','i',0};
+    static const WCHAR band_threadsW[] = {'D','i','b','B','a','n','d','T','h','r','e','a','d','s',0};
+    DWORD type, size, value;
+    HKEY key;
+
+    if (band_threads != -1) return band_threads;
+
+    value = 0;
+    if (!RegOpenKeyExW( HKEY_CURRENT_USER, gdi_keyW, 0, KEY_QUERY_VALUE, &key ))
+    {
+        size = sizeof(value);
+        if (RegQueryValueExW( key, band_threadsW, NULL, &type, (BYTE *)&value, &size ) || type != REG_DWORD)
+            value = 0;
+        RegCloseKey( key );
+    }
+    value = min( value, MAX_BAND_THREADS );
+    if (value > 1) TRACE( "using up to %u threads for large operations\n", value );
+    InterlockedExchange( &band_threads, value );
+    return value;
+}
+
+static void process_bands( struct band_job *job )
+{
+    LONG band;
+    int first;
+
+    while ((first = (band = InterlockedIncrement( &job->next ) - 1) * job->size) < job->count)
+        job->process( job, first, min( first + job->size, job->count ));
+}
+
+static void CALLBACK band_work_proc( TP_CALLBACK_INSTANCE *instance, void *context, TP_WORK *work )
+{
+    process_bands( context );
+}
+
+/* process count rows of width pixels, splitting them in bands if they are large enough */
+static void run_band_job( struct band_job *job, int count, int width )
+{
+    unsigned int i, threads, bands = 1;
+    TP_WORK *work;
+
+    job->count = count;
+    job->size  = count;
+    job->next  = 0;
+
+    if ((threads = get_band_threads()) > 1 && count >= 2 * MIN_BAND_HEIGHT &&
+        (LONGLONG)count * width >= MIN_BAND_PIXELS)
+    {
+        bands = min( threads, count / MIN_BAND_HEIGHT );
+        job->size = (count + bands - 1) / bands;
+    }
+
+    if (bands > 1 && (work = CreateThreadpoolWork( band_work_proc, job, NULL )))
+    {
+        for (i = 1; i < bands; i++) SubmitThreadpoolWork( work );
+        process_bands( job );
+        /* all the bands are done, callbacks that haven't started can be cancelled */
+        WaitForThreadpoolWorkCallbacks( work, TRUE );
+        CloseThreadpoolWork( work );
+    }
+    else process_bands( job );
+}
+
+struct blend_job
+{
+    struct band_job     job;
+    dib_info           *dst;
+    const RECT         *rect;
+    const dib_info     *src;
+    POINT               origin;
+    BLENDFUNCTION       blend;
+};
+
+static void process_blend_band( struct band_job *job, int first, int last )
+{
+    struct blend_job *blend_job = CONTAINING_RECORD( job, struct blend_job, job );
+    RECT rect = *blend_job->rect;
+    POINT origin = blend_job->origin;
+
+    rect.top = blend_job->rect->top + first;
+    rect.bottom = blend_job->rect->top + last;
+    origin.y += first;
+    blend_job->dst->funcs->blend_rect( blend_job->dst, &rect, blend_job->src, &origin, blend_job->blend );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
-    POINT origin;
+    struct blend_job job;
     struct clipped_rects clipped_rects;
     int i;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
+    job.job.process = process_blend_band;
+    job.dst   = dst;
+    job.src   = src;
+    job.blend = blend;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
-        origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
-        dst->funcs->blend_rect( dst, &clipped_rects.rects[i], src, &origin, blend );
+        const RECT *rect = &clipped_rects.rects[i];
+
+        job.rect = rect;
+        job.origin.x = src_rect->left + rect->left - dst_rect->left;
+        job.origin.y = src_rect->top  + rect->top  - dst_rect->top;
+        run_band_job( &job.job, rect->bottom - rect->top, rect->right - rect->left );
     }
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -678,19 +792,49 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
     bounds->bottom = v[2].y;
 }
 
+struct gradient_job
+{
+    struct band_job     job;
+    dib_info           *dib;
+    const RECT         *rect;
+    const TRIVERTEX    *v;
+    int                 mode;
+    BOOL                ret;
+};
+
+static void process_gradient_band( struct band_job *job, int first, int last )
+{
+    struct gradient_job *gradient_job = CONTAINING_RECORD( job, struct gradient_job, job );
+    RECT rect = *gradient_job->rect;
+
+    rect.top = gradient_job->rect->top + first;
+    rect.bottom = gradient_job->rect->top + last;
+    if (!gradient_job->dib->funcs->gradient_rect( gradient_job->dib, &rect, gradient_job->v, gradient_job->mode ))
+        gradient_job->ret = FALSE;
+}
+
 static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
 {
+    struct gradient_job job;
     int i;
     struct clipped_rects clipped_rects;
-    BOOL ret = TRUE;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
+    job.job.process = process_gradient_band;
+    job.dib  = dib;
+    job.v    = v;
+    job.mode = mode;
+    job.ret  = TRUE;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
+        const RECT *rect = &clipped_rects.rects[i];
+
+        job.rect = rect;
+        run_band_job( &job.job, rect->bottom - rect->top, rect->right - rect->left );
+        if (!job.ret) break;
     }
     free_clipped_rects( &clipped_rects );
-    return ret;
+    return job.ret;
 }
 
 static DWORD copy_src_bits( dib_info *src, RECT *src_rect )
@@ -1196,111 +1340,139 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
 }
 
 
-DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
-                          const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
-                          INT mode )
+struct stretch_job
 {
-    dib_info src_dib, dst_dib;
-    POINT dst_start, src_start, dst_end, src_end;
-    RECT rect;
-    BOOL hstretch, vstretch;
-    struct stretch_params v_params, h_params;
-    int err;
-    DWORD ret;
+    struct band_job         job;
+    dib_info                dst_dib;
+    dib_info                src_dib;
+    POINT                   dst_start;
+    POINT                   src_start;
+    struct stretch_params   v_params;
+    struct stretch_params   h_params;
+    int                     mode;
+    int                     width;
+    BOOL                    vstretch;
     void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
                     const dib_info *src_dib, const POINT *src_start,
                     const struct stretch_params *params, int mode, BOOL keep_dst);
+};
 
-    TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
-          dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
-          src->x, src->y, src->width, src->height, wine_dbgstr_rect(&src->visrect));
-
-    init_dib_info_from_bitmapinfo( &src_dib, src_info, src_bits );
-    init_dib_info_from_bitmapinfo( &dst_dib, dst_info, dst_bits );
-
-    /* v */
-    ret = calc_1d_stretch_params( dst->y, dst->height, dst->visrect.top, dst->visrect.bottom,
-                                  src->y, src->height, src->visrect.top, src->visrect.bottom,
-                                  &dst_start.y, &src_start.y, &dst_end.y, &src_end.y,
-                                  &v_params, &vstretch );
-    if (ret) return ret;
-
-    /* h */
-    ret = calc_1d_stretch_params( dst->x, dst->width, dst->visrect.left, dst->visrect.right,
-                                  src->x, src->width, src->visrect.left, src->visrect.right,
-                                  &dst_start.x, &src_start.x, &dst_end.x, &src_end.x,
-                                  &h_params, &hstretch );
-    if (ret) return ret;
-
-    TRACE("got dst start %d, %d inc %d, %d. src start %d, %d inc %d, %d len %d x %d\n",
-          dst_start.x, dst_start.y, h_params.dst_inc, v_params.dst_inc,
-          src_start.x, src_start.y, h_params.src_inc, v_params.src_inc,
-          h_params.length, v_params.length);
+/* advance to the next row iteration, returns TRUE if it starts a new destination row
+ * when shrinking, or needs a new source row when stretching */
+static inline BOOL stretch_next_row( struct stretch_job *job, int *err, POINT *dst_start, POINT *src_start )
+{
+    BOOL ret = *err > 0;
 
-    get_bounding_rect( &rect, dst_start.x, dst_start.y, dst_end.x - dst_start.x, dst_end.y - dst_start.y );
-    intersect_rect( &dst->visrect, &dst->visrect, &rect );
+    if (ret)
+    {
+        if (job->vstretch) src_start->y += job->v_params.src_inc;
+        else dst_start->y += job->v_params.dst_inc;
+        *err += job->v_params.err_add_1;
+    }
+    else *err += job->v_params.err_add_2;
 
-    dst_start.x -= dst->visrect.left;
-    dst_start.y -= dst->visrect.top;
+    if (job->vstretch) dst_start->y += job->v_params.dst_inc;
+    else src_start->y += job->v_params.src_inc;
+    return ret;
+}
 
-    err = v_params.err_start;
+static void process_stretch_band( struct band_job *band, int first, int last )
+{
+    struct stretch_job *job = CONTAINING_RECORD( band, struct stretch_job, job );
+    POINT dst_start = job->dst_start, src_start = job->src_start;
+    int i, err = job->v_params.err_start;
+    BOOL new_row = TRUE;
 
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+    for (i = 0; i < first; i++) new_row = stretch_next_row( job, &err, &dst_start, &src_start );
 
-    if (vstretch)
+    if (job->vstretch)
     {
-        BOOL need_row = TRUE;
         RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
+
         last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
+        last_row.right = job->width;
 
-        while (v_params.length--)
+        /* the previous row may belong to another band, draw the first one in any case */
+        new_row = TRUE;
+        for ( ; i < last; i++)
         {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
+            if (new_row)
+                job->row_fn( &job->dst_dib, &dst_start, &job->src_dib, &src_start, &job->h_params, job->mode, FALSE );
             else
             {
-                last_row.top = dst_start.y - v_params.dst_inc;
+                last_row.top = dst_start.y - job->v_params.dst_inc;
                 last_row.bottom = last_row.top + 1;
                 this_row = last_row;
-                offset_rect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
-            }
-
-            if (err > 0)
-            {
-                src_start.y += v_params.src_inc;
-                need_row = TRUE;
-                err += v_params.err_add_1;
+                offset_rect( &this_row, 0, job->v_params.dst_inc );
+                copy_rect( &job->dst_dib, &this_row, &job->dst_dib, &last_row, NULL, R2_COPYPEN );
             }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
+            new_row = stretch_next_row( job, &err, &dst_start, &src_start );
         }
     }
     else
     {
-        int merged_rows = 0;
+        /* a destination row merges several source rows, keep them in the same band */
+        for ( ; i < job->job.count && !new_row; i++)
+            new_row = stretch_next_row( job, &err, &dst_start, &src_start );
 
-        while (v_params.length--)
+        for ( ; i < job->job.count && (i < last || !new_row); i++)
         {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
-            merged_rows++;
-
-            if (err > 0)
-            {
-                dst_start.y += v_params.dst_inc;
-                merged_rows = 0;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
+            if (job->mode != STRETCH_DELETESCANS || new_row)
+                job->row_fn( &job->dst_dib, &dst_start, &job->src_dib, &src_start, &job->h_params,
+                             job->mode, !new_row );
+            new_row = stretch_next_row( job, &err, &dst_start, &src_start );
         }
     }
+}
+
+DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
+                          const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
+                          INT mode )
+{
+    struct stretch_job job;
+    POINT dst_end, src_end;
+    RECT rect;
+    BOOL hstretch;
+    DWORD ret;
+
+    TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
+          dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
+          src->x, src->y, src->width, src->height, wine_dbgstr_rect(&src->visrect));
+
+    init_dib_info_from_bitmapinfo( &job.src_dib, src_info, src_bits );
+    init_dib_info_from_bitmapinfo( &job.dst_dib, dst_info, dst_bits );
+
+    /* v */
+    ret = calc_1d_stretch_params( dst->y, dst->height, dst->visrect.top, dst->visrect.bottom,
+                                  src->y, src->height, src->visrect.top, src->visrect.bottom,
+                                  &job.dst_start.y, &job.src_start.y, &dst_end.y, &src_end.y,
+                                  &job.v_params, &job.vstretch );
+    if (ret) return ret;
+
+    /* h */
+    ret = calc_1d_stretch_params( dst->x, dst->width, dst->visrect.left, dst->visrect.right,
+                                  src->x, src->width, src->visrect.left, src->visrect.right,
+                                  &job.dst_start.x, &job.src_start.x, &dst_end.x, &src_end.x,
+                                  &job.h_params, &hstretch );
+    if (ret) return ret;
+
+    TRACE("got dst start %d, %d inc %d, %d. src start %d, %d inc %d, %d len %d x %d\n",
+          job.dst_start.x, job.dst_start.y, job.h_params.dst_inc, job.v_params.dst_inc,
+          job.src_start.x, job.src_start.y, job.h_params.src_inc, job.v_params.src_inc,
+          job.h_params.length, job.v_params.length);
+
+    get_bounding_rect( &rect, job.dst_start.x, job.dst_start.y,
+                       dst_end.x - job.dst_start.x, dst_end.y - job.dst_start.y );
+    intersect_rect( &dst->visrect, &dst->visrect, &rect );
+
+    job.dst_start.x -= dst->visrect.left;
+    job.dst_start.y -= dst->visrect.top;
+
+    job.row_fn = hstretch ? job.dst_dib.funcs->stretch_row : job.dst_dib.funcs->shrink_row;
+    job.mode   = (job.vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    job.width  = dst->visrect.right - dst->visrect.left;
+    job.job.process = process_stretch_band;
+    run_band_job( &job.job, job.v_params.length, job.width );
 
     /* update coordinates, the destination rectangle is always stored at 0,0 */
     *src = *dst;
@@ -20,6 +20,7 @@
 
 #include <assert.h>
 #include "gdi_private.h"
+#include "winreg.h"
 #include "dibdrv.h"
 
 #include "wine/unicode.h"
@@ -51,20 +52,34 @@ struct cached_font
     LOGFONTW              lf;
     XFORM                 xform;
     UINT                  aa_flags;
+    LONG                  size;     /* memory used by the cached glyphs */
+    LONG                  last_used;
+    LONG                  hits;
+    LONG                  misses;
     struct cached_glyph **glyphs[GLYPH_NBTYPES][GLYPH_CACHE_PAGES];
 };
 
-static struct list font_cache = LIST_INIT( font_cache );
+/* The font cache is split in shards selected by the font hash, each with its own lock and
+ * list of fonts in most-recently used order. Glyph lookups don't take any lock. Unused fonts
+ * are evicted across all the shards in least-recently used order. */
 
-static CRITICAL_SECTION font_cache_cs;
-static CRITICAL_SECTION_DEBUG critsect_debug =
+#define FONT_CACHE_SHARDS     8
+#define FONT_CACHE_UNUSED     5                  /* unused fonts to keep around */
+#define FONT_CACHE_DEF_SIZE   (16 * 1024 * 1024) /* default glyph memory budget */
+
+struct font_cache_shard
 {
-    0, 0, &font_cache_cs,
-    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
-      0, 0, { (DWORD_PTR)(__FILE__ ": font_cache_cs") }
+    SRWLOCK     lock;
+    struct list fonts;
 };
-static CRITICAL_SECTION font_cache_cs = { &critsect_debug, -1, 0, 0, 0, 0 };
 
+static struct font_cache_shard font_cache[FONT_CACHE_SHARDS];
+
+static LONG font_cache_size;          /* memory used by all the cached glyphs */
+static LONG font_cache_budget = -1;
+static LONG font_cache_clock;         /* last use stamp of the fonts */
+static LONG font_cache_hits;          /* statistics of the evicted fonts */
+static LONG font_cache_misses;
 
 static BOOL brush_rect( dibdrv_physdev *pdev, dib_brush *brush, const RECT *rect, HRGN clip )
 {
@@ -554,10 +569,106 @@ static int font_cache_cmp( const struct cached_font *p1, const struct cached_fon
     return ret;
 }
 
+static LONG get_font_cache_budget(void)
+{
+    static const WCHAR gdi_keyW[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\','G','d','i',0};
+    static const WCHAR glyph_cache_sizeW[] = {'G','l','y','p','h','C','a','c','h','e','S','i','z','e',0};
+    DWORD type, size, value;
+    HKEY key;
+
+    if (font_cache_budget != -1) return font_cache_budget;
+
+    value = FONT_CACHE_DEF_SIZE / 1024;
+    if (!RegOpenKeyExW( HKEY_CURRENT_USER, gdi_keyW, 0, KEY_QUERY_VALUE, &key ))
+    {
+        size = sizeof(value);
+        if (RegQueryValueExW( key, glyph_cache_sizeW, NULL, &type, (BYTE *)&value, &size ) ||
+            type != REG_DWORD)
+            value = FONT_CACHE_DEF_SIZE / 1024;
+        RegCloseKey( key );
+    }
+    value = min( value, MAXLONG / 1024 ) * 1024;
+    TRACE( "glyph cache budget %u bytes\n", value );
+    InterlockedExchange( &font_cache_budget, value );
+    return value;
+}
+
+static void free_cached_font( struct cached_font *font )
+{
+    UINT i, j, k;
+    LONG hits, misses;
+
+    for (i = 0; i < GLYPH_NBTYPES; i++)
+    {
+        for (j = 0; j < GLYPH_CACHE_PAGES; j++)
+        {
+            if (!font->glyphs[i][j]) continue;
+            for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
+                HeapFree( GetProcessHeap(), 0, font->glyphs[i][j][k] );
+            HeapFree( GetProcessHeap(), 0, font->glyphs[i][j] );
+        }
+    }
+    InterlockedExchangeAdd( &font_cache_size, -font->size );
+    hits = InterlockedExchangeAdd( &font_cache_hits, font->hits ) + font->hits;
+    misses = InterlockedExchangeAdd( &font_cache_misses, font->misses ) + font->misses;
+    TRACE( "evicting %p %d %s, %d bytes %d hits %d misses, total %d hits %d misses\n", font,
+           font->lf.lfHeight, debugstr_w(font->lf.lfFaceName), font->size, font->hits, font->misses,
+           hits, misses );
+    list_remove( &font->entry );
+    HeapFree( GetProcessHeap(), 0, font );
+}
+
+/* evict the least recently used unselected fonts until the cache fits */
+static void trim_font_cache(void)
+{
+    struct font_cache_shard *shard, *oldest;
+    struct cached_font *ptr;
+    LONG last_used = 0;
+    UINT i, unused;
+
+    for (;;)
+    {
+        oldest = NULL;
+        unused = 0;
+        for (i = 0; i < FONT_CACHE_SHARDS; i++)
+        {
+            shard = &font_cache[i];
+            AcquireSRWLockShared( &shard->lock );
+            if (shard->fonts.next)
+            {
+                LIST_FOR_EACH_ENTRY_REV( ptr, &shard->fonts, struct cached_font, entry )
+                {
+                    if (ptr->ref) continue;
+                    if (!oldest || ptr->last_used - last_used < 0)
+                    {
+                        oldest = shard;
+                        last_used = ptr->last_used;
+                    }
+                    unused++;
+                }
+            }
+            ReleaseSRWLockShared( &shard->lock );
+        }
+
+        if (!oldest) break;
+        if (unused <= FONT_CACHE_UNUSED && font_cache_size <= get_font_cache_budget()) break;
+
+        /* the shard may have changed in the meantime, evict its oldest unused font */
+        AcquireSRWLockExclusive( &oldest->lock );
+        LIST_FOR_EACH_ENTRY_REV( ptr, &oldest->fonts, struct cached_font, entry )
+        {
+            if (ptr->ref) continue;
+            free_cached_font( ptr );
+            break;
+        }
+        ReleaseSRWLockExclusive( &oldest->lock );
+    }
+}
+
 static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 {
-    struct cached_font font, *ptr, *last_unused = NULL;
-    UINT i = 0, j, k;
+    struct font_cache_shard *shard;
+    struct cached_font font, *ptr;
 
     GetObjectW( hfont, sizeof(font.lf), &font.lf );
     font.xform = dc->xformWorld2Vport;
@@ -571,51 +682,44 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
     font.lf.lfWidth = abs( font.lf.lfWidth );
     font.aa_flags = aa_flags;
     font.hash = font_cache_hash( &font );
+    shard = &font_cache[(font.hash ^ (font.hash >> 16)) % FONT_CACHE_SHARDS];
+
+    AcquireSRWLockExclusive( &shard->lock );
+    if (!shard->fonts.next) list_init( &shard->fonts );
 
-    EnterCriticalSection( &font_cache_cs );
-    LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
+    LIST_FOR_EACH_ENTRY( ptr, &shard->fonts, struct cached_font, entry )
     {
         if (!font_cache_cmp( &font, ptr ))
         {
             InterlockedIncrement( &ptr->ref );
             list_remove( &ptr->entry );
-            goto done;
-        }
-        if (!ptr->ref)
-        {
-            i++;
-            last_unused = ptr;
+            ptr->last_used = InterlockedIncrement( &font_cache_clock );
+            list_add_head( &shard->fonts, &ptr->entry );
+            ReleaseSRWLockExclusive( &shard->lock );
+            TRACE( "%d %s -> %p\n", ptr->lf.lfHeight, debugstr_w(ptr->lf.lfFaceName), ptr );
+            return ptr;
         }
     }
 
-    if (i > 5)  /* keep at least 5 of the most-recently used fonts around */
+    if (!(ptr = HeapAlloc( GetProcessHeap(), 0, sizeof(*ptr) )))
     {
-        ptr = last_unused;
-        for (i = 0; i < GLYPH_NBTYPES; i++)
-        {
-            for (j = 0; j < GLYPH_CACHE_PAGES; j++)
-            {
-                if (!ptr->glyphs[i][j]) continue;
-                for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
-                    HeapFree( GetProcessHeap(), 0, ptr->glyphs[i][j][k] );
-                HeapFree( GetProcessHeap(), 0, ptr->glyphs[i][j] );
-            }
-        }
-        list_remove( &ptr->entry );
-    }
-    else if (!(ptr = HeapAlloc( GetProcessHeap(), 0, sizeof(*ptr) )))
-    {
-        LeaveCriticalSection( &font_cache_cs );
+        ReleaseSRWLockExclusive( &shard->lock );
         return NULL;
     }
 
     *ptr = font;
     ptr->ref = 1;
+    ptr->size = 0;
+    ptr->last_used = InterlockedIncrement( &font_cache_clock );
+    ptr->hits = 0;
+    ptr->misses = 0;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
-done:
-    list_add_head( &font_cache, &ptr->entry );
-    LeaveCriticalSection( &font_cache_cs );
+    list_add_head( &shard->fonts, &ptr->entry );
+    ReleaseSRWLockExclusive( &shard->lock );
     TRACE( "%d %s -> %p\n", ptr->lf.lfHeight, debugstr_w(ptr->lf.lfFaceName), ptr );
+
+    /* keep the most recently used fonts that are no longer selected, as long as they fit */
+    trim_font_cache();
     return ptr;
 }
 
@@ -625,12 +729,13 @@ void release_cached_font( struct cached_font *font )
 }
 
 static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT index, UINT flags,
-                                              struct cached_glyph *glyph )
+                                              struct cached_glyph *glyph, DWORD size )
 {
     struct cached_glyph *ret;
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
     UINT entry = index % GLYPH_CACHE_PAGE_SIZE;
+    DWORD page_size = 0;
 
     if (!font->glyphs[type][page])
     {
@@ -644,10 +749,20 @@ static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT ind
         }
         if (InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page], ptr, NULL ))
             HeapFree( GetProcessHeap(), 0, ptr );
+        else
+            page_size = GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr);
     }
     ret = InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page][entry], glyph, NULL );
     if (!ret) ret = glyph;
-    else HeapFree( GetProcessHeap(), 0, glyph );
+    else
+    {
+        HeapFree( GetProcessHeap(), 0, glyph );
+        size = 0;
+    }
+    size += page_size;
+    InterlockedExchangeAdd( &font->size, size );
+    if (InterlockedExchangeAdd( &font_cache_size, size ) + size > get_font_cache_budget())
+        trim_font_cache();
     return ret;
 }
 
@@ -805,14 +920,14 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
 
 done:
     glyph->metrics = metrics;
-    return add_cached_glyph( font, index, flags, glyph );
+    return add_cached_glyph( font, index, flags, glyph, FIELD_OFFSET( struct cached_glyph, bits[size] ));
 }
 
 static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT x, INT y,
                            UINT flags, const WCHAR *str, UINT count, const INT *dx,
                            const struct clipped_rects *clipped_rects, RECT *bounds )
 {
-    UINT i;
+    UINT i, misses = 0;
     struct cached_glyph *glyph;
     dib_info glyph_dib;
     DWORD text_color;
@@ -833,8 +948,11 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
 
     for (i = 0; i < count; i++)
     {
-        if (!(glyph = get_cached_glyph( font, str[i], flags )) &&
-            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
+        if (!(glyph = get_cached_glyph( font, str[i], flags )))
+        {
+            misses++;
+            if (!(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
+        }
 
         glyph_dib.width       = glyph->metrics.gmBlackBoxX;
         glyph_dib.height      = glyph->metrics.gmBlackBoxY;
@@ -861,6 +979,9 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
             y += glyph->metrics.gmCellIncY;
         }
     }
+
+    InterlockedExchangeAdd( &font->hits, count - misses );
+    InterlockedExchangeAdd( &font->misses, misses );
 }
 
 BOOL render_aa_text_bitmapinfo( DC *dc, BITMAPINFO *info, struct gdi_image_bits *bits,
@@ -4651,32 +4651,42 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+/* row operations that have vectorized versions, selected at run time by init_dib_primitives() */
+struct row_funcs
+{
+    void (*blend_argb)( DWORD *dst, const DWORD *src, int len );
+    void (*blend_argb_alpha)( DWORD *dst, const DWORD *src, int len, DWORD alpha );
+    void (*blend_argb_constant_alpha)( DWORD *dst, const DWORD *src, int len, DWORD alpha );
+    void (*blend_argb_no_src_alpha)( DWORD *dst, const DWORD *src, int len, DWORD alpha );
+    void (*draw_glyph_8888)( DWORD *dst, const BYTE *glyph, int len, DWORD text_pixel,
+                             const struct intensity_range *ranges );
+};
+
+static const struct row_funcs row_funcs_c;
+static const struct row_funcs *row_funcs = &row_funcs_c;
+
 static void blend_rect_8888(const dib_info *dst, const RECT *rc,
                             const dib_info *src, const POINT *origin, BLENDFUNCTION blend)
 {
     DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
     DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
-    int x, y;
+    int y, len = rc->right - rc->left;
 
     if (blend.AlphaFormat & AC_SRC_ALPHA)
     {
-	if (blend.SourceConstantAlpha == 255)
-	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
-		    dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
+        if (blend.SourceConstantAlpha == 255)
+            for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+                row_funcs->blend_argb( dst_ptr, src_ptr, len );
         else
-	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
-		    dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+            for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+                row_funcs->blend_argb_alpha( dst_ptr, src_ptr, len, blend.SourceConstantAlpha );
     }
     else if (src->compression == BI_RGB)
-	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
-		dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+            row_funcs->blend_argb_constant_alpha( dst_ptr, src_ptr, len, blend.SourceConstantAlpha );
     else
-	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
-		dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+            row_funcs->blend_argb_no_src_alpha( dst_ptr, src_ptr, len, blend.SourceConstantAlpha );
 }
 
 static void blend_rect_32(const dib_info *dst, const RECT *rc,
@@ -6066,21 +6076,233 @@ static inline DWORD aa_rgb( BYTE r_dst, BYTE g_dst, BYTE b_dst, DWORD text, cons
             aa_color( r_dst, text >> 16, range->r_min, range->r_max ) << 16);
 }
 
+static inline void draw_glyph_pixel_8888( DWORD *dst, BYTE level, DWORD text_pixel,
+                                         const struct intensity_range *ranges )
+{
+    if (level <= 1) return;
+    if (level >= 16) *dst = text_pixel;
+    else *dst = aa_rgb( *dst >> 16, *dst >> 8, *dst, text_pixel, ranges + level );
+}
+
+static void blend_argb_row( DWORD *dst, const DWORD *src, int len )
+{
+    int x;
+
+    for (x = 0; x < len; x++) dst[x] = blend_argb( dst[x], src[x] );
+}
+
+static void blend_argb_alpha_row( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    int x;
+
+    for (x = 0; x < len; x++) dst[x] = blend_argb_alpha( dst[x], src[x], alpha );
+}
+
+static void blend_argb_constant_alpha_row( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    int x;
+
+    for (x = 0; x < len; x++) dst[x] = blend_argb_constant_alpha( dst[x], src[x], alpha );
+}
+
+static void blend_argb_no_src_alpha_row( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    int x;
+
+    for (x = 0; x < len; x++) dst[x] = blend_argb_no_src_alpha( dst[x], src[x], alpha );
+}
+
+static void draw_glyph_row_8888( DWORD *dst, const BYTE *glyph, int len, DWORD text_pixel,
+                                 const struct intensity_range *ranges )
+{
+    int x;
+
+    for (x = 0; x < len; x++) draw_glyph_pixel_8888( dst + x, glyph[x], text_pixel, ranges );
+}
+
+static const struct row_funcs row_funcs_c =
+{
+    blend_argb_row,
+    blend_argb_alpha_row,
+    blend_argb_constant_alpha_row,
+    blend_argb_no_src_alpha_row,
+    draw_glyph_row_8888
+};
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+
+#include <emmintrin.h>
+
+#define SSE2_FUNC __attribute__((__target__("sse2")))
+
+/* (x + 127) / 255 for each 16-bit lane, exact for x <= 255 * 255 */
+static inline SSE2_FUNC __m128i div255_sse2( __m128i x )
+{
+    x = _mm_add_epi16( x, _mm_set1_epi16( 127 ) );
+    x = _mm_add_epi16( _mm_add_epi16( x, _mm_set1_epi16( 1 ) ), _mm_srli_epi16( x, 8 ) );
+    return _mm_srli_epi16( x, 8 );
+}
+
+/* same as blend_argb() for two pixels unpacked to 16-bit lanes, without the final packing */
+static inline SSE2_FUNC __m128i blend_argb_sse2( __m128i dst, __m128i src )
+{
+    __m128i alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( src, 0xff ), 0xff );
+
+    alpha = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+    return _mm_add_epi16( src, div255_sse2( _mm_mullo_epi16( dst, alpha )));
+}
+
+/* same as blend_color() for two pixels unpacked to 16-bit lanes */
+static inline SSE2_FUNC __m128i blend_color_sse2( __m128i dst, __m128i src, __m128i alpha, __m128i inv_alpha )
+{
+    return div255_sse2( _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_mullo_epi16( dst, inv_alpha )));
+}
+
+/* store four blended pixels; the sum of the components may overflow with non premultiplied
+ * sources, leave these to the scalar code that combines them differently */
+static inline SSE2_FUNC BOOL store_argb_sse2( DWORD *dst, __m128i lo, __m128i hi )
+{
+    const __m128i max = _mm_set1_epi16( 255 );
+
+    if (_mm_movemask_epi8( _mm_or_si128( _mm_cmpgt_epi16( lo, max ), _mm_cmpgt_epi16( hi, max ))))
+        return FALSE;
+    _mm_storeu_si128( (__m128i *)dst, _mm_packus_epi16( lo, hi ));
+    return TRUE;
+}
+
+static SSE2_FUNC void blend_argb_row_sse2( DWORD *dst, const DWORD *src, int len )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s, d, lo, hi;
+    int x, i;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        lo = blend_argb_sse2( _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( s, zero ));
+        hi = blend_argb_sse2( _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( s, zero ));
+        if (!store_argb_sse2( dst + x, lo, hi ))
+            for (i = x; i < x + 4; i++) dst[i] = blend_argb( dst[i], src[i] );
+    }
+    for ( ; x < len; x++) dst[x] = blend_argb( dst[x], src[x] );
+}
+
+static SSE2_FUNC void blend_argb_alpha_row_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    const __m128i zero = _mm_setzero_si128(), mul = _mm_set1_epi16( alpha );
+    __m128i s, d, lo, hi;
+    int x, i;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        lo = div255_sse2( _mm_mullo_epi16( _mm_unpacklo_epi8( s, zero ), mul ));
+        hi = div255_sse2( _mm_mullo_epi16( _mm_unpackhi_epi8( s, zero ), mul ));
+        lo = blend_argb_sse2( _mm_unpacklo_epi8( d, zero ), lo );
+        hi = blend_argb_sse2( _mm_unpackhi_epi8( d, zero ), hi );
+        if (!store_argb_sse2( dst + x, lo, hi ))
+            for (i = x; i < x + 4; i++) dst[i] = blend_argb_alpha( dst[i], src[i], alpha );
+    }
+    for ( ; x < len; x++) dst[x] = blend_argb_alpha( dst[x], src[x], alpha );
+}
+
+static SSE2_FUNC void blend_constant_alpha_row_sse2( DWORD *dst, const DWORD *src, int len,
+                                                     DWORD alpha, DWORD src_mask )
+{
+    const __m128i zero = _mm_setzero_si128(), mask = _mm_set1_epi32( src_mask );
+    const __m128i mul = _mm_set1_epi16( alpha ), inv = _mm_set1_epi16( 255 - alpha );
+    __m128i s, d, lo, hi;
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)(src + x) ), mask );
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        lo = blend_color_sse2( _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( s, zero ), mul, inv );
+        hi = blend_color_sse2( _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( s, zero ), mul, inv );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_packus_epi16( lo, hi ));
+    }
+    for ( ; x < len; x++)
+    {
+        if (src_mask) dst[x] = blend_argb_no_src_alpha( dst[x], src[x], alpha );
+        else dst[x] = blend_argb_constant_alpha( dst[x], src[x], alpha );
+    }
+}
+
+static SSE2_FUNC void blend_argb_constant_alpha_row_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    blend_constant_alpha_row_sse2( dst, src, len, alpha, 0 );
+}
+
+static SSE2_FUNC void blend_argb_no_src_alpha_row_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    blend_constant_alpha_row_sse2( dst, src, len, alpha, 0xff000000 );
+}
+
+/* skip fully transparent runs and fill fully opaque runs of the glyph 16 pixels at a time */
+static SSE2_FUNC void draw_glyph_row_8888_sse2( DWORD *dst, const BYTE *glyph, int len, DWORD text_pixel,
+                                                const struct intensity_range *ranges )
+{
+    const __m128i one = _mm_set1_epi8( 1 ), sixteen = _mm_set1_epi8( 16 );
+    const __m128i text = _mm_set1_epi32( text_pixel );
+    __m128i level;
+    int x, i;
+
+    for (x = 0; x + 16 <= len; x += 16)
+    {
+        level = _mm_loadu_si128( (const __m128i *)(glyph + x) );
+        if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( level, one ), level )) == 0xffff)
+            continue;
+        if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_max_epu8( level, sixteen ), level )) == 0xffff)
+        {
+            for (i = 0; i < 16; i += 4) _mm_storeu_si128( (__m128i *)(dst + x + i), text );
+            continue;
+        }
+        for (i = x; i < x + 16; i++) draw_glyph_pixel_8888( dst + i, glyph[i], text_pixel, ranges );
+    }
+    for ( ; x < len; x++) draw_glyph_pixel_8888( dst + x, glyph[x], text_pixel, ranges );
+}
+
+static const struct row_funcs row_funcs_sse2 =
+{
+    blend_argb_row_sse2,
+    blend_argb_alpha_row_sse2,
+    blend_argb_constant_alpha_row_sse2,
+    blend_argb_no_src_alpha_row_sse2,
+    draw_glyph_row_8888_sse2
+};
+
+#endif  /* __GNUC__ && (__i386__ || __x86_64__) */
+
+/***********************************************************************
+ *           init_dib_primitives
+ *
+ * Select the best row operations supported by the CPU.
+ */
+void init_dib_primitives(void)
+{
+#ifdef SSE2_FUNC
+    if (IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE ))
+    {
+        TRACE( "using SSE2 row operations\n" );
+        row_funcs = &row_funcs_sse2;
+    }
+#endif
+}
+
 static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_info *glyph,
                              const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
 {
     DWORD *dst_ptr = get_pixel_ptr_32( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
-    int x, y;
+    int y;
 
     for (y = rect->top; y < rect->bottom; y++)
     {
-        for (x = 0; x < rect->right - rect->left; x++)
-        {
-            if (glyph_ptr[x] <= 1) continue;
-            if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
-            dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel, ranges + glyph_ptr[x] );
-        }
+        row_funcs->draw_glyph_8888( dst_ptr, glyph_ptr, rect->right - rect->left, text_pixel, ranges );
         dst_ptr += dib->stride / 4;
         glyph_ptr += glyph->stride;
     }
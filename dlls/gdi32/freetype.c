@@ -173,6 +173,7 @@ static FT_Error (*pFT_Property_Set)(FT_Library, const FT_String *, const FT_Stri
 
 #ifdef SONAME_LIBFONTCONFIG
 #include <fontconfig/fontconfig.h>
+MAKE_FUNCPTR(FcConfigGetFontDirs);
 MAKE_FUNCPTR(FcConfigSubstitute);
 MAKE_FUNCPTR(FcDefaultSubstitute);
 MAKE_FUNCPTR(FcFontList);
@@ -185,6 +186,8 @@ MAKE_FUNCPTR(FcPatternDestroy);
 MAKE_FUNCPTR(FcPatternGetBool);
 MAKE_FUNCPTR(FcPatternGetInteger);
 MAKE_FUNCPTR(FcPatternGetString);
+MAKE_FUNCPTR(FcStrListDone);
+MAKE_FUNCPTR(FcStrListNext);
 #ifndef FC_NAMELANG
 #define FC_NAMELANG "namelang"
 #endif
@@ -405,6 +408,9 @@ struct tagGdiFont {
     unsigned int refcount;
     GM **gm;
     DWORD gmsize;
+    struct list *glyph_cache;
+    struct list glyph_lru;
+    DWORD glyph_cache_size;
     OUTLINETEXTMETRICW *potm;
     DWORD total_kern_pairs;
     KERNINGPAIR *kern_pairs;
@@ -460,6 +466,24 @@ struct enum_charset_list {
 #define GM_BLOCK_SIZE 128
 #define FONT_GM(font,idx) (&(font)->gm[(idx) / GM_BLOCK_SIZE][(idx) % GM_BLOCK_SIZE])
 
+/* rendered glyph bitmaps and outlines, for the untransformed GetGlyphOutline formats */
+#define GLYPH_CACHE_BUCKETS   64
+#define GLYPH_CACHE_MAX_SIZE  (512 * 1024)  /* per font */
+
+struct cached_glyph
+{
+    struct list   entry;      /* entry in the hash bucket */
+    struct list   lru_entry;  /* entry in the font most-recently used list */
+    GdiFont      *font;       /* font used for rendering, may be a linked font */
+    UINT          index;
+    UINT          format;
+    BOOL          tategaki;
+    GLYPHMETRICS  gm;
+    ABC           abc;
+    DWORD         size;
+    BYTE          data[1];
+};
+
 static struct list gdi_font_list = LIST_INIT(gdi_font_list);
 static struct list unused_gdi_font_list = LIST_INIT(unused_gdi_font_list);
 static unsigned int unused_font_count;
@@ -1873,7 +1897,8 @@ static void remove_face_from_cache( Face *face )
 {
     HKEY hkey_family;
 
-    RegOpenKeyExW( hkey_font_cache, face->family->FamilyName, 0, KEY_ALL_ACCESS, &hkey_family );
+    if (RegOpenKeyExW( hkey_font_cache, face->family->FamilyName, 0, KEY_ALL_ACCESS, &hkey_family ))
+        return;
 
     if (face->scalable)
     {
@@ -1890,6 +1915,503 @@ static void remove_face_from_cache( Face *face )
     RegCloseKey(hkey_family);
 }
 
+/* The faces found when scanning the font directories are saved in a binary index file in the
+ * configuration directory instead of the registry cache. It is mapped by the following processes,
+ * even in later sessions, as long as the modification times of the directories that were scanned
+ * haven't changed. The registry cache then only holds the fonts added with AddFontResource, and
+ * its Index value is set. */
+
+#define FONT_INDEX_MAGIC    0x78646e69  /* "indx" */
+#define FONT_INDEX_VERSION  2
+
+struct font_index_header
+{
+    DWORD     magic;
+    DWORD     version;
+    DWORD     size;         /* total size of the file */
+    DWORD     config;       /* hash of the font configuration */
+    DWORD     dir_count;
+    DWORD     face_count;
+};
+
+struct font_index_dir
+{
+    ULONGLONG mtime;
+    DWORD     name;         /* offset of the unix path */
+    DWORD     pad;
+};
+
+struct font_index_face
+{
+    DWORD          family;       /* offsets of the strings, 0 if not present */
+    DWORD          english_name;
+    DWORD          style;
+    DWORD          full_name;
+    DWORD          file;
+    DWORD          flags;
+    DWORD          ntm_flags;
+    LONG           face_index;
+    LONG           font_version;
+    FONTSIGNATURE  fs;
+    ULONGLONG      dev;
+    ULONGLONG      ino;
+    BOOL           scalable;
+    SHORT          height;
+    SHORT          width;
+    SHORT          internal_leading;
+    SHORT          pad;
+    LONG           size;
+    LONG           x_ppem;
+    LONG           y_ppem;
+};
+
+struct font_index_dir_entry
+{
+    char     *name;
+    ULONGLONG mtime;
+};
+
+static const WCHAR font_index_value[] = {'I','n','d','e','x',0};
+static BOOL font_index_scan;
+static struct font_index_dir_entry *font_index_dirs;
+static unsigned int font_index_dir_count, font_index_dir_size;
+
+static char *get_font_index_name(void)
+{
+    static const char font_indexA[] = "/fontindex";
+    const char *dir = wine_get_config_dir();
+    char *name;
+
+    if (!dir) return NULL;
+    if (!(name = HeapAlloc( GetProcessHeap(), 0, strlen(dir) + sizeof(font_indexA) ))) return NULL;
+    strcpy( name, dir );
+    strcat( name, font_indexA );
+    return name;
+}
+
+static DWORD hash_font_config( DWORD hash, const void *data, DWORD size )
+{
+    const BYTE *ptr = data;
+
+    while (size--) hash = (hash ^ *ptr++) * 16777619;
+    return hash;
+}
+
+/* hash the fonts listed in the registry, except the external fonts that we write ourselves */
+static DWORD hash_font_reg_entries( DWORD hash )
+{
+    HKEY hkey, external_key;
+    DWORD i, type, name_len, data_len, max_name, max_data, ext_type, ext_len;
+    WCHAR *name;
+    BYTE *data, *ext_data;
+
+    if (RegOpenKeyW( HKEY_LOCAL_MACHINE, is_win9x() ? win9x_font_reg_key : winnt_font_reg_key, &hkey ))
+        return hash;
+    if (RegOpenKeyW( HKEY_CURRENT_USER, external_fonts_reg_key, &external_key )) external_key = 0;
+
+    if (!RegQueryInfoKeyW( hkey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &max_name, &max_data, NULL, NULL ))
+    {
+        max_name++;
+        name = HeapAlloc( GetProcessHeap(), 0, max_name * sizeof(WCHAR) );
+        data = HeapAlloc( GetProcessHeap(), 0, max_data );
+        ext_data = HeapAlloc( GetProcessHeap(), 0, max_data );
+        for (i = 0; name && data && ext_data; i++)
+        {
+            name_len = max_name;
+            data_len = max_data;
+            if (RegEnumValueW( hkey, i, name, &name_len, NULL, &type, data, &data_len )) break;
+
+            ext_len = max_data;
+            if (external_key && !RegQueryValueExW( external_key, name, NULL, &ext_type, ext_data, &ext_len ) &&
+                ext_type == type && ext_len == data_len && !memcmp( ext_data, data, data_len ))
+                continue;
+
+            hash = hash_font_config( hash, name, name_len * sizeof(WCHAR) );
+            hash = hash_font_config( hash, data, data_len );
+        }
+        HeapFree( GetProcessHeap(), 0, ext_data );
+        HeapFree( GetProcessHeap(), 0, data );
+        HeapFree( GetProcessHeap(), 0, name );
+    }
+    if (external_key) RegCloseKey( external_key );
+    RegCloseKey( hkey );
+    return hash;
+}
+
+/* hash the settings that select the font directories and the way faces are loaded */
+static DWORD get_font_config_hash(void)
+{
+    static const WCHAR pathW[] = {'P','a','t','h',0};
+    DWORD hash = 2166136261u, version = FT_SimpleVersion, size;
+    WCHAR *path;
+    HKEY hkey;
+
+    hash = hash_font_config( hash, &version, sizeof(version) );
+    hash = hash_font_config( hash, &default_aa_flags, sizeof(default_aa_flags) );
+    hash = hash_font_reg_entries( hash );
+
+    if (!RegOpenKeyW( HKEY_CURRENT_USER, wine_fonts_key, &hkey ))
+    {
+        if (!RegQueryValueExW( hkey, pathW, NULL, NULL, NULL, &size ) &&
+            (path = HeapAlloc( GetProcessHeap(), 0, size )))
+        {
+            if (!RegQueryValueExW( hkey, pathW, NULL, NULL, (BYTE *)path, &size ))
+                hash = hash_font_config( hash, path, size );
+            HeapFree( GetProcessHeap(), 0, path );
+        }
+        RegCloseKey( hkey );
+    }
+    return hash;
+}
+
+/* remember a directory that was scanned, that contains a font file, or that is watched by fontconfig */
+static void add_font_index_dir( const char *path, BOOL is_file )
+{
+    struct font_index_dir_entry *new_dirs;
+    const char *end = path + strlen( path );
+    struct stat st;
+    unsigned int i;
+    char *name;
+
+    if (!font_index_scan) return;
+    if (is_file && !(end = strrchr( path, '/' ))) return;
+
+    for (i = 0; i < font_index_dir_count; i++)
+        if (!strncmp( font_index_dirs[i].name, path, end - path ) && !font_index_dirs[i].name[end - path])
+            return;
+
+    if (!(name = HeapAlloc( GetProcessHeap(), 0, end - path + 1 ))) return;
+    memcpy( name, path, end - path );
+    name[end - path] = 0;
+    if (stat( name, &st ) == -1)
+    {
+        HeapFree( GetProcessHeap(), 0, name );
+        return;
+    }
+
+    if (font_index_dir_count == font_index_dir_size)
+    {
+        unsigned int new_size = max( 64, font_index_dir_size * 2 );
+
+        if (font_index_dirs)
+            new_dirs = HeapReAlloc( GetProcessHeap(), 0, font_index_dirs, new_size * sizeof(*new_dirs) );
+        else
+            new_dirs = HeapAlloc( GetProcessHeap(), 0, new_size * sizeof(*new_dirs) );
+        if (!new_dirs)
+        {
+            HeapFree( GetProcessHeap(), 0, name );
+            return;
+        }
+        font_index_dirs = new_dirs;
+        font_index_dir_size = new_size;
+    }
+    font_index_dirs[font_index_dir_count].name = name;
+    font_index_dirs[font_index_dir_count].mtime = st.st_mtime;
+    font_index_dir_count++;
+}
+
+static const WCHAR *get_font_index_string( const struct font_index_header *header, DWORD offset )
+{
+    const WCHAR *str, *end;
+
+    if (!offset || offset >= header->size || offset % sizeof(WCHAR)) return NULL;
+    str = (const WCHAR *)((const char *)header + offset);
+    end = (const WCHAR *)((const char *)header + header->size);
+    if (!memchrW( str, 0, end - str )) return NULL;
+    return str;
+}
+
+static BOOL validate_font_index( const struct font_index_header *header, DWORD size )
+{
+    const struct font_index_dir *dirs = (const struct font_index_dir *)(header + 1);
+    const char *name;
+    struct stat st;
+    DWORD i;
+
+    if (size < sizeof(*header) || header->magic != FONT_INDEX_MAGIC ||
+        header->version != FONT_INDEX_VERSION || header->size != size)
+        return FALSE;
+    if (header->dir_count > (size - sizeof(*header)) / sizeof(*dirs) ||
+        header->face_count > (size - sizeof(*header) - header->dir_count * sizeof(*dirs)) /
+                             sizeof(struct font_index_face))
+        return FALSE;
+    if (header->config != get_font_config_hash())
+    {
+        TRACE( "font configuration changed\n" );
+        return FALSE;
+    }
+
+    for (i = 0; i < header->dir_count; i++)
+    {
+        if (dirs[i].name >= size) return FALSE;
+        name = (const char *)header + dirs[i].name;
+        if (!memchr( name, 0, size - dirs[i].name )) return FALSE;
+        if (stat( name, &st ) == -1 || st.st_mtime != dirs[i].mtime)
+        {
+            TRACE( "%s changed\n", debugstr_a(name) );
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static Face *load_face_from_index( const struct font_index_header *header, const struct font_index_face *entry )
+{
+    const WCHAR *style = get_font_index_string( header, entry->style );
+    const WCHAR *full_name = get_font_index_string( header, entry->full_name );
+    const WCHAR *file = get_font_index_string( header, entry->file );
+    Face *face;
+
+    if (!style || !file) return NULL;
+    if (!(face = HeapAlloc( GetProcessHeap(), 0, sizeof(*face) ))) return NULL;
+
+    face->refcount = 1;
+    face->StyleName = strdupW( style );
+    face->FullName = full_name ? strdupW( full_name ) : NULL;
+    face->file = strdupW( file );
+    face->dev = entry->dev;
+    face->ino = entry->ino;
+    face->font_data_ptr = NULL;
+    face->font_data_size = 0;
+    face->face_index = entry->face_index;
+    face->fs = entry->fs;
+    face->ntmFlags = entry->ntm_flags;
+    face->font_version = entry->font_version;
+    face->scalable = entry->scalable;
+    memset( &face->size, 0, sizeof(face->size) );
+    if (!face->scalable)
+    {
+        face->size.height = entry->height;
+        face->size.width = entry->width;
+        face->size.size = entry->size;
+        face->size.x_ppem = entry->x_ppem;
+        face->size.y_ppem = entry->y_ppem;
+        face->size.internal_leading = entry->internal_leading;
+    }
+    face->flags = entry->flags;
+    face->family = NULL;
+    face->cached_enum_data = NULL;
+    return face;
+}
+
+static BOOL load_font_list_from_index(void)
+{
+    const struct font_index_header *header;
+    const struct font_index_face *faces;
+    const WCHAR *family_name, *english_name;
+    Family *family = NULL;
+    DWORD i, family_offset = 0;
+    struct stat st;
+    void *data;
+    char *name;
+    int fd;
+    BOOL ret = FALSE;
+
+    if (!(name = get_font_index_name())) return FALSE;
+    fd = open( name, O_RDONLY );
+    HeapFree( GetProcessHeap(), 0, name );
+    if (fd == -1) return FALSE;
+
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > MAXLONG ||
+        (data = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return FALSE;
+    }
+    close( fd );
+
+    header = data;
+    if (!validate_font_index( header, st.st_size )) goto done;
+
+    TRACE( "loading %u faces from the font index\n", header->face_count );
+    faces = (const struct font_index_face *)((const struct font_index_dir *)(header + 1) + header->dir_count);
+    for (i = 0; i < header->face_count; i++)
+    {
+        Face *face;
+
+        if (!family || faces[i].family != family_offset)
+        {
+            if (family) release_family( family );
+            family = NULL;
+            if (!(family_name = get_font_index_string( header, faces[i].family ))) continue;
+            english_name = get_font_index_string( header, faces[i].english_name );
+            family_offset = faces[i].family;
+            family = create_family( strdupW( family_name ), english_name ? strdupW( english_name ) : NULL );
+            if (english_name)
+            {
+                FontSubst *subst = HeapAlloc( GetProcessHeap(), 0, sizeof(*subst) );
+                subst->from.name = strdupW( english_name );
+                subst->from.charset = -1;
+                subst->to.name = strdupW( family_name );
+                subst->to.charset = -1;
+                add_font_subst( &font_subst_list, subst, 0 );
+            }
+        }
+        if (!(face = load_face_from_index( header, &faces[i] ))) continue;
+        if (insert_face_in_family_list( face, family ))
+            TRACE( "Added font %s %s\n", debugstr_w(family->FamilyName), debugstr_w(face->StyleName) );
+        release_face( face );
+    }
+    if (family) release_family( family );
+    ret = TRUE;
+
+done:
+    munmap( data, st.st_size );
+    return ret;
+}
+
+static DWORD add_font_index_string( BYTE *data, DWORD *pos, const WCHAR *str )
+{
+    DWORD ret = *pos, len;
+
+    if (!str) return 0;
+    len = (strlenW( str ) + 1) * sizeof(WCHAR);
+    if (data) memcpy( data + ret, str, len );
+    *pos += len;
+    return ret;
+}
+
+static DWORD add_font_index_data( BYTE *data, BOOL write )
+{
+    struct font_index_header *header = (struct font_index_header *)data;
+    struct font_index_dir *dirs = (struct font_index_dir *)(header + 1);
+    struct font_index_face *entry = (struct font_index_face *)(dirs + font_index_dir_count);
+    BYTE *strings = write ? data : NULL;
+    DWORD pos, face_count = 0, family_offset, english_offset, len;
+    Family *family;
+    Face *face;
+    unsigned int i;
+
+    LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry )
+        LIST_FOR_EACH_ENTRY( face, &family->faces, Face, entry )
+            if (face->file && (face->flags & ADDFONT_ADD_TO_CACHE)) face_count++;
+
+    pos = sizeof(*header) + font_index_dir_count * sizeof(*dirs) + face_count * sizeof(*entry);
+
+    for (i = 0; i < font_index_dir_count; i++)
+    {
+        len = strlen( font_index_dirs[i].name ) + 1;
+        if (write)
+        {
+            dirs[i].mtime = font_index_dirs[i].mtime;
+            dirs[i].name = pos;
+            dirs[i].pad = 0;
+            memcpy( data + pos, font_index_dirs[i].name, len );
+        }
+        pos += len;
+    }
+    pos = (pos + sizeof(WCHAR) - 1) & ~(sizeof(WCHAR) - 1);
+
+    LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry )
+    {
+        family_offset = english_offset = 0;
+        LIST_FOR_EACH_ENTRY( face, &family->faces, Face, entry )
+        {
+            if (!face->file || !(face->flags & ADDFONT_ADD_TO_CACHE)) continue;
+            if (!family_offset)
+            {
+                family_offset = add_font_index_string( strings, &pos, family->FamilyName );
+                english_offset = add_font_index_string( strings, &pos, family->EnglishName );
+            }
+            if (write)
+            {
+                memset( entry, 0, sizeof(*entry) );
+                entry->family = family_offset;
+                entry->english_name = english_offset;
+                entry->flags = face->flags;
+                entry->ntm_flags = face->ntmFlags;
+                entry->face_index = face->face_index;
+                entry->font_version = face->font_version;
+                entry->fs = face->fs;
+                entry->dev = face->dev;
+                entry->ino = face->ino;
+                entry->scalable = face->scalable;
+                entry->height = face->size.height;
+                entry->width = face->size.width;
+                entry->internal_leading = face->size.internal_leading;
+                entry->size = face->size.size;
+                entry->x_ppem = face->size.x_ppem;
+                entry->y_ppem = face->size.y_ppem;
+            }
+            len = add_font_index_string( strings, &pos, face->StyleName );
+            if (write) entry->style = len;
+            len = add_font_index_string( strings, &pos, face->FullName );
+            if (write) entry->full_name = len;
+            len = add_font_index_string( strings, &pos, face->file );
+            if (write) entry++->file = len;
+        }
+    }
+
+    if (write)
+    {
+        header->magic = FONT_INDEX_MAGIC;
+        header->version = FONT_INDEX_VERSION;
+        header->size = pos;
+        header->config = get_font_config_hash();
+        header->dir_count = font_index_dir_count;
+        header->face_count = face_count;
+    }
+    return pos;
+}
+
+/* save the result of init_font_list() for the next processes */
+static BOOL save_font_index(void)
+{
+    char *name, *tmp_name;
+    DWORD size;
+    BYTE *data;
+    unsigned int i;
+    BOOL ret = FALSE;
+    int fd;
+
+    size = add_font_index_data( NULL, FALSE );
+    if (!(data = HeapAlloc( GetProcessHeap(), 0, size ))) goto done;
+    add_font_index_data( data, TRUE );
+
+    if (!(name = get_font_index_name())) goto done;
+    if ((tmp_name = HeapAlloc( GetProcessHeap(), 0, strlen(name) + 16 )))
+    {
+        sprintf( tmp_name, "%s.%x", name, GetCurrentProcessId() );
+        if ((fd = open( tmp_name, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) != -1)
+        {
+            BOOL ok = (write( fd, data, size ) == size);
+            close( fd );
+            if (!ok || rename( tmp_name, name ) == -1)
+            {
+                WARN( "failed to write %s\n", debugstr_a(name) );
+                unlink( tmp_name );
+            }
+            else
+            {
+                TRACE( "saved %u directories and %u faces in %s\n", font_index_dir_count,
+                       ((struct font_index_header *)data)->face_count, debugstr_a(name) );
+                ret = TRUE;
+            }
+        }
+        HeapFree( GetProcessHeap(), 0, tmp_name );
+    }
+    HeapFree( GetProcessHeap(), 0, name );
+
+done:
+    HeapFree( GetProcessHeap(), 0, data );
+    for (i = 0; i < font_index_dir_count; i++) HeapFree( GetProcessHeap(), 0, font_index_dirs[i].name );
+    HeapFree( GetProcessHeap(), 0, font_index_dirs );
+    font_index_dirs = NULL;
+    font_index_dir_count = font_index_dir_size = 0;
+    return ret;
+}
+
+/* fall back to the registry cache if the index couldn't be saved */
+static void add_font_list_to_cache(void)
+{
+    Family *family;
+    Face *face;
+
+    LIST_FOR_EACH_ENTRY( family, &font_list, Family, entry )
+        LIST_FOR_EACH_ENTRY( face, &family->faces, Face, entry )
+            if (face->flags & ADDFONT_ADD_TO_CACHE) add_face_to_cache( face );
+}
+
 static WCHAR *prepend_at(WCHAR *family)
 {
     WCHAR *str;
@@ -2154,7 +2676,7 @@ static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr
 
     if (insert_face_in_family_list( face, family ))
     {
-        if (flags & ADDFONT_ADD_TO_CACHE)
+        if ((flags & ADDFONT_ADD_TO_CACHE) && !font_index_scan)
             add_face_to_cache( face );
 
         TRACE("Added font %s %s\n", debugstr_w(family->FamilyName),
@@ -2284,6 +2806,7 @@ static INT AddFontToList(const char *file, void *font_data_ptr, DWORD font_data_
             return 0;
         }
 
+        if (!face_index && file && (flags & ADDFONT_ADD_TO_CACHE)) add_font_index_dir(file, TRUE);
         AddFaceToList(ft_face, file, font_data_ptr, font_data_size, face_index, flags);
         ++ret;
 
@@ -2730,6 +3253,7 @@ static BOOL ReadFontDir(const char *dirname, BOOL external_fonts)
         WARN("Can't open directory %s\n", debugstr_a(dirname));
 	return FALSE;
     }
+    add_font_index_dir(dirname, FALSE);
     while((dent = readdir(dir)) != NULL) {
 	struct stat statbuf;
 
@@ -2796,6 +3320,7 @@ static void init_fontconfig(void)
     }
 
 #define LOAD_FUNCPTR(f) if((p##f = wine_dlsym(fc_handle, #f, NULL, 0)) == NULL){WARN("Can't find symbol %s\n", #f); return;}
+    LOAD_FUNCPTR(FcConfigGetFontDirs);
     LOAD_FUNCPTR(FcConfigSubstitute);
     LOAD_FUNCPTR(FcDefaultSubstitute);
     LOAD_FUNCPTR(FcFontList);
@@ -2808,6 +3333,8 @@ static void init_fontconfig(void)
     LOAD_FUNCPTR(FcPatternGetBool);
     LOAD_FUNCPTR(FcPatternGetInteger);
     LOAD_FUNCPTR(FcPatternGetString);
+    LOAD_FUNCPTR(FcStrListDone);
+    LOAD_FUNCPTR(FcStrListNext);
 #undef LOAD_FUNCPTR
 
     if (pFcInit())
@@ -2834,12 +3361,22 @@ static void load_fontconfig_fonts(void)
 {
     FcPattern *pat;
     FcFontSet *fontset;
+    FcStrList *dirs;
+    FcChar8 *dir;
     int i, len;
     char *file;
     const char *ext;
 
     if (!fontconfig_enabled) return;
 
+    /* the index is invalidated by new fonts in any of the fontconfig directories,
+     * including subdirectories that don't contain fonts yet */
+    if (font_index_scan && (dirs = pFcConfigGetFontDirs( NULL )))
+    {
+        while ((dir = pFcStrListNext( dirs ))) add_font_index_dir( (const char *)dir, FALSE );
+        pFcStrListDone( dirs );
+    }
+
     pat = pFcPatternCreate();
     if (!pat) return;
 
@@ -4376,7 +4913,8 @@ static void reorder_font_list(void)
 BOOL WineEngInit(void)
 {
     HKEY hkey;
-    DWORD disposition;
+    DWORD disposition, index;
+    BOOL update_reg;
     HANDLE font_mutex;
 
     /* update locale dependent font info in registry */
@@ -4413,9 +4951,35 @@ BOOL WineEngInit(void)
     WaitForSingleObject(font_mutex, INFINITE);
 
     create_font_cache_key(&hkey_font_cache, &disposition);
+    update_reg = (disposition == REG_CREATED_NEW_KEY);
 
-    if(disposition == REG_CREATED_NEW_KEY)
-        init_font_list();
+    if (disposition == REG_CREATED_NEW_KEY || !reg_load_dword(hkey_font_cache, font_index_value, &index))
+    {
+        if (load_font_list_from_index())
+        {
+            if (disposition == REG_CREATED_NEW_KEY)
+            {
+                /* the external font entries are written again from the new font list */
+                delete_external_font_keys();
+                update_reg = TRUE;
+            }
+            index = TRUE;
+        }
+        else
+        {
+            font_index_scan = TRUE;
+            init_font_list();
+            font_index_scan = FALSE;
+            update_reg = TRUE;
+            if (!(index = save_font_index()) && disposition == REG_CREATED_NEW_KEY)
+                add_font_list_to_cache();
+        }
+        if (disposition == REG_CREATED_NEW_KEY)
+        {
+            if (index) reg_save_dword(hkey_font_cache, font_index_value, TRUE);
+        }
+        else load_font_list_from_cache(hkey_font_cache);  /* fonts added with AddFontResource */
+    }
     else
         load_font_list_from_cache(hkey_font_cache);
 
@@ -4426,7 +4990,7 @@ BOOL WineEngInit(void)
     DumpSubstList();
     LoadReplaceList();
 
-    if(disposition == REG_CREATED_NEW_KEY)
+    if (update_reg)
         update_reg_entries();
 
     init_system_links();
@@ -4667,6 +5231,7 @@ static GdiFont *alloc_font(void)
     ret->gmsize = 1;
     ret->gm = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(GM*));
     ret->gm[0] = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(GM) * GM_BLOCK_SIZE);
+    list_init(&ret->glyph_lru);
     ret->potm = NULL;
     ret->font_desc.matrix.eM11 = ret->font_desc.matrix.eM22 = 1.0;
     ret->total_kern_pairs = (DWORD)-1;
@@ -4679,6 +5244,7 @@ static GdiFont *alloc_font(void)
 static void free_font(GdiFont *font)
 {
     CHILD_FONT *child, *child_next;
+    struct cached_glyph *glyph, *glyph_next;
     DWORD i;
 
     LIST_FOR_EACH_ENTRY_SAFE( child, child_next, &font->child_fonts, CHILD_FONT, entry )
@@ -4700,6 +5266,9 @@ static void free_font(GdiFont *font)
     for (i = 0; i < font->gmsize; i++)
         HeapFree(GetProcessHeap(),0,font->gm[i]);
     HeapFree(GetProcessHeap(), 0, font->gm);
+    LIST_FOR_EACH_ENTRY_SAFE( glyph, glyph_next, &font->glyph_lru, struct cached_glyph, lru_entry )
+        HeapFree(GetProcessHeap(), 0, glyph);
+    HeapFree(GetProcessHeap(), 0, font->glyph_cache);
     HeapFree(GetProcessHeap(), 0, font->GSUB_Table);
     HeapFree(GetProcessHeap(), 0, font);
 }
@@ -4751,6 +5320,94 @@ static void set_cached_metrics( GdiFont *font, UINT index, const GLYPHMETRICS *g
     font->gm[block][entry].init = TRUE;
 }
 
+static inline UINT glyph_cache_bucket( UINT index, UINT format )
+{
+    return (index ^ (format << 4)) % GLYPH_CACHE_BUCKETS;
+}
+
+static struct cached_glyph *find_cached_glyph( GdiFont *incoming_font, GdiFont *font, UINT index,
+                                               UINT format, BOOL tategaki )
+{
+    struct cached_glyph *glyph;
+
+    if (!incoming_font->glyph_cache) return NULL;
+
+    LIST_FOR_EACH_ENTRY( glyph, &incoming_font->glyph_cache[glyph_cache_bucket( index, format )],
+                         struct cached_glyph, entry )
+    {
+        if (glyph->index != index || glyph->format != format || glyph->font != font ||
+            glyph->tategaki != tategaki)
+            continue;
+        list_remove( &glyph->lru_entry );
+        list_add_head( &incoming_font->glyph_lru, &glyph->lru_entry );
+        return glyph;
+    }
+    return NULL;
+}
+
+static struct cached_glyph *alloc_cached_glyph( GdiFont *incoming_font, GdiFont *font, UINT index,
+                                                UINT format, BOOL tategaki, DWORD size )
+{
+    struct cached_glyph *glyph;
+    struct list *ptr;
+    UINT i;
+
+    if (size > GLYPH_CACHE_MAX_SIZE / 4) return NULL;
+
+    if (!incoming_font->glyph_cache)
+    {
+        incoming_font->glyph_cache = HeapAlloc( GetProcessHeap(), 0,
+                                                GLYPH_CACHE_BUCKETS * sizeof(*incoming_font->glyph_cache) );
+        if (!incoming_font->glyph_cache) return NULL;
+        for (i = 0; i < GLYPH_CACHE_BUCKETS; i++) list_init( &incoming_font->glyph_cache[i] );
+    }
+
+    while (incoming_font->glyph_cache_size + size > GLYPH_CACHE_MAX_SIZE &&
+           (ptr = list_tail( &incoming_font->glyph_lru )))
+    {
+        glyph = LIST_ENTRY( ptr, struct cached_glyph, lru_entry );
+        list_remove( &glyph->entry );
+        list_remove( &glyph->lru_entry );
+        incoming_font->glyph_cache_size -= glyph->size;
+        HeapFree( GetProcessHeap(), 0, glyph );
+    }
+
+    if (!(glyph = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( struct cached_glyph, data[size] ))))
+        return NULL;
+    glyph->font = font;
+    glyph->index = index;
+    glyph->format = format;
+    glyph->tategaki = tategaki;
+    glyph->size = size;
+    return glyph;
+}
+
+static void add_cached_glyph( GdiFont *incoming_font, struct cached_glyph *glyph )
+{
+    list_add_head( &incoming_font->glyph_cache[glyph_cache_bucket( glyph->index, glyph->format )],
+                   &glyph->entry );
+    list_add_head( &incoming_font->glyph_lru, &glyph->lru_entry );
+    incoming_font->glyph_cache_size += glyph->size;
+}
+
+static DWORD get_cached_glyph_data( const struct cached_glyph *glyph, GLYPHMETRICS *gm, ABC *abc,
+                                    DWORD buflen, BYTE *buf )
+{
+    UINT format = glyph->format & ~GGO_UNHINTED;
+
+    *abc = glyph->abc;
+    if (buf && buflen)
+    {
+        if (glyph->size > buflen) return GDI_ERROR;
+        memcpy( buf, glyph->data, glyph->size );
+        /* the bitmap formats clear the whole buffer */
+        if (format != GGO_NATIVE && format != GGO_BEZIER)
+            memset( buf + glyph->size, 0, buflen - glyph->size );
+    }
+    *gm = glyph->gm;
+    return glyph->size;
+}
+
 static DWORD get_font_data( GdiFont *font, DWORD table, DWORD offset, LPVOID buf, DWORD cbData)
 {
     FT_Face ft_face = font->ft_face;
@@ -7519,6 +8176,80 @@ static FT_Int get_load_flags( UINT format )
     return load_flags;
 }
 
+static DWORD get_glyph_data( FT_GlyphSlot glyph, FT_BBox bbox, UINT format, BOOL fake_bold,
+                             BOOL needs_transform, FT_Matrix matrices[3], GLYPHMETRICS *gm,
+                             DWORD buflen, BYTE *buf )
+{
+    DWORD needed;
+
+    switch (format)
+    {
+    case GGO_BITMAP:
+        needed = get_mono_glyph_bitmap( glyph, bbox, fake_bold,
+                                        needs_transform, matrices, buflen, buf );
+        break;
+
+    case GGO_GRAY2_BITMAP:
+    case GGO_GRAY4_BITMAP:
+    case GGO_GRAY8_BITMAP:
+    case WINE_GGO_GRAY16_BITMAP:
+        needed = get_antialias_glyph_bitmap( glyph, bbox, format, fake_bold,
+                                             needs_transform, matrices, buflen, buf );
+	break;
+
+    case WINE_GGO_HRGB_BITMAP:
+    case WINE_GGO_HBGR_BITMAP:
+    case WINE_GGO_VRGB_BITMAP:
+    case WINE_GGO_VBGR_BITMAP:
+        needed = get_subpixel_glyph_bitmap( glyph, bbox, format, fake_bold,
+                                            needs_transform, matrices, gm, buflen, buf );
+        break;
+
+    case GGO_NATIVE:
+      {
+        FT_Outline *outline = &glyph->outline;
+
+        if(buflen == 0) buf = NULL;
+
+        if (needs_transform && buf)
+            pFT_Outline_Transform( outline, &matrices[matrix_vert] );
+
+        needed = get_native_glyph_outline(outline, buflen, NULL);
+
+        if (!buf || !buflen)
+            break;
+        if (needed > buflen)
+            return GDI_ERROR;
+
+        get_native_glyph_outline(outline, buflen, buf);
+        break;
+      }
+    case GGO_BEZIER:
+      {
+        FT_Outline *outline = &glyph->outline;
+        if(buflen == 0) buf = NULL;
+
+        if (needs_transform && buf)
+            pFT_Outline_Transform( outline, &matrices[matrix_vert] );
+
+        needed = get_bezier_glyph_outline(outline, buflen, NULL);
+
+        if (!buf || !buflen)
+            break;
+        if (needed > buflen)
+            return GDI_ERROR;
+
+        get_bezier_glyph_outline(outline, buflen, buf);
+        break;
+      }
+
+    default:
+        FIXME("Unsupported format %d\n", format);
+	return GDI_ERROR;
+    }
+    return needed;
+}
+
 static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
                                LPGLYPHMETRICS lpgm, ABC *abc, DWORD buflen, LPVOID buf,
                                const MAT2* lpmat)
@@ -7536,6 +8267,8 @@ static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
     BOOL needsTransform = FALSE;
     BOOL tategaki = (font->name[0] == '@');
     BOOL vertical_metrics;
+    struct cached_glyph *cached;
+    UINT cache_format;
 
     TRACE("%p, %04x, %08x, %p, %08x, %p, %p\n", font, glyph, format, lpgm,
 	  buflen, buf, lpmat);
@@ -7564,12 +8297,18 @@ static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
             tategaki = check_unicode_tategaki(glyph);
     }
 
+    /* hinted and unhinted glyphs are loaded with different flags */
+    cache_format = format;
     format &= ~GGO_UNHINTED;
 
     if (format == GGO_METRICS && is_identity_MAT2(lpmat) &&
         get_cached_metrics( font, glyph_index, lpgm, abc ))
         return 1; /* FIXME */
 
+    if (format != GGO_METRICS && is_identity_MAT2(lpmat) &&
+        (cached = find_cached_glyph( incoming_font, font, glyph_index, cache_format, tategaki )))
+        return get_cached_glyph_data( cached, lpgm, abc, buflen, buf );
+
     needsTransform = get_transform_matrices( font, tategaki, lpmat, matrices );
 
     vertical_metrics = (tategaki && FT_HAS_VERTICAL(ft_face));
@@ -7631,71 +8370,33 @@ static DWORD get_glyph_outline(GdiFont *incoming_font, UINT glyph, UINT format,
 	return GDI_ERROR;
     }
 
-    switch (format)
+    if (is_identity_MAT2(lpmat))
     {
-    case GGO_BITMAP:
-        needed = get_mono_glyph_bitmap( ft_face->glyph, bbox, font->fake_bold,
-                                        needsTransform, matrices, buflen, buf );
-        break;
-
-    case GGO_GRAY2_BITMAP:
-    case GGO_GRAY4_BITMAP:
-    case GGO_GRAY8_BITMAP:
-    case WINE_GGO_GRAY16_BITMAP:
-        needed = get_antialias_glyph_bitmap( ft_face->glyph, bbox, format, font->fake_bold,
-                                             needsTransform, matrices, buflen, buf );
-	break;
-
-    case WINE_GGO_HRGB_BITMAP:
-    case WINE_GGO_HBGR_BITMAP:
-    case WINE_GGO_VRGB_BITMAP:
-    case WINE_GGO_VBGR_BITMAP:
-        needed = get_subpixel_glyph_bitmap( ft_face->glyph, bbox, format, font->fake_bold,
-                                            needsTransform, matrices, &gm, buflen, buf );
-        break;
-
-    case GGO_NATIVE:
-      {
-        FT_Outline *outline = &ft_face->glyph->outline;
-
-        if(buflen == 0) buf = NULL;
+        GLYPHMETRICS query_gm = gm;
 
-        if (needsTransform && buf)
-            pFT_Outline_Transform( outline, &matrices[matrix_vert] );
-
-        needed = get_native_glyph_outline(outline, buflen, NULL);
-
-        if (!buf || !buflen)
-            break;
-        if (needed > buflen)
-            return GDI_ERROR;
-
-        get_native_glyph_outline(outline, buflen, buf);
-        break;
-      }
-    case GGO_BEZIER:
-      {
-        FT_Outline *outline = &ft_face->glyph->outline;
-        if(buflen == 0) buf = NULL;
-
-        if (needsTransform && buf)
-            pFT_Outline_Transform( outline, &matrices[matrix_vert] );
-
-        needed = get_bezier_glyph_outline(outline, buflen, NULL);
-
-        if (!buf || !buflen)
-            break;
-        if (needed > buflen)
+        /* render into the cache, so that querying the size and retrieving the data only
+         * renders the glyph once */
+        needed = get_glyph_data( ft_face->glyph, bbox, format, font->fake_bold, needsTransform,
+                                 matrices, &query_gm, 0, NULL );
+        if (needed == GDI_ERROR) return GDI_ERROR;
+        if (needed &&
+            (cached = alloc_cached_glyph( incoming_font, font, glyph_index, cache_format, tategaki, needed )))
+        {
+            cached->gm = gm;
+            cached->abc = *abc;
+            if (get_glyph_data( ft_face->glyph, bbox, format, font->fake_bold, needsTransform,
+                                matrices, &cached->gm, needed, cached->data ) == needed)
+            {
+                add_cached_glyph( incoming_font, cached );
+                return get_cached_glyph_data( cached, lpgm, abc, buflen, buf );
+            }
+            HeapFree( GetProcessHeap(), 0, cached );
             return GDI_ERROR;
-
-        get_bezier_glyph_outline(outline, buflen, buf);
-        break;
-      }
-
-    default:
-        FIXME("Unsupported format %d\n", format);
-	return GDI_ERROR;
+        }
     }
+
+    needed = get_glyph_data( ft_face->glyph, bbox, format, font->fake_bold, needsTransform,
+                             matrices, &gm, buflen, buf );
     if (needed != GDI_ERROR)
         *lpgm = gm;
 
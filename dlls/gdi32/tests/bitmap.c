@@ -20,6 +20,8 @@
  */
 
 #include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 
@@ -30,6 +32,7 @@
 #include "winerror.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "winreg.h"
 #include "mmsystem.h"
 #include "winternl.h"
 #include "ddk/d3dkmthk.h"
@@ -3846,6 +3849,109 @@ static void test_GdiAlphaBlend(void)
     HeapFree(GetProcessHeap(), 0, bmi);
 }
 
+static void test_GdiAlphaBlend_rows(void)
+{
+    static const struct
+    {
+        BYTE alpha;
+        BYTE format;
+        DWORD compression;
+        BOOL premultiply;
+    }
+    tests[] =
+    {
+        { 255, AC_SRC_ALPHA, BI_RGB, TRUE },
+        { 255, AC_SRC_ALPHA, BI_RGB, FALSE },
+        { 77, AC_SRC_ALPHA, BI_RGB, TRUE },
+        { 77, AC_SRC_ALPHA, BI_RGB, FALSE },
+        { 77, 0, BI_RGB, FALSE },
+        { 200, 0, BI_BITFIELDS, FALSE },
+    };
+    char bmibuf[FIELD_OFFSET( BITMAPINFO, bmiColors[3] )];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    DWORD *src_bits, *row_bits, *pixel_bits, seed = 12345;
+    HBITMAP src_bmp, row_bmp, pixel_bmp, old_bmp;
+    HDC src_dc, row_dc, pixel_dc;
+    BLENDFUNCTION blend;
+    unsigned int i, x;
+    BOOL ret;
+
+    if (!pGdiAlphaBlend)
+    {
+        win_skip("GdiAlphaBlend() is not implemented\n");
+        return;
+    }
+
+    src_dc = CreateCompatibleDC( NULL );
+    row_dc = CreateCompatibleDC( NULL );
+    pixel_dc = CreateCompatibleDC( NULL );
+
+    memset( bmibuf, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = 37;
+    bmi->bmiHeader.biHeight = 1;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biBitCount = 32;
+    bmi->bmiHeader.biCompression = BI_RGB;
+    row_bmp = CreateDIBSection( row_dc, bmi, DIB_RGB_COLORS, (void **)&row_bits, NULL, 0 );
+    ok( row_bmp != NULL, "couldn't create bitmap\n" );
+    pixel_bmp = CreateDIBSection( pixel_dc, bmi, DIB_RGB_COLORS, (void **)&pixel_bits, NULL, 0 );
+    ok( pixel_bmp != NULL, "couldn't create bitmap\n" );
+    SelectObject( row_dc, row_bmp );
+    SelectObject( pixel_dc, pixel_bmp );
+
+    /* a whole row must be blended exactly like each of its pixels on its own */
+    for (i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        bmi->bmiHeader.biCompression = tests[i].compression;
+        ((DWORD *)bmi->bmiColors)[0] = 0xff0000;
+        ((DWORD *)bmi->bmiColors)[1] = 0x00ff00;
+        ((DWORD *)bmi->bmiColors)[2] = 0x0000ff;
+        src_bmp = CreateDIBSection( src_dc, bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+        ok( src_bmp != NULL, "couldn't create bitmap\n" );
+        old_bmp = SelectObject( src_dc, src_bmp );
+
+        for (x = 0; x < 37; x++)
+        {
+            DWORD pixel = seed = seed * 1103515245 + 12345;
+            BYTE a = pixel >> 24;
+
+            if (tests[i].premultiply)
+                pixel = a << 24 | ((pixel >> 16) & 0xff) * a / 255 << 16 |
+                        ((pixel >> 8) & 0xff) * a / 255 << 8 | (pixel & 0xff) * a / 255;
+            src_bits[x] = pixel;
+            row_bits[x] = pixel_bits[x] = seed = seed * 1103515245 + 12345;
+        }
+
+        blend.BlendOp = AC_SRC_OVER;
+        blend.BlendFlags = 0;
+        blend.SourceConstantAlpha = tests[i].alpha;
+        blend.AlphaFormat = tests[i].format;
+
+        ret = pGdiAlphaBlend( row_dc, 0, 0, 37, 1, src_dc, 0, 0, 37, 1, blend );
+        ok( ret, "%u: GdiAlphaBlend failed err %u\n", i, GetLastError() );
+        for (x = 0; x < 37; x++)
+        {
+            ret = pGdiAlphaBlend( pixel_dc, x, 0, 1, 1, src_dc, x, 0, 1, 1, blend );
+            ok( ret, "%u: GdiAlphaBlend failed err %u\n", i, GetLastError() );
+        }
+        GdiFlush();
+
+        for (x = 0; x < 37; x++)
+            ok( row_bits[x] == pixel_bits[x], "%u: pixel %u: got %08x, expected %08x\n",
+                i, x, row_bits[x], pixel_bits[x] );
+
+        SelectObject( src_dc, old_bmp );
+        DeleteObject( src_bmp );
+    }
+
+    DeleteDC( src_dc );
+    DeleteDC( row_dc );
+    DeleteDC( pixel_dc );
+    DeleteObject( row_bmp );
+    DeleteObject( pixel_bmp );
+}
+
 static void test_GdiGradientFill(void)
 {
     HDC hdc;
@@ -4002,6 +4108,146 @@ static void test_clipping(void)
     DeleteDC( hdcSrc );
 }
 
+#define BAND_TEST_SIZE  512
+#define BAND_TEST_COUNT 8
+
+static DWORD get_band_test_checksum( const DWORD *bits )
+{
+    DWORD sum = 0;
+    int i;
+
+    for (i = 0; i < BAND_TEST_SIZE * BAND_TEST_SIZE; i++) sum = sum * 33 + bits[i];
+    return sum;
+}
+
+/* draw large blends, gradients and stretches, which may be split in bands by the DIB engine */
+static void draw_band_test( DWORD sums[BAND_TEST_COUNT] )
+{
+    TRIVERTEX vert[3] =
+    {
+        { 0, 0, 0x1234, 0xff00, 0x0800, 0x8000 },
+        { BAND_TEST_SIZE, BAND_TEST_SIZE, 0xfe00, 0x0100, 0xc0c0, 0x4000 },
+        { 13, BAND_TEST_SIZE - 7, 0x7700, 0x3300, 0xff00, 0xff00 },
+    };
+    GRADIENT_TRIANGLE tri = { 0, 1, 2 };
+    GRADIENT_RECT rect = { 0, 1 };
+    BLENDFUNCTION blend;
+    BITMAPINFO info;
+    DWORD *dst_bits, *src_bits;
+    HBITMAP dst_bmp, src_bmp, old_dst, old_src;
+    HDC dst_dc, src_dc;
+    int i, n = 0;
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize        = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth       = BAND_TEST_SIZE;
+    info.bmiHeader.biHeight      = -BAND_TEST_SIZE;
+    info.bmiHeader.biPlanes      = 1;
+    info.bmiHeader.biBitCount    = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    dst_dc = CreateCompatibleDC( 0 );
+    src_dc = CreateCompatibleDC( 0 );
+    dst_bmp = CreateDIBSection( dst_dc, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    src_bmp = CreateDIBSection( src_dc, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    old_dst = SelectObject( dst_dc, dst_bmp );
+    old_src = SelectObject( src_dc, src_bmp );
+
+    for (i = 0; i < BAND_TEST_SIZE * BAND_TEST_SIZE; i++)
+    {
+        BYTE alpha = i % 251, color = (i / 509) % 256 * alpha / 255;
+
+        src_bits[i] = (alpha << 24) | (color << 16) | ((alpha - color) << 8) | (color / 2);
+        dst_bits[i] = (i * 2654435761u) & 0xffffff;
+    }
+
+    blend.BlendOp             = AC_SRC_OVER;
+    blend.BlendFlags          = 0;
+    blend.SourceConstantAlpha = 0xc0;
+    blend.AlphaFormat         = AC_SRC_ALPHA;
+    pGdiAlphaBlend( dst_dc, 3, 5, 500, 490, src_dc, 0, 0, 500, 490, blend );
+    sums[n++] = get_band_test_checksum( dst_bits );
+    pGdiAlphaBlend( dst_dc, 0, 0, BAND_TEST_SIZE, BAND_TEST_SIZE, src_dc, 10, 10, 97, 301, blend );
+    sums[n++] = get_band_test_checksum( dst_bits );
+    pGdiAlphaBlend( dst_dc, 0, 0, 500, 200, src_dc, 0, 0, BAND_TEST_SIZE, BAND_TEST_SIZE, blend );
+    sums[n++] = get_band_test_checksum( dst_bits );
+
+    pGdiGradientFill( dst_dc, vert, 2, &rect, 1, GRADIENT_FILL_RECT_H );
+    sums[n++] = get_band_test_checksum( dst_bits );
+    pGdiGradientFill( dst_dc, vert, 2, &rect, 1, GRADIENT_FILL_RECT_V );
+    sums[n++] = get_band_test_checksum( dst_bits );
+    pGdiGradientFill( dst_dc, vert, 3, &tri, 1, GRADIENT_FILL_TRIANGLE );
+    sums[n++] = get_band_test_checksum( dst_bits );
+
+    SetStretchBltMode( dst_dc, COLORONCOLOR );
+    StretchBlt( dst_dc, 0, 0, BAND_TEST_SIZE, BAND_TEST_SIZE, src_dc, 7, 3, 97, 131, SRCCOPY );
+    sums[n++] = get_band_test_checksum( dst_bits );
+    SetStretchBltMode( dst_dc, BLACKONWHITE );
+    StretchBlt( dst_dc, 0, 0, BAND_TEST_SIZE, 201, src_dc, 0, 0, BAND_TEST_SIZE, BAND_TEST_SIZE, SRCAND );
+    sums[n++] = get_band_test_checksum( dst_bits );
+    assert( n == BAND_TEST_COUNT );
+
+    SelectObject( dst_dc, old_dst );
+    SelectObject( src_dc, old_src );
+    DeleteObject( dst_bmp );
+    DeleteObject( src_bmp );
+    DeleteDC( dst_dc );
+    DeleteDC( src_dc );
+}
+
+/* draw in a child process with DibBandThreads set, and compare with the single-threaded output */
+static void test_band_threads(void)
+{
+    char cmdline[MAX_PATH + BAND_TEST_COUNT * 9 + 16], **argv;
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si;
+    DWORD sums[BAND_TEST_COUNT], value = 4;
+    HKEY key;
+    int i, len;
+
+    if (!pGdiAlphaBlend || !pGdiGradientFill)
+    {
+        win_skip( "GdiAlphaBlend or GdiGradientFill is not implemented\n" );
+        return;
+    }
+
+    draw_band_test( sums );
+
+    if (RegCreateKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\Gdi", 0, NULL, 0, KEY_SET_VALUE, NULL, &key, NULL ))
+    {
+        skip( "can't create the Gdi key\n" );
+        return;
+    }
+    RegSetValueExA( key, "DibBandThreads", 0, REG_DWORD, (BYTE *)&value, sizeof(value) );
+
+    winetest_get_mainargs( &argv );
+    len = sprintf( cmdline, "%s bitmap band_threads", argv[0] );
+    for (i = 0; i < BAND_TEST_COUNT; i++) len += sprintf( cmdline + len, " %08x", sums[i] );
+    memset( &si, 0, sizeof(si) );
+    si.cb = sizeof(si);
+    if (CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi ))
+    {
+        winetest_wait_child_process( pi.hProcess );
+        CloseHandle( pi.hProcess );
+        CloseHandle( pi.hThread );
+    }
+    else ok( 0, "CreateProcess failed: %u\n", GetLastError() );
+
+    RegDeleteValueA( key, "DibBandThreads" );
+    RegCloseKey( key );
+}
+
+static void test_band_threads_child( char **argv )
+{
+    DWORD sums[BAND_TEST_COUNT];
+    int i;
+
+    draw_band_test( sums );
+    for (i = 0; i < BAND_TEST_COUNT; i++)
+        ok( sums[i] == strtoul( argv[3 + i], NULL, 16 ), "%u: got checksum %08x, expected %s\n",
+            i, sums[i], argv[3 + i] );
+}
+
 static void test_32bit_ddb(void)
 {
     char buffer[sizeof(BITMAPINFOHEADER) + sizeof(DWORD)];
@@ -5952,6 +6198,8 @@ static void test_D3DKMTCreateDCFromMemory( void )
 START_TEST(bitmap)
 {
     HMODULE hdll;
+    char **argv;
+    int argc;
 
     hdll = GetModuleHandleA("gdi32.dll");
     pD3DKMTCreateDCFromMemory  = (void *)GetProcAddress( hdll, "D3DKMTCreateDCFromMemory" );
@@ -5960,6 +6208,13 @@ START_TEST(bitmap)
     pGdiGradientFill           = (void *)GetProcAddress( hdll, "GdiGradientFill" );
     pSetLayout                 = (void *)GetProcAddress( hdll, "SetLayout" );
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 + BAND_TEST_COUNT && !strcmp( argv[2], "band_threads" ))
+    {
+        test_band_threads_child( argv );
+        return;
+    }
+
     test_createdibitmap();
     test_dibsections();
     test_dib_formats();
@@ -5980,7 +6235,9 @@ START_TEST(bitmap)
     test_StretchBlt();
     test_StretchDIBits();
     test_GdiAlphaBlend();
+    test_GdiAlphaBlend_rows();
     test_GdiGradientFill();
+    test_band_threads();
     test_32bit_ddb();
     test_bitmapinfoheadersize();
     test_get16dibits();
@@ -4881,6 +4881,70 @@ static void test_GetGlyphOutline(void)
     DeleteDC(hdc);
 }
 
+static void test_GetGlyphOutline_repeat(void)
+{
+    static const MAT2 mat = { {0,1}, {0,0}, {0,0}, {0,1} };
+    static const UINT formats[] = { GGO_BITMAP, GGO_GRAY8_BITMAP, GGO_NATIVE, GGO_BEZIER };
+    GLYPHMETRICS gm, gm2;
+    LOGFONTA lf;
+    HFONT hfont, old_hfont;
+    BYTE *buf, *buf2;
+    DWORD size, ret;
+    HDC hdc;
+    UINT i, j;
+
+    if (!is_truetype_font_installed("Tahoma"))
+    {
+        skip("Tahoma is not installed\n");
+        return;
+    }
+
+    hdc = CreateCompatibleDC(0);
+    memset(&lf, 0, sizeof(lf));
+    lf.lfHeight = 72;
+    lstrcpyA(lf.lfFaceName, "Tahoma");
+    hfont = CreateFontIndirectA(&lf);
+    ok(hfont != 0, "CreateFontIndirectA error %u\n", GetLastError());
+    old_hfont = SelectObject(hdc, hfont);
+
+    for (i = 0; i < ARRAY_SIZE(formats); i++)
+    {
+        for (j = 'A'; j <= 'C'; j++)
+        {
+            memset(&gm, 0xcc, sizeof(gm));
+            size = GetGlyphOutlineW(hdc, j, formats[i], &gm, 0, NULL, &mat);
+            ok(size != GDI_ERROR && size, "%u/%c: GetGlyphOutlineW failed\n", formats[i], j);
+            if (size == GDI_ERROR || !size) continue;
+
+            buf = HeapAlloc(GetProcessHeap(), 0, size);
+            buf2 = HeapAlloc(GetProcessHeap(), 0, size);
+            memset(buf, 0xcc, size);
+            memset(buf2, 0x55, size);
+
+            memset(&gm2, 0xcc, sizeof(gm2));
+            ret = GetGlyphOutlineW(hdc, j, formats[i], &gm2, size, buf, &mat);
+            ok(ret == size, "%u/%c: got %u, expected %u\n", formats[i], j, ret, size);
+            ok(!memcmp(&gm, &gm2, sizeof(gm)), "%u/%c: metrics differ\n", formats[i], j);
+
+            memset(&gm2, 0xcc, sizeof(gm2));
+            ret = GetGlyphOutlineW(hdc, j, formats[i], &gm2, size, buf2, &mat);
+            ok(ret == size, "%u/%c: got %u, expected %u\n", formats[i], j, ret, size);
+            ok(!memcmp(&gm, &gm2, sizeof(gm)), "%u/%c: metrics differ\n", formats[i], j);
+            ok(!memcmp(buf, buf2, size), "%u/%c: data differs\n", formats[i], j);
+
+            ret = GetGlyphOutlineW(hdc, j, formats[i], &gm2, size - 1, buf2, &mat);
+            ok(ret == GDI_ERROR, "%u/%c: got %u\n", formats[i], j, ret);
+
+            HeapFree(GetProcessHeap(), 0, buf);
+            HeapFree(GetProcessHeap(), 0, buf2);
+        }
+    }
+
+    SelectObject(hdc, old_hfont);
+    DeleteObject(hfont);
+    DeleteDC(hdc);
+}
+
 /* bug #9995: there is a limit to the character width that can be specified */
 static void test_GetTextMetrics2(const char *fontname, int font_height)
 {
@@ -7250,6 +7314,7 @@ START_TEST(font)
     test_RealizationInfo();
     test_GetTextFace();
     test_GetGlyphOutline();
+    test_GetGlyphOutline_repeat();
     test_GetTextMetrics2("Tahoma", -11);
     test_GetTextMetrics2("Tahoma", -55);
     test_GetTextMetrics2("Tahoma", -110);
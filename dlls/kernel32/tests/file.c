@@ -4416,10 +4416,11 @@ static void test_WriteFileGather(void)
     HANDLE hfile, hiocp1, hiocp2, evt;
     DWORD ret, size, tx;
     ULONG_PTR key;
-    FILE_SEGMENT_ELEMENT fse[2];
+    FILE_SEGMENT_ELEMENT fse[2], fse4[5];
     OVERLAPPED ovl, *povl = NULL;
     SYSTEM_INFO si;
-    char *wbuf = NULL, *rbuf1, *rbuf2;
+    char *wbuf = NULL, *rbuf1, *rbuf2, *wbuf4, *rbuf4;
+    unsigned int i;
     BOOL br;
 
     evt = CreateEventW( NULL, TRUE, FALSE, NULL );
@@ -4586,6 +4587,62 @@ static void test_WriteFileGather(void)
     ok( memcmp( rbuf1 + si.dwPageSize / 2, rbuf2, si.dwPageSize - si.dwPageSize / 2 ) == 0,
             "invalid data was read into buffer\n" );
 
+    /* multiple segments, partly contiguous in memory */
+    wbuf4 = VirtualAlloc( NULL, si.dwPageSize * 4, MEM_COMMIT, PAGE_READWRITE );
+    ok( wbuf4 != NULL, "VirtualAlloc failed err %u\n", GetLastError() );
+    rbuf4 = VirtualAlloc( NULL, si.dwPageSize * 4, MEM_COMMIT, PAGE_READWRITE );
+    ok( rbuf4 != NULL, "VirtualAlloc failed err %u\n", GetLastError() );
+    for (i = 0; i < 4; i++) memset( wbuf4 + i * si.dwPageSize, 0x10 + i, si.dwPageSize );
+
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = evt;
+    memset( fse4, 0, sizeof(fse4) );
+    fse4[0].Buffer = wbuf4;
+    fse4[1].Buffer = wbuf4 + si.dwPageSize;
+    fse4[2].Buffer = wbuf4 + si.dwPageSize * 3;
+    fse4[3].Buffer = wbuf4 + si.dwPageSize * 2;
+    SetLastError( 0xdeadbeef );
+    if (!WriteFileGather( hfile, fse4, si.dwPageSize * 4, NULL, &ovl ))
+        ok( GetLastError() == ERROR_IO_PENDING, "WriteFileGather failed err %u\n", GetLastError() );
+
+    ret = GetQueuedCompletionStatus( hiocp2, &size, &key, &povl, 1000 );
+    ok( ret, "GetQueuedCompletionStatus failed err %u\n", GetLastError() );
+    ok( povl == &ovl, "wrong ovl %p\n", povl );
+
+    tx = 0;
+    br = GetOverlappedResult( hfile, &ovl, &tx, TRUE );
+    ok( br == TRUE, "GetOverlappedResult failed: %u\n", GetLastError() );
+    ok( tx == si.dwPageSize * 4, "got unexpected bytes transferred: %u\n", tx );
+
+    ResetEvent( evt );
+
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = evt;
+    memset( fse4, 0, sizeof(fse4) );
+    for (i = 0; i < 4; i++) fse4[i].Buffer = rbuf4 + i * si.dwPageSize;
+    memset( rbuf4, 0, si.dwPageSize * 4 );
+    SetLastError( 0xdeadbeef );
+    br = ReadFileScatter( hfile, fse4, si.dwPageSize * 4, NULL, &ovl );
+    ok( br == FALSE, "ReadFileScatter should be asynchronous\n" );
+    ok( GetLastError() == ERROR_IO_PENDING, "ReadFileScatter failed err %u\n", GetLastError() );
+
+    ret = GetQueuedCompletionStatus( hiocp2, &size, &key, &povl, 1000 );
+    ok( ret, "GetQueuedCompletionStatus failed err %u\n", GetLastError() );
+    ok( povl == &ovl, "wrong ovl %p\n", povl );
+
+    tx = 0;
+    br = GetOverlappedResult( hfile, &ovl, &tx, TRUE );
+    ok( br == TRUE, "GetOverlappedResult failed: %u\n", GetLastError() );
+    ok( tx == si.dwPageSize * 4, "got unexpected bytes transferred: %u\n", tx );
+
+    ok( !memcmp( rbuf4, wbuf4, si.dwPageSize * 2 ), "invalid data was read into buffer\n" );
+    ok( !memcmp( rbuf4 + si.dwPageSize * 2, wbuf4 + si.dwPageSize * 3, si.dwPageSize ),
+        "invalid data was read into buffer\n" );
+    ok( !memcmp( rbuf4 + si.dwPageSize * 3, wbuf4 + si.dwPageSize * 2, si.dwPageSize ),
+        "invalid data was read into buffer\n" );
+
+    ResetEvent( evt );
+
     if (pSetFileCompletionNotificationModes)
     {
         br = pSetFileCompletionNotificationModes(hfile, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS);
@@ -4629,6 +4686,8 @@ static void test_WriteFileGather(void)
     VirtualFree( wbuf, 0, MEM_RELEASE );
     VirtualFree( rbuf1, 0, MEM_RELEASE );
     VirtualFree( rbuf2, 0, MEM_RELEASE );
+    VirtualFree( wbuf4, 0, MEM_RELEASE );
+    VirtualFree( rbuf4, 0, MEM_RELEASE );
     CloseHandle( evt );
     DeleteFileA( filename );
 }
@@ -57,6 +57,9 @@
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #ifdef MAJOR_IN_MKDEV
 # include <sys/mkdev.h>
 #elif defined(MAJOR_IN_SYSMACROS)
@@ -1017,6 +1020,38 @@ err:
 }
 
 
+/* build an iovec array for the part of a segment list starting at byte pos,
+ * merging segments that are contiguous in memory; returns the iovec count */
+static int get_segment_iovecs( const FILE_SEGMENT_ELEMENT *segments, ULONG pos, ULONG length,
+                               struct iovec *iov, int max )
+{
+    int count = 0;
+    char *ptr;
+    ULONG len;
+
+    segments += pos / page_size;
+    pos %= page_size;
+    while (length)
+    {
+        ptr = (char *)segments->Buffer + pos;
+        len = min( length, page_size - pos );
+        if (count && (char *)iov[count - 1].iov_base + iov[count - 1].iov_len == ptr)
+            iov[count - 1].iov_len += len;
+        else
+        {
+            if (count == max) break;
+            iov[count].iov_base = ptr;
+            iov[count].iov_len = len;
+            count++;
+        }
+        length -= len;
+        pos = 0;
+        segments++;
+    }
+    return count;
+}
+
+
 /******************************************************************************
  *  NtReadFileScatter   [NTDLL.@]
  *  ZwReadFileScatter   [NTDLL.@]
@@ -1025,13 +1060,14 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
                                    PIO_STATUS_BLOCK io_status, FILE_SEGMENT_ELEMENT *segments,
                                    ULONG length, PLARGE_INTEGER offset, PULONG key )
 {
-    int result, unix_handle, needs_close;
+    int result, unix_handle, needs_close, count;
     unsigned int options;
     NTSTATUS status;
-    ULONG pos = 0, total = 0;
+    ULONG total = 0;
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
     BOOL send_completion = FALSE;
+    struct iovec iov[64];
 
     TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p),partial stub!\n",
            file, event, apc, apc_user, io_status, segments, length, offset, key);
@@ -1052,11 +1088,15 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
 
     while (length)
     {
+        count = get_segment_iovecs( segments, total, length, iov, ARRAY_SIZE(iov) );
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pread( unix_handle, (char *)segments->Buffer + pos,
-                            min( length - pos, page_size - pos ), offset->QuadPart + total );
+#ifdef HAVE_PREADV
+            result = preadv( unix_handle, iov, count, offset->QuadPart + total );
+#else
+            result = pread( unix_handle, iov[0].iov_base, iov[0].iov_len, offset->QuadPart + total );
+#endif
         else
-            result = read( unix_handle, (char *)segments->Buffer + pos, min( length - pos, page_size - pos ) );
+            result = readv( unix_handle, iov, count );
 
         if (result == -1)
         {
@@ -1067,11 +1107,6 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         if (!result) break;
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
     }
 
     if (total == 0) status = STATUS_END_OF_FILE;
@@ -1420,13 +1455,14 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
                                    PIO_STATUS_BLOCK io_status, FILE_SEGMENT_ELEMENT *segments,
                                    ULONG length, PLARGE_INTEGER offset, PULONG key )
 {
-    int result, unix_handle, needs_close;
+    int result, unix_handle, needs_close, count;
     unsigned int options;
     NTSTATUS status;
-    ULONG pos = 0, total = 0;
+    ULONG total = 0;
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
     BOOL send_completion = FALSE;
+    struct iovec iov[64];
 
     TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p),partial stub!\n",
            file, event, apc, apc_user, io_status, segments, length, offset, key);
@@ -1448,11 +1484,15 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
 
     while (length)
     {
+        count = get_segment_iovecs( segments, total, length, iov, ARRAY_SIZE(iov) );
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pwrite( unix_handle, (char *)segments->Buffer + pos,
-                             page_size - pos, offset->QuadPart + total );
+#ifdef HAVE_PWRITEV
+            result = pwritev( unix_handle, iov, count, offset->QuadPart + total );
+#else
+            result = pwrite( unix_handle, iov[0].iov_base, iov[0].iov_len, offset->QuadPart + total );
+#endif
         else
-            result = write( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
+            result = writev( unix_handle, iov, count );
 
         if (result == -1)
         {
@@ -1472,11 +1512,6 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         }
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
     }
 
     send_completion = cvalue != 0;
@@ -2638,6 +2673,8 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
         {
             FILE_COMPLETION_INFORMATION *info = ptr;
 
+            detach_local_completion( info->CompletionPort );
+
             SERVER_START_REQ( set_completion_info )
             {
                 req->handle   = wine_server_obj_handle( handle );
@@ -2646,6 +2683,7 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
                 io->u.Status  = wine_server_call( req );
             }
             SERVER_END_REQ;
+            if (!io->u.Status) server_set_fd_completion( handle );
         } else
             io->u.Status = STATUS_INVALID_PARAMETER_3;
         break;
@@ -47,6 +47,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(module);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(relayprof);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
@@ -673,7 +674,7 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
         const WCHAR *user = current_modref ? current_modref->ldr.BaseDllName.Buffer : NULL;
         proc = SNOOP_GetProcAddress( module, exports, exp_size, proc, ordinal, user );
     }
-    if (TRACE_ON(relay))
+    if (TRACE_ON(relay) || TRACE_ON(relayprof))
     {
         const WCHAR *user = current_modref ? current_modref->ldr.BaseDllName.Buffer : NULL;
         proc = RELAY_GetProcAddress( module, exports, exp_size, proc, ordinal, user );
@@ -1851,7 +1852,7 @@ static void load_builtin_callback( void *module, const char *filename )
     SERVER_END_REQ;
 
     /* setup relay debugging entry points */
-    if (TRACE_ON(relay)) RELAY_SetupDLL( module );
+    if (TRACE_ON(relay) || TRACE_ON(relayprof)) RELAY_SetupDLL( module );
 }
 
 
@@ -2223,7 +2224,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, const UNICODE_STRING *nt_nam
 
     if (image_info->image_flags & IMAGE_FLAGS_WineBuiltin)
     {
-        if (TRACE_ON(relay)) RELAY_SetupDLL( *module );
+        if (TRACE_ON(relay) || TRACE_ON(relayprof)) RELAY_SetupDLL( *module );
     }
     else
     {
@@ -3298,6 +3299,7 @@ void WINAPI LdrShutdownProcess(void)
     TRACE("()\n");
     process_detaching = TRUE;
     process_detach();
+    if (TRACE_ON(relayprof)) RELAY_DumpProfile();
 }
 
 
@@ -235,6 +235,8 @@ NTSTATUS WINAPI NtSetInformationObject(IN HANDLE handle,
 
             if (len < sizeof(*p)) return STATUS_INVALID_BUFFER_SIZE;
 
+            if (p->InheritHandle) detach_local_completion( handle );
+
             SERVER_START_REQ( set_handle_info )
             {
                 req->handle = wine_server_obj_handle( handle );
@@ -245,6 +247,7 @@ NTSTATUS WINAPI NtSetInformationObject(IN HANDLE handle,
                 status = wine_server_call( req );
             }
             SERVER_END_REQ;
+            if (!status && p->InheritHandle) server_set_fd_completion( handle );
         }
         break;
     default:
@@ -343,15 +346,11 @@ NtQuerySecurityObject(
 }
 
 
-/******************************************************************************
- *  NtDuplicateObject		[NTDLL.@]
- *  ZwDuplicateObject		[NTDLL.@]
- */
-NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
-                                   HANDLE dest_process, PHANDLE dest,
-                                   ACCESS_MASK access, ULONG attributes, ULONG options )
+static NTSTATUS dup_handle( HANDLE source_process, HANDLE source, HANDLE dest_process, HANDLE *dest,
+                            ACCESS_MASK access, ULONG attributes, ULONG options )
 {
     NTSTATUS ret;
+
     SERVER_START_REQ( dup_handle )
     {
         req->src_process = wine_server_obj_handle( source_process );
@@ -369,12 +368,39 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
             }
+            else if (reply->self) server_set_fd_completion( source );
         }
     }
     SERVER_END_REQ;
     return ret;
 }
 
+/******************************************************************************
+ *  NtDuplicateObject		[NTDLL.@]
+ *  ZwDuplicateObject		[NTDLL.@]
+ */
+NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
+                                   HANDLE dest_process, PHANDLE dest,
+                                   ACCESS_MASK access, ULONG attributes, ULONG options )
+{
+    PROCESS_BASIC_INFORMATION info;
+    NTSTATUS ret;
+
+    if (source_process == NtCurrentProcess()) detach_local_completion( source );
+
+    ret = dup_handle( source_process, source, dest_process, dest, access, attributes, options );
+
+    /* the server refuses to duplicate a local completion port */
+    if (ret == STATUS_NOT_SUPPORTED && source_process != NtCurrentProcess() &&
+        !NtQueryInformationProcess( source_process, ProcessBasicInformation, &info, sizeof(info), NULL ) &&
+        ULongToHandle( info.UniqueProcessId ) == NtCurrentTeb()->ClientId.UniqueProcess)
+    {
+        detach_local_completion( source );
+        ret = dup_handle( source_process, source, dest_process, dest, access, attributes, options );
+    }
+    return ret;
+}
+
 static LONG WINAPI invalid_handle_exception_handler( EXCEPTION_POINTERS *eptr )
 {
     EXCEPTION_RECORD *rec = eptr->ExceptionRecord;
@@ -387,6 +413,8 @@ NTSTATUS close_handle( HANDLE handle )
     NTSTATUS ret;
     int fd = server_remove_fd_from_cache( handle );
 
+    close_local_completion( handle );
+
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -33,10 +33,12 @@
 #include "winternl.h"
 #include "wine/exception.h"
 #include "ntdll_misc.h"
+#include "wine/list.h"
 #include "wine/unicode.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(relayprof);
 
 #if defined(__i386__) || defined(__x86_64__) || defined(__arm__) || defined(__aarch64__)
 
@@ -65,10 +67,13 @@ struct relay_entry_point
 {
     void       *orig_func;    /* original entry point function */
     const char *name;         /* function name (if any) */
+    int         calls;        /* number of calls (relayprof only) */
+    LONGLONG    time;         /* cumulative inclusive time (relayprof only) */
 };
 
 struct relay_private_data
 {
+    struct list              entry;             /* entry in relay_modules list */
     HMODULE                  module;            /* module handle of this dll */
     unsigned int             base;              /* ordinal base */
     char                     dllname[40];       /* dll name (without .dll extension) */
@@ -86,6 +91,47 @@ static const WCHAR **debug_from_snoop_includelist;
 
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
+static struct list relay_modules = LIST_INIT( relay_modules );
+
+/* relayprof support: instead of printing every call, keep per-entry point call
+ * counts and inclusive time, and sample the relay call stack of each thread
+ * into a ring buffer that is dumped on process exit */
+
+#define RELAY_PROFILE_MAX_DEPTH     64      /* max depth of the per-thread shadow stack */
+#define RELAY_PROFILE_SAMPLE_DEPTH  16      /* max number of frames stored per sample */
+#define RELAY_PROFILE_SAMPLES       8192    /* size of the sample ring buffer */
+#define RELAY_PROFILE_INTERVAL      10000   /* sampling interval in 100ns units */
+
+struct relay_profile_func
+{
+    struct relay_private_data *data;        /* module of the function */
+    unsigned int               ordinal;     /* function ordinal (without base) */
+};
+
+struct relay_profile_frame
+{
+    struct relay_profile_func  func;        /* function called */
+    ULONGLONG                  start;       /* time of the call */
+};
+
+struct relay_profile_thread
+{
+    unsigned int               depth;       /* current call depth */
+    ULONGLONG                  next_sample; /* time of the next stack sample */
+    struct relay_profile_frame frames[RELAY_PROFILE_MAX_DEPTH];
+};
+
+struct relay_profile_sample
+{
+    DWORD                      tid;         /* thread that was sampled */
+    unsigned int               depth;       /* depth of the sampled stack */
+    BOOL                       truncated;   /* outermost frames have been dropped */
+    struct relay_profile_func  stack[RELAY_PROFILE_SAMPLE_DEPTH];  /* innermost frames, outermost first */
+};
+
+static struct relay_profile_sample *profile_samples;
+static int profile_sample_count;
+
 /* compare an ASCII and a Unicode string without depending on the current codepage */
 static inline int strcmpAW( const char *strA, const WCHAR *strW )
 {
@@ -192,6 +238,10 @@ static DWORD WINAPI init_debug_lists( RTL_RUN_ONCE *once, void *param, void **co
     static const WCHAR SnoopFromIncludeW[] = {'S','n','o','o','p','F','r','o','m','I','n','c','l','u','d','e',0};
     static const WCHAR SnoopFromExcludeW[] = {'S','n','o','o','p','F','r','o','m','E','x','c','l','u','d','e',0};
 
+    if (TRACE_ON(relayprof))
+        profile_samples = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                           RELAY_PROFILE_SAMPLES * sizeof(*profile_samples) );
+
     RtlOpenCurrentUser( KEY_ALL_ACCESS, &root );
     attr.Length = sizeof(attr);
     attr.RootDirectory = root;
@@ -328,6 +378,98 @@ static void trace_string_w( INT_PTR ptr )
     else TRACE( "%08lx", ptr );
 }
 
+static inline ULONGLONG profile_time(void)
+{
+    LARGE_INTEGER now;
+
+    NtQueryPerformanceCounter( &now, NULL );
+    return now.QuadPart;
+}
+
+static inline void interlocked_add64( LONGLONG *dest, LONGLONG val )
+{
+    LONGLONG tmp = *dest;
+    while (interlocked_cmpxchg64( dest, tmp + val, tmp ) != tmp) tmp = *dest;
+}
+
+/***********************************************************************
+ *           profile_sample_stack
+ *
+ * Store the current relay call stack of the thread in the sample ring buffer.
+ */
+static void profile_sample_stack( const struct relay_profile_thread *prof )
+{
+    struct relay_profile_sample *sample;
+    unsigned int i, depth = min( prof->depth, RELAY_PROFILE_MAX_DEPTH );
+    unsigned int first = depth > RELAY_PROFILE_SAMPLE_DEPTH ? depth - RELAY_PROFILE_SAMPLE_DEPTH : 0;
+
+    if (!profile_samples) return;
+    sample = &profile_samples[(unsigned int)interlocked_xchg_add( &profile_sample_count, 1 ) % RELAY_PROFILE_SAMPLES];
+    sample->depth = 0;
+    sample->tid = GetCurrentThreadId();
+    for (i = first; i < depth; i++) sample->stack[i - first] = prof->frames[i].func;
+    sample->truncated = (prof->depth > depth - first);
+    sample->depth = depth - first;
+}
+
+/***********************************************************************
+ *           relay_profile_entry
+ */
+static void relay_profile_entry( struct relay_private_data *data, unsigned int ordinal )
+{
+    struct relay_profile_thread *prof = ntdll_get_thread_data()->relay_profile;
+    ULONGLONG now;
+
+    if (!prof)
+    {
+        if (!(prof = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*prof) ))) return;
+        ntdll_get_thread_data()->relay_profile = prof;
+    }
+
+    now = profile_time();
+    if (prof->depth < RELAY_PROFILE_MAX_DEPTH)
+    {
+        prof->frames[prof->depth].func.data = data;
+        prof->frames[prof->depth].func.ordinal = ordinal;
+        prof->frames[prof->depth].start = now;
+    }
+    prof->depth++;
+    if (now >= prof->next_sample)
+    {
+        profile_sample_stack( prof );
+        prof->next_sample = now + RELAY_PROFILE_INTERVAL;
+    }
+}
+
+/***********************************************************************
+ *           relay_profile_exit
+ */
+static void relay_profile_exit( struct relay_private_data *data, unsigned int ordinal )
+{
+    struct relay_profile_thread *prof = ntdll_get_thread_data()->relay_profile;
+    struct relay_profile_frame *frame;
+    unsigned int depth;
+
+    if (!prof || !prof->depth) return;
+    if (prof->depth > RELAY_PROFILE_MAX_DEPTH)
+    {
+        prof->depth--;
+        return;
+    }
+
+    /* frames skipped by an exception unwind are simply discarded */
+    for (depth = prof->depth; depth; depth--)
+    {
+        frame = &prof->frames[depth - 1];
+        if (frame->func.data != data || frame->func.ordinal != ordinal) continue;
+        interlocked_xchg_add( &data->entry_points[ordinal].calls, 1 );
+        interlocked_add64( &data->entry_points[ordinal].time, profile_time() - frame->start );
+        prof->depth = depth - 1;
+        return;
+    }
+}
+
+
 #ifdef __i386__
 
 /***********************************************************************
@@ -383,6 +525,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
         if (arg_types[1] == 't') *nb_args |= 0x40000000;  /* fastcall */
     }
     TRACE( ") ret=%08x\n", stack[-1] );
+    if (TRACE_ON(relayprof)) relay_profile_entry( data, ordinal );
     return entry_point->orig_func;
 }
 
@@ -394,6 +537,8 @@ DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigne
 {
     const char *arg_types = descr->args_string + HIWORD(idx);
 
+    if (TRACE_ON(relayprof)) relay_profile_exit( descr->private, LOWORD(idx) );
+
     TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
 
     while (!is_ret_val( *arg_types )) arg_types++;
@@ -547,6 +692,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
 #endif
     *nb_args = pos;
     TRACE( ") ret=%08x\n", stack[-1] );
+    if (TRACE_ON(relayprof)) relay_profile_entry( data, ordinal );
     return entry_point->orig_func;
 }
 
@@ -558,6 +704,8 @@ DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigne
 {
     const char *arg_types = descr->args_string + HIWORD(idx);
 
+    if (TRACE_ON(relayprof)) relay_profile_exit( descr->private, LOWORD(idx) );
+
     TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
 
     while (!is_ret_val( *arg_types )) arg_types++;
@@ -655,6 +803,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     }
     *nb_args = i;
     TRACE( ") ret=%08lx\n", stack[-1] );
+    if (TRACE_ON(relayprof)) relay_profile_entry( data, ordinal );
     return entry_point->orig_func;
 }
 
@@ -664,6 +813,8 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
 DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
                                               INT_PTR retaddr, INT_PTR retval )
 {
+    if (TRACE_ON(relayprof)) relay_profile_exit( descr->private, LOWORD(idx) );
+
     TRACE( "\1Ret  %s() retval=%08lx ret=%08lx\n",
            func_name( descr->private, LOWORD(idx) ), retval, retaddr );
 }
@@ -761,6 +912,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     }
     *nb_args = i;
     TRACE( ") ret=%08lx\n", stack[-1] );
+    if (TRACE_ON(relayprof)) relay_profile_entry( data, ordinal );
     return entry_point->orig_func;
 }
 
@@ -770,6 +922,8 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
 DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
                                               INT_PTR retaddr, INT_PTR retval )
 {
+    if (TRACE_ON(relayprof)) relay_profile_exit( descr->private, LOWORD(idx) );
+
     TRACE( "\1Ret  %s() retval=%08lx ret=%08lx\n",
            func_name( descr->private, LOWORD(idx) ), retval, retaddr );
 }
@@ -915,6 +1069,7 @@ void RELAY_SetupDLL( HMODULE module )
 
     descr->relay_call = relay_call;
     descr->private = data;
+    list_add_tail( &relay_modules, &data->entry );
 
     data->module = module;
     data->base   = exports->Base;
@@ -954,6 +1109,51 @@ void RELAY_SetupDLL( HMODULE module )
         NtProtectVirtualMemory( NtCurrentProcess(), &func_base, &func_size, old_prot, &old_prot );
 }
 
+
+
+/***********************************************************************
+ *           RELAY_DumpProfile
+ *
+ * Dump the relayprof statistics and stack samples; called on process exit.
+ * The output can be converted with tools/examine-relayprof.
+ */
+void RELAY_DumpProfile(void)
+{
+    struct relay_private_data *data;
+    unsigned int i, j, count;
+
+    LIST_FOR_EACH_ENTRY( data, &relay_modules, struct relay_private_data, entry )
+    {
+        IMAGE_EXPORT_DIRECTORY *exports;
+        DWORD size;
+
+        exports = RtlImageDirectoryEntryToData( data->module, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+        if (!exports) continue;
+        for (i = 0; i < exports->NumberOfFunctions; i++)
+        {
+            if (!data->entry_points[i].calls) continue;
+            TRACE_(relayprof)( "func %s calls=%u time=%u.%03ums\n", func_name( data, i ),
+                               data->entry_points[i].calls,
+                               (UINT)(data->entry_points[i].time / 10000),
+                               (UINT)(data->entry_points[i].time / 10 % 1000) );
+        }
+    }
+
+    if (!profile_samples) return;
+    count = min( (unsigned int)profile_sample_count, RELAY_PROFILE_SAMPLES );
+    for (i = 0; i < count; i++)
+    {
+        const struct relay_profile_sample *sample = &profile_samples[i];
+
+        if (!sample->depth) continue;
+        TRACE_(relayprof)( "stack %04x %s", sample->tid, sample->truncated ? "...;" : "" );
+        for (j = 0; j < sample->depth; j++)
+            TRACE_(relayprof)( "%s%s", j ? ";" : "",
+                               func_name( sample->stack[j].data, sample->stack[j].ordinal ));
+        TRACE_(relayprof)( "\n" );
+    }
+}
+
 #else  /* __i386__ || __x86_64__ || __arm__ || __aarch64__ */
 
 FARPROC RELAY_GetProcAddress( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
@@ -966,6 +1166,10 @@ void RELAY_SetupDLL( HMODULE module )
 {
 }
 
+void RELAY_DumpProfile(void)
+{
+}
+
 #endif  /* __i386__ || __x86_64__ || __arm__ || __aarch64__ */
 
 
@@ -822,19 +822,24 @@ union fd_cache_entry
     struct
     {
         int fd;
-        enum server_fd_type type : 5;
+        enum server_fd_type type : 4;
         unsigned int        access : 3;
         unsigned int        options : 24;
+        unsigned int        completion : 1;
     } s;
 };
 
 C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
+C_ASSERT( FD_TYPE_NB_TYPES <= 16 );
 
 #define FD_CACHE_BLOCK_SIZE  (65536 / sizeof(union fd_cache_entry))
 #define FD_CACHE_ENTRIES     128
 
 static union fd_cache_entry *fd_cache[FD_CACHE_ENTRIES];
 static union fd_cache_entry fd_cache_initial_block[FD_CACHE_BLOCK_SIZE];
+static int fd_close_serial;  /* incremented when a handle that may have a unix fd is closed */
+static const volatile struct process_shm *process_shm;  /* state shared with the server */
+static unsigned int fd_dup_serial;  /* server dup serial the cached completion state is valid for */
 
 static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 {
@@ -850,7 +855,7 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
  * Caller must hold fd_cache_section.
  */
 static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
-                            unsigned int access, unsigned int options )
+                            unsigned int access, unsigned int options, BOOL completion )
 {
     unsigned int entry, idx = handle_to_index( handle, &entry );
     union fd_cache_entry cache;
@@ -878,6 +883,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
+    cache.s.completion = completion;
     cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
     assert( !cache.s.fd );
     return TRUE;
@@ -909,6 +915,138 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
 }
 
 
+/***********************************************************************
+ *           invalidate_fd_completions
+ *
+ * Mark all cached fds as possibly having a completion port, since other
+ * processes may have obtained handles to them.
+ * Caller must hold fd_cache_section.
+ */
+static void invalidate_fd_completions(void)
+{
+    union fd_cache_entry cache, old;
+    unsigned int entry, idx;
+
+    for (entry = 0; entry < FD_CACHE_ENTRIES; entry++)
+    {
+        if (!fd_cache[entry]) continue;
+        for (idx = 0; idx < FD_CACHE_BLOCK_SIZE; idx++)
+        {
+            do
+            {
+                old.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+                if (!old.data || old.s.type == FD_TYPE_INVALID || old.s.completion) break;
+                cache.data = old.data;
+                cache.s.completion = 1;
+            } while (interlocked_cmpxchg64( &fd_cache[entry][idx].data, cache.data, old.data ) != old.data);
+        }
+    }
+}
+
+
+/***********************************************************************
+ *           get_process_shm
+ *
+ * Map the process state shared with the server. Handles may have been
+ * duplicated by other processes before the serial could be tracked, so
+ * the cached completion state is invalidated the first time.
+ */
+static const volatile struct process_shm *get_process_shm(void)
+{
+    HANDLE handle = 0;
+    LARGE_INTEGER offset;
+    SIZE_T size = 0;
+    void *ptr = NULL;
+    sigset_t sigset;
+
+    if (process_shm) return process_shm;
+
+    SERVER_START_REQ( get_process_shm )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (!handle) return NULL;
+
+    offset.QuadPart = 0;
+    NtMapViewOfSection( handle, NtCurrentProcess(), &ptr, 0, 0, &offset, &size, ViewShare, 0, PAGE_READONLY );
+    NtClose( handle );
+    if (!ptr) return NULL;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    if (!process_shm)
+    {
+        fd_dup_serial = ((const volatile struct process_shm *)ptr)->dup_serial;
+        invalidate_fd_completions();
+        process_shm = ptr;
+        ptr = NULL;
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+
+    if (ptr) NtUnmapViewOfSection( NtCurrentProcess(), ptr );
+    return process_shm;
+}
+
+
+/***********************************************************************
+ *           server_fd_has_completion
+ *
+ * Check whether I/O completions for a handle need to be sent to the server.
+ * This is only known for cached fds; the server reports a possible completion
+ * port for handles that could be used to associate one from elsewhere.
+ */
+BOOL server_fd_has_completion( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    const volatile struct process_shm *shm;
+    union fd_cache_entry cache;
+    sigset_t sigset;
+
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return TRUE;
+
+    /* another process may have duplicated handles to or from us */
+    if (!(shm = get_process_shm())) return TRUE;
+    if (shm->dup_serial != fd_dup_serial)
+    {
+        server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+        fd_dup_serial = shm->dup_serial;
+        invalidate_fd_completions();
+        server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    }
+
+    cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+    if (!cache.data || cache.s.type == FD_TYPE_INVALID) return TRUE;
+    return cache.s.completion;
+}
+
+
+/***********************************************************************
+ *           server_set_fd_completion
+ *
+ * Record that a handle may now be associated with a completion port, either
+ * because one has been set or because the handle can be shared.
+ */
+void server_set_fd_completion( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fd_cache_entry cache, old;
+    sigset_t sigset;
+
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return;
+
+    /* synchronize with a concurrent server_get_unix_fd caching the previous state */
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    do
+    {
+        old.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+        if (!old.data || old.s.type == FD_TYPE_INVALID || old.s.completion) break;
+        cache.data = old.data;
+        cache.s.completion = 1;
+    } while (interlocked_cmpxchg64( &fd_cache[entry][idx].data, cache.data, old.data ) != old.data);
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+}
+
+
 /***********************************************************************
  *           server_remove_fd_from_cache
  */
@@ -921,8 +1059,14 @@ int server_remove_fd_from_cache( HANDLE handle )
     {
         union fd_cache_entry cache;
         cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, 0 );
-        if (cache.s.type != FD_TYPE_INVALID) fd = cache.s.fd - 1;
+        if (cache.s.type != FD_TYPE_INVALID)
+        {
+            fd = cache.s.fd - 1;
+            interlocked_xchg_add( &fd_close_serial, 1 );
+        }
     }
+    /* handles beyond the cache are not tracked */
+    else if (entry >= FD_CACHE_ENTRIES) interlocked_xchg_add( &fd_close_serial, 1 );
 
     return fd;
 }
@@ -964,14 +1108,14 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                 {
                     assert( wine_server_ptr_handle(fd_handle) == handle );
                     *needs_close = (!reply->cacheable ||
-                                    !add_fd_to_cache( handle, fd, reply->type,
-                                                      reply->access, reply->options ));
+                                    !add_fd_to_cache( handle, fd, reply->type, reply->access,
+                                                      reply->options, reply->completion ));
                 }
                 else ret = STATUS_TOO_MANY_OPENED_FILES;
             }
             else if (reply->cacheable)
             {
-                add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0 );
+                add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0, FALSE );
             }
         }
         SERVER_END_REQ;
@@ -1067,6 +1211,21 @@ void CDECL wine_server_release_fd( HANDLE handle, int unix_fd )
 }
 
 
+/***********************************************************************
+ *           wine_server_fd_close_serial   (NTDLL.@)
+ *
+ * Get a counter that changes whenever a handle that had a unix fd is closed,
+ * so that callers can tell when a handle value may refer to a new object.
+ *
+ * RETURNS
+ *     the current value of the counter
+ */
+LONG CDECL wine_server_fd_close_serial(void)
+{
+    return *(volatile int *)&fd_close_serial;
+}
+
+
 /***********************************************************************
  *           server_pipe
  *
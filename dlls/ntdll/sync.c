@@ -58,6 +58,7 @@
 #include "windef.h"
 #include "winternl.h"
 #include "wine/server.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -798,6 +799,8 @@ NTSTATUS WINAPI NtSetInformationJobObject( HANDLE handle, JOBOBJECTINFOCLASS cla
         if (len != sizeof(JOBOBJECT_ASSOCIATE_COMPLETION_PORT))
             return STATUS_INVALID_PARAMETER;
 
+        detach_local_completion( ((JOBOBJECT_ASSOCIATE_COMPLETION_PORT *)info)->CompletionPort );
+
         SERVER_START_REQ( set_job_completion_port )
         {
             JOBOBJECT_ASSOCIATE_COMPLETION_PORT *port_info = info;
@@ -1083,7 +1086,11 @@ static NTSTATUS wait_objects( DWORD count, const HANDLE *handles,
 
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
-    for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
+    for (i = 0; i < count; i++)
+    {
+        detach_local_completion( handles[i] );
+        select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
+    }
     return server_select( &select_op, offsetof( select_op_t, wait.handles[count] ), flags, timeout );
 }
 
@@ -1119,6 +1126,8 @@ NTSTATUS WINAPI NtSignalAndWaitForSingleObject( HANDLE hSignalObject, HANDLE hWa
 
     if (!hSignalObject) return STATUS_INVALID_HANDLE;
 
+    detach_local_completion( hWaitObject );
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.signal_and_wait.op = SELECT_SIGNAL_AND_WAIT;
     select_op.signal_and_wait.wait = wine_server_obj_handle( hWaitObject );
@@ -1268,6 +1277,283 @@ NTSTATUS WINAPI NtReleaseKeyedEvent( HANDLE handle, const void *key,
     return server_select( &select_op, sizeof(select_op.keyed_event), flags, timeout );
 }
 
+/* Completion ports that are not named, not inheritable and not associated with
+ * any file or job can only be used from this process, so their queue is kept in
+ * process memory to avoid server round trips. The port is moved to the server
+ * as soon as it might receive completions from there, or is waited on. Until
+ * then the server refuses to duplicate its handle. */
+
+struct local_completion_msg
+{
+    struct list                     entry;
+    FILE_IO_COMPLETION_INFORMATION  info;
+};
+
+struct local_completion
+{
+    struct list            entry;     /* entry in local_completions list */
+    HANDLE                 handle;    /* handle of the port */
+    LONG                   refcount;
+    BOOL                   detaching; /* port queue is being moved to the server */
+    BOOL                   detached;  /* port is no longer handled locally */
+    BOOL                   closed;    /* port handle has been closed */
+    struct list            queue;     /* queued messages */
+    ULONG                  depth;     /* number of queued messages */
+    RTL_CONDITION_VARIABLE cv;        /* signaled when messages are queued or port is detached */
+};
+
+static struct list local_completions = LIST_INIT( local_completions );
+
+/* number of local ports per handle hash bucket, so that the handles that are
+ * not local ports can be ruled out without taking the lock */
+#define LOCAL_COMPLETION_HASH_SIZE 64
+static LONG local_completion_hash[LOCAL_COMPLETION_HASH_SIZE];
+
+static inline LONG *local_completion_bucket( HANDLE handle )
+{
+    return &local_completion_hash[((ULONG_PTR)handle >> 2) % LOCAL_COMPLETION_HASH_SIZE];
+}
+
+static inline BOOL is_local_completion( HANDLE handle )
+{
+    return *(volatile LONG *)local_completion_bucket( handle ) != 0;
+}
+
+static RTL_CRITICAL_SECTION local_completion_section;
+static RTL_CRITICAL_SECTION_DEBUG local_completion_critsect_debug =
+{
+    0, 0, &local_completion_section,
+    { &local_completion_critsect_debug.ProcessLocksList, &local_completion_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": local_completion_section") }
+};
+static RTL_CRITICAL_SECTION local_completion_section = { &local_completion_critsect_debug, -1, 0, 0, 0, 0 };
+
+/* find a local port; the caller must hold local_completion_section */
+static struct local_completion *find_local_completion( HANDLE handle )
+{
+    struct local_completion *port;
+
+    LIST_FOR_EACH_ENTRY( port, &local_completions, struct local_completion, entry )
+        if (port->handle == handle) return port;
+    return NULL;
+}
+
+/* release a local port; the caller must hold local_completion_section */
+static void release_local_completion( struct local_completion *port )
+{
+    struct local_completion_msg *msg, *next;
+
+    if (--port->refcount) return;
+    LIST_FOR_EACH_ENTRY_SAFE( msg, next, &port->queue, struct local_completion_msg, entry )
+        RtlFreeHeap( GetProcessHeap(), 0, msg );
+    RtlFreeHeap( GetProcessHeap(), 0, port );
+}
+
+/* add a local port to the list; the caller must hold local_completion_section */
+static void add_local_completion( struct local_completion *port )
+{
+    list_add_tail( &local_completions, &port->entry );
+    (*local_completion_bucket( port->handle ))++;
+}
+
+/* remove a local port from the list; the caller must hold local_completion_section */
+static void unlink_local_completion( struct local_completion *port )
+{
+    list_remove( &port->entry );
+    (*local_completion_bucket( port->handle ))--;
+}
+
+/* move messages to the server queue of a port and free them */
+static void move_local_completion_msgs( HANDLE handle, struct list *queue )
+{
+    struct local_completion_msg *msg, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( msg, next, queue, struct local_completion_msg, entry )
+    {
+        SERVER_START_REQ( add_completion )
+        {
+            req->handle      = wine_server_obj_handle( handle );
+            req->ckey        = msg->info.CompletionKey;
+            req->cvalue      = msg->info.CompletionValue;
+            req->status      = msg->info.IoStatusBlock.u.Status;
+            req->information = msg->info.IoStatusBlock.Information;
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+        list_remove( &msg->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, msg );
+    }
+}
+
+/***********************************************************************
+ *              detach_local_completion
+ *
+ * Move a local port queue to the server, before the port gets associated
+ * with an object that can post completions from the server side, or before
+ * its handle is waited on or shared.
+ */
+void detach_local_completion( HANDLE handle )
+{
+    struct local_completion *port;
+    struct list queue = LIST_INIT( queue );
+
+    if (!is_local_completion( handle )) return;
+
+    RtlEnterCriticalSection( &local_completion_section );
+    if (!(port = find_local_completion( handle )))
+    {
+        RtlLeaveCriticalSection( &local_completion_section );
+        return;
+    }
+    port->refcount++;
+
+    if (port->detaching)
+    {
+        /* another thread is moving the queue, wait until the server owns it */
+        while (!port->detached) RtlSleepConditionVariableCS( &port->cv, &local_completion_section, NULL );
+        release_local_completion( port );
+        RtlLeaveCriticalSection( &local_completion_section );
+        return;
+    }
+
+    /* waiting threads now go to the server */
+    port->detaching = TRUE;
+    RtlWakeAllConditionVariable( &port->cv );
+
+    /* messages posted while the lock is released are still queued locally,
+     * so the order is kept by moving them until the queue is empty */
+    while (!list_empty( &port->queue ))
+    {
+        list_move_tail( &queue, &port->queue );
+        port->depth = 0;
+        RtlLeaveCriticalSection( &local_completion_section );
+        move_local_completion_msgs( handle, &queue );
+        RtlEnterCriticalSection( &local_completion_section );
+    }
+    unlink_local_completion( port );
+    RtlLeaveCriticalSection( &local_completion_section );
+
+    SERVER_START_REQ( detach_completion )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+
+    RtlEnterCriticalSection( &local_completion_section );
+    port->detached = TRUE;
+    RtlWakeAllConditionVariable( &port->cv );
+    release_local_completion( port );
+    RtlLeaveCriticalSection( &local_completion_section );
+}
+
+/***********************************************************************
+ *              close_local_completion
+ *
+ * Discard the local state of a port whose handle is being closed.
+ */
+void close_local_completion( HANDLE handle )
+{
+    struct local_completion *port;
+    struct local_completion_msg *msg, *next;
+
+    if (!is_local_completion( handle )) return;
+
+    RtlEnterCriticalSection( &local_completion_section );
+    if ((port = find_local_completion( handle )) && !port->detaching)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( msg, next, &port->queue, struct local_completion_msg, entry )
+        {
+            list_remove( &msg->entry );
+            RtlFreeHeap( GetProcessHeap(), 0, msg );
+        }
+        port->depth = 0;
+        port->detaching = port->detached = port->closed = TRUE;
+        unlink_local_completion( port );
+        RtlWakeAllConditionVariable( &port->cv );
+        release_local_completion( port );
+    }
+    RtlLeaveCriticalSection( &local_completion_section );
+}
+
+/* retrieve the queue depth of a local port */
+static BOOL query_local_completion( HANDLE handle, ULONG *depth )
+{
+    struct local_completion *port;
+
+    RtlEnterCriticalSection( &local_completion_section );
+    if ((port = find_local_completion( handle )) && port->detaching) port = NULL;
+    if (port) *depth = port->depth;
+    RtlLeaveCriticalSection( &local_completion_section );
+    return port != NULL;
+}
+
+/* dequeue messages from a local port, waiting for them if necessary
+ * returns STATUS_NOT_FOUND if the port is not (or no longer) handled locally,
+ * in which case a relative timeout has been converted to an absolute one */
+static NTSTATUS remove_local_completions( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                          ULONG *written, LARGE_INTEGER **timeout, LARGE_INTEGER *end )
+{
+    struct local_completion *port;
+    struct local_completion_msg *msg;
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG i = 0;
+
+    if (!is_local_completion( handle )) return STATUS_NOT_FOUND;
+
+    RtlEnterCriticalSection( &local_completion_section );
+    if (!(port = find_local_completion( handle )) || port->detaching)
+    {
+        RtlLeaveCriticalSection( &local_completion_section );
+        return STATUS_NOT_FOUND;
+    }
+
+    if (*timeout && (*timeout)->QuadPart < 0)
+    {
+        NtQuerySystemTime( end );
+        end->QuadPart -= (*timeout)->QuadPart;
+        *timeout = end;
+    }
+
+    port->refcount++;
+    while (list_empty( &port->queue ) && !port->detaching && status != STATUS_TIMEOUT)
+    {
+        if (*timeout)
+        {
+            LARGE_INTEGER now;
+
+            /* a deadline in the past is not reported as a timeout by the sleep */
+            NtQuerySystemTime( &now );
+            if (now.QuadPart >= (*timeout)->QuadPart)
+            {
+                status = STATUS_TIMEOUT;
+                break;
+            }
+        }
+        status = RtlSleepConditionVariableCS( &port->cv, &local_completion_section, *timeout );
+    }
+
+    if (port->detaching) status = port->closed ? STATUS_ABANDONED_WAIT_0 : STATUS_NOT_FOUND;
+    else if (list_empty( &port->queue )) status = STATUS_TIMEOUT;
+    else
+    {
+        while (i < count && !list_empty( &port->queue ))
+        {
+            msg = LIST_ENTRY( list_head( &port->queue ), struct local_completion_msg, entry );
+            info[i++] = msg->info;
+            list_remove( &msg->entry );
+            RtlFreeHeap( GetProcessHeap(), 0, msg );
+            port->depth--;
+        }
+        status = STATUS_SUCCESS;
+    }
+    release_local_completion( port );
+    RtlLeaveCriticalSection( &local_completion_section );
+
+    *written = i;
+    return status;
+}
+
 /******************************************************************
  *              NtCreateIoCompletion (NTDLL.@)
  *              ZwCreateIoCompletion (NTDLL.@)
@@ -1284,7 +1570,9 @@ NTSTATUS WINAPI NtReleaseKeyedEvent( HANDLE handle, const void *key,
 NTSTATUS WINAPI NtCreateIoCompletion( PHANDLE CompletionPort, ACCESS_MASK DesiredAccess,
                                       POBJECT_ATTRIBUTES attr, ULONG NumberOfConcurrentThreads )
 {
+    struct local_completion *port = NULL;
     NTSTATUS status;
+    BOOL local = FALSE;
     data_size_t len;
     struct object_attributes *objattr;
 
@@ -1295,17 +1583,44 @@ NTSTATUS WINAPI NtCreateIoCompletion( PHANDLE CompletionPort, ACCESS_MASK Desire
 
     if ((status = alloc_object_attributes( attr, &objattr, &len ))) return status;
 
+    if (!attr || ((!attr->ObjectName || !attr->ObjectName->Length) && !(attr->Attributes & OBJ_INHERIT)))
+        port = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*port) );
+
     SERVER_START_REQ( create_completion )
     {
         req->access     = DesiredAccess;
         req->concurrent = NumberOfConcurrentThreads;
+        req->local      = (port != NULL);
         wine_server_add_data( req, objattr, len );
         if (!(status = wine_server_call( req )))
+        {
             *CompletionPort = wine_server_ptr_handle( reply->handle );
+            local = reply->local;
+        }
     }
     SERVER_END_REQ;
 
     RtlFreeHeap( GetProcessHeap(), 0, objattr );
+
+    if (port)
+    {
+        /* the server only keeps the queue local if the handle has the needed access rights */
+        if (!local) RtlFreeHeap( GetProcessHeap(), 0, port );
+        else
+        {
+            port->handle    = *CompletionPort;
+            port->refcount  = 1;
+            port->detaching = FALSE;
+            port->detached  = FALSE;
+            port->closed    = FALSE;
+            port->depth     = 0;
+            list_init( &port->queue );
+            RtlInitializeConditionVariable( &port->cv );
+            RtlEnterCriticalSection( &local_completion_section );
+            add_local_completion( port );
+            RtlLeaveCriticalSection( &local_completion_section );
+        }
+    }
     return status;
 }
 
@@ -1331,6 +1646,32 @@ NTSTATUS WINAPI NtSetIoCompletion( HANDLE CompletionPort, ULONG_PTR CompletionKe
     TRACE("(%p, %lx, %lx, %x, %lx)\n", CompletionPort, CompletionKey,
           CompletionValue, Status, NumberOfBytesTransferred);
 
+    if (is_local_completion( CompletionPort ))
+    {
+        struct local_completion *port;
+        struct local_completion_msg *msg;
+
+        RtlEnterCriticalSection( &local_completion_section );
+        if ((port = find_local_completion( CompletionPort )))
+        {
+            if ((msg = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*msg) )))
+            {
+                msg->info.CompletionKey             = CompletionKey;
+                msg->info.CompletionValue           = CompletionValue;
+                msg->info.IoStatusBlock.u.Status    = Status;
+                msg->info.IoStatusBlock.Information = NumberOfBytesTransferred;
+                list_add_tail( &port->queue, &msg->entry );
+                port->depth++;
+                RtlWakeConditionVariable( &port->cv );
+                status = STATUS_SUCCESS;
+            }
+            else status = STATUS_NO_MEMORY;
+            RtlLeaveCriticalSection( &local_completion_section );
+            return status;
+        }
+        RtlLeaveCriticalSection( &local_completion_section );
+    }
+
     SERVER_START_REQ( add_completion )
     {
         req->handle      = wine_server_obj_handle( CompletionPort );
@@ -1362,11 +1703,25 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
                                       PULONG_PTR CompletionValue, PIO_STATUS_BLOCK iosb,
                                       PLARGE_INTEGER WaitTime )
 {
+    FILE_IO_COMPLETION_INFORMATION info;
+    LARGE_INTEGER end;
     NTSTATUS status;
+    ULONG count;
 
     TRACE("(%p, %p, %p, %p, %p)\n", CompletionPort, CompletionKey,
           CompletionValue, iosb, WaitTime);
 
+    if ((status = remove_local_completions( CompletionPort, &info, 1, &count, &WaitTime, &end )) != STATUS_NOT_FOUND)
+    {
+        if (!status)
+        {
+            *CompletionKey   = info.CompletionKey;
+            *CompletionValue = info.CompletionValue;
+            *iosb            = info.IoStatusBlock;
+        }
+        return status;
+    }
+
     for(;;)
     {
         SERVER_START_REQ( remove_completion )
@@ -1396,39 +1751,44 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    struct completion_msg msgs[64];
+    LARGE_INTEGER end;
     NTSTATUS ret;
     ULONG i = 0;
 
     TRACE("%p %p %u %p %p %u\n", port, info, count, written, timeout, alertable);
 
+    /* alertable waits need the server */
+    if (alertable) detach_local_completion( port );
+    else if ((ret = remove_local_completions( port, info, count, &i, &timeout, &end )) != STATUS_NOT_FOUND)
+    {
+        *written = i ? i : 1;
+        return ret;
+    }
+
     for (;;)
     {
-        while (i < count)
+        /* fetch as many queued completions as possible in a single request */
+        SERVER_START_REQ( remove_completions )
         {
-            SERVER_START_REQ( remove_completion )
+            req->handle = wine_server_obj_handle( port );
+            wine_server_set_reply( req, msgs, min( count, ARRAY_SIZE(msgs) ) * sizeof(msgs[0]) );
+            if (!(ret = wine_server_call( req )))
             {
-                req->handle = wine_server_obj_handle( port );
-                if (!(ret = wine_server_call( req )))
+                ULONG nb = wine_server_reply_size( reply ) / sizeof(msgs[0]);
+
+                for (i = 0; i < nb; i++)
                 {
-                    info[i].CompletionKey             = reply->ckey;
-                    info[i].CompletionValue           = reply->cvalue;
-                    info[i].IoStatusBlock.Information = reply->information;
-                    info[i].IoStatusBlock.u.Status    = reply->status;
+                    info[i].CompletionKey             = msgs[i].ckey;
+                    info[i].CompletionValue           = msgs[i].cvalue;
+                    info[i].IoStatusBlock.Information = msgs[i].information;
+                    info[i].IoStatusBlock.u.Status    = msgs[i].status;
                 }
             }
-            SERVER_END_REQ;
-
-            if (ret != STATUS_SUCCESS) break;
-
-            ++i;
         }
+        SERVER_END_REQ;
 
-        if (i || ret != STATUS_PENDING)
-        {
-            if (ret == STATUS_PENDING)
-                ret = STATUS_SUCCESS;
-            break;
-        }
+        if (ret != STATUS_PENDING) break;
 
         ret = NtWaitForSingleObject( port, alertable, timeout );
         if (ret != WAIT_OBJECT_0) break;
@@ -1503,6 +1863,8 @@ NTSTATUS WINAPI NtQueryIoCompletion( HANDLE CompletionPort, IO_COMPLETION_INFORM
                 if (RequiredLength) *RequiredLength = sizeof(*info);
                 if (BufferLength != sizeof(*info))
                     status = STATUS_INFO_LENGTH_MISMATCH;
+                else if (is_local_completion( CompletionPort ) && query_local_completion( CompletionPort, info ))
+                    status = STATUS_SUCCESS;
                 else
                 {
                     SERVER_START_REQ( query_completion )
@@ -1527,6 +1889,9 @@ NTSTATUS NTDLL_AddCompletion( HANDLE hFile, ULONG_PTR CompletionValue,
 {
     NTSTATUS status;
 
+    /* avoid a server round trip when the file has no completion port */
+    if (!server_fd_has_completion( hFile )) return STATUS_SUCCESS;
+
     SERVER_START_REQ( add_fd_completion )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -1054,6 +1054,103 @@ static void test_set_io_completion(void)
     pNtClose( h );
 }
 
+static DWORD WINAPI set_io_completion_thread(void *port)
+{
+    NTSTATUS res;
+
+    Sleep( 50 );
+    res = pNtSetIoCompletion( port, CKEY_SECOND, CVALUE_FIRST, STATUS_SUCCESS, 7 );
+    ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %#x\n", res );
+    return 0;
+}
+
+static void test_io_completion_handles(void)
+{
+    LARGE_INTEGER timeout = {{0}};
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR key, value;
+    HANDLE h, dup, thread;
+    NTSTATUS res;
+    ULONG count;
+    DWORD ret;
+
+    res = pNtCreateIoCompletion( &h, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#x\n", res );
+
+    /* completions queued before the handle is duplicated are visible through the copy */
+    res = pNtSetIoCompletion( h, CKEY_FIRST, CVALUE_FIRST, STATUS_SUCCESS, 3 );
+    ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %#x\n", res );
+
+    if (!DuplicateHandle( GetCurrentProcess(), h, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS ))
+    {
+        ok( 0, "DuplicateHandle failed: %u\n", GetLastError() );
+        pNtClose( h );
+        return;
+    }
+
+    count = get_pending_msgs( dup );
+    ok( count == 1, "Unexpected msg count: %d\n", count );
+
+    res = pNtRemoveIoCompletion( dup, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletion failed: %#x\n", res );
+    ok( key == CKEY_FIRST, "Invalid completion key: %#lx\n", key );
+    ok( value == CVALUE_FIRST, "Invalid completion value: %#lx\n", value );
+    ok( iosb.Information == 3, "Invalid iosb.Information: %lu\n", iosb.Information );
+
+    count = get_pending_msgs( h );
+    ok( !count, "Unexpected msg count: %d\n", count );
+
+    pNtClose( dup );
+    pNtClose( h );
+
+    /* a completion posted from another thread wakes up the waiter */
+    res = pNtCreateIoCompletion( &h, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#x\n", res );
+
+    thread = CreateThread( NULL, 0, set_io_completion_thread, h, 0, NULL );
+    timeout.QuadPart = -10000000;
+    res = pNtRemoveIoCompletion( h, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletion failed: %#x\n", res );
+    ok( key == CKEY_SECOND, "Invalid completion key: %#lx\n", key );
+    ok( iosb.Information == 7, "Invalid iosb.Information: %lu\n", iosb.Information );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+
+    /* the timeout expires when nothing is posted */
+    timeout.QuadPart = -200000;
+    res = pNtRemoveIoCompletion( h, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_TIMEOUT, "NtRemoveIoCompletion returned %#x\n", res );
+
+    /* the port is signaled while completions are queued */
+    res = pNtSetIoCompletion( h, CKEY_FIRST, CVALUE_FIRST, STATUS_SUCCESS, 5 );
+    ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %#x\n", res );
+    ret = WaitForSingleObject( h, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+
+    timeout.QuadPart = 0;
+    res = pNtRemoveIoCompletion( h, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletion failed: %#x\n", res );
+    ok( key == CKEY_FIRST, "Invalid completion key: %#lx\n", key );
+    ok( iosb.Information == 5, "Invalid iosb.Information: %lu\n", iosb.Information );
+
+    ret = WaitForSingleObject( h, 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    timeout.QuadPart = -200000;
+    res = pNtRemoveIoCompletion( h, &key, &value, &iosb, &timeout );
+    ok( res == STATUS_TIMEOUT, "NtRemoveIoCompletion returned %#x\n", res );
+
+    pNtClose( h );
+
+    /* access rights are checked */
+    res = pNtCreateIoCompletion( &h, IO_COMPLETION_QUERY_STATE, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#x\n", res );
+    res = pNtSetIoCompletion( h, CKEY_FIRST, CVALUE_FIRST, STATUS_SUCCESS, 3 );
+    ok( res == STATUS_ACCESS_DENIED, "NtSetIoCompletion returned %#x\n", res );
+    count = get_pending_msgs( h );
+    ok( !count, "Unexpected msg count: %d\n", count );
+    pNtClose( h );
+}
+
 static void test_file_io_completion(void)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -3611,6 +3708,177 @@ static void test_file_completion_information(void)
     CloseHandle(h);
 }
 
+static void test_completion_port_after_io(void)
+{
+    static const char buf[] = "testdata";
+    OVERLAPPED ov, *pov;
+    DWORD num_bytes;
+    HANDLE port, h, dup;
+    ULONG_PTR key;
+    BOOL ret;
+
+    if (!(h = create_temp_file(FILE_FLAG_OVERLAPPED))) return;
+    ret = DuplicateHandle(GetCurrentProcess(), h, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    ok(ret, "DuplicateHandle failed, error %u\n", GetLastError());
+
+    memset(&ov, 0, sizeof(ov));
+    ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    /* do some I/O before a port is associated */
+    ret = WriteFile(dup, buf, sizeof(buf), &num_bytes, &ov);
+    if (!ret)
+    {
+        ok(GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u\n", GetLastError());
+        ret = GetOverlappedResult(dup, &ov, &num_bytes, TRUE);
+    }
+    ok(ret, "WriteFile failed, error %u\n", GetLastError());
+    ok(num_bytes == sizeof(buf), "expected sizeof(buf), got %u\n", num_bytes);
+
+    port = CreateIoCompletionPort(h, NULL, 0xdeadbeef, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed, error %u\n", GetLastError());
+
+    /* completions for the other handle go to the port too */
+    ret = WriteFile(dup, buf, sizeof(buf), &num_bytes, &ov);
+    if (!ret)
+    {
+        ok(GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u\n", GetLastError());
+        ret = GetOverlappedResult(dup, &ov, &num_bytes, TRUE);
+    }
+    ok(ret, "WriteFile failed, error %u\n", GetLastError());
+
+    key = 0;
+    pov = NULL;
+    ret = GetQueuedCompletionStatus(port, &num_bytes, &key, &pov, 1000);
+    ok(ret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError());
+    ok(key == 0xdeadbeef, "expected 0xdeadbeef, got %lx\n", key);
+    ok(pov == &ov, "expected %p, got %p\n", &ov, pov);
+    ok(num_bytes == sizeof(buf), "expected sizeof(buf), got %u\n", num_bytes);
+
+    CloseHandle(dup);
+    CloseHandle(h);
+
+    /* the handle is only duplicated after I/O went through it */
+    if (!(h = create_temp_file(FILE_FLAG_OVERLAPPED))) return;
+
+    ret = WriteFile(h, buf, sizeof(buf), &num_bytes, &ov);
+    if (!ret)
+    {
+        ok(GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u\n", GetLastError());
+        ret = GetOverlappedResult(h, &ov, &num_bytes, TRUE);
+    }
+    ok(ret, "WriteFile failed, error %u\n", GetLastError());
+
+    ret = DuplicateHandle(GetCurrentProcess(), h, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    ok(ret, "DuplicateHandle failed, error %u\n", GetLastError());
+    ok(CreateIoCompletionPort(dup, port, 0xcafe, 0) == port,
+       "CreateIoCompletionPort failed, error %u\n", GetLastError());
+
+    ret = WriteFile(h, buf, sizeof(buf), &num_bytes, &ov);
+    if (!ret)
+    {
+        ok(GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u\n", GetLastError());
+        ret = GetOverlappedResult(h, &ov, &num_bytes, TRUE);
+    }
+    ok(ret, "WriteFile failed, error %u\n", GetLastError());
+
+    key = 0;
+    pov = NULL;
+    ret = GetQueuedCompletionStatus(port, &num_bytes, &key, &pov, 1000);
+    ok(ret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError());
+    ok(key == 0xcafe, "expected 0xcafe, got %lx\n", key);
+    ok(pov == &ov, "expected %p, got %p\n", &ov, pov);
+
+    CloseHandle(ov.hEvent);
+    CloseHandle(port);
+    CloseHandle(dup);
+    CloseHandle(h);
+}
+
+static void dup_out_child(char **argv)
+{
+    HANDLE parent, h, dup = NULL, port, ready;
+    DWORD pid, num_bytes;
+    OVERLAPPED *pov;
+    ULONG_PTR key;
+    BOOL ret;
+
+    sscanf(argv[3], "%x", &pid);
+    sscanf(argv[4], "%p", &h);
+    parent = OpenProcess(PROCESS_DUP_HANDLE, FALSE, pid);
+    ok(parent != NULL, "OpenProcess failed, error %u\n", GetLastError());
+    ret = DuplicateHandle(parent, h, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    ok(ret, "DuplicateHandle failed, error %u\n", GetLastError());
+    CloseHandle(parent);
+
+    port = CreateIoCompletionPort(dup, NULL, 0xbeef, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed, error %u\n", GetLastError());
+    ready = OpenEventA(EVENT_MODIFY_STATE, FALSE, "test_completion_dup_ready");
+    ok(ready != NULL, "OpenEvent failed, error %u\n", GetLastError());
+    SetEvent(ready);
+    CloseHandle(ready);
+
+    /* the parent still writes through its original handle */
+    key = 0;
+    ret = GetQueuedCompletionStatus(port, &num_bytes, &key, &pov, 5000);
+    ok(ret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError());
+    ok(key == 0xbeef, "expected 0xbeef, got %lx\n", key);
+    ok(num_bytes == sizeof("testdata"), "got %u bytes\n", num_bytes);
+
+    CloseHandle(port);
+    CloseHandle(dup);
+}
+
+static void test_completion_port_dup_from_other_process(void)
+{
+    static const char buf[] = "testdata";
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH + 64], **argv;
+    HANDLE h, ready;
+    DWORD num_bytes;
+    OVERLAPPED ov;
+    BOOL ret;
+
+    if (!(h = create_temp_file(FILE_FLAG_OVERLAPPED))) return;
+
+    memset(&ov, 0, sizeof(ov));
+    ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    /* do some I/O while the handle is still private */
+    ret = WriteFile(h, buf, sizeof(buf), &num_bytes, &ov);
+    if (!ret)
+    {
+        ok(GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u\n", GetLastError());
+        ret = GetOverlappedResult(h, &ov, &num_bytes, TRUE);
+    }
+    ok(ret, "WriteFile failed, error %u\n", GetLastError());
+
+    /* another process pulls out the handle and associates a port with it */
+    ready = CreateEventA(NULL, TRUE, FALSE, "test_completion_dup_ready");
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" file dup_out %x %p", argv[0], GetCurrentProcessId(), h);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info);
+    ok(ret, "CreateProcess failed, error %u\n", GetLastError());
+    ok(!WaitForSingleObject(ready, 10000), "child did not associate a port\n");
+
+    ret = WriteFile(h, buf, sizeof(buf), &num_bytes, &ov);
+    if (!ret)
+    {
+        ok(GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %u\n", GetLastError());
+        ret = GetOverlappedResult(h, &ov, &num_bytes, TRUE);
+    }
+    ok(ret, "WriteFile failed, error %u\n", GetLastError());
+
+    winetest_wait_child_process(info.hProcess);
+    CloseHandle(info.hProcess);
+    CloseHandle(info.hThread);
+    CloseHandle(ready);
+    CloseHandle(ov.hEvent);
+    CloseHandle(h);
+}
+
 static void test_file_id_information(void)
 {
     BY_HANDLE_FILE_INFORMATION info;
@@ -4858,12 +5126,22 @@ START_TEST(file)
 {
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+    char **argv;
+    int argc;
+
     if (!hntdll)
     {
         skip("not running on NT, skipping test\n");
         return;
     }
 
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 5 && !strcmp(argv[2], "dup_out"))
+    {
+        dup_out_child(argv);
+        return;
+    }
+
     pGetVolumePathNameW = (void *)GetProcAddress(hkernel32, "GetVolumePathNameW");
     pGetSystemWow64DirectoryW = (void *)GetProcAddress(hkernel32, "GetSystemWow64DirectoryW");
 
@@ -4904,6 +5182,7 @@ START_TEST(file)
     append_file_test();
     nt_mailslot_test();
     test_set_io_completion();
+    test_io_completion_handles();
     test_file_io_completion();
     test_file_basic_information();
     test_file_all_information();
@@ -4915,6 +5194,8 @@ START_TEST(file)
     test_file_link_information();
     test_file_disposition_information();
     test_file_completion_information();
+    test_completion_port_after_io();
+    test_completion_port_dup_from_other_process();
     test_file_id_information();
     test_file_access_information();
     test_file_mode();
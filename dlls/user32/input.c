@@ -455,6 +455,7 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
  */
 DWORD WINAPI GetQueueStatus( UINT flags )
 {
+    const volatile struct queue_shm *shm;
     DWORD ret;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
@@ -465,6 +466,9 @@ DWORD WINAPI GetQueueStatus( UINT flags )
 
     check_for_events( flags );
 
+    /* changed bits are always a subset of wake bits, nothing to clear if none is set */
+    if ((shm = get_queue_shm()) && !(shm->wake_bits & flags)) return 0;
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
@@ -481,10 +485,13 @@ DWORD WINAPI GetQueueStatus( UINT flags )
  */
 BOOL WINAPI GetInputState(void)
 {
+    const volatile struct queue_shm *shm;
     DWORD ret;
 
     check_for_events( QS_INPUT );
 
+    if ((shm = get_queue_shm())) return shm->wake_bits & (QS_KEY | QS_MOUSEBUTTON);
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = 0;
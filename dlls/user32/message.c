@@ -2740,6 +2740,69 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+/***********************************************************************
+ *           get_server_queue_handle
+ *
+ * Get a handle to the server message queue for the current thread.
+ */
+static HANDLE get_server_queue_handle(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    HANDLE ret, shm = 0;
+
+    if (!(ret = thread_info->server_queue))
+    {
+        SERVER_START_REQ( get_msg_queue )
+        {
+            wine_server_call( req );
+            ret = wine_server_ptr_handle( reply->handle );
+            shm = wine_server_ptr_handle( reply->shm_handle );
+        }
+        SERVER_END_REQ;
+        thread_info->server_queue = ret;
+        if (!ret) ERR( "Cannot get server thread queue\n" );
+        if (shm)
+        {
+            thread_info->queue_shm = MapViewOfFile( shm, FILE_MAP_READ, 0, 0, 0 );
+            CloseHandle( shm );
+        }
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           get_queue_shm
+ *
+ * Get the read-only view of the current thread queue state, if the queue
+ * has already been created.
+ */
+const volatile struct queue_shm *get_queue_shm(void)
+{
+    return get_user_thread_info()->queue_shm;
+}
+
+
+/***********************************************************************
+ *           can_skip_get_message
+ *
+ * Check whether a get_message request would neither return a message nor
+ * change the queue state, so that PeekMessage can avoid the server call.
+ */
+static BOOL can_skip_get_message( struct user_thread_info *thread_info, UINT changed_mask )
+{
+    const volatile struct queue_shm *shm;
+
+    /* the get_message request would create the queue anyway */
+    get_server_queue_handle();
+    if (!(shm = thread_info->queue_shm) || shm->wake_bits) return FALSE;
+    if (thread_info->wake_mask != (changed_mask & (QS_SENDMESSAGE | QS_SMRESULT)) ||
+        thread_info->changed_mask != changed_mask) return FALSE;
+    /* still call the server regularly so that the queue isn't considered hung */
+    return GetTickCount() - thread_info->last_get_msg < 1000;
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2769,6 +2832,12 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
 
         thread_info->msg_source = prev_source;
 
+        if (can_skip_get_message( thread_info, changed_mask ))
+        {
+            HeapFree( GetProcessHeap(), 0, buffer );
+            return FALSE;
+        }
+
         SERVER_START_REQ( get_message )
         {
             req->flags     = flags;
@@ -2779,7 +2848,9 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
             req->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
             req->changed_mask = changed_mask;
             wine_server_set_reply( req, buffer, buffer_size );
-            if (!(res = wine_server_call( req )))
+            res = wine_server_call( req );
+            thread_info->last_get_msg = GetTickCount();
+            if (!res)
             {
                 size = wine_server_reply_size( reply );
                 info.type        = reply->type;
@@ -2994,31 +3065,6 @@ static inline void process_sent_messages(void)
 }
 
 
-/***********************************************************************
- *           get_server_queue_handle
- *
- * Get a handle to the server message queue for the current thread.
- */
-static HANDLE get_server_queue_handle(void)
-{
-    struct user_thread_info *thread_info = get_user_thread_info();
-    HANDLE ret;
-
-    if (!(ret = thread_info->server_queue))
-    {
-        SERVER_START_REQ( get_msg_queue )
-        {
-            wine_server_call( req );
-            ret = wine_server_ptr_handle( reply->handle );
-        }
-        SERVER_END_REQ;
-        thread_info->server_queue = ret;
-        if (!ret) ERR( "Cannot get server thread queue\n" );
-    }
-    return ret;
-}
-
-
 /***********************************************************************
  *           wait_message_reply
  *
@@ -3095,19 +3141,12 @@ static DWORD wait_objects( DWORD count, const HANDLE *handles, DWORD timeout,
 
 
 /***********************************************************************
- *		put_message_in_queue
+ *		get_send_timeout
  *
- * Put a sent message into the destination queue.
- * For inter-process message, reply_size is set to expected size of reply data.
+ * Get the server timeout for the reply to a sent message.
  */
-static BOOL put_message_in_queue( const struct send_message_info *info, size_t *reply_size )
+static timeout_t get_send_timeout( const struct send_message_info *info )
 {
-    struct packed_message data;
-    message_data_t msg_data;
-    unsigned int res;
-    int i;
-    timeout_t timeout = TIMEOUT_INFINITE;
-
     /* Check for INFINITE timeout for compatibility with Win9x,
      * although Windows >= NT does not do so
      */
@@ -3118,8 +3157,25 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
         info->timeout != INFINITE)
     {
         /* timeout is signed despite the prototype */
-        timeout = (timeout_t)max( 0, (int)info->timeout ) * -10000;
+        return (timeout_t)max( 0, (int)info->timeout ) * -10000;
     }
+    return TIMEOUT_INFINITE;
+}
+
+
+/***********************************************************************
+ *		put_message_in_queue
+ *
+ * Put a sent message into the destination queue.
+ * For inter-process message, reply_size is set to expected size of reply data.
+ */
+static BOOL put_message_in_queue( const struct send_message_info *info, size_t *reply_size )
+{
+    struct packed_message data;
+    message_data_t msg_data;
+    unsigned int res;
+    int i;
+    timeout_t timeout = get_send_timeout( info );
 
     memset( &data, 0, sizeof(data) );
     if (info->type == MSG_OTHER_PROCESS)
@@ -3255,6 +3311,160 @@ static BOOL is_message_broadcastable(UINT msg)
     return msg < WM_USER || msg >= 0xc000;
 }
 
+
+/***********************************************************************
+ *		broadcast_inter_thread_message
+ *
+ * Send a message to the windows of other threads at once, and wait for all the replies.
+ */
+static void broadcast_inter_thread_message( const struct send_message_info *info,
+                                            const user_handle_t *wins, UINT count )
+{
+    struct packed_message data;
+    size_t reply_size = 0;
+    LRESULT result;
+    UINT i, sent = 0;
+
+    TRACE( "msg %x (%s) wp %lx lp %lx to %u windows\n",
+           info->msg, SPY_GetMsgName(info->msg, info->hwnd), info->wparam, info->lparam, count );
+
+    memset( &data, 0, sizeof(data) );
+    if (info->type == MSG_OTHER_PROCESS)
+    {
+        reply_size = pack_message( info->hwnd, info->msg, info->wparam, info->lparam, &data );
+        if (data.count == -1)
+        {
+            WARN( "cannot pack message %x\n", info->msg );
+            return;
+        }
+    }
+
+    SERVER_START_REQ( broadcast_message )
+    {
+        req->type      = info->type;
+        req->flags     = 0;
+        req->msg       = info->msg;
+        req->wparam    = info->wparam;
+        req->lparam    = info->lparam;
+        req->timeout   = get_send_timeout( info );
+        req->wins_size = count * sizeof(*wins);
+        if (info->flags & SMTO_ABORTIFHUNG) req->flags |= SEND_MSG_ABORT_IF_HUNG;
+        wine_server_add_data( req, wins, count * sizeof(*wins) );
+        for (i = 0; i < data.count; i++) wine_server_add_data( req, data.data[i], data.size[i] );
+        wine_server_call( req );
+        sent = reply->count;
+    }
+    SERVER_END_REQ;
+
+    /* the replies come back in reverse order, they are all for the same message anyway */
+    for (i = 0; i < sent; i++)
+    {
+        wait_message_reply( info->flags );
+        retrieve_reply( info, reply_size, &result );
+    }
+}
+
+
+struct broadcast_params
+{
+    const struct send_message_info *info;
+    const user_handle_t            *wins;
+    UINT                            count;
+};
+
+/***********************************************************************
+ *		broadcast_inter_thread_callback
+ */
+static LRESULT broadcast_inter_thread_callback( HWND hwnd, UINT msg, WPARAM wp, LPARAM lp,
+                                                LRESULT *result, void *arg )
+{
+    struct broadcast_params *params = arg;
+    struct send_message_info info = *params->info;
+
+    info.hwnd   = hwnd;
+    info.msg    = msg;
+    info.wparam = wp;
+    info.lparam = lp;
+    broadcast_inter_thread_message( &info, params->wins, params->count );
+    return 1;
+}
+
+
+/***********************************************************************
+ *		broadcast_send_message
+ *
+ * Send a message to all the top-level windows. The messages to the other
+ * threads are all queued before waiting for the replies, so that slow
+ * receivers don't add up.
+ */
+static void broadcast_send_message( const struct send_message_info *info, BOOL unicode )
+{
+    struct send_message_info batch_info;
+    struct broadcast_params params;
+    user_handle_t *wins;
+    UINT i, count, local_count = 0, remote_count = 0;
+    DWORD tid, pid;
+    LRESULT result;
+    HWND *list;
+
+    if (!(list = WIN_ListChildren( GetDesktopWindow() ))) return;
+    for (count = 0; list[count]; count++) ;
+
+    /* windows of the current process go at the start of the array, other processes at the end */
+    if (!(wins = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*wins) )))
+    {
+        HeapFree( GetProcessHeap(), 0, list );
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (!(GetWindowLongW( list[i], GWL_STYLE ) & (WS_POPUP|WS_CAPTION))) continue;
+        if (!(tid = GetWindowThreadProcessId( list[i], &pid ))) continue;
+        if (tid == GetCurrentThreadId())
+        {
+            if (unicode)
+                SendMessageTimeoutW( list[i], info->msg, info->wparam, info->lparam,
+                                     info->flags, info->timeout, NULL );
+            else
+                SendMessageTimeoutA( list[i], info->msg, info->wparam, info->lparam,
+                                     info->flags, info->timeout, NULL );
+            continue;
+        }
+        if (USER_IsExitingThread( tid )) continue;
+        if (pid == GetCurrentProcessId()) wins[local_count++] = wine_server_user_handle( list[i] );
+        else wins[count - ++remote_count] = wine_server_user_handle( list[i] );
+    }
+    HeapFree( GetProcessHeap(), 0, list );
+
+    for (i = 0; i < 2; i++)
+    {
+        batch_info = *info;
+        params.info = &batch_info;
+        if (!i)
+        {
+            params.wins  = wins;
+            params.count = local_count;
+        }
+        else
+        {
+            batch_info.type = MSG_OTHER_PROCESS;
+            params.wins  = wins + count - remote_count;
+            params.count = remote_count;
+        }
+        if (!params.count) continue;
+
+        /* MSG_ASCII can be sent unconverted except for WM_CHAR; everything else needs to be Unicode */
+        if (!unicode && is_unicode_message( info->msg ) &&
+            (batch_info.type != MSG_ASCII || info->msg == WM_CHAR))
+            WINPROC_CallProcAtoW( broadcast_inter_thread_callback, info->hwnd, info->msg,
+                                  info->wparam, info->lparam, &result, &params, info->wm_char );
+        else
+            broadcast_inter_thread_message( &batch_info, params.wins, params.count );
+    }
+    HeapFree( GetProcessHeap(), 0, wins );
+}
+
 /***********************************************************************
  *		send_message
  *
@@ -3271,7 +3481,12 @@ static BOOL send_message( struct send_message_info *info, DWORD_PTR *res_ptr, BO
     if (is_broadcast(info->hwnd))
     {
         if (is_message_broadcastable( info->msg ))
-            EnumWindows( broadcast_message_callback, (LPARAM)info );
+        {
+            if (info->type == MSG_ASCII || info->type == MSG_UNICODE)
+                broadcast_send_message( info, unicode );
+            else
+                EnumWindows( broadcast_message_callback, (LPARAM)info );
+        }
         if (res_ptr) *res_ptr = 1;
         return TRUE;
     }
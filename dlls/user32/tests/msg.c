@@ -12411,6 +12411,49 @@ static void test_PeekMessage3(void)
     flush_events();
 }
 
+static DWORD WINAPI post_thread_message_proc(void *param)
+{
+    DWORD tid = PtrToUlong(param);
+
+    Sleep(50);
+    ok(PostThreadMessageA(tid, WM_USER + 1, 0, 0), "PostThreadMessage failed, error %u\n", GetLastError());
+    return 0;
+}
+
+static void test_PeekMessage4(void)
+{
+    DWORD status, start;
+    HANDLE thread;
+    BOOL ret;
+    MSG msg;
+
+    flush_events();
+
+    /* messages posted from another thread show up while polling an empty queue */
+    ret = PeekMessageA(&msg, NULL, 0, 0, PM_NOREMOVE);
+    ok(!ret, "expected PeekMessage to return FALSE, got %u\n", ret);
+    status = GetQueueStatus(QS_ALLINPUT);
+    ok(!status, "GetQueueStatus returned %08x\n", status);
+
+    thread = CreateThread(NULL, 0, post_thread_message_proc, ULongToPtr(GetCurrentThreadId()), 0, NULL);
+    start = GetTickCount();
+    while (!(ret = PeekMessageA(&msg, NULL, 0, 0, PM_NOREMOVE)) && GetTickCount() - start < 5000);
+    ok(ret, "expected PeekMessage to return TRUE\n");
+    ok(msg.message == WM_USER + 1, "got message %04x\n", msg.message);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+
+    status = GetQueueStatus(QS_POSTMESSAGE);
+    ok(status == MAKELONG(0, QS_POSTMESSAGE), "GetQueueStatus returned %08x\n", status);
+
+    ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+    ok(ret && msg.message == WM_USER + 1, "got message %04x\n", msg.message);
+    ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+    ok(!ret, "expected PeekMessage to return FALSE, got %u\n", ret);
+    status = GetQueueStatus(QS_ALLINPUT);
+    ok(!status, "GetQueueStatus returned %08x\n", status);
+}
+
 static INT_PTR CALLBACK wm_quit_dlg_proc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
 {
     struct recvd_message msg;
@@ -15907,6 +15950,73 @@ static void test_broadcast(void)
     DestroyWindow(hwnd);
 }
 
+static UINT broadcast_thread_msg;
+static LONG broadcast_thread_count;
+
+static LRESULT WINAPI broadcast_thread_proc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    if (message == broadcast_thread_msg && wParam == 0xbaadbeef)
+    {
+        Sleep(100);
+        InterlockedIncrement(&broadcast_thread_count);
+        return 0;
+    }
+    return DefWindowProcA(hwnd, message, wParam, lParam);
+}
+
+static DWORD CALLBACK broadcast_thread(void *arg)
+{
+    HANDLE ready = arg;
+    HWND hwnd;
+    MSG msg;
+
+    hwnd = CreateWindowExA(0, "static", NULL, WS_POPUP, 0, 0, 0, 0, 0, 0, 0, NULL);
+    ok(hwnd != NULL, "got %p\n", hwnd);
+    SetWindowLongPtrA(hwnd, GWLP_WNDPROC, (LONG_PTR)broadcast_thread_proc);
+    SetEvent(ready);
+
+    while (GetMessageA(&msg, 0, 0, 0))
+        DispatchMessageA(&msg);
+
+    DestroyWindow(hwnd);
+    return 0;
+}
+
+static void test_broadcast_threads(void)
+{
+    HANDLE threads[4], ready;
+    DWORD tids[4], ret;
+    unsigned int i;
+
+    broadcast_thread_msg = RegisterWindowMessageA("test_broadcast_threads");
+    ready = CreateEventA(NULL, FALSE, FALSE, NULL);
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        threads[i] = CreateThread(NULL, 0, broadcast_thread, ready, 0, &tids[i]);
+        ret = WaitForSingleObject(ready, 5000);
+        ok(ret == WAIT_OBJECT_0, "%u: wait failed %u\n", i, ret);
+    }
+
+    broadcast_thread_count = 0;
+    ret = SendMessageTimeoutA(HWND_BROADCAST, broadcast_thread_msg, 0xbaadbeef, 0, SMTO_NORMAL, 5000, NULL);
+    ok(ret, "SendMessageTimeout failed, error %u\n", GetLastError());
+    ok(broadcast_thread_count == ARRAY_SIZE(threads), "got %d replies\n", broadcast_thread_count);
+
+    broadcast_thread_count = 0;
+    ret = SendMessageW(HWND_BROADCAST, broadcast_thread_msg, 0xbaadbeef, 0);
+    ok(ret, "SendMessage failed, error %u\n", GetLastError());
+    ok(broadcast_thread_count == ARRAY_SIZE(threads), "got %d replies\n", broadcast_thread_count);
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        PostThreadMessageA(tids[i], WM_QUIT, 0, 0);
+        ret = WaitForSingleObject(threads[i], 5000);
+        ok(ret == WAIT_OBJECT_0, "%u: wait failed %u\n", i, ret);
+        CloseHandle(threads[i]);
+    }
+    CloseHandle(ready);
+}
+
 static const struct
 {
     DWORD exp, broken;
@@ -17747,10 +17857,12 @@ START_TEST(msg)
     test_SetParent();
     test_PostMessage();
     test_broadcast();
+    test_broadcast_threads();
     test_ShowWindow();
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_PeekMessage4();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
@@ -9397,8 +9397,9 @@ static void window_from_point_proc(HWND parent)
 
 static void test_window_from_point(const char *argv0)
 {
-    HWND hwnd, child, win;
+    HWND hwnd, child, win, children[100];
     POINT pt;
+    int i;
     PROCESS_INFORMATION info;
     STARTUPINFOA startup;
     char cmd[MAX_PATH];
@@ -9465,6 +9466,52 @@ static void test_window_from_point(const char *argv0)
     CloseHandle(info.hProcess);
     CloseHandle(info.hThread);
 
+    /* many children */
+    for (i = 0; i < ARRAY_SIZE(children); i++)
+    {
+        children[i] = CreateWindowExA(0, "button", "button", WS_CHILD | WS_VISIBLE,
+                                      (i % 10) * 20, (i / 10) * 10, 20, 10, hwnd, 0, NULL, NULL);
+        ok(children[i] != 0, "CreateWindowEx failed\n");
+    }
+    for (i = 0; i < ARRAY_SIZE(children); i += 7)
+    {
+        pt.x = 100 + (i % 10) * 20 + 10;
+        pt.y = 100 + (i / 10) * 10 + 5;
+        win = WindowFromPoint(pt);
+        ok(win == children[i], "%d: WindowFromPoint returned %p, expected %p\n", i, win, children[i]);
+    }
+
+    /* move a child on top of another one */
+    SetWindowPos(children[0], HWND_TOP, 40, 50, 20, 10, 0);
+    pt.x = 150;
+    pt.y = 155;
+    win = WindowFromPoint(pt);
+    ok(win == children[0], "WindowFromPoint returned %p, expected %p\n", win, children[0]);
+    SetWindowPos(children[0], HWND_BOTTOM, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
+    win = WindowFromPoint(pt);
+    ok(win == children[52], "WindowFromPoint returned %p, expected %p\n", win, children[52]);
+
+    /* move it without changing the Z-order */
+    SetWindowPos(children[99], 0, 0, 0, 20, 10, SWP_NOZORDER);
+    pt.x = pt.y = 105;
+    win = WindowFromPoint(pt);
+    ok(win == children[99], "WindowFromPoint returned %p, expected %p\n", win, children[99]);
+    ShowWindow(children[99], SW_HIDE);
+    win = WindowFromPoint(pt);
+    ok(win == hwnd, "WindowFromPoint returned %p, expected %p\n", win, hwnd);
+
+    /* reparent a child and destroy it */
+    child = CreateWindowExA(0, "MainWindowClass", NULL, WS_POPUP, 400, 400, 100, 100, 0, 0, NULL, NULL);
+    ok(child != 0, "CreateWindowEx failed\n");
+    SetParent(children[52], child);
+    DestroyWindow(children[52]);
+    pt.x = 150;
+    pt.y = 155;
+    win = WindowFromPoint(pt);
+    ok(win == children[0], "WindowFromPoint returned %p, expected %p\n", win, children[0]);
+    DestroyWindow(child);
+
+    for (i = 0; i < ARRAY_SIZE(children); i++) DestroyWindow(children[i]);
     DestroyWindow(hwnd);
 }
 
@@ -11737,7 +11784,8 @@ static void other_process_proc(HWND hwnd)
 {
     HANDLE window_ready_event, test_done_event;
     WINDOWPLACEMENT wp;
-    DWORD ret;
+    DWORD ret, pid;
+    RECT rect;
 
     window_ready_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opw_window");
     ok(!!window_ready_event, "OpenEvent failed.\n");
@@ -11751,6 +11799,18 @@ static void other_process_proc(HWND hwnd)
     ok(ret, "Unexpected ret %#x.\n", ret);
     ok(wp.showCmd == SW_SHOWNORMAL, "Unexpected showCmd %#x.\n", wp.showCmd);
     ok(!wp.flags, "Unexpected flags %#x.\n", wp.flags);
+    ok(IsWindow(hwnd), "Expected a valid window.\n");
+    ok(IsWindowVisible(hwnd), "Expected a visible window.\n");
+    ret = GetWindowLongA(hwnd, GWL_STYLE);
+    ok((ret & (WS_POPUP | WS_VISIBLE)) == (WS_POPUP | WS_VISIBLE), "Unexpected style %#x.\n", ret);
+    ok(!GetParent(hwnd), "Unexpected parent %p.\n", GetParent(hwnd));
+    ret = GetWindowThreadProcessId(hwnd, &pid);
+    ok(ret && ret != GetCurrentThreadId(), "Unexpected thread id %#x.\n", ret);
+    ok(pid && pid != GetCurrentProcessId(), "Unexpected process id %#x.\n", pid);
+    ret = GetWindowRect(hwnd, &rect);
+    ok(ret, "Unexpected ret %#x.\n", ret);
+    ok(rect.left == 100 && rect.top == 100 && rect.right == 200 && rect.bottom == 200,
+       "Unexpected rect %s.\n", wine_dbgstr_rect(&rect));
     SetEvent(test_done_event);
 
     /* SW_SHOWMAXIMIZED */
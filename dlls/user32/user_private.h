@@ -169,8 +169,12 @@ struct wm_char_mapping_data
     MSG  get_msg;
 };
 
+struct queue_shm;
+
 /* this is the structure stored in TEB->Win32ClientInfo */
 /* no attempt is made to keep the layout compatible with the Windows one */
+/* it is packed to leave no padding at the end on 64-bit */
+#include "pshpack4.h"
 struct user_thread_info
 {
     HANDLE                        server_queue;           /* Handle to server-side queue */
@@ -193,7 +197,10 @@ struct user_thread_info
     HWND                          top_window;             /* Desktop window */
     HWND                          msg_window;             /* HWND_MESSAGE parent window */
     RAWINPUT                     *rawinput;
+    const volatile struct queue_shm *queue_shm;           /* Read-only view of the queue state */
+    DWORD                         last_get_msg;           /* Time of last get_message request */
 };
+#include "poppack.h"
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
 
@@ -230,6 +237,7 @@ extern HMODULE user32_module DECLSPEC_HIDDEN;
 struct dce;
 struct tagWND;
 
+extern const volatile struct queue_shm *get_queue_shm(void) DECLSPEC_HIDDEN;
 extern void CLIPBOARD_ReleaseOwner( HWND hwnd ) DECLSPEC_HIDDEN;
 extern BOOL FOCUS_MouseActivate( HWND hwnd ) DECLSPEC_HIDDEN;
 extern BOOL set_capture_window( HWND hwnd, UINT gui_flags, HWND *prev_ret ) DECLSPEC_HIDDEN;
@@ -165,6 +165,78 @@ void release_user_handle_ptr( void *ptr )
 }
 
 
+/***********************************************************************
+ *           get_window_shm
+ *
+ * Map the section holding the window state published by the server.
+ */
+static const volatile struct window_shm *get_window_shm(void)
+{
+    static const volatile struct window_shm *window_shm;
+    static BOOL failed;
+    HANDLE handle = 0;
+    void *ptr;
+
+    if (window_shm || failed) return window_shm;
+
+    SERVER_START_REQ( get_window_shm )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+
+    if (!handle)
+    {
+        failed = TRUE;
+        return NULL;
+    }
+    ptr = MapViewOfFile( handle, FILE_MAP_READ, 0, 0, 0 );
+    CloseHandle( handle );
+    if (!ptr)
+    {
+        failed = TRUE;
+        return NULL;
+    }
+    if (InterlockedCompareExchangePointer( (void **)&window_shm, ptr, NULL ))
+        UnmapViewOfFile( ptr );  /* another thread got there first */
+    return window_shm;
+}
+
+
+/***********************************************************************
+ *           get_shared_window
+ *
+ * Get a consistent copy of the state of a window from the shared section.
+ * Used to avoid server round trips for windows of other processes.
+ */
+static BOOL get_shared_window( HWND hwnd, struct window_shm *info )
+{
+    const volatile struct window_shm *shm;
+    WORD index = USER_HANDLE_TO_INDEX( hwnd );
+    unsigned int seq;
+
+    if (index >= NB_USER_HANDLES) return FALSE;
+    if (!(shm = get_window_shm())) return FALSE;
+    shm += index;
+
+    for (;;)
+    {
+        if ((seq = shm->seq) & 1)  /* being updated by the server */
+        {
+            Sleep( 0 );
+            continue;
+        }
+        __sync_synchronize();
+        memcpy( info, (const void *)shm, sizeof(*info) );
+        __sync_synchronize();
+        if (shm->seq == seq) break;
+    }
+
+    if (!info->handle) return FALSE;
+    return (info->handle == (UINT)(UINT_PTR)hwnd || !HIWORD(hwnd) || HIWORD(hwnd) == 0xffff);
+}
+
+
 /***********************************************************************
  *           free_user_handle
  */
@@ -372,15 +444,25 @@ static HWND *list_window_parents( HWND hwnd )
     for (;;)
     {
         if (!(win = WIN_GetPtr( current ))) goto empty;
-        if (win == WND_OTHER_PROCESS) break;  /* need to do it the hard way */
-        if (win == WND_DESKTOP)
+        if (win == WND_OTHER_PROCESS)
+        {
+            struct window_shm info;
+
+            if (!get_shared_window( current, &info )) break;  /* need to do it the hard way */
+            if (!info.parent && !pos) goto empty;
+            list[pos] = current = wine_server_ptr_handle( info.parent );
+        }
+        else if (win == WND_DESKTOP)
         {
             if (!pos) goto empty;
             list[pos] = 0;
             return list;
         }
-        list[pos] = current = win->parent;
-        WIN_ReleasePtr( win );
+        else
+        {
+            list[pos] = current = win->parent;
+            WIN_ReleasePtr( win );
+        }
         if (!current) return list;
         if (++pos == size - 1)
         {
@@ -727,6 +809,10 @@ HWND WIN_GetFullHandle( HWND hwnd )
     }
     else  /* may belong to another process */
     {
+        struct window_shm info;
+
+        if (get_shared_window( hwnd, &info )) return wine_server_ptr_handle( info.handle );
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -825,6 +911,59 @@ ULONG WIN_SetStyle( HWND hwnd, ULONG set_bits, ULONG clear_bits )
 }
 
 
+/***********************************************************************
+ *           get_shared_rectangles
+ *
+ * Get the rectangles of a window of another process from the shared section.
+ * Cases that require mirroring or DPI scaling are left to the server.
+ */
+static BOOL get_shared_rectangles( HWND hwnd, enum coords_relative relative, RECT *rectWindow, RECT *rectClient )
+{
+    struct window_shm info, parent;
+    RECT window_rect, client_rect;
+    user_handle_t handle;
+
+    if (!get_shared_window( hwnd, &info )) return FALSE;
+    if (info.dpi != get_thread_dpi()) return FALSE;
+
+    SetRect( &window_rect, info.window.left, info.window.top, info.window.right, info.window.bottom );
+    SetRect( &client_rect, info.client.left, info.client.top, info.client.right, info.client.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        if (info.ex_style & WS_EX_LAYOUTRTL) return FALSE;
+        OffsetRect( &window_rect, -info.client.left, -info.client.top );
+        OffsetRect( &client_rect, -info.client.left, -info.client.top );
+        break;
+    case COORDS_WINDOW:
+        if (info.ex_style & WS_EX_LAYOUTRTL) return FALSE;
+        OffsetRect( &window_rect, -info.window.left, -info.window.top );
+        OffsetRect( &client_rect, -info.window.left, -info.window.top );
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_shared_window( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL) return FALSE;
+        break;
+    case COORDS_SCREEN:
+        for (handle = info.parent; handle; handle = parent.parent)
+        {
+            if (!get_shared_window( wine_server_ptr_handle( handle ), &parent )) return FALSE;
+            if (!parent.parent) break;  /* desktop window */
+            OffsetRect( &window_rect, parent.client.left, parent.client.top );
+            OffsetRect( &client_rect, parent.client.left, parent.client.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (rectWindow) *rectWindow = window_rect;
+    if (rectClient) *rectClient = client_rect;
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           WIN_GetRectangles
  *
@@ -933,6 +1072,8 @@ BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWind
     }
 
 other_process:
+    if (get_shared_rectangles( hwnd, relative, rectWindow, rectClient )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2221,6 +2362,10 @@ BOOL WINAPI IsWindowUnicode( HWND hwnd )
     }
     else
     {
+        struct window_shm info;
+
+        if (get_shared_window( hwnd, &info )) return info.is_unicode;
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2290,6 +2435,11 @@ UINT WINAPI GetDpiForWindow( HWND hwnd )
     }
     else
     {
+        struct window_shm info;
+
+        /* per-monitor aware windows need the server to find their monitor */
+        if (get_shared_window( hwnd, &info ) && info.dpi) return info.dpi;
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2348,11 +2498,24 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS)
     {
+        struct window_shm info;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if (offset < 0 && get_shared_window( hwnd, &info ))
+        {
+            switch(offset)
+            {
+            case GWL_STYLE:      return info.style;
+            case GWL_EXSTYLE:    return info.ex_style;
+            case GWLP_ID:        return info.id;
+            case GWLP_HINSTANCE: return (ULONG_PTR)wine_server_get_ptr( info.instance );
+            case GWLP_USERDATA:  return info.user_data;
+            }
+        }
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2997,6 +3160,7 @@ INT WINAPI GetWindowTextLengthW( HWND hwnd )
  */
 BOOL WINAPI IsWindow( HWND hwnd )
 {
+    struct window_shm info;
     WND *ptr;
     BOOL ret;
 
@@ -3010,6 +3174,8 @@ BOOL WINAPI IsWindow( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -3025,6 +3191,7 @@ BOOL WINAPI IsWindow( HWND hwnd )
  */
 DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
 {
+    struct window_shm info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -3044,6 +3211,12 @@ DWORD WINAPI GetWindowThreadProcessId( HWND hwnd, LPDWORD process )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -3074,7 +3247,16 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        struct window_shm info;
+        LONG style;
+
+        if (get_shared_window( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) retvalue = wine_server_ptr_handle( info.owner );
+            else if (info.style & WS_CHILD) retvalue = wine_server_ptr_handle( info.parent );
+            return retvalue;
+        }
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -91,6 +91,131 @@ static inline float to_sRGB_component(float f)
     return 1.055f * powf(f, 1.0f/2.4f) - 0.055f;
 }
 
+static inline BYTE to_sRGB_byte_exact(float f)
+{
+    return (BYTE)floorf(to_sRGB_component(f) * 255.0f + 0.51f);
+}
+
+/* Lookup tables for the common conversions, they give the same results as the direct
+ * computations. The sRGB conversion is monotonic, so the output value of a gray level
+ * between 0 and 1 is the number of thresholds below it. */
+static float srgb_thresholds[256];
+static float luma_r[256], luma_g[256], luma_b[256];
+static DWORD unpremultiply_factors[256];  /* 16.16 fixed point 255 / alpha */
+
+static BOOL WINAPI init_conversion_tables(INIT_ONCE *once, void *param, void **context)
+{
+    union { float f; DWORD i; } lo, hi, mid;
+    UINT i;
+
+    for (i = 0; i < 256; i++)
+    {
+        luma_r[i] = i * 0.2126f;
+        luma_g[i] = i * 0.7152f;
+        luma_b[i] = i * 0.0722f;
+        unpremultiply_factors[i] = i ? (255 * 65536 + i - 1) / i : 0;
+    }
+
+    srgb_thresholds[0] = 0.0f;
+    for (i = 1; i < 256; i++)
+    {
+        lo.f = 0.0f;
+        hi.f = 1.0f;
+        if (to_sRGB_byte_exact(hi.f) < i)
+        {
+            srgb_thresholds[i] = 2.0f;
+            continue;
+        }
+        /* bisect on the bit patterns, positive floats are ordered like integers */
+        while (hi.i - lo.i > 1)
+        {
+            mid.i = lo.i + (hi.i - lo.i) / 2;
+            if (to_sRGB_byte_exact(mid.f) >= i) hi = mid;
+            else lo = mid;
+        }
+        srgb_thresholds[i] = hi.f;
+    }
+    return TRUE;
+}
+
+static void init_conversion(void)
+{
+    static INIT_ONCE init_once = INIT_ONCE_STATIC_INIT;
+
+    InitOnceExecuteOnce(&init_once, init_conversion_tables, NULL, NULL);
+}
+
+/* same as to_sRGB_byte_exact(), init_conversion() must have been called */
+static inline BYTE to_sRGB_byte(float f)
+{
+    UINT lo = 0, hi = 256, mid;
+
+    if (!(f >= 0.0f && f <= 1.0f)) return to_sRGB_byte_exact(f);
+
+    while (hi - lo > 1)
+    {
+        mid = (lo + hi) / 2;
+        if (srgb_thresholds[mid] <= f) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static inline float bgr_to_luma(const BYTE *bgr)
+{
+    return (luma_r[bgr[2]] + luma_g[bgr[1]] + luma_b[bgr[0]]) / 255.0f;
+}
+
+/* exact x / 255 for x <= 255 * 255 */
+static inline BYTE div255(UINT x)
+{
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+static void premultiply_alpha(BYTE *bits, UINT width, UINT height, UINT stride)
+{
+    UINT x, y;
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        BYTE *pixel = bits;
+
+        for (x = 0; x < width; x++, pixel += 4)
+        {
+            BYTE alpha = pixel[3];
+
+            if (alpha == 255) continue;
+            pixel[0] = div255(pixel[0] * alpha);
+            pixel[1] = div255(pixel[1] * alpha);
+            pixel[2] = div255(pixel[2] * alpha);
+        }
+    }
+}
+
+static void unpremultiply_alpha(BYTE *bits, UINT width, UINT height, UINT stride)
+{
+    UINT x, y;
+
+    init_conversion();
+
+    for (y = 0; y < height; y++, bits += stride)
+    {
+        BYTE *pixel = bits;
+
+        for (x = 0; x < width; x++, pixel += 4)
+        {
+            BYTE alpha = pixel[3];
+            DWORD factor;
+
+            if (alpha == 0 || alpha == 255) continue;
+            factor = unpremultiply_factors[alpha];
+            pixel[0] = (pixel[0] * factor) >> 16;
+            pixel[1] = (pixel[1] * factor) >> 16;
+            pixel[2] = (pixel[2] * factor) >> 16;
+        }
+    }
+}
+
 #if 0 /* FIXME: enable once needed */
 static inline float from_sRGB_component(float f)
 {
@@ -730,22 +855,11 @@ static HRESULT copypixels_to_32bppBGRA(struct FormatConverter *This, const WICRe
         if (prc)
         {
             HRESULT res;
-            INT x, y;
 
             res = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(res)) return res;
 
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 0 && alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * 255 / alpha;
-                    }
-                }
+            unpremultiply_alpha(pbBuffer, prc->Width, prc->Height, cbStride);
         }
         return S_OK;
     case format_48bppRGB:
@@ -893,22 +1007,10 @@ static HRESULT copypixels_to_32bppRGBA(struct FormatConverter *This, const WICRe
     case format_32bppPRGBA:
         if (prc)
         {
-            INT x, y;
-
             hr = IWICBitmapSource_CopyPixels(This->source, prc, cbStride, cbBufferSize, pbBuffer);
             if (FAILED(hr)) return hr;
 
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 0 && alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * 255 / alpha;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * 255 / alpha;
-                    }
-                }
+            unpremultiply_alpha(pbBuffer, prc->Width, prc->Height, cbStride);
         }
         return S_OK;
 
@@ -966,21 +1068,7 @@ static HRESULT copypixels_to_32bppPBGRA(struct FormatConverter *This, const WICR
     default:
         hr = copypixels_to_32bppBGRA(This, prc, cbStride, cbBufferSize, pbBuffer, source_format);
         if (SUCCEEDED(hr) && prc)
-        {
-            INT x, y;
-
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * alpha / 255;
-                    }
-                }
-        }
+            premultiply_alpha(pbBuffer, prc->Width, prc->Height, cbStride);
         return hr;
     }
 }
@@ -999,21 +1087,7 @@ static HRESULT copypixels_to_32bppPRGBA(struct FormatConverter *This, const WICR
     default:
         hr = copypixels_to_32bppRGBA(This, prc, cbStride, cbBufferSize, pbBuffer, source_format);
         if (SUCCEEDED(hr) && prc)
-        {
-            INT x, y;
-
-            for (y=0; y<prc->Height; y++)
-                for (x=0; x<prc->Width; x++)
-                {
-                    BYTE alpha = pbBuffer[cbStride*y+4*x+3];
-                    if (alpha != 255)
-                    {
-                        pbBuffer[cbStride*y+4*x] = pbBuffer[cbStride*y+4*x] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+1] = pbBuffer[cbStride*y+4*x+1] * alpha / 255;
-                        pbBuffer[cbStride*y+4*x+2] = pbBuffer[cbStride*y+4*x+2] * alpha / 255;
-                    }
-                }
-        }
+            premultiply_alpha(pbBuffer, prc->Width, prc->Height, cbStride);
         return hr;
     }
 }
@@ -1100,6 +1174,8 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
                 INT x, y;
                 BYTE *src = srcdata, *dst = pbBuffer;
 
+                init_conversion();
+
                 for (y = 0; y < prc->Height; y++)
                 {
                     float *gray_float = (float *)src;
@@ -1107,7 +1183,7 @@ static HRESULT copypixels_to_24bppBGR(struct FormatConverter *This, const WICRec
 
                     for (x = 0; x < prc->Width; x++)
                     {
-                        BYTE gray = (BYTE)floorf(to_sRGB_component(gray_float[x]) * 255.0f + 0.51f);
+                        BYTE gray = to_sRGB_byte(gray_float[x]);
                         *bgr++ = gray;
                         *bgr++ = gray;
                         *bgr++ = gray;
@@ -1272,13 +1348,14 @@ static HRESULT copypixels_to_32bppGrayFloat(struct FormatConverter *This, const
         INT x, y;
         BYTE *p = pbBuffer;
 
+        init_conversion();
+
         for (y = 0; y < prc->Height; y++)
         {
             BYTE *bgr = p;
             for (x = 0; x < prc->Width; x++)
             {
-                float gray = (bgr[2] * 0.2126f + bgr[1] * 0.7152f + bgr[0] * 0.0722f) / 255.0f;
-                *(float *)bgr = gray;
+                *(float *)bgr = bgr_to_luma(bgr);
                 bgr += 4;
             }
             p += cbStride;
@@ -1320,13 +1397,15 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
                 INT x, y;
                 BYTE *src = srcdata, *dst = pbBuffer;
 
+                init_conversion();
+
                 for (y=0; y < prc->Height; y++)
                 {
                     float *srcpixel = (float*)src;
                     BYTE *dstpixel = dst;
 
                     for (x=0; x < prc->Width; x++)
-                        *dstpixel++ = (BYTE)floorf(to_sRGB_component(*srcpixel++) * 255.0f + 0.51f);
+                        *dstpixel++ = to_sRGB_byte(*srcpixel++);
 
                     src += srcstride;
                     dst += cbStride;
@@ -1354,16 +1433,15 @@ static HRESULT copypixels_to_8bppGray(struct FormatConverter *This, const WICRec
         INT x, y;
         BYTE *src = srcdata, *dst = pbBuffer;
 
+        init_conversion();
+
         for (y = 0; y < prc->Height; y++)
         {
             BYTE *bgr = src;
 
             for (x = 0; x < prc->Width; x++)
             {
-                float gray = (bgr[2] * 0.2126f + bgr[1] * 0.7152f + bgr[0] * 0.0722f) / 255.0f;
-
-                gray = to_sRGB_component(gray) * 255.0f;
-                dst[x] = (BYTE)floorf(gray + 0.51f);
+                dst[x] = to_sRGB_byte(bgr_to_luma(bgr));
                 bgr += 3;
             }
             src += srcstride;
@@ -69,6 +69,7 @@ static const WCHAR wszJpegYCrCbSubsampling[] = {'J','p','e','g','Y','C','r','C',
 static const WCHAR wszSuppressApp0[] = {'S','u','p','p','r','e','s','s','A','p','p','0',0};
 
 #define MAKE_FUNCPTR(f) static typeof(f) * p##f
+MAKE_FUNCPTR(jpeg_abort_decompress);
 MAKE_FUNCPTR(jpeg_CreateCompress);
 MAKE_FUNCPTR(jpeg_CreateDecompress);
 MAKE_FUNCPTR(jpeg_destroy_compress);
@@ -94,6 +95,7 @@ static void *load_libjpeg(void)
         return NULL; \
     }
 
+        LOAD_FUNCPTR(jpeg_abort_decompress);
         LOAD_FUNCPTR(jpeg_CreateCompress);
         LOAD_FUNCPTR(jpeg_CreateDecompress);
         LOAD_FUNCPTR(jpeg_destroy_compress);
@@ -156,8 +158,9 @@ typedef struct {
     struct jpeg_error_mgr jerr;
     struct jpeg_source_mgr source_mgr;
     BYTE source_buffer[1024];
-    UINT bpp, stride;
-    BYTE *image_data;
+    ULONGLONG stream_pos;
+    UINT bpp;
+    struct strip_cache strips;
     CRITICAL_SECTION lock;
 } JpegDecoder;
 
@@ -227,7 +230,7 @@ static ULONG WINAPI JpegDecoder_Release(IWICBitmapDecoder *iface)
         DeleteCriticalSection(&This->lock);
         if (This->cinfo_initialized) pjpeg_destroy_decompress(&This->cinfo);
         if (This->stream) IStream_Release(This->stream);
-        HeapFree(GetProcessHeap(), 0, This->image_data);
+        strip_cache_free(&This->strips);
         HeapFree(GetProcessHeap(), 0, This);
     }
 
@@ -259,10 +262,17 @@ static void source_mgr_init_source(j_decompress_ptr cinfo)
 static jpeg_boolean source_mgr_fill_input_buffer(j_decompress_ptr cinfo)
 {
     JpegDecoder *This = decoder_from_decompress(cinfo);
+    LARGE_INTEGER seek;
     HRESULT hr;
     ULONG bytesread;
 
-    hr = IStream_Read(This->stream, This->source_buffer, 1024, &bytesread);
+    /* the stream may have been moved since the last read, as scanlines are
+     * decoded on demand */
+    seek.QuadPart = This->stream_pos;
+    hr = IStream_Seek(This->stream, seek, STREAM_SEEK_SET, NULL);
+
+    if (SUCCEEDED(hr))
+        hr = IStream_Read(This->stream, This->source_buffer, 1024, &bytesread);
 
     if (FAILED(hr) || bytesread == 0)
     {
@@ -270,6 +280,7 @@ static jpeg_boolean source_mgr_fill_input_buffer(j_decompress_ptr cinfo)
     }
     else
     {
+        This->stream_pos += bytesread;
         This->source_mgr.next_input_byte = This->source_buffer;
         This->source_mgr.bytes_in_buffer = bytesread;
         return TRUE;
@@ -279,12 +290,10 @@ static jpeg_boolean source_mgr_fill_input_buffer(j_decompress_ptr cinfo)
 static void source_mgr_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
 {
     JpegDecoder *This = decoder_from_decompress(cinfo);
-    LARGE_INTEGER seek;
 
     if (num_bytes > This->source_mgr.bytes_in_buffer)
     {
-        seek.QuadPart = num_bytes - This->source_mgr.bytes_in_buffer;
-        IStream_Seek(This->stream, seek, STREAM_SEEK_CUR, NULL);
+        This->stream_pos += num_bytes - This->source_mgr.bytes_in_buffer;
         This->source_mgr.bytes_in_buffer = 0;
     }
     else if (num_bytes > 0)
@@ -298,64 +307,17 @@ static void source_mgr_term_source(j_decompress_ptr cinfo)
 {
 }
 
-static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *pIStream,
-    WICDecodeOptions cacheOptions)
+static HRESULT start_decompress(JpegDecoder *This)
 {
-    JpegDecoder *This = impl_from_IWICBitmapDecoder(iface);
     int ret;
-    LARGE_INTEGER seek;
-    jmp_buf jmpbuf;
-    UINT data_size, i;
-
-    TRACE("(%p,%p,%u)\n", iface, pIStream, cacheOptions);
-
-    EnterCriticalSection(&This->lock);
-
-    if (This->cinfo_initialized)
-    {
-        LeaveCriticalSection(&This->lock);
-        return WINCODEC_ERR_WRONGSTATE;
-    }
-
-    pjpeg_std_error(&This->jerr);
-
-    This->jerr.error_exit = error_exit_fn;
-    This->jerr.emit_message = emit_message_fn;
-
-    This->cinfo.err = &This->jerr;
-
-    This->cinfo.client_data = jmpbuf;
-
-    if (setjmp(jmpbuf))
-    {
-        LeaveCriticalSection(&This->lock);
-        return E_FAIL;
-    }
-
-    pjpeg_CreateDecompress(&This->cinfo, JPEG_LIB_VERSION, sizeof(struct jpeg_decompress_struct));
-
-    This->cinfo_initialized = TRUE;
-
-    This->stream = pIStream;
-    IStream_AddRef(pIStream);
-
-    seek.QuadPart = 0;
-    IStream_Seek(This->stream, seek, STREAM_SEEK_SET, NULL);
 
+    This->stream_pos = 0;
     This->source_mgr.bytes_in_buffer = 0;
-    This->source_mgr.init_source = source_mgr_init_source;
-    This->source_mgr.fill_input_buffer = source_mgr_fill_input_buffer;
-    This->source_mgr.skip_input_data = source_mgr_skip_input_data;
-    This->source_mgr.resync_to_restart = pjpeg_resync_to_restart;
-    This->source_mgr.term_source = source_mgr_term_source;
-
-    This->cinfo.src = &This->source_mgr;
 
     ret = pjpeg_read_header(&This->cinfo, TRUE);
 
     if (ret != JPEG_HEADER_OK) {
         WARN("Jpeg image in stream has bad format, read header returned %d.\n",ret);
-        LeaveCriticalSection(&This->lock);
         return E_FAIL;
     }
 
@@ -374,47 +336,53 @@ static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *
         break;
     default:
         ERR("Unknown JPEG color space %i\n", This->cinfo.jpeg_color_space);
-        LeaveCriticalSection(&This->lock);
         return E_FAIL;
     }
 
     if (!pjpeg_start_decompress(&This->cinfo))
     {
         ERR("jpeg_start_decompress failed\n");
-        LeaveCriticalSection(&This->lock);
         return E_FAIL;
     }
 
-    if (This->cinfo.out_color_space == JCS_GRAYSCALE) This->bpp = 8;
-    else if (This->cinfo.out_color_space == JCS_CMYK) This->bpp = 32;
-    else This->bpp = 24;
+    return S_OK;
+}
+
+static HRESULT read_rows(void *user, BOOL restart, UINT count, UINT stride, BYTE *dst)
+{
+    JpegDecoder *This = user;
+    jmp_buf jmpbuf;
+    UINT first_row, i;
+    HRESULT hr;
+
+    This->cinfo.client_data = jmpbuf;
 
-    This->stride = (This->bpp * This->cinfo.output_width + 7) / 8;
-    data_size = This->stride * This->cinfo.output_height;
+    if (setjmp(jmpbuf))
+        return E_FAIL;
 
-    This->image_data = heap_alloc(data_size);
-    if (!This->image_data)
+    if (restart)
     {
-        LeaveCriticalSection(&This->lock);
-        return E_OUTOFMEMORY;
+        pjpeg_abort_decompress(&This->cinfo);
+        hr = start_decompress(This);
+        if (FAILED(hr)) return hr;
     }
 
-    while (This->cinfo.output_scanline < This->cinfo.output_height)
+    first_row = This->cinfo.output_scanline;
+
+    while (This->cinfo.output_scanline < first_row + count)
     {
-        UINT first_scanline = This->cinfo.output_scanline;
         UINT max_rows;
         JSAMPROW out_rows[4];
         JDIMENSION ret;
 
-        max_rows = min(This->cinfo.output_height-first_scanline, 4);
+        max_rows = min(first_row + count - This->cinfo.output_scanline, 4);
         for (i=0; i<max_rows; i++)
-            out_rows[i] = This->image_data + This->stride * (first_scanline+i);
+            out_rows[i] = dst + stride * (This->cinfo.output_scanline - first_row + i);
 
         ret = pjpeg_read_scanlines(&This->cinfo, out_rows, max_rows);
         if (ret == 0)
         {
             ERR("read_scanlines failed\n");
-            LeaveCriticalSection(&This->lock);
             return E_FAIL;
         }
     }
@@ -422,18 +390,81 @@ static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *
     if (This->bpp == 24)
     {
         /* libjpeg gives us RGB data and we want BGR, so byteswap the data */
-        reverse_bgr8(3, This->image_data,
-            This->cinfo.output_width, This->cinfo.output_height,
-            This->stride);
+        reverse_bgr8(3, dst, This->cinfo.output_width, count, stride);
     }
 
     if (This->cinfo.out_color_space == JCS_CMYK && This->cinfo.saw_Adobe_marker)
     {
         /* Adobe JPEG's have inverted CMYK data. */
-        for (i=0; i<data_size; i++)
-            This->image_data[i] ^= 0xff;
+        for (i=0; i<stride * count; i++)
+            dst[i] ^= 0xff;
+    }
+
+    return S_OK;
+}
+
+static HRESULT WINAPI JpegDecoder_Initialize(IWICBitmapDecoder *iface, IStream *pIStream,
+    WICDecodeOptions cacheOptions)
+{
+    JpegDecoder *This = impl_from_IWICBitmapDecoder(iface);
+    jmp_buf jmpbuf;
+    HRESULT hr;
+
+    TRACE("(%p,%p,%u)\n", iface, pIStream, cacheOptions);
+
+    EnterCriticalSection(&This->lock);
+
+    if (This->cinfo_initialized)
+    {
+        LeaveCriticalSection(&This->lock);
+        return WINCODEC_ERR_WRONGSTATE;
+    }
+
+    pjpeg_std_error(&This->jerr);
+
+    This->jerr.error_exit = error_exit_fn;
+    This->jerr.emit_message = emit_message_fn;
+
+    This->cinfo.err = &This->jerr;
+
+    This->cinfo.client_data = jmpbuf;
+
+    if (setjmp(jmpbuf))
+    {
+        LeaveCriticalSection(&This->lock);
+        return E_FAIL;
     }
 
+    pjpeg_CreateDecompress(&This->cinfo, JPEG_LIB_VERSION, sizeof(struct jpeg_decompress_struct));
+
+    This->cinfo_initialized = TRUE;
+
+    This->stream = pIStream;
+    IStream_AddRef(pIStream);
+
+    This->source_mgr.init_source = source_mgr_init_source;
+    This->source_mgr.fill_input_buffer = source_mgr_fill_input_buffer;
+    This->source_mgr.skip_input_data = source_mgr_skip_input_data;
+    This->source_mgr.resync_to_restart = pjpeg_resync_to_restart;
+    This->source_mgr.term_source = source_mgr_term_source;
+
+    This->cinfo.src = &This->source_mgr;
+
+    hr = start_decompress(This);
+    if (FAILED(hr))
+    {
+        LeaveCriticalSection(&This->lock);
+        return hr;
+    }
+
+    if (This->cinfo.out_color_space == JCS_GRAYSCALE) This->bpp = 8;
+    else if (This->cinfo.out_color_space == JCS_CMYK) This->bpp = 32;
+    else This->bpp = 24;
+
+    /* scanlines are only decoded when CopyPixels needs them */
+    strip_cache_init(&This->strips, This->bpp, This->cinfo.output_width,
+        This->cinfo.output_height, FALSE, read_rows, This);
+
     This->initialized = TRUE;
 
     LeaveCriticalSection(&This->lock);
@@ -643,12 +674,15 @@ static HRESULT WINAPI JpegDecoder_Frame_CopyPixels(IWICBitmapFrameDecode *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
     JpegDecoder *This = impl_from_IWICBitmapFrameDecode(iface);
+    HRESULT hr;
 
     TRACE("(%p,%s,%u,%u,%p)\n", iface, debug_wic_rect(prc), cbStride, cbBufferSize, pbBuffer);
 
-    return copy_pixels(This->bpp, This->image_data,
-        This->cinfo.output_width, This->cinfo.output_height, This->stride,
-        prc, cbStride, cbBufferSize, pbBuffer);
+    EnterCriticalSection(&This->lock);
+    hr = strip_cache_copy_pixels(&This->strips, prc, cbStride, cbBufferSize, pbBuffer);
+    LeaveCriticalSection(&This->lock);
+
+    return hr;
 }
 
 static HRESULT WINAPI JpegDecoder_Frame_GetMetadataQueryReader(IWICBitmapFrameDecode *iface,
@@ -784,7 +818,7 @@ HRESULT JpegDecoder_CreateInstance(REFIID iid, void** ppv)
     This->initialized = FALSE;
     This->cinfo_initialized = FALSE;
     This->stream = NULL;
-    This->image_data = NULL;
+    strip_cache_init(&This->strips, 0, 0, 0, FALSE, NULL, NULL);
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": JpegDecoder.lock");
 
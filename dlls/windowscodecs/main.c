@@ -120,6 +120,183 @@ HRESULT copy_pixels(UINT bpp, const BYTE *srcbuffer,
     }
 }
 
+/* target size of a single decoded strip */
+#define STRIP_BYTES (256 * 1024)
+
+/* largest image kept whole once the decoder had to be restarted */
+#define WHOLE_IMAGE_BYTES (512 * 1024 * 1024)
+
+void strip_cache_init(struct strip_cache *cache, UINT bpp, UINT width, UINT height,
+    BOOL whole_image, read_rows_func read_rows, void *user)
+{
+    UINT i;
+
+    cache->bpp = bpp;
+    cache->width = width;
+    cache->height = height;
+    cache->stride = (bpp * width + 7) / 8;
+    if (whole_image || !cache->stride)
+        cache->strip_rows = height;
+    else
+        cache->strip_rows = min(height, max(1, STRIP_BYTES / cache->stride));
+    cache->next_row = 0;
+    cache->clock = 0;
+    cache->read_rows = read_rows;
+    cache->user = user;
+    for (i = 0; i < STRIP_CACHE_SIZE; i++)
+    {
+        cache->strips[i].index = ~0u;
+        cache->strips[i].last_used = 0;
+        cache->strips[i].bits = NULL;
+    }
+}
+
+void strip_cache_free(struct strip_cache *cache)
+{
+    UINT i;
+
+    for (i = 0; i < STRIP_CACHE_SIZE; i++)
+    {
+        HeapFree(GetProcessHeap(), 0, cache->strips[i].bits);
+        cache->strips[i].bits = NULL;
+        cache->strips[i].index = ~0u;
+        cache->strips[i].last_used = 0;
+    }
+}
+
+static UINT strip_rows(const struct strip_cache *cache, UINT index)
+{
+    return min(cache->strip_rows, cache->height - index * cache->strip_rows);
+}
+
+/* get the strip containing a row, the strip size may change when the decoder is restarted */
+static HRESULT get_strip(struct strip_cache *cache, UINT row, struct decoded_strip **ret)
+{
+    UINT index = row / cache->strip_rows;
+    struct decoded_strip *strip;
+    BOOL restart = FALSE;
+    BYTE *bits;
+    HRESULT hr;
+    UINT i;
+
+    for (i = 0; i < STRIP_CACHE_SIZE; i++)
+    {
+        if (cache->strips[i].index == index)
+        {
+            cache->strips[i].last_used = ++cache->clock;
+            *ret = &cache->strips[i];
+            return S_OK;
+        }
+    }
+
+    if (index * cache->strip_rows < cache->next_row)
+    {
+        TRACE("restarting decoder for strip %u\n", index);
+        restart = TRUE;
+        cache->next_row = 0;
+
+        /* Restarting for every backward access, for instance when the rows are
+         * read bottom-up, would decode the image once per strip, so keep the
+         * whole image from now on if it can be allocated. */
+        if (cache->strip_rows < cache->height &&
+            (ULONGLONG)cache->stride * cache->height <= WHOLE_IMAGE_BYTES &&
+            (bits = HeapAlloc(GetProcessHeap(), 0, cache->stride * cache->height)))
+        {
+            TRACE("keeping the whole image\n");
+            strip_cache_free(cache);
+            cache->strip_rows = cache->height;
+            cache->strips[0].bits = bits;
+            index = 0;
+        }
+    }
+
+    /* Strips are decoded in order; those preceding the requested one go
+     * through the cache as well since the work to decode them is done anyway. */
+    for (;;)
+    {
+        UINT current = cache->next_row / cache->strip_rows;
+
+        strip = &cache->strips[0];
+        for (i = 1; i < STRIP_CACHE_SIZE; i++)
+            if (cache->strips[i].last_used < strip->last_used) strip = &cache->strips[i];
+
+        if (!strip->bits)
+        {
+            strip->bits = HeapAlloc(GetProcessHeap(), 0, cache->stride * cache->strip_rows);
+            if (!strip->bits) return E_OUTOFMEMORY;
+        }
+
+        strip->index = ~0u;
+        hr = cache->read_rows(cache->user, restart, strip_rows(cache, current), cache->stride, strip->bits);
+        if (FAILED(hr))
+        {
+            cache->next_row = cache->height;
+            return hr;
+        }
+
+        restart = FALSE;
+        strip->index = current;
+        strip->last_used = ++cache->clock;
+        cache->next_row += strip_rows(cache, current);
+
+        if (current == index)
+        {
+            *ret = strip;
+            return S_OK;
+        }
+    }
+}
+
+HRESULT strip_cache_copy_pixels(struct strip_cache *cache, const WICRect *rc,
+    UINT dststride, UINT dstbuffersize, BYTE *dstbuffer)
+{
+    struct decoded_strip *strip = NULL;
+    UINT bytesperrow, first, strip_first;
+    WICRect rect, strip_rect;
+    HRESULT hr;
+
+    if (!rc)
+    {
+        rect.X = 0;
+        rect.Y = 0;
+        rect.Width = cache->width;
+        rect.Height = cache->height;
+    }
+    else
+    {
+        if (rc->X < 0 || rc->Y < 0 || rc->X+rc->Width > cache->width || rc->Y+rc->Height > cache->height)
+            return E_INVALIDARG;
+        rect = *rc;
+    }
+
+    bytesperrow = ((cache->bpp * rect.Width)+7)/8;
+
+    if (dststride < bytesperrow)
+        return E_INVALIDARG;
+
+    if ((dststride * (rect.Height-1)) + bytesperrow > dstbuffersize)
+        return E_INVALIDARG;
+
+    for (first = rect.Y; first < rect.Y + rect.Height; first += strip_rect.Height)
+    {
+        hr = get_strip(cache, first, &strip);
+        if (FAILED(hr)) return hr;
+        strip_first = strip->index * cache->strip_rows;
+
+        strip_rect.X = rect.X;
+        strip_rect.Y = first - strip_first;
+        strip_rect.Width = rect.Width;
+        strip_rect.Height = min(rect.Y + rect.Height - first, strip_rows(cache, strip->index) - strip_rect.Y);
+
+        hr = copy_pixels(cache->bpp, strip->bits, cache->width, strip_rows(cache, strip->index), cache->stride,
+            &strip_rect, dststride, dststride * (strip_rect.Height-1) + bytesperrow,
+            dstbuffer + dststride * (first - rect.Y));
+        if (FAILED(hr)) return hr;
+    }
+
+    return S_OK;
+}
+
 HRESULT configure_write_source(IWICBitmapFrameEncode *iface,
     IWICBitmapSource *source, const WICRect *prc,
     const WICPixelFormatGUID *format,
@@ -313,6 +313,7 @@ MAKE_FUNCPTR(png_get_error_ptr);
 MAKE_FUNCPTR(png_get_iCCP);
 MAKE_FUNCPTR(png_get_image_height);
 MAKE_FUNCPTR(png_get_image_width);
+MAKE_FUNCPTR(png_get_interlace_type);
 MAKE_FUNCPTR(png_get_io_ptr);
 MAKE_FUNCPTR(png_get_pHYs);
 MAKE_FUNCPTR(png_get_PLTE);
@@ -336,6 +337,7 @@ MAKE_FUNCPTR(png_set_swap);
 MAKE_FUNCPTR(png_read_end);
 MAKE_FUNCPTR(png_read_image);
 MAKE_FUNCPTR(png_read_info);
+MAKE_FUNCPTR(png_read_row);
 MAKE_FUNCPTR(png_write_end);
 MAKE_FUNCPTR(png_write_info);
 MAKE_FUNCPTR(png_write_rows);
@@ -380,6 +382,7 @@ static void *load_libpng(void)
         LOAD_FUNCPTR(png_get_iCCP);
         LOAD_FUNCPTR(png_get_image_height);
         LOAD_FUNCPTR(png_get_image_width);
+        LOAD_FUNCPTR(png_get_interlace_type);
         LOAD_FUNCPTR(png_get_io_ptr);
         LOAD_FUNCPTR(png_get_pHYs);
         LOAD_FUNCPTR(png_get_PLTE);
@@ -403,6 +406,7 @@ static void *load_libpng(void)
         LOAD_FUNCPTR(png_read_end);
         LOAD_FUNCPTR(png_read_image);
         LOAD_FUNCPTR(png_read_info);
+        LOAD_FUNCPTR(png_read_row);
         LOAD_FUNCPTR(png_write_end);
         LOAD_FUNCPTR(png_write_info);
         LOAD_FUNCPTR(png_write_rows);
@@ -445,15 +449,16 @@ typedef struct {
     IWICMetadataBlockReader IWICMetadataBlockReader_iface;
     LONG ref;
     IStream *stream;
+    ULONGLONG stream_pos;
     png_structp png_ptr;
     png_infop info_ptr;
     png_infop end_info;
     BOOL initialized;
     int bpp;
     int width, height;
-    UINT stride;
+    BOOL interlaced;
     const WICPixelFormatGUID *format;
-    BYTE *image_bits;
+    struct strip_cache strips;
     CRITICAL_SECTION lock; /* must be held when png structures are accessed or initialized is set */
     ULONG metadata_count;
     metadata_block_info* metadata_blocks;
@@ -524,7 +529,7 @@ static ULONG WINAPI PngDecoder_Release(IWICBitmapDecoder *iface)
             ppng_destroy_read_struct(&This->png_ptr, &This->info_ptr, &This->end_info);
         This->lock.DebugInfo->Spare[0] = 0;
         DeleteCriticalSection(&This->lock);
-        HeapFree(GetProcessHeap(), 0, This->image_bits);
+        strip_cache_free(&This->strips);
         for (i=0; i<This->metadata_count; i++)
         {
             if (This->metadata_blocks[i].reader)
@@ -557,47 +562,40 @@ static HRESULT WINAPI PngDecoder_QueryCapability(IWICBitmapDecoder *iface, IStre
 
 static void user_read_data(png_structp png_ptr, png_bytep data, png_size_t length)
 {
-    IStream *stream = ppng_get_io_ptr(png_ptr);
+    PngDecoder *This = ppng_get_io_ptr(png_ptr);
+    LARGE_INTEGER seek;
     HRESULT hr;
-    ULONG bytesread;
+    ULONG bytesread = 0;
 
-    hr = IStream_Read(stream, data, length, &bytesread);
+    /* rows are decoded on demand and the stream is also used to find the
+     * metadata blocks, so always continue from where the last read ended */
+    seek.QuadPart = This->stream_pos;
+    hr = IStream_Seek(This->stream, seek, STREAM_SEEK_SET, NULL);
+    if (SUCCEEDED(hr))
+        hr = IStream_Read(This->stream, data, length, &bytesread);
     if (FAILED(hr) || bytesread != length)
     {
         ppng_error(png_ptr, "failed reading data");
     }
+    This->stream_pos += bytesread;
 }
 
-static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *pIStream,
-    WICDecodeOptions cacheOptions)
+/* Create the libpng read structures and read the header, choosing the pixel
+ * format and the transformations needed to produce it. */
+static HRESULT start_read(PngDecoder *This)
 {
-    PngDecoder *This = impl_from_IWICBitmapDecoder(iface);
-    LARGE_INTEGER seek;
-    HRESULT hr=S_OK;
-    png_bytep *row_pointers=NULL;
-    UINT image_size;
-    UINT i;
     int color_type, bit_depth;
     png_bytep trans;
     int num_trans;
     png_uint_32 transparency;
     png_color_16p trans_values;
     jmp_buf jmpbuf;
-    BYTE chunk_type[4];
-    ULONG chunk_size;
-    ULARGE_INTEGER chunk_start;
-    ULONG metadata_blocks_size = 0;
-
-    TRACE("(%p,%p,%x)\n", iface, pIStream, cacheOptions);
-
-    EnterCriticalSection(&This->lock);
 
     /* initialize libpng */
     This->png_ptr = ppng_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!This->png_ptr)
     {
-        hr = E_FAIL;
-        goto end;
+        return E_FAIL;
     }
 
     This->info_ptr = ppng_create_info_struct(This->png_ptr);
@@ -605,8 +603,7 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
     {
         ppng_destroy_read_struct(&This->png_ptr, NULL, NULL);
         This->png_ptr = NULL;
-        hr = E_FAIL;
-        goto end;
+        return E_FAIL;
     }
 
     This->end_info = ppng_create_info_struct(This->png_ptr);
@@ -614,8 +611,7 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
     {
         ppng_destroy_read_struct(&This->png_ptr, &This->info_ptr, NULL);
         This->png_ptr = NULL;
-        hr = E_FAIL;
-        goto end;
+        return E_FAIL;
     }
 
     /* set up setjmp/longjmp error handling */
@@ -623,23 +619,20 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
     {
         ppng_destroy_read_struct(&This->png_ptr, &This->info_ptr, &This->end_info);
         This->png_ptr = NULL;
-        hr = WINCODEC_ERR_UNKNOWNIMAGEFORMAT;
-        goto end;
+        return WINCODEC_ERR_UNKNOWNIMAGEFORMAT;
     }
     ppng_set_error_fn(This->png_ptr, jmpbuf, user_error_fn, user_warning_fn);
     ppng_set_crc_action(This->png_ptr, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
 
-    /* seek to the start of the stream */
-    seek.QuadPart = 0;
-    hr = IStream_Seek(pIStream, seek, STREAM_SEEK_SET, NULL);
-    if (FAILED(hr)) goto end;
-
-    /* set up custom i/o handling */
-    ppng_set_read_fn(This->png_ptr, pIStream, user_read_data);
+    /* start reading from the beginning of the stream */
+    This->stream_pos = 0;
+    ppng_set_read_fn(This->png_ptr, This, user_read_data);
 
     /* read the header */
     ppng_read_info(This->png_ptr, This->info_ptr);
 
+    This->interlaced = ppng_get_interlace_type(This->png_ptr, This->info_ptr) != PNG_INTERLACE_NONE;
+
     /* choose a pixel format */
     color_type = ppng_get_color_type(This->png_ptr, This->info_ptr);
     bit_depth = ppng_get_bit_depth(This->png_ptr, This->info_ptr);
@@ -678,8 +671,7 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
         case 16: This->format = &GUID_WICPixelFormat64bppRGBA; break;
         default:
             ERR("invalid RGBA bit depth: %i\n", bit_depth);
-            hr = E_FAIL;
-            goto end;
+            return E_FAIL;
         }
         break;
     case PNG_COLOR_TYPE_GRAY:
@@ -695,8 +687,7 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
             case 16: This->format = &GUID_WICPixelFormat16bppGray; break;
             default:
                 ERR("invalid grayscale bit depth: %i\n", bit_depth);
-                hr = E_FAIL;
-                goto end;
+                return E_FAIL;
             }
             break;
         }
@@ -711,8 +702,7 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
         case 8: This->format = &GUID_WICPixelFormat8bppIndexed; break;
         default:
             ERR("invalid indexed color bit depth: %i\n", bit_depth);
-            hr = E_FAIL;
-            goto end;
+            return E_FAIL;
         }
         break;
     case PNG_COLOR_TYPE_RGB:
@@ -726,45 +716,87 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
         case 16: This->format = &GUID_WICPixelFormat48bppRGB; break;
         default:
             ERR("invalid RGB color bit depth: %i\n", bit_depth);
-            hr = E_FAIL;
-            goto end;
+            return E_FAIL;
         }
         break;
     default:
         ERR("invalid color type %i\n", color_type);
-        hr = E_FAIL;
-        goto end;
+        return E_FAIL;
     }
 
-    /* read the image data */
-    This->width = ppng_get_image_width(This->png_ptr, This->info_ptr);
-    This->height = ppng_get_image_height(This->png_ptr, This->info_ptr);
-    This->stride = (This->width * This->bpp + 7) / 8;
-    image_size = This->stride * This->height;
 
-    This->image_bits = HeapAlloc(GetProcessHeap(), 0, image_size);
-    if (!This->image_bits)
+    return S_OK;
+}
+
+static HRESULT read_rows(void *user, BOOL restart, UINT count, UINT stride, BYTE *dst)
+{
+    PngDecoder *This = user;
+    png_bytep *row_pointers;
+    jmp_buf jmpbuf;
+    HRESULT hr;
+    UINT i;
+
+    if (restart)
     {
-        hr = E_OUTOFMEMORY;
-        goto end;
+        ppng_destroy_read_struct(&This->png_ptr, &This->info_ptr, &This->end_info);
+        This->png_ptr = NULL;
+        hr = start_read(This);
+        if (FAILED(hr)) return hr;
     }
 
-    row_pointers = HeapAlloc(GetProcessHeap(), 0, sizeof(png_bytep)*This->height);
-    if (!row_pointers)
+    row_pointers = HeapAlloc(GetProcessHeap(), 0, sizeof(png_bytep) * count);
+    if (!row_pointers) return E_OUTOFMEMORY;
+
+    for (i=0; i<count; i++)
+        row_pointers[i] = dst + i * stride;
+
+    if (setjmp(jmpbuf))
     {
-        hr = E_OUTOFMEMORY;
-        goto end;
+        HeapFree(GetProcessHeap(), 0, row_pointers);
+        return E_FAIL;
     }
+    ppng_set_error_fn(This->png_ptr, jmpbuf, user_error_fn, user_warning_fn);
 
-    for (i=0; i<This->height; i++)
-        row_pointers[i] = This->image_bits + i * This->stride;
-
-    ppng_read_image(This->png_ptr, row_pointers);
+    /* interlaced images are decoded as a single strip */
+    if (This->interlaced)
+        ppng_read_image(This->png_ptr, row_pointers);
+    else
+    {
+        for (i=0; i<count; i++)
+            ppng_read_row(This->png_ptr, row_pointers[i], NULL);
+    }
 
     HeapFree(GetProcessHeap(), 0, row_pointers);
-    row_pointers = NULL;
 
-    ppng_read_end(This->png_ptr, This->end_info);
+    return S_OK;
+}
+
+static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *pIStream,
+    WICDecodeOptions cacheOptions)
+{
+    PngDecoder *This = impl_from_IWICBitmapDecoder(iface);
+    LARGE_INTEGER seek;
+    HRESULT hr=S_OK;
+    BYTE chunk_type[4];
+    ULONG chunk_size;
+    ULARGE_INTEGER chunk_start;
+    ULONG metadata_blocks_size = 0;
+
+    TRACE("(%p,%p,%x)\n", iface, pIStream, cacheOptions);
+
+    EnterCriticalSection(&This->lock);
+
+    This->stream = pIStream;
+    IStream_AddRef(This->stream);
+
+    hr = start_read(This);
+    if (FAILED(hr)) goto end;
+
+    /* the image data is only decoded when CopyPixels needs it */
+    This->width = ppng_get_image_width(This->png_ptr, This->info_ptr);
+    This->height = ppng_get_image_height(This->png_ptr, This->info_ptr);
+    strip_cache_init(&This->strips, This->bpp, This->width, This->height,
+        This->interlaced, read_rows, This);
 
     /* Find the metadata chunks in the file. */
     seek.QuadPart = 8;
@@ -813,15 +845,16 @@ static HRESULT WINAPI PngDecoder_Initialize(IWICBitmapDecoder *iface, IStream *p
         seek.QuadPart = chunk_start.QuadPart + chunk_size + 12; /* skip data and CRC */
     } while (memcmp(chunk_type, "IEND", 4));
 
-    This->stream = pIStream;
-    IStream_AddRef(This->stream);
-
     This->initialized = TRUE;
 
 end:
-    LeaveCriticalSection(&This->lock);
+    if (FAILED(hr))
+    {
+        IStream_Release(This->stream);
+        This->stream = NULL;
+    }
 
-    HeapFree(GetProcessHeap(), 0, row_pointers);
+    LeaveCriticalSection(&This->lock);
 
     return hr;
 }
@@ -1105,11 +1138,15 @@ static HRESULT WINAPI PngDecoder_Frame_CopyPixels(IWICBitmapFrameDecode *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
     PngDecoder *This = impl_from_IWICBitmapFrameDecode(iface);
+    HRESULT hr;
+
     TRACE("(%p,%s,%u,%u,%p)\n", iface, debug_wic_rect(prc), cbStride, cbBufferSize, pbBuffer);
 
-    return copy_pixels(This->bpp, This->image_bits,
-        This->width, This->height, This->stride,
-        prc, cbStride, cbBufferSize, pbBuffer);
+    EnterCriticalSection(&This->lock);
+    hr = strip_cache_copy_pixels(&This->strips, prc, cbStride, cbBufferSize, pbBuffer);
+    LeaveCriticalSection(&This->lock);
+
+    return hr;
 }
 
 static HRESULT WINAPI PngDecoder_Frame_GetMetadataQueryReader(IWICBitmapFrameDecode *iface,
@@ -1322,7 +1359,7 @@ HRESULT PngDecoder_CreateInstance(REFIID iid, void** ppv)
     This->end_info = NULL;
     This->stream = NULL;
     This->initialized = FALSE;
-    This->image_bits = NULL;
+    strip_cache_init(&This->strips, 0, 0, 0, FALSE, NULL, NULL);
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": PngDecoder.lock");
     This->metadata_count = 0;
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <stdarg.h>
+#include <math.h>
 
 #define COBJMACROS
 
@@ -33,6 +34,19 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(wincodecs);
 
+/* upper bound on the source data fetched by a single strip in CopyPixels */
+#define SCALER_STRIP_SIZE (1024 * 1024)
+
+#define FILTER_BITS 14
+
+struct scaler_filter
+{
+    UINT taps;      /* stride of the weights array */
+    UINT *first;    /* first source pixel contributing to each destination pixel */
+    UINT *count;    /* number of contributing source pixels */
+    INT *weights;   /* taps weights per destination pixel, FILTER_BITS fixed point */
+};
+
 typedef struct BitmapScaler {
     IWICBitmapScaler IWICBitmapScaler_iface;
     LONG ref;
@@ -44,9 +58,109 @@ typedef struct BitmapScaler {
     UINT bpp;
     void (*fn_get_required_source_rect)(struct BitmapScaler*,UINT,UINT,WICRect*);
     void (*fn_copy_scanline)(struct BitmapScaler*,UINT,UINT,UINT,BYTE**,UINT,UINT,BYTE*);
+    struct scaler_filter filter_x, filter_y;
+    INT *row_buffer;
     CRITICAL_SECTION lock; /* must be held when initialized */
 } BitmapScaler;
 
+static void free_filter(struct scaler_filter *filter)
+{
+    HeapFree(GetProcessHeap(), 0, filter->first);
+    HeapFree(GetProcessHeap(), 0, filter->count);
+    HeapFree(GetProcessHeap(), 0, filter->weights);
+    memset(filter, 0, sizeof(*filter));
+}
+
+static double filter_kernel(WICBitmapInterpolationMode mode, double x)
+{
+    x = fabs(x);
+
+    if (mode == WICBitmapInterpolationModeLinear)
+        return x < 1.0 ? 1.0 - x : 0.0;
+
+    /* Catmull-Rom cubic */
+    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+}
+
+/* Build the weight table for resampling src_size pixels to dst_size along one
+ * axis. Fant is a box filter weighting each source pixel by its coverage, the
+ * other modes sample their kernel around the destination pixel centre. Edge
+ * pixels are replicated, and the weights of each destination pixel are
+ * normalized to exactly 1 << FILTER_BITS. Source pixels with a zero weight
+ * are kept, so that the first and last source pixels only grow with the
+ * destination pixel, which CopyPixels relies on to size its source strips. */
+static BOOL init_filter(struct scaler_filter *filter, UINT src_size, UINT dst_size,
+    WICBitmapInterpolationMode mode)
+{
+    double scale = (double)src_size / dst_size;
+    double support, *weights, total;
+    INT lo, hi, i, n, sum, best;
+    UINT x;
+
+    if (mode == WICBitmapInterpolationModeFant)
+        support = scale / 2.0 + 0.5;
+    else if (mode == WICBitmapInterpolationModeLinear)
+        support = 1.0;
+    else
+        support = 2.0;
+
+    filter->taps = (UINT)ceil(support * 2.0) + 3;
+    filter->first = HeapAlloc(GetProcessHeap(), 0, dst_size * sizeof(UINT));
+    filter->count = HeapAlloc(GetProcessHeap(), 0, dst_size * sizeof(UINT));
+    filter->weights = HeapAlloc(GetProcessHeap(), 0, dst_size * filter->taps * sizeof(INT));
+    weights = HeapAlloc(GetProcessHeap(), 0, filter->taps * sizeof(double));
+    if (!filter->first || !filter->count || !filter->weights || !weights)
+    {
+        HeapFree(GetProcessHeap(), 0, weights);
+        free_filter(filter);
+        return FALSE;
+    }
+
+    for (x = 0; x < dst_size; x++)
+    {
+        INT *dst = filter->weights + x * filter->taps;
+        double center = (x + 0.5) * scale;
+
+        lo = max((INT)floor(center - support), 0);
+        hi = min((INT)ceil(center + support), (INT)src_size - 1);
+        if (hi < lo) hi = lo;
+        n = hi - lo + 1;
+        memset(weights, 0, n * sizeof(weights[0]));
+
+        for (i = (INT)floor(center - support); i <= (INT)ceil(center + support); i++)
+        {
+            INT idx = min(max(i, lo), hi);
+            double w;
+
+            if (mode == WICBitmapInterpolationModeFant)
+                w = max(0.0, min(i + 1.0, (x + 1) * scale) - max((double)i, x * scale));
+            else
+                w = filter_kernel(mode, i + 0.5 - center);
+            weights[idx - lo] += w;
+        }
+
+        total = 0.0;
+        for (i = 0; i < n; i++) total += weights[i];
+
+        sum = best = 0;
+        for (i = 0; i < n; i++)
+        {
+            dst[i] = floor(weights[i] / total * (1 << FILTER_BITS) + 0.5);
+            sum += dst[i];
+            if (dst[i] > dst[best]) best = i;
+        }
+        dst[best] += (1 << FILTER_BITS) - sum;
+
+        filter->first[x] = lo;
+        filter->count[x] = n;
+    }
+
+    HeapFree(GetProcessHeap(), 0, weights);
+    return TRUE;
+}
+
 static inline BitmapScaler *impl_from_IWICBitmapScaler(IWICBitmapScaler *iface)
 {
     return CONTAINING_RECORD(iface, BitmapScaler, IWICBitmapScaler_iface);
@@ -108,6 +222,9 @@ static ULONG WINAPI BitmapScaler_Release(IWICBitmapScaler *iface)
         This->lock.DebugInfo->Spare[0] = 0;
         DeleteCriticalSection(&This->lock);
         if (This->source) IWICBitmapSource_Release(This->source);
+        free_filter(&This->filter_x);
+        free_filter(&This->filter_y);
+        HeapFree(GetProcessHeap(), 0, This->row_buffer);
         HeapFree(GetProcessHeap(), 0, This);
     }
 
@@ -205,6 +322,81 @@ static void NearestNeighbor_CopyScanline(BitmapScaler *This,
     }
 }
 
+static BOOL is_filterable_format(const GUID *format)
+{
+    static const GUID * const formats[] =
+    {
+        &GUID_WICPixelFormat8bppGray,
+        &GUID_WICPixelFormat24bppBGR,
+        &GUID_WICPixelFormat24bppRGB,
+        &GUID_WICPixelFormat32bppBGR,
+        &GUID_WICPixelFormat32bppBGRA,
+        &GUID_WICPixelFormat32bppPBGRA,
+        &GUID_WICPixelFormat32bppRGB,
+        &GUID_WICPixelFormat32bppRGBA,
+        &GUID_WICPixelFormat32bppPRGBA,
+    };
+    UINT i;
+
+    /* formats with one byte per channel can be filtered channel by channel */
+    for (i = 0; i < ARRAY_SIZE(formats); i++)
+        if (IsEqualGUID(format, formats[i])) return TRUE;
+
+    return FALSE;
+}
+
+static void Filter_GetRequiredSourceRect(BitmapScaler *This,
+    UINT x, UINT y, WICRect *src_rect)
+{
+    src_rect->X = This->filter_x.first[x];
+    src_rect->Y = This->filter_y.first[y];
+    src_rect->Width = This->filter_x.count[x];
+    src_rect->Height = This->filter_y.count[y];
+}
+
+static void Filter_CopyScanline(BitmapScaler *This,
+    UINT dst_x, UINT dst_y, UINT dst_width,
+    BYTE **src_data, UINT src_data_x, UINT src_data_y, BYTE *pbBuffer)
+{
+    const struct scaler_filter *fx = &This->filter_x, *fy = &This->filter_y;
+    const INT *wy = fy->weights + dst_y * fy->taps;
+    UINT channels = This->bpp / 8;
+    UINT start, end, i, k, c, x;
+    INT *row = This->row_buffer;
+
+    /* Vertical pass over the needed source columns, keeping 6 extra bits of
+     * precision for the horizontal pass. The inner loops are kept free of
+     * dependencies so the compiler can vectorize them. */
+    start = (fx->first[dst_x] - src_data_x) * channels;
+    end = (fx->first[dst_x + dst_width - 1] + fx->count[dst_x + dst_width - 1] - src_data_x) * channels;
+
+    for (i = start; i < end; i++) row[i] = 1 << 7;
+    for (k = 0; k < fy->count[dst_y]; k++)
+    {
+        const BYTE *src = src_data[fy->first[dst_y] + k - src_data_y];
+        INT w = wy[k];
+
+        for (i = start; i < end; i++) row[i] += w * src[i];
+    }
+    for (i = start; i < end; i++) row[i] >>= 8;
+
+    for (x = 0; x < dst_width; x++)
+    {
+        const INT *wx = fx->weights + (dst_x + x) * fx->taps;
+        const INT *src = row + (fx->first[dst_x + x] - src_data_x) * channels;
+        UINT count = fx->count[dst_x + x];
+
+        for (c = 0; c < channels; c++)
+        {
+            INT sum = 1 << (FILTER_BITS + 5);
+
+            for (k = 0; k < count; k++) sum += wx[k] * src[k * channels + c];
+            sum >>= FILTER_BITS + 6;
+            pbBuffer[x * channels + c] = sum < 0 ? 0 : sum > 255 ? 255 : sum;
+        }
+    }
+}
+
 static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
@@ -217,7 +409,7 @@ static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
     ULONG bytesperrow;
     ULONG src_bytesperrow;
     ULONG buffer_size;
-    UINT y;
+    UINT y, row, strip_end;
 
     TRACE("(%p,%s,%u,%u,%p)\n", iface, debug_wic_rect(prc), cbStride, cbBufferSize, pbBuffer);
 
@@ -259,54 +451,76 @@ static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
         goto end;
     }
 
+    if (!dest_rect.Width || !dest_rect.Height)
+    {
+        hr = S_OK;
+        goto end;
+    }
+
     /* MSDN recommends calling CopyPixels once for each scanline from top to
      * bottom, and claims codecs optimize for this. Ideally, when called in this
      * way, we should avoid requesting a scanline from the source more than
      * once, by saving the data that will be useful for the next scanline after
      * the call returns. The GetRequiredSourceRect/CopyScanline functions are
      * designed to make it possible to do this in a generic way, but for now we
-     * just grab all the data we need in each call. */
+     * just grab the data we need in each call, in strips of destination rows
+     * whose source data fits in SCALER_STRIP_SIZE so that memory use stays
+     * bounded for large images. */
 
-    This->fn_get_required_source_rect(This, dest_rect.X, dest_rect.Y, &src_rect_ul);
-    This->fn_get_required_source_rect(This, dest_rect.X+dest_rect.Width-1,
-        dest_rect.Y+dest_rect.Height-1, &src_rect_br);
+    hr = S_OK;
+    for (y = 0; y < dest_rect.Height && SUCCEEDED(hr); y = strip_end)
+    {
+        This->fn_get_required_source_rect(This, dest_rect.X, dest_rect.Y+y, &src_rect_ul);
+        This->fn_get_required_source_rect(This, dest_rect.X+dest_rect.Width-1,
+            dest_rect.Y+y, &src_rect_br);
 
-    src_rect.X = src_rect_ul.X;
-    src_rect.Y = src_rect_ul.Y;
-    src_rect.Width = src_rect_br.Width + src_rect_br.X - src_rect_ul.X;
-    src_rect.Height = src_rect_br.Height + src_rect_br.Y - src_rect_ul.Y;
+        src_rect.X = src_rect_ul.X;
+        src_rect.Y = src_rect_ul.Y;
+        src_rect.Width = src_rect_br.Width + src_rect_br.X - src_rect_ul.X;
+        src_rect.Height = src_rect_br.Height + src_rect_br.Y - src_rect_ul.Y;
 
-    src_bytesperrow = (src_rect.Width * This->bpp + 7)/8;
-    buffer_size = src_bytesperrow * src_rect.Height;
+        src_bytesperrow = (src_rect.Width * This->bpp + 7)/8;
 
-    src_rows = HeapAlloc(GetProcessHeap(), 0, sizeof(BYTE*) * src_rect.Height);
-    src_bits = HeapAlloc(GetProcessHeap(), 0, buffer_size);
+        for (strip_end = y + 1; strip_end < dest_rect.Height; strip_end++)
+        {
+            This->fn_get_required_source_rect(This, dest_rect.X+dest_rect.Width-1,
+                dest_rect.Y+strip_end, &src_rect_br);
+            if ((src_rect_br.Height + src_rect_br.Y - src_rect.Y) * src_bytesperrow > SCALER_STRIP_SIZE)
+                break;
+            src_rect.Height = src_rect_br.Height + src_rect_br.Y - src_rect.Y;
+        }
 
-    if (!src_rows || !src_bits)
-    {
-        HeapFree(GetProcessHeap(), 0, src_rows);
-        HeapFree(GetProcessHeap(), 0, src_bits);
-        hr = E_OUTOFMEMORY;
-        goto end;
-    }
+        buffer_size = src_bytesperrow * src_rect.Height;
 
-    for (y=0; y<src_rect.Height; y++)
-        src_rows[y] = src_bits + y * src_bytesperrow;
+        src_rows = HeapAlloc(GetProcessHeap(), 0, sizeof(BYTE*) * src_rect.Height);
+        src_bits = HeapAlloc(GetProcessHeap(), 0, buffer_size);
 
-    hr = IWICBitmapSource_CopyPixels(This->source, &src_rect, src_bytesperrow,
-        buffer_size, src_bits);
+        if (!src_rows || !src_bits)
+        {
+            HeapFree(GetProcessHeap(), 0, src_rows);
+            HeapFree(GetProcessHeap(), 0, src_bits);
+            hr = E_OUTOFMEMORY;
+            goto end;
+        }
 
-    if (SUCCEEDED(hr))
-    {
-        for (y=0; y < dest_rect.Height; y++)
+        for (row=0; row<src_rect.Height; row++)
+            src_rows[row] = src_bits + row * src_bytesperrow;
+
+        hr = IWICBitmapSource_CopyPixels(This->source, &src_rect, src_bytesperrow,
+            buffer_size, src_bits);
+
+        if (SUCCEEDED(hr))
         {
-            This->fn_copy_scanline(This, dest_rect.X, dest_rect.Y+y, dest_rect.Width,
-                src_rows, src_rect.X, src_rect.Y, pbBuffer + cbStride * y);
+            for (row=y; row < strip_end; row++)
+            {
+                This->fn_copy_scanline(This, dest_rect.X, dest_rect.Y+row, dest_rect.Width,
+                    src_rows, src_rect.X, src_rect.Y, pbBuffer + cbStride * row);
+            }
         }
-    }
 
-    HeapFree(GetProcessHeap(), 0, src_rows);
-    HeapFree(GetProcessHeap(), 0, src_bits);
+        HeapFree(GetProcessHeap(), 0, src_rows);
+        HeapFree(GetProcessHeap(), 0, src_bits);
+    }
 
 end:
     LeaveCriticalSection(&This->lock);
@@ -321,6 +535,7 @@ static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
     BitmapScaler *This = impl_from_IWICBitmapScaler(iface);
     HRESULT hr;
     GUID src_pixelformat;
+    BOOL filter = FALSE;
 
     TRACE("(%p,%p,%u,%u,%u)\n", iface, pISource, uiWidth, uiHeight, mode);
 
@@ -349,28 +564,61 @@ static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
         hr = get_pixelformat_bpp(&src_pixelformat, &This->bpp);
     }
 
+    if (SUCCEEDED(hr))
+    {
+        if ((This->bpp % 8) == 0)
+        {
+            IWICBitmapSource_AddRef(pISource);
+            This->source = pISource;
+        }
+        else
+        {
+            hr = WICConvertBitmapSource(&GUID_WICPixelFormat32bppBGRA,
+                pISource, &This->source);
+            src_pixelformat = GUID_WICPixelFormat32bppBGRA;
+            This->bpp = 32;
+        }
+    }
+
     if (SUCCEEDED(hr))
     {
         switch (mode)
         {
+        case WICBitmapInterpolationModeNearestNeighbor:
+            break;
+        case WICBitmapInterpolationModeLinear:
+        case WICBitmapInterpolationModeCubic:
+        case WICBitmapInterpolationModeFant:
+            filter = is_filterable_format(&src_pixelformat);
+            if (!filter)
+                FIXME("unsupported format %s for mode %i\n", debugstr_guid(&src_pixelformat), mode);
+            break;
         default:
             FIXME("unsupported mode %i\n", mode);
-            /* fall-through */
-        case WICBitmapInterpolationModeNearestNeighbor:
-            if ((This->bpp % 8) == 0)
-            {
-                IWICBitmapSource_AddRef(pISource);
-                This->source = pISource;
-            }
-            else
+            break;
+        }
+
+        if (filter)
+        {
+            if (!init_filter(&This->filter_x, This->src_width, This->width, mode) ||
+                !init_filter(&This->filter_y, This->src_height, This->height, mode) ||
+                !(This->row_buffer = HeapAlloc(GetProcessHeap(), 0,
+                    This->src_width * (This->bpp / 8) * sizeof(INT))))
             {
-                hr = WICConvertBitmapSource(&GUID_WICPixelFormat32bppBGRA,
-                    pISource, &This->source);
-                This->bpp = 32;
+                free_filter(&This->filter_x);
+                free_filter(&This->filter_y);
+                IWICBitmapSource_Release(This->source);
+                This->source = NULL;
+                hr = E_OUTOFMEMORY;
+                goto end;
             }
+            This->fn_get_required_source_rect = Filter_GetRequiredSourceRect;
+            This->fn_copy_scanline = Filter_CopyScanline;
+        }
+        else
+        {
             This->fn_get_required_source_rect = NearestNeighbor_GetRequiredSourceRect;
             This->fn_copy_scanline = NearestNeighbor_CopyScanline;
-            break;
         }
     }
 
@@ -529,6 +777,9 @@ HRESULT BitmapScaler_Create(IWICBitmapScaler **scaler)
     This->src_height = 0;
     This->mode = 0;
     This->bpp = 0;
+    memset(&This->filter_x, 0, sizeof(This->filter_x));
+    memset(&This->filter_y, 0, sizeof(This->filter_y));
+    This->row_buffer = NULL;
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": BitmapScaler.lock");
 
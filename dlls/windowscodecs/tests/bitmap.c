@@ -1324,6 +1324,106 @@ static void test_bitmap_scaler(void)
     IWICBitmap_Release(bitmap);
 }
 
+static void test_bitmap_scaler_fant(void)
+{
+    static const BYTE src[] =
+    {
+        0x10,0x20,0x30,0xff, 0x30,0x40,0x50,0xff, 0x00,0x00,0x00,0xff, 0x80,0x80,0x80,0xff,
+        0x50,0x60,0x70,0xff, 0x70,0x80,0x90,0xff, 0x80,0x80,0x80,0xff, 0x80,0x80,0x80,0xff,
+    };
+    static const BYTE expected[] =
+    {
+        0x40,0x50,0x60,0xff, 0x60,0x60,0x60,0xff,
+    };
+    WICPixelFormatGUID pixel_format;
+    IWICBitmapScaler *scaler;
+    IWICBitmap *bitmap;
+    BYTE buf[8];
+    HRESULT hr;
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 4, 2, &GUID_WICPixelFormat32bppBGRA,
+        16, sizeof(src), (BYTE *)src, &bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+
+    hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+    ok(hr == S_OK, "Failed to create bitmap scaler, hr %#x.\n", hr);
+
+    hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, 2, 1,
+        WICBitmapInterpolationModeFant);
+    ok(hr == S_OK, "Failed to initialize bitmap scaler, hr %#x.\n", hr);
+
+    hr = IWICBitmapScaler_GetPixelFormat(scaler, &pixel_format);
+    ok(hr == S_OK, "Failed to get pixel format, hr %#x.\n", hr);
+    ok(IsEqualGUID(&pixel_format, &GUID_WICPixelFormat32bppBGRA), "Unexpected pixel format %s.\n",
+        wine_dbgstr_guid(&pixel_format));
+
+    memset(buf, 0xcc, sizeof(buf));
+    hr = IWICBitmapScaler_CopyPixels(scaler, NULL, 8, sizeof(buf), buf);
+    ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+    ok(!memcmp(buf, expected, sizeof(expected)), "Unexpected data %02x %02x %02x %02x %02x %02x %02x %02x.\n",
+        buf[0], buf[1], buf[2], buf[3], buf[4], buf[5], buf[6], buf[7]);
+
+    IWICBitmapScaler_Release(scaler);
+    IWICBitmap_Release(bitmap);
+}
+
+static void test_bitmap_scaler_rect(void)
+{
+    static const WICRect rects[] =
+    {
+        { 0, 0, 23, 5 },
+        { 4, 0, 19, 29 },
+        { 5, 7, 11, 13 },
+        { 22, 28, 1, 1 },
+    };
+    static const WICBitmapInterpolationMode modes[] =
+    {
+        WICBitmapInterpolationModeLinear,
+        WICBitmapInterpolationModeCubic,
+        WICBitmapInterpolationModeFant,
+    };
+    BYTE src[10 * 10 * 4], full[23 * 29 * 4], part[23 * 29 * 4];
+    IWICBitmapScaler *scaler;
+    IWICBitmap *bitmap;
+    UINT i, j, y;
+    HRESULT hr;
+
+    for (i = 0; i < sizeof(src); i++) src[i] = i * 37 + (i >> 3);
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 10, 10, &GUID_WICPixelFormat32bppBGRA,
+        40, sizeof(src), src, &bitmap);
+    ok(hr == S_OK, "Failed to create a bitmap, hr %#x.\n", hr);
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+        ok(hr == S_OK, "Failed to create bitmap scaler, hr %#x.\n", hr);
+
+        hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource *)bitmap, 23, 29, modes[i]);
+        ok(hr == S_OK, "Failed to initialize bitmap scaler, hr %#x.\n", hr);
+
+        hr = IWICBitmapScaler_CopyPixels(scaler, NULL, 23 * 4, sizeof(full), full);
+        ok(hr == S_OK, "Failed to copy pixels, hr %#x.\n", hr);
+
+        /* a part of the image matches the same part of the whole image */
+        for (j = 0; j < ARRAY_SIZE(rects); j++)
+        {
+            const WICRect *rc = &rects[j];
+
+            memset(part, 0xcc, sizeof(part));
+            hr = IWICBitmapScaler_CopyPixels(scaler, rc, rc->Width * 4, sizeof(part), part);
+            ok(hr == S_OK, "%u, %u: Failed to copy pixels, hr %#x.\n", i, j, hr);
+            for (y = 0; y < rc->Height; y++)
+                ok(!memcmp(part + y * rc->Width * 4, full + ((rc->Y + y) * 23 + rc->X) * 4, rc->Width * 4),
+                    "%u, %u: Unexpected data in row %u.\n", i, j, y);
+        }
+
+        IWICBitmapScaler_Release(scaler);
+    }
+
+    IWICBitmap_Release(bitmap);
+}
+
 static LONG obj_refcount(void *obj)
 {
     IUnknown_AddRef((IUnknown *)obj);
@@ -1494,6 +1594,8 @@ START_TEST(bitmap)
     test_CreateBitmapFromHBITMAP();
     test_clipper();
     test_bitmap_scaler();
+    test_bitmap_scaler_fant();
+    test_bitmap_scaler_rect();
 
     IWICImagingFactory_Release(factory);
 
@@ -922,6 +922,105 @@ todo_wine_if(td[i].todo)
 #undef PNG_COLOR_TYPE_GRAY_ALPHA
 #undef PNG_COLOR_TYPE_RGB_ALPHA
 
+static void test_large_image(void)
+{
+    static const UINT width = 512, height = 256, stride = 512 * 4;
+    IWICBitmapFrameEncode *frame_encode;
+    IWICBitmapFrameDecode *frame;
+    IWICBitmapEncoder *encoder;
+    IWICBitmapDecoder *decoder;
+    WICPixelFormatGUID format;
+    LARGE_INTEGER zero;
+    IStream *stream;
+    BYTE *bits, *buf;
+    WICRect rc;
+    UINT x, y;
+    HRESULT hr;
+
+    bits = HeapAlloc(GetProcessHeap(), 0, stride * height);
+    buf = HeapAlloc(GetProcessHeap(), 0, stride * height);
+    for (y = 0; y < height; y++)
+        for (x = 0; x < stride; x++)
+            bits[y * stride + x] = (x % 4 == 3) ? 0xff : (BYTE)(x * 7 + y * 13);
+
+    hr = CreateStreamOnHGlobal(NULL, TRUE, &stream);
+    ok(hr == S_OK, "CreateStreamOnHGlobal error %#x\n", hr);
+
+    hr = IWICImagingFactory_CreateEncoder(factory, &GUID_ContainerFormatPng, NULL, &encoder);
+    ok(hr == S_OK, "CreateEncoder error %#x\n", hr);
+    hr = IWICBitmapEncoder_Initialize(encoder, stream, WICBitmapEncoderNoCache);
+    ok(hr == S_OK, "Initialize error %#x\n", hr);
+    hr = IWICBitmapEncoder_CreateNewFrame(encoder, &frame_encode, NULL);
+    ok(hr == S_OK, "CreateNewFrame error %#x\n", hr);
+    hr = IWICBitmapFrameEncode_Initialize(frame_encode, NULL);
+    ok(hr == S_OK, "Initialize error %#x\n", hr);
+    hr = IWICBitmapFrameEncode_SetSize(frame_encode, width, height);
+    ok(hr == S_OK, "SetSize error %#x\n", hr);
+    format = GUID_WICPixelFormat32bppBGRA;
+    hr = IWICBitmapFrameEncode_SetPixelFormat(frame_encode, &format);
+    ok(hr == S_OK, "SetPixelFormat error %#x\n", hr);
+    ok(IsEqualGUID(&format, &GUID_WICPixelFormat32bppBGRA), "got format %s\n", wine_dbgstr_guid(&format));
+    hr = IWICBitmapFrameEncode_WritePixels(frame_encode, height, stride, stride * height, bits);
+    ok(hr == S_OK, "WritePixels error %#x\n", hr);
+    hr = IWICBitmapFrameEncode_Commit(frame_encode);
+    ok(hr == S_OK, "Commit error %#x\n", hr);
+    hr = IWICBitmapEncoder_Commit(encoder);
+    ok(hr == S_OK, "Commit error %#x\n", hr);
+    IWICBitmapFrameEncode_Release(frame_encode);
+    IWICBitmapEncoder_Release(encoder);
+
+    zero.QuadPart = 0;
+    IStream_Seek(stream, zero, STREAM_SEEK_SET, NULL);
+    hr = IWICImagingFactory_CreateDecoderFromStream(factory, stream, NULL, 0, &decoder);
+    ok(hr == S_OK, "CreateDecoderFromStream error %#x\n", hr);
+    hr = IWICBitmapDecoder_GetFrame(decoder, 0, &frame);
+    ok(hr == S_OK, "GetFrame error %#x\n", hr);
+
+    /* rows near the end first, then rows before them */
+    rc.X = 3;
+    rc.Y = height - 2;
+    rc.Width = 5;
+    rc.Height = 2;
+    memset(buf, 0, stride * height);
+    hr = IWICBitmapFrameDecode_CopyPixels(frame, &rc, stride, stride * 2, buf);
+    ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+    ok(!memcmp(buf, bits + rc.Y * stride + rc.X * 4, rc.Width * 4), "wrong data in row %u\n", rc.Y);
+    ok(!memcmp(buf + stride, bits + (rc.Y + 1) * stride + rc.X * 4, rc.Width * 4), "wrong data in row %u\n", rc.Y + 1);
+
+    rc.X = 0;
+    rc.Y = 1;
+    rc.Width = width;
+    rc.Height = 1;
+    memset(buf, 0, stride * height);
+    hr = IWICBitmapFrameDecode_CopyPixels(frame, &rc, stride, stride, buf);
+    ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+    ok(!memcmp(buf, bits + stride, stride), "wrong data in row 1\n");
+
+    memset(buf, 0, stride * height);
+    hr = IWICBitmapFrameDecode_CopyPixels(frame, NULL, stride, stride * height, buf);
+    ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+    ok(!memcmp(buf, bits, stride * height), "wrong image data\n");
+
+    /* rows read bottom-up, like a vertical flip does */
+    rc.X = 0;
+    rc.Width = width;
+    rc.Height = 1;
+    for (y = height; y-- > 0;)
+    {
+        rc.Y = y;
+        memset(buf, 0, stride);
+        hr = IWICBitmapFrameDecode_CopyPixels(frame, &rc, stride, stride, buf);
+        ok(hr == S_OK, "CopyPixels error %#x\n", hr);
+        ok(!memcmp(buf, bits + y * stride, stride), "wrong data in row %u\n", y);
+    }
+
+    IWICBitmapFrameDecode_Release(frame);
+    IWICBitmapDecoder_Release(decoder);
+    IStream_Release(stream);
+    HeapFree(GetProcessHeap(), 0, bits);
+    HeapFree(GetProcessHeap(), 0, buf);
+}
+
 START_TEST(pngformat)
 {
     HRESULT hr;
@@ -935,6 +1034,7 @@ START_TEST(pngformat)
     test_color_contexts();
     test_png_palette();
     test_color_formats();
+    test_large_image();
 
     IWICImagingFactory_Release(factory);
     CoUninitialize();
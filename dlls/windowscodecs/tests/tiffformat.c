@@ -23,6 +23,8 @@
 #define COBJMACROS
 
 #include "windef.h"
+#include "winbase.h"
+#include "winreg.h"
 #include "wincodec.h"
 #include "wine/test.h"
 
@@ -630,6 +632,88 @@ static void test_tiff_8bpp_palette(void)
     IWICBitmapDecoder_Release(decoder);
 }
 
+static void test_tiff_prefetch(void)
+{
+    static const BYTE expected_data[2][4] = { { 0,1,2,3 }, { 3,2,1,0 } };
+    static const WICColor expected_color[2] = { 0xff112233, 0xff332211 };
+    struct tiff_8bpp_data *data;
+    char buf[2 * sizeof(tiff_8bpp_data)];
+    HRESULT hr;
+    IWICBitmapDecoder *decoder;
+    IWICBitmapFrameDecode *frame[2];
+    IWICPalette *palette;
+    WICColor color[256];
+    WICRect rc = { 0, 0, 4, 1 };
+    BYTE pixels[4];
+    DWORD prefetch = 1;
+    UINT count, ret, i;
+    HKEY key;
+    LONG res;
+
+    /* two frames with their own color map, the second one follows the first */
+    memcpy(buf, &tiff_8bpp_data, sizeof(tiff_8bpp_data));
+    memcpy(buf + sizeof(tiff_8bpp_data), &tiff_8bpp_data, sizeof(tiff_8bpp_data));
+    data = (struct tiff_8bpp_data *)buf;
+    generate_tiff_palette(data[0].palette_data, 256);
+    generate_tiff_palette(data[1].palette_data, 256);
+    data[1].palette_data[0][0] = 0x33 * 257;
+    data[1].palette_data[2][0] = 0x11 * 257;
+    memcpy(data[1].pixel_data, expected_data[1], sizeof(expected_data[1]));
+    data[0].next_IFD = sizeof(tiff_8bpp_data) + FIELD_OFFSET(struct tiff_8bpp_data, number_of_entries);
+    for (i = 0; i < data[1].number_of_entries; i++)
+    {
+        if (data[1].entry[i].id == 0x111 || data[1].entry[i].id == 0x11a ||
+            data[1].entry[i].id == 0x11b || data[1].entry[i].id == 0x140)
+            data[1].entry[i].value += sizeof(tiff_8bpp_data);
+    }
+
+    /* Wine specific, decode the frame following the requested one on a worker thread */
+    res = RegCreateKeyA(HKEY_CURRENT_USER, "Software\\Wine\\WindowsCodecs", &key);
+    ok(!res, "RegCreateKey error %d\n", res);
+    res = RegSetValueExA(key, "TiffPrefetchFrames", 0, REG_DWORD, (BYTE *)&prefetch, sizeof(prefetch));
+    ok(!res, "RegSetValueEx error %d\n", res);
+
+    hr = create_decoder(buf, sizeof(buf), &decoder);
+    ok(hr == S_OK, "Failed to load TIFF image data %#x\n", hr);
+    if (hr != S_OK) goto done;
+
+    hr = IWICBitmapDecoder_GetFrameCount(decoder, &count);
+    ok(hr == S_OK, "GetFrameCount error %#x\n", hr);
+    ok(count == 2, "expected 2, got %u\n", count);
+
+    for (i = 0; i < 2; i++)
+    {
+        hr = IWICBitmapDecoder_GetFrame(decoder, i, &frame[i]);
+        ok(hr == S_OK, "%u: GetFrame error %#x\n", i, hr);
+    }
+
+    /* the directory of the second frame is the current one when the first is queried */
+    for (i = 0; i < 2; i++)
+    {
+        hr = IWICImagingFactory_CreatePalette(factory, &palette);
+        ok(hr == S_OK, "CreatePalette error %#x\n", hr);
+        hr = IWICBitmapFrameDecode_CopyPalette(frame[i], palette);
+        ok(hr == S_OK, "%u: CopyPalette error %#x\n", i, hr);
+        hr = IWICPalette_GetColors(palette, 256, color, &ret);
+        ok(hr == S_OK, "%u: GetColors error %#x\n", i, hr);
+        ok(color[0] == expected_color[i], "%u: got %#x\n", i, color[0]);
+        IWICPalette_Release(palette);
+
+        hr = IWICBitmapFrameDecode_CopyPixels(frame[i], &rc, 4, sizeof(pixels), pixels);
+        ok(hr == S_OK, "%u: CopyPixels error %#x\n", i, hr);
+        ok(!memcmp(pixels, expected_data[i], sizeof(pixels)), "%u: got %02x %02x %02x %02x\n",
+           i, pixels[0], pixels[1], pixels[2], pixels[3]);
+    }
+
+    for (i = 0; i < 2; i++)
+        IWICBitmapFrameDecode_Release(frame[i]);
+    IWICBitmapDecoder_Release(decoder);
+
+done:
+    RegDeleteValueA(key, "TiffPrefetchFrames");
+    RegCloseKey(key);
+}
+
 static void test_tiff_resolution(void)
 {
     HRESULT hr;
@@ -756,6 +840,7 @@ START_TEST(tiffformat)
 
     test_tiff_1bpp_palette();
     test_tiff_8bpp_palette();
+    test_tiff_prefetch();
     test_QueryCapability();
     test_tiff_8bpp_alpha();
     test_tiff_resolution();
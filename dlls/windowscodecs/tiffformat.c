@@ -32,12 +32,14 @@
 
 #include "windef.h"
 #include "winbase.h"
+#include "winreg.h"
 #include "objbase.h"
 
 #include "wincodecs_private.h"
 
 #include "wine/debug.h"
 #include "wine/library.h"
+#include "wine/list.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(wincodecs);
 
@@ -229,6 +231,8 @@ typedef struct {
     CRITICAL_SECTION lock; /* Must be held when tiff is used or initialized is set */
     TIFF *tiff;
     BOOL initialized;
+    UINT prefetch_frames;
+    struct list prefetch; /* frames being decoded ahead of the caller */
 } TiffDecoder;
 
 typedef struct {
@@ -261,6 +265,22 @@ typedef struct {
     BYTE *cached_tile;
 } TiffFrameDecode;
 
+/* don't prefetch frames that would need more memory than this */
+#define TIFF_PREFETCH_MAX_SIZE (64 * 1024 * 1024)
+
+struct tiff_prefetch
+{
+    struct list entry;
+    TiffDecoder *decoder;
+    IStream *stream; /* private clone of the decoder stream, if available */
+    UINT index;
+    tiff_decode_info decode_info;
+    UINT tile_count;
+    BYTE *tiles;
+    HRESULT hr;
+    HANDLE done;
+};
+
 static const IWICBitmapFrameDecodeVtbl TiffFrameDecode_Vtbl;
 static const IWICMetadataBlockReaderVtbl TiffFrameDecode_BlockVtbl;
 
@@ -563,6 +583,263 @@ static HRESULT tiff_get_decode_info(TIFF *tiff, tiff_decode_info *decode_info)
     return S_OK;
 }
 
+static HRESULT tiff_read_tile(TIFF *tiff, const tiff_decode_info *decode_info, UINT index,
+    UINT tile_x, UINT tile_y, BYTE *tile)
+{
+    tsize_t ret;
+    int swap_bytes;
+
+    swap_bytes = pTIFFIsByteSwapped(tiff);
+
+    ret = pTIFFSetDirectory(tiff, index);
+    if (ret == -1)
+        return E_FAIL;
+
+    if (decode_info->tiled)
+        ret = pTIFFReadEncodedTile(tiff, tile_x + tile_y * decode_info->tiles_across, tile, decode_info->tile_size);
+    else
+        ret = pTIFFReadEncodedStrip(tiff, tile_y, tile, decode_info->tile_size);
+
+    if (ret == -1)
+        return E_FAIL;
+
+    /* 8bpp grayscale with extra alpha */
+    if (decode_info->source_bpp == 16 && decode_info->samples == 2 && decode_info->bpp == 32)
+    {
+        BYTE *src;
+        DWORD *dst, count = decode_info->tile_width * decode_info->tile_height;
+
+        src = tile + decode_info->tile_width * decode_info->tile_height * 2 - 2;
+        dst = (DWORD *)(tile + decode_info->tile_size - 4);
+
+        while (count--)
+        {
+            *dst-- = src[0] | (src[0] << 8) | (src[0] << 16) | (src[1] << 24);
+            src -= 2;
+        }
+    }
+
+    if (decode_info->reverse_bgr)
+    {
+        if (decode_info->bps == 8)
+        {
+            UINT sample_count = decode_info->samples;
+
+            reverse_bgr8(sample_count, tile, decode_info->tile_width,
+                decode_info->tile_height, decode_info->tile_width * sample_count);
+        }
+    }
+
+    if (swap_bytes && decode_info->bps > 8)
+    {
+        UINT row, i, samples_per_row;
+        BYTE *sample, temp;
+
+        samples_per_row = decode_info->tile_width * decode_info->samples;
+
+        switch(decode_info->bps)
+        {
+        case 16:
+            for (row=0; row<decode_info->tile_height; row++)
+            {
+                sample = tile + row * decode_info->tile_stride;
+                for (i=0; i<samples_per_row; i++)
+                {
+                    temp = sample[1];
+                    sample[1] = sample[0];
+                    sample[0] = temp;
+                    sample += 2;
+                }
+            }
+            break;
+        default:
+            ERR("unhandled bps for byte swap %u\n", decode_info->bps);
+            return E_FAIL;
+        }
+    }
+
+    if (decode_info->invert_grayscale)
+    {
+        BYTE *byte, *end;
+
+        if (decode_info->samples != 1)
+        {
+            ERR("cannot invert grayscale image with %u samples\n", decode_info->samples);
+            return E_FAIL;
+        }
+
+        end = tile+decode_info->tile_size;
+
+        for (byte = tile; byte != end; byte++)
+            *byte = ~(*byte);
+    }
+
+    return S_OK;
+}
+
+static UINT get_prefetch_frames(void)
+{
+    static const WCHAR keyW[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\',
+        'W','i','n','d','o','w','s','C','o','d','e','c','s',0};
+    static const WCHAR prefetchW[] = {'T','i','f','f','P','r','e','f','e','t','c','h','F','r','a','m','e','s',0};
+    DWORD frames = 0, size = sizeof(frames);
+    HKEY key;
+
+    /* number of frames following the last requested one to decode on worker threads */
+    if (!RegOpenKeyW(HKEY_CURRENT_USER, keyW, &key))
+    {
+        if (RegQueryValueExW(key, prefetchW, NULL, NULL, (BYTE *)&frames, &size)) frames = 0;
+        RegCloseKey(key);
+    }
+
+    return min(frames, 16);
+}
+
+static void free_prefetch(struct tiff_prefetch *job)
+{
+    WaitForSingleObject(job->done, INFINITE);
+    CloseHandle(job->done);
+    if (job->stream) IStream_Release(job->stream);
+    HeapFree(GetProcessHeap(), 0, job->tiles);
+    HeapFree(GetProcessHeap(), 0, job);
+}
+
+static void CALLBACK prefetch_callback(TP_CALLBACK_INSTANCE *instance, void *context)
+{
+    struct tiff_prefetch *job = context;
+    TiffDecoder *decoder = job->decoder;
+    TIFF *tiff = NULL;
+    HRESULT hr = S_OK;
+    UINT tile;
+
+    TRACE("decoding frame %u\n", job->index);
+
+    /* With a private stream the frame is decoded independently of the
+     * caller, otherwise tiles are read between the caller's requests. */
+    if (job->stream && !(tiff = tiff_open_stream(job->stream, "r")))
+        hr = E_FAIL;
+
+    for (tile = 0; tile < job->tile_count && SUCCEEDED(hr); tile++)
+    {
+        UINT tile_x = tile % job->decode_info.tiles_across, tile_y = tile / job->decode_info.tiles_across;
+        BYTE *dst = job->tiles + tile * job->decode_info.tile_size;
+
+        if (tiff)
+            hr = tiff_read_tile(tiff, &job->decode_info, job->index, tile_x, tile_y, dst);
+        else
+        {
+            EnterCriticalSection(&decoder->lock);
+            hr = tiff_read_tile(decoder->tiff, &job->decode_info, job->index, tile_x, tile_y, dst);
+            LeaveCriticalSection(&decoder->lock);
+        }
+    }
+
+    if (tiff) pTIFFClose(tiff);
+
+    TRACE("frame %u, %u tiles: %#x\n", job->index, job->tile_count, hr);
+
+    job->hr = hr;
+    SetEvent(job->done);
+}
+
+/* Start decoding the frames after index on worker threads, and drop the
+ * prefetched frames that are outside of the new window. */
+static void prefetch_frames(TiffDecoder *This, UINT index)
+{
+    struct tiff_prefetch *job, *next;
+    struct list unused = LIST_INIT(unused);
+    tiff_decode_info decode_info;
+    UINT frame, count, tiles_down;
+
+    EnterCriticalSection(&This->lock);
+
+    LIST_FOR_EACH_ENTRY_SAFE(job, next, &This->prefetch, struct tiff_prefetch, entry)
+    {
+        if (job->index < index || job->index > index + This->prefetch_frames)
+        {
+            list_remove(&job->entry);
+            list_add_tail(&unused, &job->entry);
+        }
+    }
+
+    count = pTIFFNumberOfDirectories(This->tiff);
+    for (frame = index + 1; frame <= index + This->prefetch_frames && frame < count; frame++)
+    {
+        LIST_FOR_EACH_ENTRY(job, &This->prefetch, struct tiff_prefetch, entry)
+            if (job->index == frame) break;
+        if (&job->entry != &This->prefetch) continue;
+
+        if (!pTIFFSetDirectory(This->tiff, frame) ||
+            tiff_get_decode_info(This->tiff, &decode_info) != S_OK)
+            break;
+
+        tiles_down = (decode_info.height + decode_info.tile_height - 1) / decode_info.tile_height;
+        if ((ULONGLONG)decode_info.tile_size * decode_info.tiles_across * tiles_down > TIFF_PREFETCH_MAX_SIZE)
+            continue;
+
+        if (!(job = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*job))))
+            break;
+        job->decoder = This;
+        job->index = frame;
+        job->decode_info = decode_info;
+        job->tile_count = decode_info.tiles_across * tiles_down;
+        job->tiles = HeapAlloc(GetProcessHeap(), 0, decode_info.tile_size * job->tile_count);
+        job->done = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (!job->tiles || !job->done)
+        {
+            if (job->done) CloseHandle(job->done);
+            HeapFree(GetProcessHeap(), 0, job->tiles);
+            HeapFree(GetProcessHeap(), 0, job);
+            break;
+        }
+        if (FAILED(IStream_Clone(This->stream, &job->stream)))
+            job->stream = NULL;
+
+        if (!TrySubmitThreadpoolCallback(prefetch_callback, job, NULL))
+        {
+            job->hr = E_FAIL;
+            SetEvent(job->done);
+        }
+        list_add_tail(&This->prefetch, &job->entry);
+    }
+
+    /* frames read tags from the current directory, give it back to the caller */
+    pTIFFSetDirectory(This->tiff, index);
+
+    LeaveCriticalSection(&This->lock);
+
+    LIST_FOR_EACH_ENTRY_SAFE(job, next, &unused, struct tiff_prefetch, entry)
+    {
+        list_remove(&job->entry);
+        free_prefetch(job);
+    }
+}
+
+/* Wait until a frame being prefetched, if any, is ready to be used. */
+static void wait_prefetch(TiffDecoder *This, UINT index)
+{
+    struct tiff_prefetch *job;
+    HANDLE done = NULL;
+
+    EnterCriticalSection(&This->lock);
+    LIST_FOR_EACH_ENTRY(job, &This->prefetch, struct tiff_prefetch, entry)
+    {
+        if (job->index == index)
+        {
+            DuplicateHandle(GetCurrentProcess(), job->done, GetCurrentProcess(), &done,
+                0, FALSE, DUPLICATE_SAME_ACCESS);
+            break;
+        }
+    }
+    LeaveCriticalSection(&This->lock);
+
+    if (done)
+    {
+        WaitForSingleObject(done, INFINITE);
+        CloseHandle(done);
+    }
+}
+
 static HRESULT WINAPI TiffDecoder_QueryInterface(IWICBitmapDecoder *iface, REFIID iid,
     void **ppv)
 {
@@ -605,6 +882,13 @@ static ULONG WINAPI TiffDecoder_Release(IWICBitmapDecoder *iface)
 
     if (ref == 0)
     {
+        struct tiff_prefetch *job, *next;
+
+        LIST_FOR_EACH_ENTRY_SAFE(job, next, &This->prefetch, struct tiff_prefetch, entry)
+        {
+            list_remove(&job->entry);
+            free_prefetch(job);
+        }
         if (This->tiff) pTIFFClose(This->tiff);
         if (This->stream) IStream_Release(This->stream);
         This->lock.DebugInfo->Spare[0] = 0;
@@ -669,6 +953,7 @@ static HRESULT WINAPI TiffDecoder_Initialize(IWICBitmapDecoder *iface, IStream *
     This->tiff = tiff;
     This->stream = pIStream;
     IStream_AddRef(pIStream);
+    This->prefetch_frames = get_prefetch_frames();
     This->initialized = TRUE;
 
 exit:
@@ -793,7 +1078,10 @@ static HRESULT WINAPI TiffDecoder_GetFrame(IWICBitmapDecoder *iface,
             result->cached_tile = HeapAlloc(GetProcessHeap(), 0, decode_info.tile_size);
 
             if (result->cached_tile)
+            {
                 *ppIBitmapFrame = &result->IWICBitmapFrameDecode_iface;
+                if (This->prefetch_frames) prefetch_frames(This, index);
+            }
             else
             {
                 hr = E_OUTOFMEMORY;
@@ -952,16 +1240,12 @@ static HRESULT WINAPI TiffFrameDecode_CopyPalette(IWICBitmapFrameDecode *iface,
     color_count = 1<<This->decode_info.bps;
 
     EnterCriticalSection(&This->parent->lock);
-    ret = pTIFFGetField(This->parent->tiff, TIFFTAG_COLORMAP, &red, &green, &blue);
-    LeaveCriticalSection(&This->parent->lock);
 
-    if (!ret)
-    {
-        WARN("Couldn't read color map\n");
-        return WINCODEC_ERR_PALETTEUNAVAILABLE;
-    }
+    /* the color map belongs to the current directory, which prefetching may have moved */
+    ret = pTIFFSetDirectory(This->parent->tiff, This->index) &&
+          pTIFFGetField(This->parent->tiff, TIFFTAG_COLORMAP, &red, &green, &blue);
 
-    for (i=0; i<color_count; i++)
+    for (i=0; ret && i<color_count; i++)
     {
         colors[i] = 0xff000000 |
             ((red[i]<<8) & 0xff0000) |
@@ -969,103 +1253,45 @@ static HRESULT WINAPI TiffFrameDecode_CopyPalette(IWICBitmapFrameDecode *iface,
             ((blue[i]>>8) & 0xff);
     }
 
-    return IWICPalette_InitializeCustom(pIPalette, colors, color_count);
-}
-
-static HRESULT TiffFrameDecode_ReadTile(TiffFrameDecode *This, UINT tile_x, UINT tile_y)
-{
-    tsize_t ret;
-    int swap_bytes;
-
-    swap_bytes = pTIFFIsByteSwapped(This->parent->tiff);
-
-    ret = pTIFFSetDirectory(This->parent->tiff, This->index);
-    if (ret == -1)
-        return E_FAIL;
-
-    if (This->decode_info.tiled)
-        ret = pTIFFReadEncodedTile(This->parent->tiff, tile_x + tile_y * This->decode_info.tiles_across, This->cached_tile, This->decode_info.tile_size);
-    else
-        ret = pTIFFReadEncodedStrip(This->parent->tiff, tile_y, This->cached_tile, This->decode_info.tile_size);
-
-    if (ret == -1)
-        return E_FAIL;
+    LeaveCriticalSection(&This->parent->lock);
 
-    /* 8bpp grayscale with extra alpha */
-    if (This->decode_info.source_bpp == 16 && This->decode_info.samples == 2 && This->decode_info.bpp == 32)
+    if (!ret)
     {
-        BYTE *src;
-        DWORD *dst, count = This->decode_info.tile_width * This->decode_info.tile_height;
-
-        src = This->cached_tile + This->decode_info.tile_width * This->decode_info.tile_height * 2 - 2;
-        dst = (DWORD *)(This->cached_tile + This->decode_info.tile_size - 4);
-
-        while (count--)
-        {
-            *dst-- = src[0] | (src[0] << 8) | (src[0] << 16) | (src[1] << 24);
-            src -= 2;
-        }
+        WARN("Couldn't read color map\n");
+        return WINCODEC_ERR_PALETTEUNAVAILABLE;
     }
 
-    if (This->decode_info.reverse_bgr)
-    {
-        if (This->decode_info.bps == 8)
-        {
-            UINT sample_count = This->decode_info.samples;
+    return IWICPalette_InitializeCustom(pIPalette, colors, color_count);
+}
 
-            reverse_bgr8(sample_count, This->cached_tile, This->decode_info.tile_width,
-                This->decode_info.tile_height, This->decode_info.tile_width * sample_count);
-        }
-    }
+static HRESULT TiffFrameDecode_ReadTile(TiffFrameDecode *This, UINT tile_x, UINT tile_y)
+{
+    UINT tile = tile_x + tile_y * This->decode_info.tiles_across;
+    struct tiff_prefetch *job;
+    HRESULT hr;
 
-    if (swap_bytes && This->decode_info.bps > 8)
+    LIST_FOR_EACH_ENTRY(job, &This->parent->prefetch, struct tiff_prefetch, entry)
     {
-        UINT row, i, samples_per_row;
-        BYTE *sample, temp;
-
-        samples_per_row = This->decode_info.tile_width * This->decode_info.samples;
-
-        switch(This->decode_info.bps)
+        if (job->index == This->index && WaitForSingleObject(job->done, 0) == WAIT_OBJECT_0 &&
+            job->hr == S_OK)
         {
-        case 16:
-            for (row=0; row<This->decode_info.tile_height; row++)
-            {
-                sample = This->cached_tile + row * This->decode_info.tile_stride;
-                for (i=0; i<samples_per_row; i++)
-                {
-                    temp = sample[1];
-                    sample[1] = sample[0];
-                    sample[0] = temp;
-                    sample += 2;
-                }
-            }
-            break;
-        default:
-            ERR("unhandled bps for byte swap %u\n", This->decode_info.bps);
-            return E_FAIL;
+            memcpy(This->cached_tile, job->tiles + tile * This->decode_info.tile_size,
+                This->decode_info.tile_size);
+            This->cached_tile_x = tile_x;
+            This->cached_tile_y = tile_y;
+            return S_OK;
         }
     }
 
-    if (This->decode_info.invert_grayscale)
+    hr = tiff_read_tile(This->parent->tiff, &This->decode_info, This->index, tile_x, tile_y,
+        This->cached_tile);
+    if (SUCCEEDED(hr))
     {
-        BYTE *byte, *end;
-
-        if (This->decode_info.samples != 1)
-        {
-            ERR("cannot invert grayscale image with %u samples\n", This->decode_info.samples);
-            return E_FAIL;
-        }
-
-        end = This->cached_tile+This->decode_info.tile_size;
-
-        for (byte = This->cached_tile; byte != end; byte++)
-            *byte = ~(*byte);
+        This->cached_tile_x = tile_x;
+        This->cached_tile_y = tile_y;
     }
 
-    This->cached_tile_x = tile_x;
-    This->cached_tile_y = tile_y;
-
-    return S_OK;
+    return hr;
 }
 
 static HRESULT WINAPI TiffFrameDecode_CopyPixels(IWICBitmapFrameDecode *iface,
@@ -1110,6 +1336,8 @@ static HRESULT WINAPI TiffFrameDecode_CopyPixels(IWICBitmapFrameDecode *iface,
     max_tile_x = (prc->X+prc->Width-1) / This->decode_info.tile_width;
     max_tile_y = (prc->Y+prc->Height-1) / This->decode_info.tile_height;
 
+    if (This->parent->prefetch_frames) wait_prefetch(This->parent, This->index);
+
     EnterCriticalSection(&This->parent->lock);
 
     for (tile_x=min_tile_x; tile_x <= max_tile_x; tile_x++)
@@ -1194,7 +1422,8 @@ static HRESULT WINAPI TiffFrameDecode_GetColorContexts(IWICBitmapFrameDecode *if
 
     EnterCriticalSection(&This->parent->lock);
 
-    if (pTIFFGetField(This->parent->tiff, TIFFTAG_ICCPROFILE, &len, &profile))
+    if (pTIFFSetDirectory(This->parent->tiff, This->index) &&
+        pTIFFGetField(This->parent->tiff, TIFFTAG_ICCPROFILE, &len, &profile))
     {
         if (cCount && ppIColorContexts)
         {
@@ -1302,8 +1531,12 @@ static HRESULT create_metadata_reader(TiffFrameDecode *This, IWICMetadataReader
 
     EnterCriticalSection(&This->parent->lock);
 
-    dir_offset.QuadPart = pTIFFCurrentDirOffset(This->parent->tiff);
-    hr = IStream_Seek(This->parent->stream, dir_offset, STREAM_SEEK_SET, NULL);
+    if (pTIFFSetDirectory(This->parent->tiff, This->index))
+    {
+        dir_offset.QuadPart = pTIFFCurrentDirOffset(This->parent->tiff);
+        hr = IStream_Seek(This->parent->stream, dir_offset, STREAM_SEEK_SET, NULL);
+    }
+    else hr = E_FAIL;
     if (SUCCEEDED(hr))
     {
         BOOL byte_swapped = pTIFFIsByteSwapped(This->parent->tiff);
@@ -1387,6 +1620,8 @@ HRESULT TiffDecoder_CreateInstance(REFIID iid, void** ppv)
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": TiffDecoder.lock");
     This->tiff = NULL;
     This->initialized = FALSE;
+    This->prefetch_frames = 0;
+    list_init(&This->prefetch);
 
     ret = IWICBitmapDecoder_QueryInterface(&This->IWICBitmapDecoder_iface, iid, ppv);
     IWICBitmapDecoder_Release(&This->IWICBitmapDecoder_iface);
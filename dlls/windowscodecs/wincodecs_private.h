@@ -167,6 +167,38 @@ extern HRESULT copy_pixels(UINT bpp, const BYTE *srcbuffer,
     UINT srcwidth, UINT srcheight, INT srcstride,
     const WICRect *rc, UINT dststride, UINT dstbuffersize, BYTE *dstbuffer) DECLSPEC_HIDDEN;
 
+#define STRIP_CACHE_SIZE 4
+
+typedef HRESULT (*read_rows_func)(void *user, BOOL restart, UINT count, UINT stride, BYTE *dst);
+
+struct decoded_strip
+{
+    UINT index;
+    UINT last_used;
+    BYTE *bits;
+};
+
+/* Bounded cache of decoded row strips for decoders that can only produce rows
+ * sequentially. read_rows is called with restart set when rows before the
+ * current decoder position are needed again, after which the whole image is
+ * kept if it isn't too large. */
+struct strip_cache
+{
+    UINT bpp, width, height, stride;
+    UINT strip_rows;
+    UINT next_row;
+    UINT clock;
+    read_rows_func read_rows;
+    void *user;
+    struct decoded_strip strips[STRIP_CACHE_SIZE];
+};
+
+extern void strip_cache_init(struct strip_cache *cache, UINT bpp, UINT width, UINT height,
+    BOOL whole_image, read_rows_func read_rows, void *user) DECLSPEC_HIDDEN;
+extern void strip_cache_free(struct strip_cache *cache) DECLSPEC_HIDDEN;
+extern HRESULT strip_cache_copy_pixels(struct strip_cache *cache, const WICRect *rc,
+    UINT dststride, UINT dstbuffersize, BYTE *dstbuffer) DECLSPEC_HIDDEN;
+
 extern HRESULT configure_write_source(IWICBitmapFrameEncode *iface,
     IWICBitmapSource *source, const WICRect *prc,
     const WICPixelFormatGUID *format,
@@ -34,6 +34,7 @@
 
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #ifdef HAVE_FLOAT_H
 # include <float.h>
 #endif
@@ -640,6 +641,334 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+/* Programs linked by the GLSL backend can be saved to a persistent cache
+ * directory using GL_ARB_get_program_binary. Entries are keyed by a hash of
+ * the driver strings and of the attached shader sources, and store the full
+ * sources so that hash collisions are detected on load. */
+#define GLSL_BINARY_CACHE_MAGIC 0x42473357 /* "W3GB" */
+#define GLSL_BINARY_CACHE_VERSION 1
+
+struct glsl_binary_header
+{
+    DWORD magic;
+    DWORD version;
+    ULONGLONG driver_hash;
+    GLenum format;
+    DWORD source_size;
+    DWORD binary_size;
+};
+
+struct glsl_binary_file
+{
+    FILETIME time;
+    ULONGLONG size;
+    char name[16 + 5];
+};
+
+static CRITICAL_SECTION glsl_binary_cache_cs;
+static CRITICAL_SECTION_DEBUG glsl_binary_cache_cs_debug =
+{
+    0, 0, &glsl_binary_cache_cs,
+    {&glsl_binary_cache_cs_debug.ProcessLocksList,
+    &glsl_binary_cache_cs_debug.ProcessLocksList},
+    0, 0, {(DWORD_PTR)(__FILE__ ": glsl_binary_cache_cs")}
+};
+static CRITICAL_SECTION glsl_binary_cache_cs = {&glsl_binary_cache_cs_debug, -1, 0, 0, 0, 0};
+
+static BOOL glsl_binary_cache_scanned;
+static ULONGLONG glsl_binary_cache_size;
+
+static ULONGLONG glsl_binary_hash(ULONGLONG hash, const void *data, SIZE_T size)
+{
+    const BYTE *ptr = data;
+    SIZE_T i;
+
+    /* 64-bit FNV-1a. */
+    for (i = 0; i < size; ++i)
+        hash = (hash ^ ptr[i]) * 0x100000001b3ull;
+
+    return hash;
+}
+
+static int glsl_binary_file_compare(const void *a, const void *b)
+{
+    const struct glsl_binary_file *f1 = a, *f2 = b;
+
+    return CompareFileTime(&f1->time, &f2->time);
+}
+
+/* Compute the size of the cache directory, and when "limit" is not zero
+ * remove the least recently used entries until the cache fits in it. */
+static void glsl_binary_cache_scan(ULONGLONG limit)
+{
+    struct glsl_binary_file *files = NULL;
+    SIZE_T count = 0, files_size = 0, i;
+    char path[MAX_PATH];
+    WIN32_FIND_DATAA data;
+    HANDLE find;
+
+    glsl_binary_cache_size = 0;
+    snprintf(path, sizeof(path), "%s\\*.bin", wined3d_settings.shader_cache_path);
+    if ((find = FindFirstFileA(path, &data)) == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || strlen(data.cFileName) >= sizeof(files->name))
+            continue;
+        glsl_binary_cache_size += ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        if (!limit)
+            continue;
+        if (!wined3d_array_reserve((void **)&files, &files_size, count + 1, sizeof(*files)))
+            break;
+        files[count].time = data.ftLastWriteTime;
+        files[count].size = ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        strcpy(files[count].name, data.cFileName);
+        ++count;
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+
+    if (!limit || glsl_binary_cache_size <= limit)
+    {
+        heap_free(files);
+        return;
+    }
+
+    /* Trim to three quarters of the limit, so that the directory is not
+     * scanned again for every program that gets stored. */
+    qsort(files, count, sizeof(*files), glsl_binary_file_compare);
+    for (i = 0; i < count && glsl_binary_cache_size > limit - limit / 4; ++i)
+    {
+        snprintf(path, sizeof(path), "%s\\%s", wined3d_settings.shader_cache_path, files[i].name);
+        TRACE("Removing cached program %s.\n", debugstr_a(files[i].name));
+        if (DeleteFileA(path))
+            glsl_binary_cache_size -= files[i].size;
+    }
+    heap_free(files);
+}
+
+/* Context activation is done by the caller. */
+static char *shader_glsl_get_program_source(const struct wined3d_gl_info *gl_info,
+        GLuint program, SIZE_T *size)
+{
+    GLint i, j, shader_count, length;
+    GLuint shaders[WINED3D_SHADER_TYPE_COUNT];
+    GLint types[WINED3D_SHADER_TYPE_COUNT];
+    char *source, *ptr;
+
+    GL_EXTCALL(glGetProgramiv(program, GL_ATTACHED_SHADERS, &shader_count));
+    if (shader_count > (GLint)ARRAY_SIZE(shaders))
+        return NULL;
+    GL_EXTCALL(glGetAttachedShaders(program, shader_count, &shader_count, shaders));
+
+    /* The order of attached shaders is implementation dependent. Sort them
+     * by type, there can be only one shader of each type. */
+    *size = 0;
+    for (i = 0; i < shader_count; ++i)
+    {
+        GLuint shader = shaders[i];
+        GLint type;
+
+        GL_EXTCALL(glGetShaderiv(shader, GL_SHADER_TYPE, &type));
+        GL_EXTCALL(glGetShaderiv(shader, GL_SHADER_SOURCE_LENGTH, &length));
+        *size += sizeof(type) + length;
+        for (j = i; j > 0 && types[j - 1] > type; --j)
+        {
+            types[j] = types[j - 1];
+            shaders[j] = shaders[j - 1];
+        }
+        types[j] = type;
+        shaders[j] = shader;
+    }
+
+    if (!(source = heap_alloc(*size)))
+        return NULL;
+
+    ptr = source;
+    for (i = 0; i < shader_count; ++i)
+    {
+        memcpy(ptr, &types[i], sizeof(types[i]));
+        ptr += sizeof(types[i]);
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length));
+        GL_EXTCALL(glGetShaderSource(shaders[i], length, NULL, ptr));
+        ptr += length;
+    }
+    checkGLcall("get program source");
+
+    return source;
+}
+
+/* Context activation is done by the caller. */
+static BOOL shader_glsl_load_program_binary(const struct wined3d_gl_info *gl_info, GLuint program,
+        const char *path, ULONGLONG driver_hash, const char *source, SIZE_T source_size)
+{
+    struct glsl_binary_header header;
+    BOOL ret = FALSE;
+    void *data = NULL;
+    FILETIME now;
+    HANDLE file;
+    DWORD size;
+    GLint tmp;
+
+    if ((file = CreateFileA(path, GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, 0, NULL)) == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    if (!ReadFile(file, &header, sizeof(header), &size, NULL) || size != sizeof(header)
+            || header.magic != GLSL_BINARY_CACHE_MAGIC || header.version != GLSL_BINARY_CACHE_VERSION
+            || header.driver_hash != driver_hash || header.source_size != source_size)
+        goto done;
+
+    if (!(data = heap_alloc(max(header.source_size, header.binary_size))))
+        goto done;
+    if (!ReadFile(file, data, header.source_size, &size, NULL) || size != header.source_size
+            || memcmp(data, source, source_size))
+    {
+        WARN("Source mismatch for %s.\n", debugstr_a(path));
+        goto done;
+    }
+    if (!ReadFile(file, data, header.binary_size, &size, NULL) || size != header.binary_size)
+        goto done;
+
+    GL_EXTCALL(glProgramBinary(program, header.format, data, header.binary_size));
+    GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &tmp));
+    checkGLcall("glProgramBinary");
+    if (!(ret = !!tmp))
+    {
+        WARN("Driver rejected cached program %s.\n", debugstr_a(path));
+        goto done;
+    }
+
+    /* Keep recently used entries when trimming the cache. */
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(file, NULL, NULL, &now);
+
+done:
+    heap_free(data);
+    CloseHandle(file);
+    return ret;
+}
+
+/* Context activation is done by the caller. */
+static void shader_glsl_store_program_binary(const struct wined3d_gl_info *gl_info, GLuint program,
+        const char *path, ULONGLONG driver_hash, const char *source, SIZE_T source_size)
+{
+    struct glsl_binary_header header;
+    WIN32_FILE_ATTRIBUTE_DATA old_data;
+    ULONGLONG old_size = 0;
+    char tmp_path[MAX_PATH];
+    void *binary;
+    GLint length;
+    HANDLE file;
+    DWORD size;
+    BOOL ret;
+
+    GL_EXTCALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0 || !(binary = heap_alloc(length)))
+        return;
+    GL_EXTCALL(glGetProgramBinary(program, length, &length, &header.format, binary));
+    checkGLcall("glGetProgramBinary");
+
+    header.magic = GLSL_BINARY_CACHE_MAGIC;
+    header.version = GLSL_BINARY_CACHE_VERSION;
+    header.driver_hash = driver_hash;
+    header.source_size = source_size;
+    header.binary_size = length;
+
+    /* Write to a temporary file first, other processes may be reading or
+     * writing the same entry. */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%04x", path, GetCurrentThreadId());
+    if ((file = CreateFileA(tmp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        WARN("Failed to create %s, error %u.\n", debugstr_a(tmp_path), GetLastError());
+        heap_free(binary);
+        return;
+    }
+    ret = WriteFile(file, &header, sizeof(header), &size, NULL)
+            && WriteFile(file, source, source_size, &size, NULL)
+            && WriteFile(file, binary, length, &size, NULL);
+    CloseHandle(file);
+    heap_free(binary);
+
+    /* The entry may be replacing a stale one, e.g. after a driver update. */
+    if (GetFileAttributesExA(path, GetFileExInfoStandard, &old_data))
+        old_size = ((ULONGLONG)old_data.nFileSizeHigh << 32) | old_data.nFileSizeLow;
+
+    if (!ret || !MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        WARN("Failed to write %s, error %u.\n", debugstr_a(path), GetLastError());
+        DeleteFileA(tmp_path);
+        return;
+    }
+
+    EnterCriticalSection(&glsl_binary_cache_cs);
+    glsl_binary_cache_size -= min(glsl_binary_cache_size, old_size);
+    glsl_binary_cache_size += sizeof(header) + source_size + length;
+    if (glsl_binary_cache_size > (ULONGLONG)wined3d_settings.shader_cache_size * 1024 * 1024)
+        glsl_binary_cache_scan((ULONGLONG)wined3d_settings.shader_cache_size * 1024 * 1024);
+    LeaveCriticalSection(&glsl_binary_cache_cs);
+}
+
+/* Link a GLSL program, going through the persistent program cache when it
+ * is enabled. Programs with state that is not part of the shader sources,
+ * like transform feedback varyings, shouldn't be cached.
+ *
+ * Context activation is done by the caller. */
+static void shader_glsl_link_program(const struct wined3d_gl_info *gl_info, GLuint program, BOOL cacheable)
+{
+    static const GLenum driver_strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    ULONGLONG driver_hash = 0xcbf29ce484222325ull, hash;
+    char path[MAX_PATH];
+    SIZE_T source_size;
+    unsigned int i;
+    char *source;
+    GLint tmp;
+
+    if (!cacheable || !wined3d_settings.shader_cache_path || !wined3d_settings.shader_cache_size
+            || !gl_info->supported[ARB_GET_PROGRAM_BINARY]
+            || !(source = shader_glsl_get_program_source(gl_info, program, &source_size)))
+    {
+        GL_EXTCALL(glLinkProgram(program));
+        shader_glsl_validate_link(gl_info, program);
+        return;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(driver_strings); ++i)
+    {
+        const char *str = (const char *)gl_info->gl_ops.gl.p_glGetString(driver_strings[i]);
+
+        if (str)
+            driver_hash = glsl_binary_hash(driver_hash, str, strlen(str) + 1);
+    }
+    hash = glsl_binary_hash(driver_hash, source, source_size);
+    snprintf(path, sizeof(path), "%s\\%08x%08x.bin", wined3d_settings.shader_cache_path,
+            (unsigned int)(hash >> 32), (unsigned int)hash);
+
+    EnterCriticalSection(&glsl_binary_cache_cs);
+    if (!glsl_binary_cache_scanned)
+    {
+        CreateDirectoryA(wined3d_settings.shader_cache_path, NULL);
+        glsl_binary_cache_scan(0);
+        glsl_binary_cache_scanned = TRUE;
+    }
+    LeaveCriticalSection(&glsl_binary_cache_cs);
+
+    if (shader_glsl_load_program_binary(gl_info, program, path, driver_hash, source, source_size))
+    {
+        TRACE("Loaded program %u from %s.\n", program, debugstr_a(path));
+        heap_free(source);
+        return;
+    }
+
+    GL_EXTCALL(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    GL_EXTCALL(glLinkProgram(program));
+    shader_glsl_validate_link(gl_info, program);
+
+    GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &tmp));
+    if (tmp)
+        shader_glsl_store_program_binary(gl_info, program, path, driver_hash, source, source_size);
+    heap_free(source);
+}
+
 static BOOL shader_glsl_use_layout_qualifier(const struct wined3d_gl_info *gl_info)
 {
     /* Layout qualifiers were introduced in GLSL 1.40. The Nvidia Legacy GPU
@@ -10062,8 +10391,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     list_add_head(&shader->linked_programs, &entry->cs.shader_entry);
 
     TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    shader_glsl_link_program(gl_info, program_id, TRUE);
 
     GL_EXTCALL(glUseProgram(program_id));
     checkGLcall("glUseProgram");
@@ -10392,8 +10720,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
 
     /* Link the program */
     TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    shader_glsl_link_program(gl_info, program_id, !gshader || !gshader->u.gs.so_desc.element_count);
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? vshader->limits->constant_float : 0);
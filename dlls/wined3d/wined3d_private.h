@@ -418,6 +418,8 @@ struct wined3d_settings
     /* Memory tracking and object counting. */
     UINT64 emulated_textureram;
     char *logo;
+    char *shader_cache_path;
+    unsigned int shader_cache_size;
     unsigned int multisample_textures;
     unsigned int sample_count;
     BOOL check_float_constants;
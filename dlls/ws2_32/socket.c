@@ -79,6 +79,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
 #endif
@@ -131,6 +132,17 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+# include <sys/epoll.h>
+# define USE_EPOLL
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+# include <sys/sendfile.h>
+# define USE_SENDFILE
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -159,6 +171,7 @@
 #include "wine/exception.h"
 #include "wine/unicode.h"
 #include "wine/heap.h"
+#include "wine/list.h"
 
 #if defined(linux) && !defined(IP_UNICAST_IF)
 #define IP_UNICAST_IF 50
@@ -266,6 +279,10 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                           LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine,
                           LPWSABUF lpControlBuffer );
 
+static void dgram_init_queues(void);
+static void dgram_free_queues(void);
+static void dgram_detach_asyncs( HANDLE handle, DWORD thread );
+
 /* critical section to protect some non-reentrant net function */
 static CRITICAL_SECTION csWSgetXXXbyYYY;
 static CRITICAL_SECTION_DEBUG critsect_debug =
@@ -507,6 +524,10 @@ struct ws2_async
     WSABUF                             *control;
     unsigned int                        n_iovecs;
     unsigned int                        first_iovec;
+    struct list                         dgram_entry;    /* entry in the batched datagram operations */
+    int                                 dgram_state;
+    int                                 dgram_result;
+    DWORD                               dgram_thread;
     struct iovec                        iovec[1];
 };
 
@@ -532,6 +553,7 @@ struct ws2_transmitfile_async
     DWORD                 file_read;
     DWORD                 file_bytes;
     DWORD                 bytes_per_send;
+    BOOL                  use_sendfile;
     TRANSMIT_FILE_BUFFERS buffers;
     DWORD                 flags;
     LARGE_INTEGER         offset;
@@ -563,7 +585,7 @@ static struct ws2_async_io *alloc_async_io( DWORD size, async_callback_t callbac
         io = next;
     }
 
-    io = HeapAlloc( GetProcessHeap(), 0, size );
+    io = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, size );
     if (io) io->callback = callback;
     return io;
 }
@@ -616,7 +638,11 @@ struct per_thread_data
     struct WS_servent *se_buffer;
     struct WS_protoent *pe_buffer;
     struct pollfd *fd_cache;
+    SOCKET *fd_sockets;         /* sockets of the fd_cache entries built by select */
     unsigned int fd_count;
+    LONG close_serial;          /* fd close serial when fd_sockets was filled */
+    BOOL last_poll_large;       /* whether the previous poll used a large socket set */
+    struct poll_set *poll_set;  /* epoll set for large socket sets */
     int he_len;
     int se_len;
     int pe_len;
@@ -639,6 +665,8 @@ static struct WS_hostent *WS_dup_he(const struct hostent* p_he);
 static struct WS_protoent *WS_create_pe( const char *name, char **aliases, int prot );
 static struct WS_servent *WS_dup_se(const struct servent* p_se);
 static int ws_protocol_info(SOCKET s, int unicode, WSAPROTOCOL_INFOW *buffer, int *size);
+static void rio_stop_worker(void);
+static void rio_free_buffers(void);
 
 int WSAIOCTL_GetInterfaceCount(void);
 int WSAIOCTL_GetInterfaceName(int intNumber, char *intName);
@@ -1151,6 +1179,104 @@ static inline void release_sock_fd( SOCKET s, int fd )
     wine_server_release_fd( SOCKET2HANDLE(s), fd );
 }
 
+/* cache of the entries of the sockets in the section holding the event state */
+#define SOCKET_SHM_CACHE_SIZE 16384
+
+struct socket_shm_cache
+{
+    SOCKET       socket;
+    unsigned int index;
+    unsigned int serial;
+};
+
+static const volatile struct socket_shm *socket_shm;
+static struct socket_shm_cache *socket_shm_cache;
+
+static CRITICAL_SECTION socket_shm_cs;
+static CRITICAL_SECTION_DEBUG socket_shm_cs_debug =
+{
+    0, 0, &socket_shm_cs,
+    { &socket_shm_cs_debug.ProcessLocksList, &socket_shm_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": socket_shm_cs") }
+};
+static CRITICAL_SECTION socket_shm_cs = { &socket_shm_cs_debug, -1, 0, 0, 0, 0 };
+
+/* remember the entry of a socket in the shared section, an index of 0 forgets it */
+static void set_socket_shm_index( SOCKET s, unsigned int index, unsigned int serial )
+{
+    struct socket_shm_cache *entry;
+
+    EnterCriticalSection( &socket_shm_cs );
+
+    if (index && !socket_shm)
+    {
+        HANDLE handle = 0;
+
+        SERVER_START_REQ( get_socket_shm )
+        {
+            if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+        }
+        SERVER_END_REQ;
+        if (handle)
+        {
+            socket_shm = MapViewOfFile( handle, FILE_MAP_READ, 0, 0, 0 );
+            CloseHandle( handle );
+        }
+    }
+    if (index && !socket_shm_cache)
+        socket_shm_cache = heap_alloc_zero( SOCKET_SHM_CACHE_SIZE * sizeof(*socket_shm_cache) );
+
+    if (socket_shm_cache)
+    {
+        entry = &socket_shm_cache[(s >> 2) % SOCKET_SHM_CACHE_SIZE];
+        if (index || entry->socket == s)
+        {
+            entry->socket = s;
+            entry->index  = index;
+            entry->serial = serial;
+        }
+    }
+
+    LeaveCriticalSection( &socket_shm_cs );
+}
+
+/* get a consistent copy of the event state of a socket from the shared section */
+static BOOL get_socket_shm_state( SOCKET s, struct socket_shm *state )
+{
+    const volatile struct socket_shm *shm;
+    struct socket_shm_cache *entry;
+    unsigned int index = 0, serial = 0, seq;
+
+    EnterCriticalSection( &socket_shm_cs );
+    if (socket_shm_cache)
+    {
+        entry = &socket_shm_cache[(s >> 2) % SOCKET_SHM_CACHE_SIZE];
+        if (entry->socket == s)
+        {
+            index  = entry->index;
+            serial = entry->serial;
+        }
+    }
+    LeaveCriticalSection( &socket_shm_cs );
+
+    if (!index || !socket_shm) return FALSE;
+    shm = &socket_shm[index - 1];
+
+    for (;;)
+    {
+        if ((seq = shm->seq) & 1)  /* being updated by the server */
+        {
+            Sleep( 0 );
+            continue;
+        }
+        __sync_synchronize();
+        memcpy( state, (const void *)shm, sizeof(*state) );
+        __sync_synchronize();
+        if (shm->seq == seq) break;
+    }
+    return state->serial == serial;
+}
+
 static void _enable_event( HANDLE s, unsigned int event,
                            unsigned int sstate, unsigned int cstate )
 {
@@ -1333,6 +1459,39 @@ static BOOL get_dont_fragment(SOCKET s, int level, BOOL *out)
     return value;
 }
 
+/* epoll set holding the fds of the last large poll array of a thread */
+struct poll_set_entry
+{
+    int fd;
+    int events;
+    int revents;
+};
+
+struct poll_set
+{
+    int                    epoll_fd;
+    LONG                   close_serial; /* fd close serial when the set was created */
+    unsigned int           count;        /* number of registered fds */
+    unsigned int           size;         /* allocated size of the arrays */
+    struct poll_set_entry *entries;      /* registered fds, sorted by fd */
+    struct poll_set_entry *pending;      /* scratch array for the next set */
+#ifdef USE_EPOLL
+    struct epoll_event    *events;
+#endif
+};
+
+static void free_poll_set( struct poll_set *set )
+{
+    if (!set) return;
+    if (set->epoll_fd != -1) close( set->epoll_fd );
+    heap_free( set->entries );
+    heap_free( set->pending );
+#ifdef USE_EPOLL
+    heap_free( set->events );
+#endif
+    heap_free( set );
+}
+
 static struct per_thread_data *get_per_thread_data(void)
 {
     struct per_thread_data * ptb = NtCurrentTeb()->WinSockData;
@@ -1356,6 +1515,8 @@ static void free_per_thread_data(void)
     HeapFree( GetProcessHeap(), 0, ptb->se_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->pe_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->fd_cache );
+    HeapFree( GetProcessHeap(), 0, ptb->fd_sockets );
+    free_poll_set( ptb->poll_set );
 
     HeapFree( GetProcessHeap(), 0, ptb );
     NtCurrentTeb()->WinSockData = NULL;
@@ -1369,13 +1530,18 @@ BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID fImpLoad)
     TRACE("%p 0x%x %p\n", hInstDLL, fdwReason, fImpLoad);
     switch (fdwReason) {
     case DLL_PROCESS_ATTACH:
+        dgram_init_queues();
         break;
     case DLL_PROCESS_DETACH:
         if (fImpLoad) break;
+        rio_stop_worker();
+        rio_free_buffers();
+        dgram_free_queues();
         free_per_thread_data();
         DeleteCriticalSection(&csWSgetXXXbyYYY);
         break;
     case DLL_THREAD_DETACH:
+        dgram_detach_asyncs( 0, GetCurrentThreadId() );
         free_per_thread_data();
         break;
     }
@@ -1718,6 +1884,7 @@ INT WINAPI WSACleanup(void)
     if (num_startup) {
         num_startup--;
         TRACE("pending cleanups: %d\n", num_startup);
+        if (!num_startup) rio_stop_worker();
         return 0;
     }
     SetLastError(WSANOTINITIALISED);
@@ -2381,6 +2548,251 @@ static void WINAPI ws2_async_apc( void *arg, IO_STATUS_BLOCK *iosb, ULONG reserv
     release_async_io( &wsa->io );
 }
 
+/***********************************************************************
+ * Batched datagram operations
+ *
+ * Overlapped receives and sends on datagram sockets that cannot complete
+ * immediately are also kept in a list. The first one that gets alerted
+ * transfers the data of all the queued operations of the same socket with
+ * a single recvmmsg or sendmmsg call, and the server is then asked to
+ * alert the others at once so that they report their results. The
+ * operations of a batch are marked busy while the data is transferred, so
+ * that the queue lock is not held across the system call.
+ */
+
+#define DGRAM_BATCH_SIZE 64
+#define DGRAM_HASH_SIZE  64
+
+enum dgram_state
+{
+    DGRAM_NONE,    /* not batched */
+    DGRAM_QUEUED,  /* waiting for data */
+    DGRAM_BUSY,    /* data being transferred by a batch */
+    DGRAM_DONE     /* data transferred by another operation, dgram_result is valid */
+};
+
+/* queued operations of the sockets hashing to the same entry */
+struct dgram_queue
+{
+    CRITICAL_SECTION    cs;
+    CONDITION_VARIABLE  done;    /* signaled when a batch has been transferred */
+    struct list         asyncs;
+};
+
+static struct dgram_queue dgram_queues[DGRAM_HASH_SIZE];
+
+static void dgram_init_queues(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < DGRAM_HASH_SIZE; i++)
+    {
+        InitializeCriticalSection( &dgram_queues[i].cs );
+        dgram_queues[i].cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": dgram_queue.cs");
+        InitializeConditionVariable( &dgram_queues[i].done );
+        list_init( &dgram_queues[i].asyncs );
+    }
+}
+
+static void dgram_free_queues(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < DGRAM_HASH_SIZE; i++)
+    {
+        dgram_queues[i].cs.DebugInfo->Spare[0] = 0;
+        DeleteCriticalSection( &dgram_queues[i].cs );
+    }
+}
+
+static inline struct dgram_queue *dgram_get_queue( HANDLE handle )
+{
+    return &dgram_queues[((ULONG_PTR)handle >> 2) % DGRAM_HASH_SIZE];
+}
+
+/* the operations are completed from system APCs, which may interrupt the thread at
+ * any time, so they must not run while the thread is in the middle of updating a queue */
+static void dgram_lock( struct dgram_queue *queue, sigset_t *sigset )
+{
+    sigset_t block;
+
+    sigemptyset( &block );
+    sigaddset( &block, SIGUSR1 );
+    pthread_sigmask( SIG_BLOCK, &block, sigset );
+    EnterCriticalSection( &queue->cs );
+}
+
+static void dgram_unlock( struct dgram_queue *queue, sigset_t *sigset )
+{
+    LeaveCriticalSection( &queue->cs );
+    pthread_sigmask( SIG_SETMASK, sigset, NULL );
+}
+
+/* wait until an operation is no longer being transferred by another one; queue must be locked */
+static void dgram_wait_async( struct dgram_queue *queue, struct ws2_async *wsa )
+{
+    while (wsa->dgram_state == DGRAM_BUSY)
+        SleepConditionVariableCS( &queue->done, &queue->cs, INFINITE );
+}
+
+/* add a pending overlapped operation to the batched ones, before it is registered */
+static BOOL dgram_queue_async( struct ws2_async *wsa, int type )
+{
+    struct dgram_queue *queue = dgram_get_queue( wsa->hSocket );
+    sigset_t sigset;
+
+#ifndef HAVE_RECVMMSG
+    if (type == ASYNC_TYPE_READ) return FALSE;
+#endif
+#ifndef HAVE_SENDMMSG
+    if (type == ASYNC_TYPE_WRITE) return FALSE;
+#endif
+    dgram_lock( queue, &sigset );
+    wsa->dgram_state  = DGRAM_QUEUED;
+    wsa->dgram_thread = GetCurrentThreadId();
+    list_add_tail( &queue->asyncs, &wsa->dgram_entry );
+    dgram_unlock( queue, &sigset );
+    return TRUE;
+}
+
+/* stop batching an operation, returns TRUE if its data has already been transferred */
+static BOOL dgram_dequeue_async( struct ws2_async *wsa, int *result )
+{
+    struct dgram_queue *queue = dgram_get_queue( wsa->hSocket );
+    BOOL done = FALSE;
+    sigset_t sigset;
+
+    if (wsa->dgram_state == DGRAM_NONE) return FALSE;
+
+    dgram_lock( queue, &sigset );
+    dgram_wait_async( queue, wsa );
+    if (wsa->dgram_state == DGRAM_DONE)
+    {
+        *result = wsa->dgram_result;
+        done = TRUE;
+    }
+    else if (wsa->dgram_state == DGRAM_QUEUED) list_remove( &wsa->dgram_entry );
+    wsa->dgram_state = DGRAM_NONE;
+    dgram_unlock( queue, &sigset );
+    return done;
+}
+
+/* check if the data of a batched operation has been transferred by another one */
+static BOOL dgram_async_done( struct ws2_async *wsa, int *result )
+{
+    struct dgram_queue *queue = dgram_get_queue( wsa->hSocket );
+    BOOL done = FALSE;
+    sigset_t sigset;
+
+    if (wsa->dgram_state == DGRAM_NONE) return FALSE;
+
+    dgram_lock( queue, &sigset );
+    dgram_wait_async( queue, wsa );
+    if (wsa->dgram_state == DGRAM_DONE)
+    {
+        *result = wsa->dgram_result;
+        wsa->dgram_state = DGRAM_NONE;
+        done = TRUE;
+    }
+    dgram_unlock( queue, &sigset );
+    return done;
+}
+
+/* stop batching the operations of a socket being closed, or of an exiting thread */
+static void dgram_detach_asyncs( HANDLE handle, DWORD thread )
+{
+    struct ws2_async *wsa, *next;
+    struct dgram_queue *queue;
+    unsigned int i;
+    sigset_t sigset;
+
+    for (i = 0; i < DGRAM_HASH_SIZE; i++)
+    {
+        queue = &dgram_queues[i];
+        if (handle && queue != dgram_get_queue( handle )) continue;
+
+        dgram_lock( queue, &sigset );
+    restart:
+        LIST_FOR_EACH_ENTRY_SAFE( wsa, next, &queue->asyncs, struct ws2_async, dgram_entry )
+        {
+            if (wsa->hSocket != handle && wsa->dgram_thread != thread) continue;
+            if (wsa->dgram_state == DGRAM_BUSY)
+            {
+                dgram_wait_async( queue, wsa );
+                goto restart;
+            }
+            list_remove( &wsa->dgram_entry );
+            wsa->dgram_state = DGRAM_NONE;
+        }
+        dgram_unlock( queue, &sigset );
+    }
+}
+
+/* collect the queued operations of the socket that can be batched with the given one;
+ * queue must be locked, the operations are owned by the caller until dgram_end_batch */
+static unsigned int dgram_get_batch( struct dgram_queue *queue, struct ws2_async *wsa,
+                                     struct ws2_async **batch )
+{
+    struct ws2_async *other;
+    unsigned int count = 0;
+
+    batch[count++] = wsa;
+    wsa->dgram_state = DGRAM_BUSY;
+    LIST_FOR_EACH_ENTRY( other, &queue->asyncs, struct ws2_async, dgram_entry )
+    {
+        if (count == DGRAM_BATCH_SIZE) break;
+        if (other == wsa || other->hSocket != wsa->hSocket) continue;
+        if (other->dgram_state != DGRAM_QUEUED) continue;
+        if (other->io.callback != wsa->io.callback || other->flags != wsa->flags) continue;
+        other->dgram_state = DGRAM_BUSY;
+        batch[count++] = other;
+    }
+    return count;
+}
+
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+/* release the operations of a batch, the first ret ones have been transferred;
+ * the first operation is the caller's and is only queued again if keep is set */
+static void dgram_end_batch( struct dgram_queue *queue, struct ws2_async **batch, unsigned int count,
+                             const struct mmsghdr *msgs, int ret, BOOL keep )
+{
+    unsigned int i;
+    sigset_t sigset;
+
+    dgram_lock( queue, &sigset );
+    for (i = 1; i < count; i++)
+    {
+        if ((int)i < ret)
+        {
+            list_remove( &batch[i]->dgram_entry );
+            batch[i]->dgram_result = msgs[i].msg_len;
+            batch[i]->dgram_state = DGRAM_DONE;
+        }
+        else batch[i]->dgram_state = DGRAM_QUEUED;
+    }
+    if (keep) batch[0]->dgram_state = DGRAM_QUEUED;
+    else
+    {
+        list_remove( &batch[0]->dgram_entry );
+        batch[0]->dgram_state = DGRAM_NONE;
+    }
+    WakeAllConditionVariable( &queue->done );
+    dgram_unlock( queue, &sigset );
+}
+#endif
+
+/* alert the operations of a socket that were completed by a batch */
+static void dgram_wake_asyncs( HANDLE handle, int type )
+{
+    SERVER_START_REQ( wake_socket_asyncs )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        req->type   = type;
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
 /***********************************************************************
  *              WS2_recv                (INTERNAL)
  *
@@ -2454,6 +2866,83 @@ static int WS2_recv( int fd, struct ws2_async *wsa, int flags )
     return n;
 }
 
+/***********************************************************************
+ *              WS2_recv_batch          (INTERNAL)
+ *
+ * Receive the data of a queued datagram receive, along with the data of
+ * the other receives queued on the same socket.
+ */
+static int WS2_recv_batch( int fd, struct ws2_async *wsa, int flags )
+{
+#ifdef HAVE_RECVMMSG
+    struct dgram_queue *queue = dgram_get_queue( wsa->hSocket );
+    struct ws2_async *batch[DGRAM_BATCH_SIZE];
+    union generic_unix_sockaddr addrs[DGRAM_BATCH_SIZE];
+    struct mmsghdr msgs[DGRAM_BATCH_SIZE];
+    unsigned int i, count;
+    sigset_t sigset;
+    int ret, err;
+
+    dgram_lock( queue, &sigset );
+    dgram_wait_async( queue, wsa );
+    if (wsa->dgram_state != DGRAM_QUEUED)
+    {
+        /* the data has been received in the meantime */
+        dgram_unlock( queue, &sigset );
+        if (dgram_async_done( wsa, &ret )) return ret;
+        return WS2_recv( fd, wsa, flags );
+    }
+    count = dgram_get_batch( queue, wsa, batch );
+    dgram_unlock( queue, &sigset );
+
+    memset( msgs, 0, count * sizeof(msgs[0]) );
+    for (i = 0; i < count; i++)
+    {
+        msgs[i].msg_hdr.msg_iov = batch[i]->iovec + batch[i]->first_iovec;
+        msgs[i].msg_hdr.msg_iovlen = batch[i]->n_iovecs - batch[i]->first_iovec;
+        if (batch[i]->addr)
+        {
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+    }
+
+    while ((ret = recvmmsg( fd, msgs, count, flags, NULL )) == -1 && errno == EINTR);
+    if (ret == -1 && errno == EFAULT)
+    {
+        /* buffers with write watches are only writable through ntdll */
+        for (ret = 0; ret < count; ret++)
+        {
+            int n;
+
+            while ((n = __wine_locked_recvmsg( fd, &msgs[ret].msg_hdr, flags )) == -1 && errno == EINTR);
+            if (n == -1) break;
+            msgs[ret].msg_len = n;
+        }
+        if (!ret) ret = -1;
+    }
+    err = errno;
+
+    for (i = 0; (int)i < ret; i++)
+    {
+        if (batch[i]->addr && msgs[i].msg_hdr.msg_namelen)
+            ws_sockaddr_u2ws( &addrs[i].addr, batch[i]->addr, batch[i]->addrlen.ptr );
+    }
+    dgram_end_batch( queue, batch, count, msgs, ret, ret == -1 );
+
+    if (ret == -1)
+    {
+        errno = err;
+        return -1;
+    }
+    TRACE( "received %d datagrams for socket %p\n", ret, wsa->hSocket );
+    if (ret > 1) dgram_wake_asyncs( wsa->hSocket, ASYNC_TYPE_READ );
+    return msgs[0].msg_len;
+#else
+    return WS2_recv( fd, wsa, flags );
+#endif
+}
+
 /***********************************************************************
  *              WS2_async_recv          (INTERNAL)
  *
@@ -2467,10 +2956,19 @@ static NTSTATUS WS2_async_recv( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
     switch (status)
     {
     case STATUS_ALERTED:
+        /* the data may have been received along with another operation */
+        if (dgram_async_done( wsa, &result ))
+        {
+            status = STATUS_SUCCESS;
+            break;
+        }
         if ((status = wine_server_handle_to_fd( wsa->hSocket, FILE_READ_DATA, &fd, NULL ) ))
             break;
 
-        result = WS2_recv( fd, wsa, convert_flags(wsa->flags) );
+        if (wsa->dgram_state != DGRAM_NONE)
+            result = WS2_recv_batch( fd, wsa, convert_flags(wsa->flags) );
+        else
+            result = WS2_recv( fd, wsa, convert_flags(wsa->flags) );
         wine_server_release_fd( wsa->hSocket, fd );
         if (result >= 0)
         {
@@ -2492,6 +2990,8 @@ static NTSTATUS WS2_async_recv( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
         }
         break;
     }
+    if (status != STATUS_PENDING && dgram_dequeue_async( wsa, &result ))
+        status = STATUS_SUCCESS;
     if (status != STATUS_PENDING)
     {
         iosb->u.Status = status;
@@ -2523,6 +3023,21 @@ static NTSTATUS WS2_async_accept_recv( void *user, IO_STATUS_BLOCK *iosb, NTSTAT
     return status;
 }
 
+/* accept a pending connection of the listening socket into the accepting socket */
+static NTSTATUS accept_into_socket( HANDLE listener, HANDLE acceptor )
+{
+    NTSTATUS status;
+
+    SERVER_START_REQ( accept_into_socket )
+    {
+        req->lhandle = wine_server_obj_handle( listener );
+        req->ahandle = wine_server_obj_handle( acceptor );
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    return status;
+}
+
 /***********************************************************************
  *              WS2_async_accept                (INTERNAL)
  *
@@ -2538,13 +3053,7 @@ static NTSTATUS WS2_async_accept( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS st
 
     if (status == STATUS_ALERTED)
     {
-        SERVER_START_REQ( accept_into_socket )
-        {
-            req->lhandle = wine_server_obj_handle( wsa->listen_socket );
-            req->ahandle = wine_server_obj_handle( wsa->accept_socket );
-            status = wine_server_call( req );
-        }
-        SERVER_END_REQ;
+        status = accept_into_socket( wsa->listen_socket, wsa->accept_socket );
 
         if (NtStatusToWSAError( status ) == WSAEWOULDBLOCK)
             return STATUS_PENDING;
@@ -2673,6 +3182,75 @@ static int WS2_send( int fd, struct ws2_async *wsa, int flags )
     return ret;
 }
 
+/***********************************************************************
+ *              WS2_send_batch          (INTERNAL)
+ *
+ * Send the data of a queued datagram send, along with the data of the
+ * other sends queued on the same socket.
+ */
+static int WS2_send_batch( int fd, struct ws2_async *wsa, int flags )
+{
+#ifdef HAVE_SENDMMSG
+    struct dgram_queue *queue = dgram_get_queue( wsa->hSocket );
+    struct ws2_async *batch[DGRAM_BATCH_SIZE];
+    union generic_unix_sockaddr addrs[DGRAM_BATCH_SIZE];
+    struct mmsghdr msgs[DGRAM_BATCH_SIZE];
+    unsigned int i, count;
+    sigset_t sigset;
+    int ret, err;
+
+    dgram_lock( queue, &sigset );
+    dgram_wait_async( queue, wsa );
+    if (wsa->dgram_state != DGRAM_QUEUED)
+    {
+        /* the data has been sent in the meantime */
+        dgram_unlock( queue, &sigset );
+        if (dgram_async_done( wsa, &ret )) return ret;
+        return WS2_send( fd, wsa, flags );
+    }
+    count = dgram_get_batch( queue, wsa, batch );
+    dgram_unlock( queue, &sigset );
+
+    memset( msgs, 0, count * sizeof(msgs[0]) );
+    for (i = 0; i < count; i++)
+    {
+        msgs[i].msg_hdr.msg_iov = batch[i]->iovec + batch[i]->first_iovec;
+        msgs[i].msg_hdr.msg_iovlen = batch[i]->n_iovecs - batch[i]->first_iovec;
+        if (batch[i]->addr)
+        {
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = ws_sockaddr_ws2u( batch[i]->addr, batch[i]->addrlen.val, &addrs[i] );
+            /* let the regular path report the error */
+            if (!msgs[i].msg_hdr.msg_namelen) break;
+        }
+    }
+    if (!i)
+    {
+        dgram_end_batch( queue, batch, count, msgs, 0, FALSE );
+        return WS2_send( fd, wsa, flags );
+    }
+
+    while ((ret = sendmmsg( fd, msgs, i, flags )) == -1 && errno == EINTR);
+    err = errno;
+
+    for (i = 1; (int)i < ret; i++) batch[i]->first_iovec = batch[i]->n_iovecs;
+    if (ret > 0) wsa->first_iovec = wsa->n_iovecs;
+    dgram_end_batch( queue, batch, count, msgs, ret, ret == -1 && err != EISCONN );
+
+    if (ret == -1)
+    {
+        if (err == EISCONN) return WS2_send( fd, wsa, flags );
+        errno = err;
+        return -1;
+    }
+    TRACE( "sent %d datagrams for socket %p\n", ret, wsa->hSocket );
+    if (ret > 1) dgram_wake_asyncs( wsa->hSocket, ASYNC_TYPE_WRITE );
+    return msgs[0].msg_len;
+#else
+    return WS2_send( fd, wsa, flags );
+#endif
+}
+
 /***********************************************************************
  *              WS2_async_send          (INTERNAL)
  *
@@ -2686,6 +3264,13 @@ static NTSTATUS WS2_async_send( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
     switch (status)
     {
     case STATUS_ALERTED:
+        /* the data may have been sent along with another operation */
+        if (dgram_async_done( wsa, &result ))
+        {
+            iosb->Information += result;
+            status = STATUS_SUCCESS;
+            break;
+        }
         if ( wsa->n_iovecs <= wsa->first_iovec )
         {
             /* Nothing to do */
@@ -2696,7 +3281,10 @@ static NTSTATUS WS2_async_send( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
             break;
 
         /* check to see if the data is ready (non-blocking) */
-        result = WS2_send( fd, wsa, convert_flags(wsa->flags) );
+        if (wsa->dgram_state != DGRAM_NONE)
+            result = WS2_send_batch( fd, wsa, convert_flags(wsa->flags) );
+        else
+            result = WS2_send( fd, wsa, convert_flags(wsa->flags) );
         wine_server_release_fd( wsa->hSocket, fd );
 
         if (result >= 0)
@@ -2718,6 +3306,11 @@ static NTSTATUS WS2_async_send( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
         }
         break;
     }
+    if (status != STATUS_PENDING && dgram_dequeue_async( wsa, &result ))
+    {
+        iosb->Information += result;
+        status = STATUS_SUCCESS;
+    }
     if (status != STATUS_PENDING)
     {
         iosb->u.Status = status;
@@ -2847,6 +3440,9 @@ static BOOL WINAPI WS2_AcceptEx(SOCKET listener, SOCKET acceptor, PVOID dest, DW
 {
     DWORD status;
     struct ws2_accept_async *wsa;
+    struct pollfd pfd;
+    ULONG_PTR cvalue;
+    BOOL pending;
     int fd;
 
     TRACE("(%04lx, %04lx, %p, %d, %d, %d, %p, %p)\n", listener, acceptor, dest, dest_len, local_addr_len,
@@ -2877,6 +3473,9 @@ static BOOL WINAPI WS2_AcceptEx(SOCKET listener, SOCKET acceptor, PVOID dest, DW
         SetLastError(WSAENOTSOCK);
         return FALSE;
     }
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pending = poll( &pfd, 1, 0 ) == 1 && (pfd.revents & POLLIN);
     release_sock_fd( listener, fd );
 
     fd = get_sock_fd( acceptor, FILE_READ_DATA, NULL );
@@ -2928,6 +3527,25 @@ static BOOL WINAPI WS2_AcceptEx(SOCKET listener, SOCKET acceptor, PVOID dest, DW
         wsa->read->iovec[0].iov_len  = wsa->data_len;
     }
 
+    /* a connection is already waiting, accept it right away instead of waiting
+     * for an async on the listening socket to be alerted */
+    if (pending && accept_into_socket( wsa->listen_socket, wsa->accept_socket ) == STATUS_SUCCESS)
+    {
+        cvalue = wsa->cvalue;
+        status = WS2_async_accept( wsa, (IO_STATUS_BLOCK *)overlapped, STATUS_SUCCESS );
+        if (status == STATUS_SUCCESS)
+        {
+            if (cvalue) WS_AddCompletion( listener, cvalue, STATUS_SUCCESS, 0, TRUE );
+            if (overlapped->hEvent) SetEvent( overlapped->hEvent );
+            status = STATUS_PENDING;
+        }
+        else if (status == STATUS_MORE_PROCESSING_REQUIRED)
+            status = STATUS_PENDING;  /* waiting for the initial data */
+
+        SetLastError( NtStatusToWSAError(status) );
+        return FALSE;
+    }
+
     status = register_async( ASYNC_TYPE_READ, SOCKET2HANDLE(listener), &wsa->io,
                              overlapped->hEvent, NULL, (void *)wsa->cvalue, (IO_STATUS_BLOCK *)overlapped );
 
@@ -2988,16 +3606,73 @@ static NTSTATUS WS2_ReadFile(HANDLE hFile, PIO_STATUS_BLOCK io_status, char* buf
     return status;
 }
 
+#ifdef USE_SENDFILE
+
+/* maximum amount of file data sent by a single sendfile call */
+#define TRANSMITFILE_SENDFILE_CHUNK (1 << 20)
+
 /***********************************************************************
- *     WS2_transmitfile_getbuffer       (INTERNAL)
+ *     WS2_transmitfile_sendfile        (INTERNAL)
  *
- * Pick the appropriate buffer for a TransmitFile send operation.
+ * Send the next part of the main file of a TransmitFile operation without
+ * copying it to user space.
  */
-static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_async *wsa )
+static NTSTATUS WS2_transmitfile_sendfile( int fd, struct ws2_transmitfile_async *wsa )
 {
-    /* send any incomplete writes from a previous iteration */
-    if (wsa->write.first_iovec < wsa->write.n_iovecs)
-        return STATUS_PENDING;
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+    size_t count = TRANSMITFILE_SENDFILE_CHUNK;
+    NTSTATUS status;
+    off_t offset;
+    ssize_t n;
+    int file_fd, err;
+
+    if ((status = wine_server_handle_to_fd( wsa->file, FILE_READ_DATA, &file_fd, NULL )))
+        return status;
+
+    /* when the size of the transfer is limited ensure that we don't go past that limit */
+    if (wsa->file_bytes != 0)
+        count = min( count, wsa->file_bytes - wsa->file_read );
+    if (wsa->offset.QuadPart == FILE_USE_FILE_POINTER_POSITION)
+        n = sendfile( fd, file_fd, NULL, count );
+    else
+    {
+        offset = wsa->offset.QuadPart;
+        n = sendfile( fd, file_fd, &offset, count );
+    }
+    err = errno;
+    wine_server_release_fd( wsa->file, file_fd );
+
+    if (n < 0)
+    {
+        if (err == EAGAIN) return STATUS_PENDING;
+        /* not supported for this file or socket, fall back to reading the file */
+        if (err == EINVAL || err == ENOSYS) return STATUS_NOT_SUPPORTED;
+        errno = err;
+        return wsaErrStatus();
+    }
+    if (!n) return STATUS_END_OF_FILE;
+
+    if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+        wsa->offset.QuadPart += n;
+    wsa->file_read += n;
+    if (iosb) iosb->Information += n;
+    if (wsa->file_bytes != 0 && wsa->file_read >= wsa->file_bytes)
+        wsa->file = NULL;
+    return STATUS_PENDING;
+}
+
+#endif  /* USE_SENDFILE */
+
+/***********************************************************************
+ *     WS2_transmitfile_getbuffer       (INTERNAL)
+ *
+ * Pick the appropriate buffer for a TransmitFile send operation.
+ */
+static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_async *wsa )
+{
+    /* send any incomplete writes from a previous iteration */
+    if (wsa->write.first_iovec < wsa->write.n_iovecs)
+        return STATUS_PENDING;
 
     /* process the header (if applicable) */
     if (wsa->buffers.Head)
@@ -3011,6 +3686,19 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
     }
 
     /* process the main file */
+#ifdef USE_SENDFILE
+    if (wsa->file && wsa->use_sendfile)
+    {
+        NTSTATUS status = WS2_transmitfile_sendfile( fd, wsa );
+
+        if (status == STATUS_END_OF_FILE)
+            wsa->file = NULL; /* continue on to the footer */
+        else if (status == STATUS_NOT_SUPPORTED)
+            wsa->use_sendfile = FALSE;
+        else
+            return status;
+    }
+#endif
     if (wsa->file)
     {
         DWORD bytes_per_send = wsa->bytes_per_send;
@@ -3070,7 +3758,7 @@ static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *ws
     NTSTATUS status;
 
     status = WS2_transmitfile_getbuffer( fd, wsa );
-    if (status == STATUS_PENDING)
+    if (status == STATUS_PENDING && wsa->write.first_iovec < wsa->write.n_iovecs)
     {
         IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
         int n;
@@ -3104,119 +3792,1158 @@ static NTSTATUS WS2_async_transmitfile( void *user, IO_STATUS_BLOCK *iosb, NTSTA
             status = WS2_transmitfile_base( fd, wsa );
             wine_server_release_fd( wsa->write.hSocket, fd );
         }
-        if (status == STATUS_PENDING)
-            return status;
+        if (status == STATUS_PENDING)
+            return status;
+    }
+
+    iosb->u.Status = status;
+    release_async_io( &wsa->io );
+    return status;
+}
+
+/***********************************************************************
+ *     TransmitFile
+ */
+static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD bytes_per_send,
+                                     LPOVERLAPPED overlapped, LPTRANSMIT_FILE_BUFFERS buffers,
+                                     DWORD flags )
+{
+    union generic_unix_sockaddr uaddr;
+    socklen_t uaddrlen = sizeof(uaddr);
+    struct ws2_transmitfile_async *wsa;
+    NTSTATUS status;
+    int fd;
+
+    TRACE("(%lx, %p, %d, %d, %p, %p, %d)\n", s, h, file_bytes, bytes_per_send, overlapped,
+            buffers, flags );
+
+    fd = get_sock_fd( s, FILE_WRITE_DATA, NULL );
+    if (fd == -1)
+    {
+        WSASetLastError( WSAENOTSOCK );
+        return FALSE;
+    }
+    if (getpeername( fd, &uaddr.addr, &uaddrlen ) != 0)
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAENOTCONN );
+        return FALSE;
+    }
+    if (flags)
+        FIXME("Flags are not currently supported (0x%x).\n", flags);
+
+    if (h && GetFileType( h ) != FILE_TYPE_DISK)
+    {
+        FIXME("Non-disk file handles are not currently supported.\n");
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEOPNOTSUPP );
+        return FALSE;
+    }
+
+    /* set reasonable defaults when requested */
+    if (!bytes_per_send)
+        bytes_per_send = (1 << 16); /* Depends on OS version: PAGE_SIZE, 2*PAGE_SIZE, or 2^16 */
+
+    if (!(wsa = (struct ws2_transmitfile_async *)alloc_async_io( sizeof(*wsa) + bytes_per_send,
+                                                                 WS2_async_transmitfile )))
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEFAULT );
+        return FALSE;
+    }
+    if (buffers)
+        wsa->buffers = *buffers;
+    else
+        memset(&wsa->buffers, 0x0, sizeof(wsa->buffers));
+    wsa->buffer                = (char *)(wsa + 1);
+    wsa->file                  = h;
+    wsa->file_read             = 0;
+    wsa->file_bytes            = file_bytes;
+    wsa->bytes_per_send        = bytes_per_send;
+    wsa->use_sendfile          = FALSE;
+    wsa->flags                 = flags;
+    wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
+    wsa->write.hSocket         = SOCKET2HANDLE(s);
+    wsa->write.addr            = NULL;
+    wsa->write.addrlen.val     = 0;
+    wsa->write.flags           = 0;
+    wsa->write.lpFlags         = &wsa->flags;
+    wsa->write.control         = NULL;
+    wsa->write.n_iovecs        = 0;
+    wsa->write.first_iovec     = 0;
+    wsa->write.user_overlapped = overlapped;
+#ifdef USE_SENDFILE
+    if (h)
+    {
+        struct stat st;
+        int file_fd;
+
+        /* regular files are sent directly from the page cache */
+        if (!wine_server_handle_to_fd( h, FILE_READ_DATA, &file_fd, NULL ))
+        {
+            wsa->use_sendfile = !fstat( file_fd, &st ) && S_ISREG( st.st_mode );
+            wine_server_release_fd( h, file_fd );
+        }
+    }
+#endif
+    if (overlapped)
+    {
+        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
+        int status;
+
+        wsa->offset.u.LowPart  = overlapped->u.s.Offset;
+        wsa->offset.u.HighPart = overlapped->u.s.OffsetHigh;
+        iosb->u.Status = STATUS_PENDING;
+        iosb->Information = 0;
+        status = register_async( ASYNC_TYPE_WRITE, SOCKET2HANDLE(s), &wsa->io,
+                                 overlapped->hEvent, NULL, NULL, iosb );
+        if(status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
+        release_sock_fd( s, fd );
+        WSASetLastError( NtStatusToWSAError(status) );
+        return FALSE;
+    }
+
+    do
+    {
+        status = WS2_transmitfile_base( fd, wsa );
+        if (status == STATUS_PENDING)
+        {
+            /* block here */
+            do_block(fd, POLLOUT, -1);
+            _sync_sock_state(s); /* let wineserver notice connection */
+        }
+    }
+    while (status == STATUS_PENDING);
+    release_sock_fd( s, fd );
+
+    if (status != STATUS_SUCCESS)
+        WSASetLastError( NtStatusToWSAError(status) );
+    HeapFree( GetProcessHeap(), 0, wsa );
+    return (status == STATUS_SUCCESS);
+}
+
+/***********************************************************************
+ *     Registered I/O
+ *
+ * Requests are queued in user space and issued with non-blocking
+ * recvmmsg/sendmmsg calls batching all the committed requests of a queue.
+ * Requests that cannot complete immediately are retried by a worker thread
+ * polling the sockets of the request queues.
+ */
+
+#define RIO_BATCH_SIZE 64
+
+#if !defined(HAVE_RECVMMSG) && !defined(HAVE_SENDMMSG)
+struct mmsghdr
+{
+    struct msghdr msg_hdr;
+    unsigned int  msg_len;
+};
+#endif
+
+struct rio_buffer
+{
+    char  *data;
+    DWORD  length;
+};
+
+struct rio_cq
+{
+    CRITICAL_SECTION            cs;
+    RIO_NOTIFICATION_COMPLETION notification;
+    BOOL                        has_notification;
+    BOOL                        notify_armed;
+    ULONG                       size;      /* size of the results ring */
+    ULONG                       reserved;  /* maximum number of outstanding requests of the queues using it */
+    ULONG                       head;
+    ULONG                       count;
+    RIORESULT                  *results;
+};
+
+struct rio_request
+{
+    RIO_BUF  buf;
+    RIO_BUF  addr;     /* remote address, BufferId is NULL if not specified */
+    char    *data;     /* memory of the buffer slices, resolved when queued */
+    char    *addr_data;
+    ULONG    done;     /* bytes already sent */
+    DWORD    flags;
+    PVOID    context;
+};
+
+struct rio_request_ring
+{
+    struct rio_request *requests;
+    ULONG               size;
+    ULONG               head;
+    ULONG               count;
+    ULONG               committed;  /* number of requests that can be issued */
+};
+
+struct rio_rq
+{
+    struct list              entry;
+    LONG                     refcount;
+    CRITICAL_SECTION         cs;
+    CONDITION_VARIABLE       idle;         /* signaled when the requests are no longer being issued */
+    BOOL                     busy;         /* requests are being issued, with cs released */
+    BOOL                     closed;       /* the socket has been closed */
+    SOCKET                   socket;
+    BOOL                     stream;
+    short                    poll_events;  /* events polled by the worker thread */
+    struct rio_cq           *recv_cq;
+    struct rio_cq           *send_cq;
+    PVOID                    context;
+    struct rio_request_ring  recvs;
+    struct rio_request_ring  sends;
+};
+
+/* notifications to send once the queue locks have been released */
+struct rio_notifications
+{
+    unsigned int                count;
+    struct rio_cq              *cqs[2];
+    RIO_NOTIFICATION_COMPLETION notifications[2];
+};
+
+/* rio_cs protects the list of queues, the registered buffers, the worker thread and the
+ * completion queue reservations; it is taken before the locks of the queues */
+static struct list rio_queues = LIST_INIT( rio_queues );
+static struct rio_buffer *rio_buffers;  /* registered buffers, the buffer id is the index + 1 */
+static ULONG rio_buffers_size;
+static int rio_wake_pipe[2] = { -1, -1 };
+static HANDLE rio_thread;
+
+static CRITICAL_SECTION rio_cs;
+static CRITICAL_SECTION_DEBUG rio_cs_debug =
+{
+    0, 0, &rio_cs,
+    { &rio_cs_debug.ProcessLocksList, &rio_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": rio_cs") }
+};
+static CRITICAL_SECTION rio_cs = { &rio_cs_debug, -1, 0, 0, 0, 0 };
+
+static inline struct rio_request *rio_ring_entry( struct rio_request_ring *ring, ULONG index )
+{
+    return &ring->requests[(ring->head + index) % ring->size];
+}
+
+static inline struct rio_request *rio_alloc_ring( ULONG size )
+{
+    return heap_alloc( max( size, 1 ) * sizeof(struct rio_request) );
+}
+
+/* move the requests of a ring to a new array allocated with rio_alloc_ring */
+static void rio_set_ring( struct rio_request_ring *ring, struct rio_request *requests, ULONG size )
+{
+    ULONG i;
+
+    for (i = 0; i < ring->count; i++) requests[i] = *rio_ring_entry( ring, i );
+    heap_free( ring->requests );
+    ring->requests = requests;
+    ring->size = max( size, 1 );
+    ring->head = 0;
+}
+
+/* get the memory described by a registered buffer slice, must be called with rio_cs held */
+static char *rio_get_buffer( const RIO_BUF *buf )
+{
+    ULONG_PTR id = (ULONG_PTR)buf->BufferId;
+    struct rio_buffer *buffer;
+
+    if (!id || id > rio_buffers_size) return NULL;
+    buffer = &rio_buffers[id - 1];
+    if (!buffer->data) return NULL;
+    if (buf->Offset > buffer->length || buf->Length > buffer->length - buf->Offset) return NULL;
+    return buffer->data + buf->Offset;
+}
+
+/* disarm the notification of a completion queue, must be called with the queue lock held */
+static void rio_notify( struct rio_cq *cq, struct rio_notifications *notify )
+{
+    unsigned int i;
+
+    if (!cq->notify_armed || !cq->count) return;
+
+    cq->notify_armed = FALSE;
+    for (i = 0; i < notify->count; i++) if (notify->cqs[i] == cq) return;
+    notify->cqs[notify->count] = cq;
+    notify->notifications[notify->count++] = cq->notification;
+}
+
+/* send the notifications of the completion queues, must be called without any queue lock held */
+static void rio_send_notifications( const struct rio_notifications *notify )
+{
+    const RIO_NOTIFICATION_COMPLETION *notification;
+    unsigned int i;
+
+    for (i = 0; i < notify->count; i++)
+    {
+        notification = &notify->notifications[i];
+        if (notification->Type == RIO_EVENT_COMPLETION)
+            SetEvent( notification->u.Event.EventHandle );
+        else
+            PostQueuedCompletionStatus( notification->u.Iocp.IocpHandle, 0,
+                                        (ULONG_PTR)notification->u.Iocp.CompletionKey,
+                                        notification->u.Iocp.Overlapped );
+    }
+}
+
+/* remove the first request of a ring and report its result, must be called with rq->cs held */
+static void rio_complete_request( struct rio_rq *rq, struct rio_request_ring *ring, struct rio_cq *cq,
+                                  LONG status, ULONG bytes, struct rio_notifications *notify )
+{
+    struct rio_request *req = rio_ring_entry( ring, 0 );
+    RIORESULT *result;
+
+    ring->head = (ring->head + 1) % ring->size;
+    ring->count--;
+    if (ring->committed) ring->committed--;
+    if (!cq) return;
+
+    EnterCriticalSection( &cq->cs );
+    /* the queue reservation guarantees that there is room for the result */
+    result = &cq->results[(cq->head + cq->count++) % cq->size];
+    result->Status           = status;
+    result->BytesTransferred = bytes;
+    result->SocketContext    = (ULONG_PTR)rq->context;
+    result->RequestContext   = (ULONG_PTR)req->context;
+    if (!(req->flags & RIO_MSG_DONT_NOTIFY)) rio_notify( cq, notify );
+    LeaveCriticalSection( &cq->cs );
+}
+
+static int rio_recvmmsg( int fd, struct mmsghdr *msgs, unsigned int count )
+{
+    unsigned int i;
+    ssize_t ret;
+
+#ifdef HAVE_RECVMMSG
+    if ((ret = recvmmsg( fd, msgs, count, 0, NULL )) != -1 || errno != EFAULT) return ret;
+#endif
+    /* recvmmsg fails on write watched buffers, ntdll knows how to receive into them */
+    for (i = 0; i < count; i++)
+    {
+        if ((ret = __wine_locked_recvmsg( fd, &msgs[i].msg_hdr, 0 )) < 0) return i ? i : -1;
+        msgs[i].msg_len = ret;
+    }
+    return count;
+}
+
+static int rio_sendmmsg( int fd, struct mmsghdr *msgs, unsigned int count )
+{
+#ifdef HAVE_SENDMMSG
+    return sendmmsg( fd, msgs, count, 0 );
+#else
+    unsigned int i;
+    ssize_t ret;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((ret = sendmsg( fd, &msgs[i].msg_hdr, 0 )) < 0) return i ? i : -1;
+        msgs[i].msg_len = ret;
+    }
+    return count;
+#endif
+}
+
+/* issue the committed receives, must be called with rq->cs held, which is released during the calls */
+static void rio_receive( struct rio_rq *rq, int fd, struct rio_notifications *notify )
+{
+    struct rio_request_ring *ring = &rq->recvs;
+    union generic_unix_sockaddr addrs[RIO_BATCH_SIZE];
+    struct mmsghdr msgs[RIO_BATCH_SIZE];
+    struct iovec iov[RIO_BATCH_SIZE];
+    char *addr_data[RIO_BATCH_SIZE];
+    int addr_len[RIO_BATCH_SIZE];
+    LONG status[RIO_BATCH_SIZE];
+    unsigned int i, count;
+    int ret, err;
+
+    while (ring->committed)
+    {
+        count = min( ring->committed, RIO_BATCH_SIZE );
+        for (i = 0; i < count; i++)
+        {
+            struct rio_request *req = rio_ring_entry( ring, i );
+
+            memset( &msgs[i], 0, sizeof(msgs[i]) );
+            iov[i].iov_base = req->data;
+            iov[i].iov_len  = req->buf.Length;
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            addr_data[i] = req->addr_data;
+            addr_len[i]  = req->addr.Length;
+            if (addr_data[i])
+            {
+                msgs[i].msg_hdr.msg_name    = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            }
+        }
+
+        LeaveCriticalSection( &rq->cs );
+        ret = rio_recvmmsg( fd, msgs, count );
+        err = errno;
+        for (i = 0; (int)i < ret; i++)
+        {
+            status[i] = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? WSAEMSGSIZE : 0;
+            if (addr_data[i] && ws_sockaddr_u2ws( &addrs[i].addr, (struct WS_sockaddr *)addr_data[i], &addr_len[i] ))
+                status[i] = WSAEFAULT;
+        }
+        EnterCriticalSection( &rq->cs );
+
+        if (ret < 0)
+        {
+            if (err == EAGAIN || err == EINTR) break;
+            errno = err;
+            rio_complete_request( rq, ring, rq->recv_cq, wsaErrno(), 0, notify );
+            continue;
+        }
+
+        for (i = 0; i < ret; i++)
+            rio_complete_request( rq, ring, rq->recv_cq, status[i], msgs[i].msg_len, notify );
+        if (ret < count) break;
+    }
+}
+
+/* issue the committed sends, must be called with rq->cs held, which is released during the calls */
+static void rio_send( struct rio_rq *rq, int fd, struct rio_notifications *notify )
+{
+    struct rio_request_ring *ring = &rq->sends;
+    union generic_unix_sockaddr addrs[RIO_BATCH_SIZE];
+    struct mmsghdr msgs[RIO_BATCH_SIZE];
+    struct iovec iov[RIO_BATCH_SIZE];
+    unsigned int i, count;
+    int ret, err;
+
+    while (ring->committed)
+    {
+        /* a partial send on a stream socket must not be followed by the next request */
+        count = rq->stream ? 1 : min( ring->committed, RIO_BATCH_SIZE );
+        for (i = 0; i < count; i++)
+        {
+            struct rio_request *req = rio_ring_entry( ring, i );
+
+            memset( &msgs[i], 0, sizeof(msgs[i]) );
+            iov[i].iov_base = req->data + req->done;
+            iov[i].iov_len  = req->buf.Length - req->done;
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (req->addr_data)
+            {
+                msgs[i].msg_hdr.msg_name    = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = ws_sockaddr_ws2u( (struct WS_sockaddr *)req->addr_data,
+                                                                req->addr.Length, &addrs[i] );
+            }
+        }
+
+        LeaveCriticalSection( &rq->cs );
+        ret = rio_sendmmsg( fd, msgs, count );
+        err = errno;
+        EnterCriticalSection( &rq->cs );
+
+        if (ret < 0)
+        {
+            if (err == EAGAIN || err == EINTR) break;
+            errno = err;
+            rio_complete_request( rq, ring, rq->send_cq, wsaErrno(), 0, notify );
+            continue;
+        }
+
+        for (i = 0; i < ret; i++)
+        {
+            struct rio_request *req = rio_ring_entry( ring, 0 );
+
+            req->done += msgs[i].msg_len;
+            if (req->done < req->buf.Length) break;
+            rio_complete_request( rq, ring, rq->send_cq, 0, req->done, notify );
+        }
+        if (i < ret || ret < count) break;
+    }
+}
+
+/* issue the committed requests of a queue, must be called with rq->cs held */
+static void rio_process_queue( struct rio_rq *rq, struct rio_notifications *notify )
+{
+    int fd;
+
+    /* requests committed while another thread issues them are left to the worker thread */
+    if (rq->busy || rq->closed) return;
+    if (!rq->recvs.committed && !rq->sends.committed) return;
+
+    rq->busy = TRUE;
+    if ((fd = get_sock_fd( rq->socket, 0, NULL )) == -1)
+    {
+        while (rq->recvs.committed) rio_complete_request( rq, &rq->recvs, rq->recv_cq, WSAENOTSOCK, 0, notify );
+        while (rq->sends.committed) rio_complete_request( rq, &rq->sends, rq->send_cq, WSAENOTSOCK, 0, notify );
+    }
+    else
+    {
+        if (rq->recvs.committed) rio_receive( rq, fd, notify );
+        if (rq->sends.committed) rio_send( rq, fd, notify );
+        release_sock_fd( rq->socket, fd );
+    }
+    rq->busy = FALSE;
+    WakeAllConditionVariable( &rq->idle );
+}
+
+static void rio_release_queue( struct rio_rq *rq )
+{
+    if (InterlockedDecrement( &rq->refcount )) return;
+
+    rq->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &rq->cs );
+    heap_free( rq->recvs.requests );
+    heap_free( rq->sends.requests );
+    heap_free( rq );
+}
+
+static DWORD WINAPI rio_thread_proc( void *arg )
+{
+    int wake_fd = PtrToLong( arg );
+    struct rio_notifications notify;
+    struct pollfd *fds = NULL;
+    struct rio_rq **queues = NULL;
+    unsigned int i, count, size = 0;
+    struct rio_rq *rq;
+    HMODULE module;
+    char buffer[64];
+    BOOL stop = FALSE;
+    int ret;
+
+    while (!stop)
+    {
+        EnterCriticalSection( &rio_cs );
+
+        count = list_count( &rio_queues ) + 1;
+        if (count > size)
+        {
+            struct pollfd *new_fds;
+            struct rio_rq **new_queues;
+
+            if ((new_fds = heap_realloc( fds, count * sizeof(*fds) ))) fds = new_fds;
+            if ((new_queues = heap_realloc( queues, count * sizeof(*queues) ))) queues = new_queues;
+            if (new_fds && new_queues) size = count;
+        }
+        if (!size)
+        {
+            LeaveCriticalSection( &rio_cs );
+            Sleep( 10 );
+            continue;
+        }
+
+        fds[0].fd = wake_fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        count = 1;
+        LIST_FOR_EACH_ENTRY( rq, &rio_queues, struct rio_rq, entry )
+        {
+            short events;
+            int fd;
+
+            EnterCriticalSection( &rq->cs );
+            events = (rq->recvs.committed ? POLLIN : 0) | (rq->sends.committed ? POLLOUT : 0);
+            rq->poll_events = 0;
+            if (events && count < size &&
+                /* socket fds are cached by ntdll, so the fd stays valid until the socket is closed */
+                (fd = get_sock_fd( rq->socket, 0, NULL )) != -1)
+            {
+                release_sock_fd( rq->socket, fd );
+                rq->poll_events = events;
+                fds[count].fd = fd;
+                fds[count].events = events;
+                fds[count].revents = 0;
+                /* the queues may be freed by closesocket while the thread polls them */
+                InterlockedIncrement( &rq->refcount );
+                queues[count++] = rq;
+            }
+            LeaveCriticalSection( &rq->cs );
+        }
+
+        LeaveCriticalSection( &rio_cs );
+
+        if (poll( fds, count, -1 ) > 0 && fds[0].revents)
+        {
+            while ((ret = read( wake_fd, buffer, sizeof(buffer) )) > 0) /* nothing */;
+            if (!ret) stop = TRUE;  /* the worker is being stopped */
+        }
+
+        for (i = 1; i < count; i++)
+        {
+            if (!stop && fds[i].revents)
+            {
+                notify.count = 0;
+                EnterCriticalSection( &queues[i]->cs );
+                rio_process_queue( queues[i], &notify );
+                LeaveCriticalSection( &queues[i]->cs );
+                rio_send_notifications( &notify );
+            }
+            rio_release_queue( queues[i] );
+        }
+    }
+
+    TRACE( "exiting\n" );
+    close( wake_fd );
+    heap_free( fds );
+    heap_free( queues );
+    /* the thread holds a reference on the module, see rio_start_worker */
+    GetModuleHandleExW( GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                        (const WCHAR *)rio_thread_proc, &module );
+    FreeLibraryAndExitThread( module, 0 );
+}
+
+/* start the worker thread, must be called with rio_cs held */
+static BOOL rio_start_worker(void)
+{
+    HMODULE module;
+
+    if (rio_thread) return TRUE;
+
+    if (pipe( rio_wake_pipe ) == -1) return FALSE;
+    fcntl( rio_wake_pipe[0], F_SETFL, O_NONBLOCK );
+    fcntl( rio_wake_pipe[1], F_SETFL, O_NONBLOCK );
+    fcntl( rio_wake_pipe[0], F_SETFD, FD_CLOEXEC );
+    fcntl( rio_wake_pipe[1], F_SETFD, FD_CLOEXEC );
+    /* keep the module loaded until the thread has exited */
+    if (!GetModuleHandleExW( GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (const WCHAR *)rio_thread_proc, &module ))
+        module = NULL;
+    if (!module || !(rio_thread = CreateThread( NULL, 0, rio_thread_proc,
+                                                LongToPtr( rio_wake_pipe[0] ), 0, NULL )))
+    {
+        if (module) FreeLibrary( module );
+        close( rio_wake_pipe[0] );
+        close( rio_wake_pipe[1] );
+        rio_wake_pipe[0] = rio_wake_pipe[1] = -1;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* stop the worker thread, it exits once it notices that the pipe has been closed */
+static void rio_stop_worker(void)
+{
+    EnterCriticalSection( &rio_cs );
+    if (rio_thread)
+    {
+        close( rio_wake_pipe[1] );
+        rio_wake_pipe[0] = rio_wake_pipe[1] = -1;
+        CloseHandle( rio_thread );
+        rio_thread = NULL;
+    }
+    LeaveCriticalSection( &rio_cs );
+}
+
+static void rio_free_buffers(void)
+{
+    heap_free( rio_buffers );
+    rio_buffers = NULL;
+    rio_buffers_size = 0;
+}
+
+/* check whether the worker thread polls for the requests of a queue, must be called with rq->cs held */
+static BOOL rio_need_wake_worker( struct rio_rq *rq )
+{
+    short events = (rq->recvs.committed ? POLLIN : 0) | (rq->sends.committed ? POLLOUT : 0);
+
+    if (!(events & ~rq->poll_events)) return FALSE;
+    rq->poll_events |= events;
+    return TRUE;
+}
+
+/* wake up the worker thread so that it polls for the new requests */
+static void rio_wake_worker(void)
+{
+    char dummy = 0;
+    int ret;
+
+    EnterCriticalSection( &rio_cs );
+    if (rio_start_worker())
+    {
+        while ((ret = write( rio_wake_pipe[1], &dummy, 1 )) == -1 && errno == EINTR) /* nothing */;
+        /* a full pipe already wakes up the worker */
+        if (ret == -1 && errno != EAGAIN) WARN( "failed to wake up the worker: %s\n", strerror( errno ) );
+    }
+    LeaveCriticalSection( &rio_cs );
+}
+
+/* abort the requests and free the request queues of a socket being closed */
+static void rio_close_socket( SOCKET s )
+{
+    struct rio_notifications notify;
+    struct rio_rq *rq;
+
+    if (list_empty( &rio_queues )) return;
+
+    for (;;)
+    {
+        EnterCriticalSection( &rio_cs );
+        LIST_FOR_EACH_ENTRY( rq, &rio_queues, struct rio_rq, entry )
+            if (rq->socket == s) break;
+        if (&rq->entry == &rio_queues)
+        {
+            LeaveCriticalSection( &rio_cs );
+            break;
+        }
+
+        notify.count = 0;
+        EnterCriticalSection( &rq->cs );
+        while (rq->busy) SleepConditionVariableCS( &rq->idle, &rq->cs, INFINITE );
+        rq->closed = TRUE;
+        while (rq->recvs.count) rio_complete_request( rq, &rq->recvs, rq->recv_cq, WSA_OPERATION_ABORTED, 0, &notify );
+        while (rq->sends.count) rio_complete_request( rq, &rq->sends, rq->send_cq, WSA_OPERATION_ABORTED, 0, &notify );
+        if (rq->recv_cq) rq->recv_cq->reserved -= rq->recvs.size;
+        if (rq->send_cq) rq->send_cq->reserved -= rq->sends.size;
+        rq->recv_cq = rq->send_cq = NULL;
+        LeaveCriticalSection( &rq->cs );
+        list_remove( &rq->entry );
+        LeaveCriticalSection( &rio_cs );
+
+        rio_send_notifications( &notify );
+        rio_release_queue( rq );
+    }
+}
+
+/* queue a request in a ring and issue the committed requests */
+static BOOL rio_queue_request( struct rio_rq *rq, struct rio_request_ring *ring, const RIO_BUF *buf,
+                               ULONG count, const RIO_BUF *addr, DWORD flags, PVOID context )
+{
+    struct rio_notifications notify;
+    struct rio_request *req;
+    char *data = NULL, *addr_data = NULL;
+    BOOL wake = FALSE;
+    DWORD error = 0;
+
+    if (!rq || (flags & ~(RIO_MSG_DONT_NOTIFY | RIO_MSG_DEFER | RIO_MSG_WAITALL | RIO_MSG_COMMIT_ONLY)))
+    {
+        WSASetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & RIO_MSG_WAITALL) FIXME( "RIO_MSG_WAITALL not supported\n" );
+
+    if (!(flags & RIO_MSG_COMMIT_ONLY))
+    {
+        EnterCriticalSection( &rio_cs );
+        if (count != 1 || !buf || !(data = rio_get_buffer( buf )) || (addr && !(addr_data = rio_get_buffer( addr ))))
+            error = WSAEINVAL;
+        LeaveCriticalSection( &rio_cs );
+    }
+
+    notify.count = 0;
+    EnterCriticalSection( &rq->cs );
+    if (!error && !(flags & RIO_MSG_COMMIT_ONLY))
+    {
+        if (ring->count == ring->size)
+            error = WSAENOBUFS;
+        else
+        {
+            req = rio_ring_entry( ring, ring->count++ );
+            req->buf       = *buf;
+            req->data      = data;
+            req->addr_data = addr_data;
+            req->done      = 0;
+            req->flags     = flags;
+            req->context   = context;
+            if (addr) req->addr = *addr;
+            else memset( &req->addr, 0, sizeof(req->addr) );
+        }
+    }
+    if (!error && !(flags & RIO_MSG_DEFER))
+    {
+        rq->recvs.committed = rq->recvs.count;
+        rq->sends.committed = rq->sends.count;
+        rio_process_queue( rq, &notify );
+        wake = rio_need_wake_worker( rq );
+    }
+    LeaveCriticalSection( &rq->cs );
+
+    rio_send_notifications( &notify );
+    if (wake) rio_wake_worker();
+    if (error) WSASetLastError( error );
+    return !error;
+}
+
+/***********************************************************************
+ *     RIORegisterBuffer
+ */
+static RIO_BUFFERID WINAPI WS2_RIORegisterBuffer( PCHAR data, DWORD length )
+{
+    struct rio_buffer *buffers;
+    ULONG i, size;
+
+    TRACE( "(%p, %u)\n", data, length );
+
+    if (!data)
+    {
+        WSASetLastError( WSAEINVAL );
+        return RIO_INVALID_BUFFERID;
+    }
+
+    EnterCriticalSection( &rio_cs );
+    for (i = 0; i < rio_buffers_size; i++) if (!rio_buffers[i].data) break;
+    if (i == rio_buffers_size)
+    {
+        size = max( rio_buffers_size * 2, 16 );
+        if (!(buffers = heap_realloc( rio_buffers, size * sizeof(*buffers) )))
+        {
+            LeaveCriticalSection( &rio_cs );
+            WSASetLastError( WSAENOBUFS );
+            return RIO_INVALID_BUFFERID;
+        }
+        memset( buffers + rio_buffers_size, 0, (size - rio_buffers_size) * sizeof(*buffers) );
+        rio_buffers = buffers;
+        rio_buffers_size = size;
+    }
+    rio_buffers[i].data   = data;
+    rio_buffers[i].length = length;
+    LeaveCriticalSection( &rio_cs );
+
+    return (RIO_BUFFERID)(ULONG_PTR)(i + 1);
+}
+
+/***********************************************************************
+ *     RIODeregisterBuffer
+ */
+static void WINAPI WS2_RIODeregisterBuffer( RIO_BUFFERID id )
+{
+    ULONG_PTR index = (ULONG_PTR)id;
+
+    TRACE( "(%p)\n", id );
+
+    EnterCriticalSection( &rio_cs );
+    if (index && index <= rio_buffers_size) rio_buffers[index - 1].data = NULL;
+    LeaveCriticalSection( &rio_cs );
+}
+
+/***********************************************************************
+ *     RIOCreateCompletionQueue
+ */
+static RIO_CQ WINAPI WS2_RIOCreateCompletionQueue( DWORD size, PRIO_NOTIFICATION_COMPLETION notification )
+{
+    struct rio_cq *cq;
+
+    TRACE( "(%u, %p)\n", size, notification );
+
+    if (!size || size > RIO_MAX_CQ_SIZE ||
+        (notification && (notification->Type == RIO_EVENT_COMPLETION ? !notification->u.Event.EventHandle :
+                          notification->Type == RIO_IOCP_COMPLETION ? !notification->u.Iocp.IocpHandle : TRUE)))
+    {
+        WSASetLastError( WSAEINVAL );
+        return RIO_INVALID_CQ;
+    }
+    if (!(cq = heap_alloc_zero( sizeof(*cq) )) || !(cq->results = heap_alloc( size * sizeof(*cq->results) )))
+    {
+        heap_free( cq );
+        WSASetLastError( WSAENOBUFS );
+        return RIO_INVALID_CQ;
+    }
+    InitializeCriticalSection( &cq->cs );
+    cq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": rio_cq.cs");
+    cq->size = size;
+    if (notification)
+    {
+        cq->notification = *notification;
+        cq->has_notification = TRUE;
+    }
+    return (RIO_CQ)cq;
+}
+
+/***********************************************************************
+ *     RIOResizeCompletionQueue
+ */
+static BOOL WINAPI WS2_RIOResizeCompletionQueue( RIO_CQ handle, DWORD size )
+{
+    struct rio_cq *cq = (struct rio_cq *)handle;
+    RIORESULT *results;
+    DWORD error = 0;
+    ULONG i;
+
+    TRACE( "(%p, %u)\n", handle, size );
+
+    if (!cq || !size || size > RIO_MAX_CQ_SIZE)
+    {
+        WSASetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    EnterCriticalSection( &rio_cs );
+    EnterCriticalSection( &cq->cs );
+    if (size < cq->reserved || size < cq->count)
+        error = WSAEINVAL;
+    else if (!(results = heap_alloc( size * sizeof(*results) )))
+        error = WSAENOBUFS;
+    else
+    {
+        for (i = 0; i < cq->count; i++) results[i] = cq->results[(cq->head + i) % cq->size];
+        heap_free( cq->results );
+        cq->results = results;
+        cq->size = size;
+        cq->head = 0;
+    }
+    LeaveCriticalSection( &cq->cs );
+    LeaveCriticalSection( &rio_cs );
+
+    if (error) WSASetLastError( error );
+    return !error;
+}
+
+/***********************************************************************
+ *     RIOCloseCompletionQueue
+ */
+static void WINAPI WS2_RIOCloseCompletionQueue( RIO_CQ handle )
+{
+    struct rio_cq *cq = (struct rio_cq *)handle;
+    struct rio_rq *rq;
+
+    TRACE( "(%p)\n", handle );
+
+    if (!cq) return;
+
+    EnterCriticalSection( &rio_cs );
+    LIST_FOR_EACH_ENTRY( rq, &rio_queues, struct rio_rq, entry )
+    {
+        EnterCriticalSection( &rq->cs );
+        if (rq->recv_cq == cq) rq->recv_cq = NULL;
+        if (rq->send_cq == cq) rq->send_cq = NULL;
+        LeaveCriticalSection( &rq->cs );
+    }
+    LeaveCriticalSection( &rio_cs );
+
+    cq->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &cq->cs );
+    heap_free( cq->results );
+    heap_free( cq );
+}
+
+/***********************************************************************
+ *     RIONotify
+ */
+static INT WINAPI WS2_RIONotify( RIO_CQ handle )
+{
+    struct rio_cq *cq = (struct rio_cq *)handle;
+    struct rio_notifications notify;
+    INT ret = 0;
+
+    TRACE( "(%p)\n", handle );
+
+    if (!cq) return WSAEINVAL;
+
+    EnterCriticalSection( &cq->cs );
+    if (!cq->has_notification)
+        ret = WSAEINVAL;
+    else if (cq->notify_armed)
+        ret = WSAEALREADY;
+    LeaveCriticalSection( &cq->cs );
+    if (ret) return ret;
+
+    /* the event must be reset before the notification can be sent again */
+    if (cq->notification.Type == RIO_EVENT_COMPLETION && cq->notification.u.Event.NotifyReset)
+        ResetEvent( cq->notification.u.Event.EventHandle );
+
+    notify.count = 0;
+    EnterCriticalSection( &cq->cs );
+    if (cq->notify_armed)
+        ret = WSAEALREADY;
+    else
+    {
+        cq->notify_armed = TRUE;
+        rio_notify( cq, &notify );
+    }
+    LeaveCriticalSection( &cq->cs );
+
+    rio_send_notifications( &notify );
+    return ret;
+}
+
+/***********************************************************************
+ *     RIODequeueCompletion
+ */
+static ULONG WINAPI WS2_RIODequeueCompletion( RIO_CQ handle, PRIORESULT array, ULONG size )
+{
+    struct rio_cq *cq = (struct rio_cq *)handle;
+    ULONG i, count;
+
+    TRACE( "(%p, %p, %u)\n", handle, array, size );
+
+    if (!cq || !array) return RIO_CORRUPT_CQ;
+
+    EnterCriticalSection( &cq->cs );
+    count = min( size, cq->count );
+    for (i = 0; i < count; i++) array[i] = cq->results[(cq->head + i) % cq->size];
+    cq->head = (cq->head + count) % cq->size;
+    cq->count -= count;
+    LeaveCriticalSection( &cq->cs );
+    return count;
+}
+
+/***********************************************************************
+ *     RIOCreateRequestQueue
+ */
+static RIO_RQ WINAPI WS2_RIOCreateRequestQueue( SOCKET s, ULONG max_recv, ULONG max_recv_buffers,
+                                                ULONG max_send, ULONG max_send_buffers,
+                                                RIO_CQ recv_handle, RIO_CQ send_handle, PVOID context )
+{
+    struct rio_cq *recv_cq = (struct rio_cq *)recv_handle, *send_cq = (struct rio_cq *)send_handle;
+    struct rio_rq *rq = NULL;
+    DWORD error = 0;
+    int fd;
+
+    TRACE( "(%lx, %u, %u, %u, %u, %p, %p, %p)\n", s, max_recv, max_recv_buffers, max_send,
+           max_send_buffers, recv_handle, send_handle, context );
+
+    if ((fd = get_sock_fd( s, 0, NULL )) == -1) return RIO_INVALID_RQ;
+
+    if (!recv_cq || !send_cq || max_recv_buffers > 1 || max_send_buffers > 1)
+        error = WSAEINVAL;
+    else if (!(rq = heap_alloc_zero( sizeof(*rq) )) ||
+             !(rq->recvs.requests = rio_alloc_ring( max_recv )) ||
+             !(rq->sends.requests = rio_alloc_ring( max_send )))
+        error = WSAENOBUFS;
+    else
+    {
+        EnterCriticalSection( &rio_cs );
+        if (recv_cq->reserved + max_recv + (recv_cq == send_cq ? max_send : 0) > recv_cq->size ||
+            send_cq->reserved + max_send + (recv_cq == send_cq ? max_recv : 0) > send_cq->size)
+            error = WSAENOBUFS;
+        else if (!rio_start_worker())
+            error = WSAENOBUFS;
+        else
+        {
+            InitializeCriticalSection( &rq->cs );
+            rq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": rio_rq.cs");
+            InitializeConditionVariable( &rq->idle );
+            rq->refcount = 1;
+            rq->recvs.size = max( max_recv, 1 );
+            rq->sends.size = max( max_send, 1 );
+            rq->socket  = s;
+            rq->stream  = _get_fd_type( fd ) == SOCK_STREAM;
+            rq->recv_cq = recv_cq;
+            rq->send_cq = send_cq;
+            rq->context = context;
+            recv_cq->reserved += rq->recvs.size;
+            send_cq->reserved += rq->sends.size;
+            list_add_tail( &rio_queues, &rq->entry );
+        }
+        LeaveCriticalSection( &rio_cs );
+    }
+    release_sock_fd( s, fd );
+
+    if (error)
+    {
+        if (rq)
+        {
+            heap_free( rq->recvs.requests );
+            heap_free( rq->sends.requests );
+            heap_free( rq );
+        }
+        WSASetLastError( error );
+        return RIO_INVALID_RQ;
     }
-
-    iosb->u.Status = status;
-    release_async_io( &wsa->io );
-    return status;
+    return (RIO_RQ)rq;
 }
 
 /***********************************************************************
- *     TransmitFile
+ *     RIOResizeRequestQueue
  */
-static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD bytes_per_send,
-                                     LPOVERLAPPED overlapped, LPTRANSMIT_FILE_BUFFERS buffers,
-                                     DWORD flags )
+static BOOL WINAPI WS2_RIOResizeRequestQueue( RIO_RQ handle, DWORD max_recv, DWORD max_send )
 {
-    union generic_unix_sockaddr uaddr;
-    socklen_t uaddrlen = sizeof(uaddr);
-    struct ws2_transmitfile_async *wsa;
-    NTSTATUS status;
-    int fd;
+    struct rio_rq *rq = (struct rio_rq *)handle;
+    struct rio_request *recvs = NULL, *sends = NULL;
+    DWORD error = 0;
 
-    TRACE("(%lx, %p, %d, %d, %p, %p, %d)\n", s, h, file_bytes, bytes_per_send, overlapped,
-            buffers, flags );
+    TRACE( "(%p, %u, %u)\n", handle, max_recv, max_send );
 
-    fd = get_sock_fd( s, FILE_WRITE_DATA, NULL );
-    if (fd == -1)
+    if (!rq)
     {
-        WSASetLastError( WSAENOTSOCK );
+        WSASetLastError( WSAEINVAL );
         return FALSE;
     }
-    if (getpeername( fd, &uaddr.addr, &uaddrlen ) != 0)
+
+    EnterCriticalSection( &rio_cs );
+    EnterCriticalSection( &rq->cs );
+    if (max_recv < rq->recvs.count || max_send < rq->sends.count)
+        error = WSAEINVAL;
+    else if ((rq->recv_cq && rq->recv_cq->reserved - rq->recvs.size + max( max_recv, 1 ) > rq->recv_cq->size) ||
+             (rq->send_cq && rq->send_cq->reserved - rq->sends.size + max( max_send, 1 ) > rq->send_cq->size))
+        error = WSAENOBUFS;
+    /* allocate both rings first, so that the queue is left untouched on failure */
+    else if (!(recvs = rio_alloc_ring( max_recv )) || !(sends = rio_alloc_ring( max_send )))
     {
-        release_sock_fd( s, fd );
-        WSASetLastError( WSAENOTCONN );
-        return FALSE;
+        heap_free( recvs );
+        error = WSAENOBUFS;
     }
-    if (flags)
-        FIXME("Flags are not currently supported (0x%x).\n", flags);
-
-    if (h && GetFileType( h ) != FILE_TYPE_DISK)
+    else
     {
-        FIXME("Non-disk file handles are not currently supported.\n");
-        release_sock_fd( s, fd );
-        WSASetLastError( WSAEOPNOTSUPP );
-        return FALSE;
+        if (rq->recv_cq) rq->recv_cq->reserved -= rq->recvs.size;
+        if (rq->send_cq) rq->send_cq->reserved -= rq->sends.size;
+        rio_set_ring( &rq->recvs, recvs, max_recv );
+        rio_set_ring( &rq->sends, sends, max_send );
+        if (rq->recv_cq) rq->recv_cq->reserved += rq->recvs.size;
+        if (rq->send_cq) rq->send_cq->reserved += rq->sends.size;
     }
+    LeaveCriticalSection( &rq->cs );
+    LeaveCriticalSection( &rio_cs );
 
-    /* set reasonable defaults when requested */
-    if (!bytes_per_send)
-        bytes_per_send = (1 << 16); /* Depends on OS version: PAGE_SIZE, 2*PAGE_SIZE, or 2^16 */
+    if (error) WSASetLastError( error );
+    return !error;
+}
 
-    if (!(wsa = (struct ws2_transmitfile_async *)alloc_async_io( sizeof(*wsa) + bytes_per_send,
-                                                                 WS2_async_transmitfile )))
-    {
-        release_sock_fd( s, fd );
-        WSASetLastError( WSAEFAULT );
-        return FALSE;
-    }
-    if (buffers)
-        wsa->buffers = *buffers;
-    else
-        memset(&wsa->buffers, 0x0, sizeof(wsa->buffers));
-    wsa->buffer                = (char *)(wsa + 1);
-    wsa->file                  = h;
-    wsa->file_read             = 0;
-    wsa->file_bytes            = file_bytes;
-    wsa->bytes_per_send        = bytes_per_send;
-    wsa->flags                 = flags;
-    wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
-    wsa->write.hSocket         = SOCKET2HANDLE(s);
-    wsa->write.addr            = NULL;
-    wsa->write.addrlen.val     = 0;
-    wsa->write.flags           = 0;
-    wsa->write.lpFlags         = &wsa->flags;
-    wsa->write.control         = NULL;
-    wsa->write.n_iovecs        = 0;
-    wsa->write.first_iovec     = 0;
-    wsa->write.user_overlapped = overlapped;
-    if (overlapped)
-    {
-        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
-        int status;
+/***********************************************************************
+ *     RIOReceive
+ */
+static BOOL WINAPI WS2_RIOReceive( RIO_RQ handle, PRIO_BUF buf, ULONG count, DWORD flags, PVOID context )
+{
+    struct rio_rq *rq = (struct rio_rq *)handle;
 
-        wsa->offset.u.LowPart  = overlapped->u.s.Offset;
-        wsa->offset.u.HighPart = overlapped->u.s.OffsetHigh;
-        iosb->u.Status = STATUS_PENDING;
-        iosb->Information = 0;
-        status = register_async( ASYNC_TYPE_WRITE, SOCKET2HANDLE(s), &wsa->io,
-                                 overlapped->hEvent, NULL, NULL, iosb );
-        if(status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
-        release_sock_fd( s, fd );
-        WSASetLastError( NtStatusToWSAError(status) );
-        return FALSE;
-    }
+    TRACE( "(%p, %p, %u, %#x, %p)\n", handle, buf, count, flags, context );
 
-    do
-    {
-        status = WS2_transmitfile_base( fd, wsa );
-        if (status == STATUS_PENDING)
-        {
-            /* block here */
-            do_block(fd, POLLOUT, -1);
-            _sync_sock_state(s); /* let wineserver notice connection */
-        }
-    }
-    while (status == STATUS_PENDING);
-    release_sock_fd( s, fd );
+    return rio_queue_request( rq, rq ? &rq->recvs : NULL, buf, count, NULL, flags, context );
+}
 
-    if (status != STATUS_SUCCESS)
-        WSASetLastError( NtStatusToWSAError(status) );
-    HeapFree( GetProcessHeap(), 0, wsa );
-    return (status == STATUS_SUCCESS);
+/***********************************************************************
+ *     RIOReceiveEx
+ */
+static int WINAPI WS2_RIOReceiveEx( RIO_RQ handle, PRIO_BUF buf, ULONG count, PRIO_BUF local_addr,
+                                    PRIO_BUF remote_addr, PRIO_BUF control, PRIO_BUF flags_buf,
+                                    DWORD flags, PVOID context )
+{
+    struct rio_rq *rq = (struct rio_rq *)handle;
+
+    TRACE( "(%p, %p, %u, %p, %p, %p, %p, %#x, %p)\n", handle, buf, count, local_addr, remote_addr,
+           control, flags_buf, flags, context );
+
+    if (local_addr || control || flags_buf)
+        FIXME( "local address, control and flags buffers not supported\n" );
+
+    return rio_queue_request( rq, rq ? &rq->recvs : NULL, buf, count, remote_addr, flags, context );
+}
+
+/***********************************************************************
+ *     RIOSend
+ */
+static BOOL WINAPI WS2_RIOSend( RIO_RQ handle, PRIO_BUF buf, ULONG count, DWORD flags, PVOID context )
+{
+    struct rio_rq *rq = (struct rio_rq *)handle;
+
+    TRACE( "(%p, %p, %u, %#x, %p)\n", handle, buf, count, flags, context );
+
+    return rio_queue_request( rq, rq ? &rq->sends : NULL, buf, count, NULL, flags, context );
+}
+
+/***********************************************************************
+ *     RIOSendEx
+ */
+static BOOL WINAPI WS2_RIOSendEx( RIO_RQ handle, PRIO_BUF buf, ULONG count, PRIO_BUF local_addr,
+                                  PRIO_BUF remote_addr, PRIO_BUF control, PRIO_BUF flags_buf,
+                                  DWORD flags, PVOID context )
+{
+    struct rio_rq *rq = (struct rio_rq *)handle;
+
+    TRACE( "(%p, %p, %u, %p, %p, %p, %p, %#x, %p)\n", handle, buf, count, local_addr, remote_addr,
+           control, flags_buf, flags, context );
+
+    if (local_addr || control || flags_buf)
+        FIXME( "local address, control and flags buffers not supported\n" );
+
+    return rio_queue_request( rq, rq ? &rq->sends : NULL, buf, count, remote_addr, flags, context );
 }
 
 /***********************************************************************
@@ -3450,6 +5177,9 @@ int WINAPI WS_closesocket(SOCKET s)
         if (fd >= 0)
         {
             release_sock_fd(s, fd);
+            set_socket_shm_index( s, 0, 0 );
+            rio_close_socket( s );
+            dgram_detach_asyncs( SOCKET2HANDLE(s), 0 );
             if (CloseHandle(SOCKET2HANDLE(s)))
                 res = 0;
         }
@@ -4522,6 +6252,7 @@ static const char *debugstr_wsaioctl(DWORD code)
         IOCTL_NAME(WS_SIO_GET_BROADCAST_ADDRESS);
         IOCTL_NAME(WS_SIO_GET_EXTENSION_FUNCTION_POINTER);
         IOCTL_NAME(WS_SIO_GET_GROUP_QOS);
+        IOCTL_NAME(WS_SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER);
         IOCTL_NAME(WS_SIO_GET_INTERFACE_LIST);
         /* IOCTL_NAME(WS_SIO_GET_INTERFACE_LIST_EX); */
         IOCTL_NAME(WS_SIO_GET_QOS);
@@ -4982,6 +6713,47 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         status = WSAEOPNOTSUPP;
         break;
     }
+    case WS_SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER:
+    {
+        static const GUID rio_guid = WSAID_MULTIPLE_RIO;
+
+        if (!in_buff || in_size < sizeof(GUID) || !out_buff)
+        {
+            status = WSAEFAULT;
+            break;
+        }
+        if (IsEqualGUID(&rio_guid, in_buff))
+        {
+            RIO_EXTENSION_FUNCTION_TABLE *table = out_buff;
+
+            if (out_size < sizeof(*table))
+            {
+                status = WSAEFAULT;
+                break;
+            }
+            TRACE("-> got RIO function table\n");
+            table->cbSize                   = sizeof(*table);
+            table->RIOReceive               = WS2_RIOReceive;
+            table->RIOReceiveEx             = WS2_RIOReceiveEx;
+            table->RIOSend                  = WS2_RIOSend;
+            table->RIOSendEx                = WS2_RIOSendEx;
+            table->RIOCloseCompletionQueue  = WS2_RIOCloseCompletionQueue;
+            table->RIOCreateCompletionQueue = WS2_RIOCreateCompletionQueue;
+            table->RIOCreateRequestQueue    = WS2_RIOCreateRequestQueue;
+            table->RIODequeueCompletion     = WS2_RIODequeueCompletion;
+            table->RIODeregisterBuffer      = WS2_RIODeregisterBuffer;
+            table->RIONotify                = WS2_RIONotify;
+            table->RIORegisterBuffer        = WS2_RIORegisterBuffer;
+            table->RIOResizeCompletionQueue = WS2_RIOResizeCompletionQueue;
+            table->RIOResizeRequestQueue    = WS2_RIOResizeRequestQueue;
+            total = sizeof(*table);
+            break;
+        }
+
+        FIXME("SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER %s: stub\n", debugstr_guid(in_buff));
+        status = WSAEOPNOTSUPP;
+        break;
+    }
     case WS_SIO_KEEPALIVE_VALS:
     {
         struct tcp_keepalive *k;
@@ -5218,6 +6990,47 @@ int WINAPI WS_recvfrom(SOCKET s, char *buf, INT len, int flags,
         return n;
 }
 
+/* get the thread poll array, large enough to hold count descriptors */
+static struct pollfd *get_poll_fds( struct per_thread_data *ptb, unsigned int count )
+{
+    LONG serial = wine_server_fd_close_serial();
+    struct pollfd *fds;
+    SOCKET *sockets;
+
+    /* check if the cache can hold all descriptors, if not do the resizing */
+    if (ptb->fd_count < count)
+    {
+        fds = HeapAlloc( GetProcessHeap(), 0, count * sizeof(fds[0]) );
+        sockets = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, count * sizeof(sockets[0]) );
+        if (!fds || !sockets)
+        {
+            HeapFree( GetProcessHeap(), 0, fds );
+            HeapFree( GetProcessHeap(), 0, sockets );
+            return NULL;
+        }
+        HeapFree( GetProcessHeap(), 0, ptb->fd_cache );
+        HeapFree( GetProcessHeap(), 0, ptb->fd_sockets );
+        ptb->fd_cache = fds;
+        ptb->fd_sockets = sockets;
+        ptb->fd_count = count;
+    }
+    else if (ptb->close_serial != serial)
+    {
+        /* a socket was closed, its handle and unix fd may have been reused */
+        memset( ptb->fd_sockets, 0, ptb->fd_count * sizeof(ptb->fd_sockets[0]) );
+    }
+    ptb->close_serial = serial;
+    return ptb->fd_cache;
+}
+
+/* check if the entry of a previous select call can be reused without checking the socket state */
+/* only positive results are cached, since a bound socket never becomes unbound */
+static inline BOOL is_cached_poll_fd( const struct per_thread_data *ptb, unsigned int idx,
+                                      SOCKET s, int fd, short events )
+{
+    return ptb->fd_sockets[idx] == s && ptb->fd_cache[idx].fd == fd && ptb->fd_cache[idx].events == events;
+}
+
 /* allocate a poll array for the corresponding fd sets */
 static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
                                        const WS_fd_set *exceptfds, int *count_ptr )
@@ -5225,6 +7038,8 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
     unsigned int i, j = 0, count = 0;
     struct pollfd *fds;
     struct per_thread_data *ptb = get_per_thread_data();
+    SOCKET s;
+    int fd;
 
     if (readfds) count += readfds->fd_count;
     if (writefds) count += writefds->fd_count;
@@ -5236,59 +7051,47 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
         return NULL;
     }
 
-    /* check if the cache can hold all descriptors, if not do the resizing */
-    if (ptb->fd_count < count)
+    if (!(fds = get_poll_fds( ptb, count )))
     {
-        if (!(fds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(fds[0]))))
-        {
-            SetLastError( ERROR_NOT_ENOUGH_MEMORY );
-            return NULL;
-        }
-        HeapFree(GetProcessHeap(), 0, ptb->fd_cache);
-        ptb->fd_cache = fds;
-        ptb->fd_count = count;
+        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+        return NULL;
     }
-    else
-        fds = ptb->fd_cache;
 
     if (readfds)
         for (i = 0; i < readfds->fd_count; i++, j++)
         {
-            fds[j].fd = get_sock_fd( readfds->fd_array[i], FILE_READ_DATA, NULL );
-            if (fds[j].fd == -1) goto failed;
-            fds[j].revents = 0;
-            if (is_fd_bound(fds[j].fd, NULL, NULL) == 1)
-            {
-                fds[j].events = POLLIN;
-            }
-            else
+            s = readfds->fd_array[i];
+            if ((fd = get_sock_fd( s, FILE_READ_DATA, NULL )) == -1) goto failed;
+            if (!is_cached_poll_fd( ptb, j, s, fd, POLLIN ) && is_fd_bound( fd, NULL, NULL ) != 1)
             {
-                release_sock_fd( readfds->fd_array[i], fds[j].fd );
-                fds[j].fd = -1;
-                fds[j].events = 0;
+                release_sock_fd( s, fd );
+                fd = -1;
             }
+            fds[j].fd = fd;
+            fds[j].events = fd == -1 ? 0 : POLLIN;
+            fds[j].revents = 0;
+            ptb->fd_sockets[j] = s;
         }
     if (writefds)
         for (i = 0; i < writefds->fd_count; i++, j++)
         {
-            fds[j].fd = get_sock_fd( writefds->fd_array[i], FILE_WRITE_DATA, NULL );
-            if (fds[j].fd == -1) goto failed;
-            fds[j].revents = 0;
-            if (is_fd_bound(fds[j].fd, NULL, NULL) == 1 ||
-                _get_fd_type(fds[j].fd) == SOCK_DGRAM)
-            {
-                fds[j].events = POLLOUT;
-            }
-            else
+            s = writefds->fd_array[i];
+            if ((fd = get_sock_fd( s, FILE_WRITE_DATA, NULL )) == -1) goto failed;
+            if (!is_cached_poll_fd( ptb, j, s, fd, POLLOUT ) &&
+                is_fd_bound( fd, NULL, NULL ) != 1 && _get_fd_type( fd ) != SOCK_DGRAM)
             {
-                release_sock_fd( writefds->fd_array[i], fds[j].fd );
-                fds[j].fd = -1;
-                fds[j].events = 0;
+                release_sock_fd( s, fd );
+                fd = -1;
             }
+            fds[j].fd = fd;
+            fds[j].events = fd == -1 ? 0 : POLLOUT;
+            fds[j].revents = 0;
+            ptb->fd_sockets[j] = s;
         }
     if (exceptfds)
         for (i = 0; i < exceptfds->fd_count; i++, j++)
         {
+            ptb->fd_sockets[j] = 0;
             fds[j].fd = get_sock_fd( exceptfds->fd_array[i], 0, NULL );
             if (fds[j].fd == -1) goto failed;
             fds[j].revents = 0;
@@ -5363,14 +7166,179 @@ static void release_poll_fds( const WS_fd_set *readfds, const WS_fd_set *writefd
     }
 }
 
+#ifdef USE_EPOLL
+
+/* minimum number of descriptors to use the thread epoll set instead of poll() */
+#define POLL_SET_MIN_COUNT 128
+
+static int compare_poll_set_entry( const void *a, const void *b )
+{
+    const struct poll_set_entry *entry1 = a, *entry2 = b;
+    return (entry1->fd > entry2->fd) - (entry1->fd < entry2->fd);
+}
+
+static BOOL update_poll_set_entry( struct poll_set *set, int ctl, int fd, int events )
+{
+    struct epoll_event ev;
+
+    memset( &ev, 0, sizeof(ev) );
+    ev.events = events;
+    ev.data.fd = fd;
+    /* the fd may already have been removed from the set if it was closed */
+    return !epoll_ctl( set->epoll_fd, ctl, fd, &ev ) || ctl == EPOLL_CTL_DEL;
+}
+
+/* update the fds registered in the thread epoll set to match a poll array */
+static struct poll_set *sync_poll_set( struct per_thread_data *ptb, const struct pollfd *fds, unsigned int count )
+{
+    struct poll_set *set = ptb->poll_set;
+    struct poll_set_entry *new, *old;
+    LONG serial = wine_server_fd_close_serial();
+    unsigned int i, j, n;
+    BOOL ret;
+
+    if (set && set->close_serial != serial)
+    {
+        /* a socket was closed, its unix fd may have been reused */
+        free_poll_set( set );
+        set = ptb->poll_set = NULL;
+    }
+    if (!set)
+    {
+        if (!(set = heap_alloc_zero( sizeof(*set) ))) return NULL;
+        if ((set->epoll_fd = epoll_create( count )) == -1)
+        {
+            heap_free( set );
+            return NULL;
+        }
+        fcntl( set->epoll_fd, F_SETFD, FD_CLOEXEC );
+        set->close_serial = serial;
+        ptb->poll_set = set;
+    }
+    if (set->size < count)
+    {
+        struct epoll_event *events;
+
+        if (!(new = heap_realloc( set->entries, count * sizeof(*new) ))) goto failed;
+        set->entries = new;
+        if (!(new = heap_realloc( set->pending, count * sizeof(*new) ))) goto failed;
+        set->pending = new;
+        if (!(events = heap_realloc( set->events, count * sizeof(*events) ))) goto failed;
+        set->events = events;
+        set->size = count;
+    }
+
+    new = set->pending;
+    for (i = n = 0; i < count; i++)
+    {
+        if (fds[i].fd == -1) continue;
+        new[n].fd = fds[i].fd;
+        new[n].events = fds[i].events;
+        new[n].revents = 0;
+        n++;
+    }
+    qsort( new, n, sizeof(*new), compare_poll_set_entry );
+
+    /* merge the entries of sockets present in several fd sets */
+    for (i = j = 0; i < n; i++)
+    {
+        if (j && new[j - 1].fd == new[i].fd) new[j - 1].events |= new[i].events;
+        else new[j++] = new[i];
+    }
+    n = j;
+
+    old = set->entries;
+    for (i = j = 0; i < n || j < set->count;)
+    {
+        if (j == set->count || (i < n && new[i].fd < old[j].fd))
+        {
+            ret = update_poll_set_entry( set, EPOLL_CTL_ADD, new[i].fd, new[i].events );
+            i++;
+        }
+        else if (i == n || old[j].fd < new[i].fd)
+        {
+            ret = update_poll_set_entry( set, EPOLL_CTL_DEL, old[j].fd, 0 );
+            j++;
+        }
+        else
+        {
+            ret = new[i].events == old[j].events ||
+                  update_poll_set_entry( set, EPOLL_CTL_MOD, new[i].fd, new[i].events );
+            i++;
+            j++;
+        }
+        if (!ret) goto failed;
+    }
+    set->entries = new;
+    set->pending = old;
+    set->count = n;
+    return set;
+
+failed:
+    WARN( "failed to update epoll set, falling back to poll\n" );
+    free_poll_set( set );
+    ptb->poll_set = NULL;
+    return NULL;
+}
+
+/* wait on the epoll set and store the results in the poll array */
+static int poll_set_wait( struct poll_set *set, struct pollfd *fds, unsigned int count, int timeout )
+{
+    struct poll_set_entry *entry, key;
+    unsigned int i;
+    int ret;
+
+    for (i = 0; i < set->count; i++) set->entries[i].revents = 0;
+
+    if ((ret = epoll_wait( set->epoll_fd, set->events, max( set->count, 1 ), timeout )) <= 0)
+        return ret;
+
+    for (i = 0; i < ret; i++)
+    {
+        key.fd = set->events[i].data.fd;
+        if ((entry = bsearch( &key, set->entries, set->count, sizeof(key), compare_poll_set_entry )))
+            entry->revents = set->events[i].events;
+    }
+
+    for (i = ret = 0; i < count; i++)
+    {
+        fds[i].revents = 0;
+        if (fds[i].fd == -1) continue;
+        key.fd = fds[i].fd;
+        if (!(entry = bsearch( &key, set->entries, set->count, sizeof(key), compare_poll_set_entry )))
+            continue;
+        fds[i].revents = entry->revents & (fds[i].events | POLLERR | POLLHUP);
+        if (fds[i].revents) ret++;
+    }
+    return ret;
+}
+
+#endif  /* USE_EPOLL */
+
+/* poll the descriptors, using an epoll set when the same large set is polled repeatedly */
+static int poll_fds( struct per_thread_data *ptb, struct pollfd *fds, int count, int timeout )
+{
+#ifdef USE_EPOLL
+    BOOL large = count >= POLL_SET_MIN_COUNT;
+    BOOL repeated = large && (ptb->last_poll_large || ptb->poll_set);
+    struct poll_set *set;
+
+    ptb->last_poll_large = large;
+    if (repeated && (set = sync_poll_set( ptb, fds, count )))
+        return poll_set_wait( set, fds, count, timeout );
+#endif
+    return poll( fds, count, timeout );
+}
+
 static int do_poll(struct pollfd *pollfds, int count, int timeout)
 {
+    struct per_thread_data *ptb = get_per_thread_data();
     struct timeval tv1, tv2;
     int ret, torig = timeout;
 
     if (timeout > 0) gettimeofday( &tv1, 0 );
 
-    while ((ret = poll( pollfds, count, timeout )) < 0)
+    while ((ret = poll_fds( ptb, pollfds, count, timeout )) < 0)
     {
         if (errno != EINTR) break;
         if (timeout < 0) continue;
@@ -5465,6 +7433,7 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
  */
 int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
 {
+    struct per_thread_data *ptb = get_per_thread_data();
     int i, ret;
     struct pollfd *ufds;
 
@@ -5479,7 +7448,7 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         return SOCKET_ERROR;
     }
 
-    if (!(ufds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(ufds[0]))))
+    if (!(ufds = get_poll_fds( ptb, count )))
     {
         SetLastError(WSAENOBUFS);
         return SOCKET_ERROR;
@@ -5490,6 +7459,7 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         ufds[i].fd = get_sock_fd(wfds[i].fd, 0, NULL);
         ufds[i].events = convert_poll_w2u(wfds[i].events);
         ufds[i].revents = 0;
+        ptb->fd_sockets[i] = 0;
     }
 
     ret = do_poll(ufds, count, timeout);
@@ -5518,7 +7488,6 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
             wfds[i].revents = WS_POLLNVAL;
     }
 
-    HeapFree(GetProcessHeap(), 0, ufds);
     return ret;
 }
 
@@ -5588,7 +7557,7 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     struct ws2_async *wsa = NULL, localwsa;
     int totalLength = 0;
     DWORD bytes_sent;
-    BOOL is_blocking;
+    BOOL is_blocking, dgram;
 
     TRACE("socket %04lx, wsabuf %p, nbufs %d, flags %d, to %p, tolen %d, ovl %p, func %p\n",
           s, lpBuffers, dwBufferCount, dwFlags,
@@ -5649,6 +7618,8 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
         wsa->user_overlapped = lpOverlapped;
         wsa->completion_func = lpCompletionRoutine;
+        /* datagrams that cannot be sent yet may be sent together once the socket is writable */
+        dgram = n == -1 && (!to || to->sa_family != WS_AF_IPX) && _get_fd_type( fd ) == SOCK_DGRAM;
         release_sock_fd( s, fd );
 
         if (n == -1 || n < totalLength)
@@ -5656,12 +7627,15 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             iosb->u.Status = STATUS_PENDING;
             iosb->Information = n == -1 ? 0 : n;
 
+            /* the async may complete as soon as it is registered */
+            if (dgram) dgram = dgram_queue_async( wsa, ASYNC_TYPE_WRITE );
             if (wsa->completion_func)
                 err = register_async( ASYNC_TYPE_WRITE, wsa->hSocket, &wsa->io, NULL,
                                       ws2_async_apc, wsa, iosb );
             else
                 err = register_async( ASYNC_TYPE_WRITE, wsa->hSocket, &wsa->io, lpOverlapped->hEvent,
                                       NULL, (void *)cvalue, iosb );
+            if (err != STATUS_PENDING && dgram) dgram_dequeue_async( wsa, &n );
 
             /* Enable the event only after starting the async. The server will deliver it as soon as
                the async is done. */
@@ -7355,12 +9329,21 @@ int WINAPI WS_gethostname(char *name, int namelen)
  */
 int WINAPI WSAEnumNetworkEvents(SOCKET s, WSAEVENT hEvent, LPWSANETWORKEVENTS lpEvent)
 {
+    struct socket_shm state;
     int ret;
     int i;
     int errors[FD_MAX_EVENTS];
 
     TRACE("%04lx, hEvent %p, lpEvent %p\n", s, hEvent, lpEvent );
 
+    /* nothing to report or to reset, avoid the server round trip; an event
+     * is always reset, even if set by the application, which needs one anyway */
+    if (!hEvent && get_socket_shm_state( s, &state ) && !state.pmask && !state.signaled)
+    {
+        lpEvent->lNetworkEvents = 0;
+        return 0;
+    }
+
     SERVER_START_REQ( get_socket_event )
     {
         req->handle  = wine_server_obj_handle( SOCKET2HANDLE(s) );
@@ -7399,7 +9382,8 @@ int WINAPI WSAEventSelect(SOCKET s, WSAEVENT hEvent, LONG lEvent)
         req->event  = wine_server_obj_handle( hEvent );
         req->window = 0;
         req->msg    = 0;
-        ret = wine_server_call( req );
+        if (!(ret = wine_server_call( req )))
+            set_socket_shm_index( s, reply->shm_index, reply->shm_serial );
     }
     SERVER_END_REQ;
     if (!ret) return 0;
@@ -7982,7 +9966,7 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     unsigned int i, options;
     int n, fd, err, overlapped, flags;
     struct ws2_async *wsa = NULL, localwsa;
-    BOOL is_blocking;
+    BOOL is_blocking, dgram;
     DWORD timeout_start = GetTickCount();
     ULONG_PTR cvalue = (lpOverlapped && ((ULONG_PTR)lpOverlapped->hEvent & 1) == 0) ? (ULONG_PTR)lpOverlapped : 0;
 
@@ -8067,6 +10051,9 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
             wsa->user_overlapped = lpOverlapped;
             wsa->completion_func = lpCompletionRoutine;
+            /* datagrams that are not available yet may be received together once they arrive */
+            dgram = n == -1 && !wsa->control && !(flags & (MSG_OOB | MSG_PEEK)) &&
+                    _get_fd_type( fd ) == SOCK_DGRAM;
             release_sock_fd( s, fd );
 
             if (n == -1)
@@ -8074,12 +10061,15 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                 iosb->u.Status = STATUS_PENDING;
                 iosb->Information = 0;
 
+                /* the async may complete as soon as it is registered */
+                if (dgram) dgram = dgram_queue_async( wsa, ASYNC_TYPE_READ );
                 if (wsa->completion_func)
                     err = register_async( ASYNC_TYPE_READ, wsa->hSocket, &wsa->io, NULL,
                                           ws2_async_apc, wsa, iosb );
                 else
                     err = register_async( ASYNC_TYPE_READ, wsa->hSocket, &wsa->io, lpOverlapped->hEvent,
                                           NULL, (void *)cvalue, iosb );
+                if (err != STATUS_PENDING && dgram) dgram_dequeue_async( wsa, &n );
 
                 if (err != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
                 SetLastError(NtStatusToWSAError( err ));
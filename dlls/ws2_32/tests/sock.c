@@ -3080,6 +3080,69 @@ static void test_WSAEnumNetworkEvents(void)
     }
 }
 
+static void test_WSAEnumNetworkEvents_read(void)
+{
+    WSANETWORKEVENTS net_events;
+    SOCKET src, dst;
+    HANDLE event;
+    char buffer[4];
+    DWORD ret;
+    int i;
+
+    ok(!tcp_socketpair(&src, &dst), "creating socket pair failed\n");
+    event = WSACreateEvent();
+    ok(!WSAEventSelect(dst, event, FD_READ), "WSAEventSelect failed\n");
+
+    for (i = 0; i < 4; i++)
+    {
+        memset(&net_events, 0xab, sizeof(net_events));
+        ok(!WSAEnumNetworkEvents(dst, (i & 1) ? event : NULL, &net_events), "WSAEnumNetworkEvents failed\n");
+        ok(!net_events.lNetworkEvents, "%d: got events %#x\n", i, net_events.lNetworkEvents);
+    }
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+
+    /* the event is reset even if nothing is pending */
+    SetEvent(event);
+    memset(&net_events, 0xab, sizeof(net_events));
+    ok(!WSAEnumNetworkEvents(dst, event, &net_events), "WSAEnumNetworkEvents failed\n");
+    ok(!net_events.lNetworkEvents, "got events %#x\n", net_events.lNetworkEvents);
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+
+    ok(send(src, "data", 4, 0) == 4, "send failed\n");
+    ret = WaitForSingleObject(event, 1000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+
+    memset(&net_events, 0xab, sizeof(net_events));
+    ok(!WSAEnumNetworkEvents(dst, event, &net_events), "WSAEnumNetworkEvents failed\n");
+    ok(net_events.lNetworkEvents == FD_READ, "got events %#x\n", net_events.lNetworkEvents);
+    ok(!net_events.iErrorCode[FD_READ_BIT], "got error %d\n", net_events.iErrorCode[FD_READ_BIT]);
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+
+    memset(&net_events, 0xab, sizeof(net_events));
+    ok(!WSAEnumNetworkEvents(dst, event, &net_events), "WSAEnumNetworkEvents failed\n");
+    ok(!net_events.lNetworkEvents, "got events %#x\n", net_events.lNetworkEvents);
+
+    ok(recv(dst, buffer, sizeof(buffer), 0) == 4, "recv failed\n");
+    memset(&net_events, 0xab, sizeof(net_events));
+    ok(!WSAEnumNetworkEvents(dst, event, &net_events), "WSAEnumNetworkEvents failed\n");
+    ok(!net_events.lNetworkEvents, "got events %#x\n", net_events.lNetworkEvents);
+
+    /* the event is signaled again for new data */
+    ok(send(src, "data", 4, 0) == 4, "send failed\n");
+    ret = WaitForSingleObject(event, 1000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    memset(&net_events, 0xab, sizeof(net_events));
+    ok(!WSAEnumNetworkEvents(dst, event, &net_events), "WSAEnumNetworkEvents failed\n");
+    ok(net_events.lNetworkEvents == FD_READ, "got events %#x\n", net_events.lNetworkEvents);
+
+    closesocket(src);
+    closesocket(dst);
+    WSACloseEvent(event);
+}
+
 static void test_WSAAddressToStringA(void)
 {
     SOCKET v6 = INVALID_SOCKET;
@@ -4198,6 +4261,95 @@ todo_wine
     ok(FD_ISSET(fdWrite, &writefds), "fdWrite socket is not in the set\n");
     closesocket(fdWrite);
 }
+
+#define LARGE_SET_PAIRS 80
+
+struct large_fd_set
+{
+    u_int  fd_count;
+    SOCKET fd_array[LARGE_SET_PAIRS];
+};
+
+static void test_select_large_set(void)
+{
+    static const struct timeval timeout = {0, 0};
+    SOCKET src[LARGE_SET_PAIRS], dst[LARGE_SET_PAIRS];
+    struct large_fd_set readfds, writefds;
+    char buffer[4];
+    int i, j, ret;
+
+    for (i = 0; i < LARGE_SET_PAIRS; i++)
+        ok(!tcp_socketpair(&src[i], &dst[i]), "creating socket pair %u failed\n", i);
+
+    /* the same large set is polled repeatedly */
+    for (i = 0; i < 4; i++)
+    {
+        readfds.fd_count = writefds.fd_count = LARGE_SET_PAIRS;
+        memcpy(readfds.fd_array, dst, sizeof(dst));
+        memcpy(writefds.fd_array, dst, sizeof(dst));
+        if (i == 1 || i == 3)
+        {
+            ret = send(src[i * 10], "data", 4, 0);
+            ok(ret == 4, "send failed\n");
+        }
+        ret = select(0, (fd_set *)&readfds, (fd_set *)&writefds, NULL, &timeout);
+        if (i == 1 || i == 3)
+        {
+            ok(ret == LARGE_SET_PAIRS + 1, "%d: got %d\n", i, ret);
+            ok(readfds.fd_count == 1, "%d: got %u readable sockets\n", i, readfds.fd_count);
+            ok(readfds.fd_array[0] == dst[i * 10], "%d: got socket %#lx\n", i, readfds.fd_array[0]);
+            ret = recv(dst[i * 10], buffer, sizeof(buffer), 0);
+            ok(ret == 4, "recv failed\n");
+        }
+        else
+        {
+            ok(ret == LARGE_SET_PAIRS, "%d: got %d\n", i, ret);
+            ok(!readfds.fd_count, "%d: got %u readable sockets\n", i, readfds.fd_count);
+        }
+        ok(writefds.fd_count == LARGE_SET_PAIRS, "%d: got %u writable sockets\n", i, writefds.fd_count);
+    }
+
+    /* closing a peer makes the socket readable */
+    closesocket(src[5]);
+    readfds.fd_count = writefds.fd_count = LARGE_SET_PAIRS;
+    memcpy(readfds.fd_array, dst, sizeof(dst));
+    memcpy(writefds.fd_array, dst, sizeof(dst));
+    ret = select(0, (fd_set *)&readfds, (fd_set *)&writefds, NULL, &timeout);
+    ok(ret == LARGE_SET_PAIRS + 1, "got %d\n", ret);
+    ok(readfds.fd_count == 1, "got %u readable sockets\n", readfds.fd_count);
+    ok(readfds.fd_array[0] == dst[5], "got socket %#lx\n", readfds.fd_array[0]);
+
+    /* sockets removed from the set are not reported anymore */
+    for (j = 0; j < 2; j++)
+    {
+        readfds.fd_count = writefds.fd_count = LARGE_SET_PAIRS - 10;
+        memcpy(readfds.fd_array, dst + 10, sizeof(dst) - 10 * sizeof(dst[0]));
+        memcpy(writefds.fd_array, dst + 10, sizeof(dst) - 10 * sizeof(dst[0]));
+        ret = select(0, (fd_set *)&readfds, (fd_set *)&writefds, NULL, &timeout);
+        ok(ret == LARGE_SET_PAIRS - 10, "%d: got %d\n", j, ret);
+        ok(!readfds.fd_count, "%d: got %u readable sockets\n", j, readfds.fd_count);
+    }
+
+    /* a socket closed with CloseHandle, its handle and unix fd are likely reused */
+    closesocket(src[20]);
+    CloseHandle((HANDLE)dst[20]);
+    ok(!tcp_socketpair(&src[20], &dst[20]), "creating socket pair failed\n");
+    ret = send(src[20], "data", 4, 0);
+    ok(ret == 4, "send failed\n");
+    readfds.fd_count = writefds.fd_count = LARGE_SET_PAIRS - 10;
+    memcpy(readfds.fd_array, dst + 10, sizeof(dst) - 10 * sizeof(dst[0]));
+    memcpy(writefds.fd_array, dst + 10, sizeof(dst) - 10 * sizeof(dst[0]));
+    ret = select(0, (fd_set *)&readfds, (fd_set *)&writefds, NULL, &timeout);
+    ok(ret == LARGE_SET_PAIRS - 9, "got %d\n", ret);
+    ok(readfds.fd_count == 1, "got %u readable sockets\n", readfds.fd_count);
+    ok(readfds.fd_array[0] == dst[20], "got socket %#lx\n", readfds.fd_array[0]);
+
+    for (i = 0; i < LARGE_SET_PAIRS; i++)
+    {
+        if (i != 5) closesocket(src[i]);
+        closesocket(dst[i]);
+    }
+}
 #undef FD_SET_ALL
 #undef FD_ZERO_ALL
 
@@ -8750,6 +8902,101 @@ end:
         closesocket(connector2);
 }
 
+static void test_AcceptEx_pending_connection(void)
+{
+    GUID acceptex_guid = WSAID_ACCEPTEX;
+    LPFN_ACCEPTEX pAcceptEx;
+    struct sockaddr_in addr, peer, local;
+    SOCKET listener, acceptor, connector;
+    char buffer[256];
+    OVERLAPPED overlapped;
+    DWORD size, flags;
+    int ret, len;
+    BOOL bret;
+
+    listener = WSASocketA(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED);
+    ok(listener != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+
+    ret = WSAIoctl(listener, SIO_GET_EXTENSION_FUNCTION_POINTER, &acceptex_guid, sizeof(acceptex_guid),
+                   &pAcceptEx, sizeof(pAcceptEx), &size, NULL, NULL);
+    ok(!ret, "failed to get AcceptEx, error %u\n", WSAGetLastError());
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ret = bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!ret, "bind failed, error %u\n", WSAGetLastError());
+    len = sizeof(addr);
+    ret = getsockname(listener, (struct sockaddr *)&addr, &len);
+    ok(!ret, "getsockname failed, error %u\n", WSAGetLastError());
+    ret = listen(listener, 2);
+    ok(!ret, "listen failed, error %u\n", WSAGetLastError());
+
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    /* the connection is already waiting when AcceptEx is called */
+    connector = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(connector != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+    ret = connect(connector, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!ret, "connect failed, error %u\n", WSAGetLastError());
+    len = sizeof(peer);
+    ret = getsockname(connector, (struct sockaddr *)&peer, &len);
+    ok(!ret, "getsockname failed, error %u\n", WSAGetLastError());
+
+    acceptor = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(acceptor != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+    memset(buffer, 0, sizeof(buffer));
+    size = 0xdeadbeef;
+    bret = pAcceptEx(listener, acceptor, buffer, 0, sizeof(struct sockaddr_in) + 16,
+                     sizeof(struct sockaddr_in) + 16, &size, &overlapped);
+    ok(bret || WSAGetLastError() == ERROR_IO_PENDING, "AcceptEx returned %d, error %u\n", bret, WSAGetLastError());
+
+    ret = WaitForSingleObject(overlapped.hEvent, 1000);
+    ok(!ret, "wait returned %d\n", ret);
+    bret = WSAGetOverlappedResult(listener, &overlapped, &size, FALSE, &flags);
+    ok(bret, "WSAGetOverlappedResult failed, error %u\n", WSAGetLastError());
+    ok(!size, "got size %u\n", size);
+
+    ret = setsockopt(acceptor, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, (char *)&listener, sizeof(listener));
+    ok(!ret, "setsockopt failed, error %u\n", WSAGetLastError());
+    len = sizeof(local);
+    ret = getpeername(acceptor, (struct sockaddr *)&local, &len);
+    ok(!ret, "getpeername failed, error %u\n", WSAGetLastError());
+    ok(local.sin_port == peer.sin_port, "got port %u, expected %u\n", ntohs(local.sin_port), ntohs(peer.sin_port));
+
+    closesocket(acceptor);
+    closesocket(connector);
+
+    /* the connection and its initial data are already waiting */
+    connector = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(connector != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+    ret = connect(connector, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!ret, "connect failed, error %u\n", WSAGetLastError());
+    ret = send(connector, "data", 4, 0);
+    ok(ret == 4, "send returned %d, error %u\n", ret, WSAGetLastError());
+
+    acceptor = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(acceptor != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+    ResetEvent(overlapped.hEvent);
+    memset(buffer, 0, sizeof(buffer));
+    bret = pAcceptEx(listener, acceptor, buffer, 4, sizeof(struct sockaddr_in) + 16,
+                     sizeof(struct sockaddr_in) + 16, &size, &overlapped);
+    ok(bret || WSAGetLastError() == ERROR_IO_PENDING, "AcceptEx returned %d, error %u\n", bret, WSAGetLastError());
+
+    ret = WaitForSingleObject(overlapped.hEvent, 1000);
+    ok(!ret, "wait returned %d\n", ret);
+    bret = WSAGetOverlappedResult(listener, &overlapped, &size, FALSE, &flags);
+    ok(bret, "WSAGetOverlappedResult failed, error %u\n", WSAGetLastError());
+    ok(size == 4, "got size %u\n", size);
+    ok(!memcmp(buffer, "data", 4), "got data %s\n", buffer);
+
+    closesocket(acceptor);
+    closesocket(connector);
+    closesocket(listener);
+    CloseHandle(overlapped.hEvent);
+}
+
 static void test_DisconnectEx(void)
 {
     SOCKET listener, acceptor, connector;
@@ -9080,6 +9327,28 @@ static void test_TransmitFile(void)
     ok(memcmp(buf, &footer_msg[0], sizeof(footer_msg)) == 0,
        "TransmitFile footer buffer did not match!\n");
 
+    /* Test TransmitFile with a limited number of bytes from the file pointer */
+    if (file_size > 120)
+    {
+        char expect[100];
+        DWORD read;
+
+        SetFilePointer(file, 20, NULL, FILE_BEGIN);
+        ReadFile(file, expect, sizeof(expect), &read, NULL);
+        ok(read == sizeof(expect), "got %u\n", read);
+        SetFilePointer(file, 20, NULL, FILE_BEGIN);
+        bret = pTransmitFile(client, file, sizeof(expect), 0, NULL, NULL, 0);
+        ok(bret, "TransmitFile failed unexpectedly.\n");
+        for (len = 0; len < sizeof(expect); len += iret)
+        {
+            iret = recv(dest, buf + len, sizeof(expect) - len, 0);
+            ok(iret > 0, "recv failed, error %d\n", WSAGetLastError());
+            if (iret <= 0) break;
+        }
+        ok(len == sizeof(expect), "got %d bytes\n", len);
+        ok(!memcmp(buf, expect, sizeof(expect)), "TransmitFile data did not match\n");
+    }
+
     /* Test TransmitFile with a UDP datagram socket */
     closesocket(client);
     client = socket(AF_INET, SOCK_DGRAM, 0);
@@ -9095,6 +9364,274 @@ cleanup:
     closesocket(server);
 }
 
+static void test_rio(void)
+{
+    GUID rio_guid = WSAID_MULTIPLE_RIO;
+    RIO_EXTENSION_FUNCTION_TABLE rio;
+    RIO_NOTIFICATION_COMPLETION notification;
+    struct sockaddr_in addr;
+    RIORESULT results[16];
+    RIO_BUFFERID buffer_id;
+    RIO_BUF buf;
+    RIO_CQ cq;
+    RIO_RQ src_rq, dst_rq;
+    SOCKET src, dst;
+    char buffer[4096], expect[16];
+    unsigned int i, count, recv_count, send_count;
+    int ret, len;
+    DWORD size;
+    HANDLE event;
+    BOOL bret;
+
+    src = WSASocketA(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, WSA_FLAG_REGISTERED_IO);
+    ok(src != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+    dst = WSASocketA(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, WSA_FLAG_REGISTERED_IO);
+    ok(dst != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+
+    memset(&rio, 0, sizeof(rio));
+    ret = WSAIoctl(dst, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &rio_guid, sizeof(rio_guid),
+                   &rio, sizeof(rio), &size, NULL, NULL);
+    if (ret)
+    {
+        win_skip("RIO is not supported\n");
+        closesocket(src);
+        closesocket(dst);
+        return;
+    }
+    ok(size == sizeof(rio), "got size %u\n", size);
+    ok(rio.cbSize == sizeof(rio), "got cbSize %u\n", rio.cbSize);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ret = bind(dst, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!ret, "bind failed, error %u\n", WSAGetLastError());
+    len = sizeof(addr);
+    ret = getsockname(dst, (struct sockaddr *)&addr, &len);
+    ok(!ret, "getsockname failed, error %u\n", WSAGetLastError());
+    ret = connect(src, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!ret, "connect failed, error %u\n", WSAGetLastError());
+
+    buffer_id = rio.RIORegisterBuffer(buffer, sizeof(buffer));
+    ok(buffer_id != RIO_INVALID_BUFFERID, "RIORegisterBuffer failed, error %u\n", WSAGetLastError());
+
+    event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    memset(&notification, 0, sizeof(notification));
+    notification.Type = RIO_EVENT_COMPLETION;
+    notification.Event.EventHandle = event;
+    notification.Event.NotifyReset = TRUE;
+    cq = rio.RIOCreateCompletionQueue(16, &notification);
+    ok(cq != RIO_INVALID_CQ, "RIOCreateCompletionQueue failed, error %u\n", WSAGetLastError());
+
+    /* the completion queue must be able to hold the results of all the requests */
+    dst_rq = rio.RIOCreateRequestQueue(dst, 16, 1, 16, 1, cq, cq, (void *)0xdead);
+    ok(dst_rq == RIO_INVALID_RQ, "RIOCreateRequestQueue succeeded\n");
+    ok(WSAGetLastError() == WSAENOBUFS, "got error %u\n", WSAGetLastError());
+
+    dst_rq = rio.RIOCreateRequestQueue(dst, 4, 1, 1, 1, cq, cq, (void *)0xdead);
+    ok(dst_rq != RIO_INVALID_RQ, "RIOCreateRequestQueue failed, error %u\n", WSAGetLastError());
+    src_rq = rio.RIOCreateRequestQueue(src, 1, 1, 4, 1, cq, cq, (void *)0xbeef);
+    ok(src_rq != RIO_INVALID_RQ, "RIOCreateRequestQueue failed, error %u\n", WSAGetLastError());
+
+    ret = rio.RIONotify(cq);
+    ok(!ret, "RIONotify returned %d\n", ret);
+    ret = rio.RIONotify(cq);
+    ok(ret == WSAEALREADY, "RIONotify returned %d\n", ret);
+    count = rio.RIODequeueCompletion(cq, results, ARRAY_SIZE(results));
+    ok(!count, "got %u results\n", count);
+
+    for (i = 0; i < 4; i++)
+    {
+        buf.BufferId = buffer_id;
+        buf.Offset = 256 * i;
+        buf.Length = 256;
+        bret = rio.RIOReceive(dst_rq, &buf, 1, 0, (void *)(ULONG_PTR)(i + 1));
+        ok(bret, "RIOReceive failed, error %u\n", WSAGetLastError());
+    }
+    bret = rio.RIOReceive(dst_rq, &buf, 1, 0, NULL);
+    ok(!bret, "RIOReceive succeeded\n");
+    ok(WSAGetLastError() == WSAENOBUFS, "got error %u\n", WSAGetLastError());
+
+    ret = WaitForSingleObject(event, 100);
+    ok(ret == WAIT_TIMEOUT, "got %d\n", ret);
+
+    /* deferred sends are issued together with the next one */
+    for (i = 0; i < 4; i++)
+    {
+        buf.BufferId = buffer_id;
+        buf.Offset = 2048 + 16 * i;
+        buf.Length = sprintf(buffer + buf.Offset, "packet %u", i);
+        bret = rio.RIOSend(src_rq, &buf, 1, i < 3 ? RIO_MSG_DEFER : 0, (void *)(ULONG_PTR)(i + 0x10));
+        ok(bret, "RIOSend failed, error %u\n", WSAGetLastError());
+    }
+
+    recv_count = send_count = 0;
+    while (recv_count + send_count < 8)
+    {
+        ret = WaitForSingleObject(event, 1000);
+        ok(ret == WAIT_OBJECT_0, "got %d\n", ret);
+        if (ret) break;
+
+        count = rio.RIODequeueCompletion(cq, results, ARRAY_SIZE(results));
+        ok(count && count <= 8 - recv_count - send_count, "got %u results\n", count);
+        for (i = 0; i < count; i++)
+        {
+            ok(!results[i].Status, "got status %d\n", results[i].Status);
+            if (results[i].SocketContext == 0xdead)
+            {
+                ok(results[i].RequestContext == recv_count + 1, "got request context %s\n",
+                   wine_dbgstr_longlong(results[i].RequestContext));
+                sprintf(expect, "packet %u", recv_count);
+                ok(results[i].BytesTransferred == strlen(expect), "got %u bytes\n", results[i].BytesTransferred);
+                ok(!memcmp(buffer + 256 * recv_count, expect, strlen(expect)), "data %u did not match\n", recv_count);
+                recv_count++;
+            }
+            else
+            {
+                ok(results[i].SocketContext == 0xbeef, "got socket context %s\n",
+                   wine_dbgstr_longlong(results[i].SocketContext));
+                ok(results[i].RequestContext == send_count + 0x10, "got request context %s\n",
+                   wine_dbgstr_longlong(results[i].RequestContext));
+                ok(results[i].BytesTransferred == 8, "got %u bytes\n", results[i].BytesTransferred);
+                send_count++;
+            }
+        }
+        if (recv_count + send_count < 8)
+        {
+            ret = rio.RIONotify(cq);
+            ok(!ret, "RIONotify returned %d\n", ret);
+        }
+    }
+    ok(recv_count == 4, "got %u receive results\n", recv_count);
+    ok(send_count == 4, "got %u send results\n", send_count);
+
+    /* outstanding requests are aborted when the socket is closed */
+    buf.BufferId = buffer_id;
+    buf.Offset = 0;
+    buf.Length = 256;
+    bret = rio.RIOReceive(dst_rq, &buf, 1, 0, (void *)0x55);
+    ok(bret, "RIOReceive failed, error %u\n", WSAGetLastError());
+    closesocket(dst);
+
+    for (i = 0; i < 100; i++)
+    {
+        if ((count = rio.RIODequeueCompletion(cq, results, ARRAY_SIZE(results)))) break;
+        Sleep(10);
+    }
+    ok(count == 1, "got %u results\n", count);
+    ok(results[0].Status == WSA_OPERATION_ABORTED, "got status %d\n", results[0].Status);
+    ok(results[0].SocketContext == 0xdead, "got socket context %s\n",
+       wine_dbgstr_longlong(results[0].SocketContext));
+    ok(results[0].RequestContext == 0x55, "got request context %s\n",
+       wine_dbgstr_longlong(results[0].RequestContext));
+    ok(!results[0].BytesTransferred, "got %u bytes\n", results[0].BytesTransferred);
+
+    closesocket(src);
+    rio.RIOCloseCompletionQueue(cq);
+    rio.RIODeregisterBuffer(buffer_id);
+    CloseHandle(event);
+}
+
+static void test_overlapped_recvfrom_batch(BOOL write_watch)
+{
+    UINT (WINAPI *pGetWriteWatch)(DWORD,LPVOID,SIZE_T,LPVOID*,ULONG_PTR*,ULONG*);
+    struct sockaddr_in addr, from[8];
+    WSAOVERLAPPED ov[8];
+    char (*buffers)[16], expect[16];
+    int ret, len, fromlen[8];
+    DWORD flags[8], size, recv_flags;
+    void *results[4];
+    ULONG_PTR count;
+    ULONG pagesize;
+    SOCKET src, dst;
+    WSABUF buf;
+    unsigned int i;
+    BOOL bret;
+
+    pGetWriteWatch = (void *)GetProcAddress( GetModuleHandleA("kernel32.dll"), "GetWriteWatch" );
+    if (write_watch && !pGetWriteWatch)
+    {
+        win_skip( "write watched buffers not supported\n" );
+        return;
+    }
+    buffers = VirtualAlloc( NULL, sizeof(*buffers) * ARRAY_SIZE(ov), MEM_RESERVE | MEM_COMMIT |
+                            (write_watch ? MEM_WRITE_WATCH : 0), PAGE_READWRITE );
+    ok( buffers != NULL, "VirtualAlloc failed, error %u\n", GetLastError() );
+
+    src = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ok(src != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+    dst = WSASocketA(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, WSA_FLAG_OVERLAPPED);
+    ok(dst != INVALID_SOCKET, "failed to create socket, error %u\n", WSAGetLastError());
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ret = bind(dst, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!ret, "bind failed, error %u\n", WSAGetLastError());
+    len = sizeof(addr);
+    ret = getsockname(dst, (struct sockaddr *)&addr, &len);
+    ok(!ret, "getsockname failed, error %u\n", WSAGetLastError());
+
+    for (i = 0; i < ARRAY_SIZE(ov); i++) memset(buffers[i], 0xcc, sizeof(buffers[i]));
+    if (write_watch)
+    {
+        /* the buffers are received into while their page is not marked as written */
+        count = ARRAY_SIZE(results);
+        ret = pGetWriteWatch( WRITE_WATCH_FLAG_RESET, buffers, sizeof(*buffers), results, &count, &pagesize );
+        ok( !ret, "GetWriteWatch failed, error %u\n", GetLastError() );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(ov); i++)
+    {
+        memset(&ov[i], 0, sizeof(ov[i]));
+        ov[i].hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        buf.buf = buffers[i];
+        buf.len = sizeof(buffers[i]);
+        flags[i] = 0;
+        fromlen[i] = sizeof(from[i]);
+        ret = WSARecvFrom(dst, &buf, 1, NULL, &flags[i], (struct sockaddr *)&from[i], &fromlen[i], &ov[i], NULL);
+        ok(ret == SOCKET_ERROR, "%u: got %d\n", i, ret);
+        ok(WSAGetLastError() == WSA_IO_PENDING, "%u: got error %u\n", i, WSAGetLastError());
+    }
+
+    /* all the datagrams arrive before the receives are alerted */
+    for (i = 0; i < ARRAY_SIZE(ov); i++)
+    {
+        memset(expect, 'a' + i, sizeof(expect));
+        ret = sendto(src, expect, i + 1, 0, (struct sockaddr *)&addr, sizeof(addr));
+        ok(ret == i + 1, "%u: sendto returned %d, error %u\n", i, ret, WSAGetLastError());
+    }
+
+    for (i = 0; i < ARRAY_SIZE(ov); i++)
+    {
+        ret = WaitForSingleObject(ov[i].hEvent, 1000);
+        ok(!ret, "%u: wait returned %d\n", i, ret);
+        bret = WSAGetOverlappedResult(dst, &ov[i], &size, FALSE, &recv_flags);
+        ok(bret, "%u: WSAGetOverlappedResult failed, error %u\n", i, WSAGetLastError());
+        ok(size == i + 1, "%u: got size %u\n", i, size);
+        memset(expect, 'a' + i, sizeof(expect));
+        ok(!memcmp(buffers[i], expect, i + 1), "%u: data did not match\n", i);
+        ok(buffers[i][i + 1] == (char)0xcc, "%u: buffer overrun\n", i);
+        ok(fromlen[i] == sizeof(from[i]), "%u: got address length %d\n", i, fromlen[i]);
+        ok(from[i].sin_family == AF_INET, "%u: got family %u\n", i, from[i].sin_family);
+        ok(from[i].sin_addr.s_addr == inet_addr("127.0.0.1"), "%u: got address %08x\n",
+           i, from[i].sin_addr.s_addr);
+        CloseHandle(ov[i].hEvent);
+    }
+
+    if (write_watch)
+    {
+        count = ARRAY_SIZE(results);
+        ret = pGetWriteWatch( 0, buffers, sizeof(*buffers), results, &count, &pagesize );
+        ok( !ret, "GetWriteWatch failed, error %u\n", GetLastError() );
+        ok( count == 1, "got count %lu\n", count );
+    }
+
+    closesocket(src);
+    closesocket(dst);
+    VirtualFree( buffers, 0, MEM_RELEASE );
+}
+
 static void test_getpeername(void)
 {
     SOCKET sock;
@@ -11557,6 +12094,7 @@ START_TEST( sock )
     test_WSASocket();
     test_WSADuplicateSocket();
     test_WSAEnumNetworkEvents();
+    test_WSAEnumNetworkEvents_read();
 
     test_WSAAddressToStringA();
     test_WSAAddressToStringW();
@@ -11567,6 +12105,7 @@ START_TEST( sock )
     test_errors();
     test_listen();
     test_select();
+    test_select_large_set();
     test_accept();
     test_getpeername();
     test_getsockname();
@@ -11590,10 +12129,14 @@ START_TEST( sock )
 
     test_ipv6only();
     test_TransmitFile();
+    test_rio();
+    test_overlapped_recvfrom_batch(FALSE);
+    test_overlapped_recvfrom_batch(TRUE);
     test_GetAddrInfoW();
     test_GetAddrInfoExW();
     test_getaddrinfo();
     test_AcceptEx();
+    test_AcceptEx_pending_connection();
     test_ConnectEx();
     test_DisconnectEx();
 
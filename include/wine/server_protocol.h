@@ -988,6 +988,26 @@ struct set_process_info_reply
 
 
 
+struct process_shm
+{
+    unsigned int  dup_serial;
+};
+
+
+struct get_process_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_process_shm_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
 struct get_thread_info_request
 {
     struct request_header __header;
@@ -1558,6 +1578,8 @@ struct get_handle_fd_reply
     int          cacheable;
     unsigned int access;
     unsigned int options;
+    int          completion;
+    char __pad_28[4];
 };
 enum server_fd_type
 {
@@ -1726,6 +1748,33 @@ struct set_socket_event_request
 struct set_socket_event_reply
 {
     struct reply_header __header;
+    unsigned int  shm_index;
+    unsigned int  shm_serial;
+};
+
+
+
+struct socket_shm
+{
+    unsigned int  seq;
+    unsigned int  serial;
+    unsigned int  mask;
+    unsigned int  pmask;
+    unsigned int  state;
+    unsigned int  signaled;
+};
+
+
+struct get_socket_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_socket_shm_reply
+{
+    struct reply_header __header;
+    obj_handle_t  handle;
+    char __pad_12[4];
 };
 
 
@@ -1792,6 +1841,19 @@ struct set_socket_deferred_reply
 };
 
 
+struct wake_socket_asyncs_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    int          type;
+    char __pad_20[4];
+};
+struct wake_socket_asyncs_reply
+{
+    struct reply_header __header;
+};
+
+
 struct alloc_console_request
 {
     struct request_header __header;
@@ -3031,6 +3093,13 @@ struct init_atom_table_reply
 
 
 
+struct queue_shm
+{
+    unsigned int  wake_bits;
+    unsigned int  changed_bits;
+};
+
+
 struct get_msg_queue_request
 {
     struct request_header __header;
@@ -3040,7 +3109,7 @@ struct get_msg_queue_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    obj_handle_t shm_handle;
 };
 
 
@@ -3119,6 +3188,28 @@ struct send_message_reply
     struct reply_header __header;
 };
 
+
+struct broadcast_message_request
+{
+    struct request_header __header;
+    int             type;
+    int             flags;
+    unsigned int    msg;
+    lparam_t        wparam;
+    lparam_t        lparam;
+    timeout_t       timeout;
+    data_size_t     wins_size;
+    /* VARARG(wins,user_handles,wins_size); */
+    /* VARARG(data,message_data); */
+    char __pad_52[4];
+};
+struct broadcast_message_reply
+{
+    struct reply_header __header;
+    unsigned int    count;
+    char __pad_12[4];
+};
+
 struct post_quit_message_request
 {
     struct request_header __header;
@@ -3566,6 +3657,41 @@ struct get_window_info_reply
 
 
 
+struct window_shm
+{
+    unsigned int   seq;
+    user_handle_t  handle;
+    user_handle_t  parent;
+    user_handle_t  owner;
+    process_id_t   pid;
+    thread_id_t    tid;
+    unsigned int   style;
+    unsigned int   ex_style;
+    unsigned int   id;
+    unsigned int   dpi;
+    unsigned int   is_unicode;
+    unsigned int   __pad;
+    mod_handle_t   instance;
+    lparam_t       user_data;
+    rectangle_t    window;
+    rectangle_t    client;
+};
+
+
+struct get_window_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_window_shm_reply
+{
+    struct reply_header __header;
+    obj_handle_t   handle;
+    char __pad_12[4];
+};
+
+
+
 struct set_window_info_request
 {
     struct request_header __header;
@@ -5377,14 +5503,14 @@ struct create_completion_request
     struct request_header __header;
     unsigned int access;
     unsigned int concurrent;
+    int          local;
     /* VARARG(objattr,object_attributes); */
-    char __pad_20[4];
 };
 struct create_completion_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          local;
 };
 
 
@@ -5439,6 +5565,40 @@ struct remove_completion_reply
 };
 
 
+struct completion_msg
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    unsigned int  __pad;
+};
+
+
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(msgs,completion_msgs); */
+};
+
+
+
+struct detach_completion_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+};
+struct detach_completion_reply
+{
+    struct reply_header __header;
+};
+
+
 
 struct query_completion_request
 {
@@ -5798,6 +5958,7 @@ enum request
     REQ_get_process_info,
     REQ_get_process_vm_counters,
     REQ_set_process_info,
+    REQ_get_process_shm,
     REQ_get_thread_info,
     REQ_get_thread_times,
     REQ_set_thread_info,
@@ -5843,10 +6004,12 @@ enum request
     REQ_accept_socket,
     REQ_accept_into_socket,
     REQ_set_socket_event,
+    REQ_get_socket_shm,
     REQ_get_socket_event,
     REQ_get_socket_info,
     REQ_enable_socket_event,
     REQ_set_socket_deferred,
+    REQ_wake_socket_asyncs,
     REQ_alloc_console,
     REQ_free_console,
     REQ_get_console_renderer_events,
@@ -5924,6 +6087,7 @@ enum request
     REQ_get_queue_status,
     REQ_get_process_idle_event,
     REQ_send_message,
+    REQ_broadcast_message,
     REQ_post_quit_message,
     REQ_send_hardware_message,
     REQ_get_message,
@@ -5949,6 +6113,7 @@ enum request
     REQ_get_desktop_window,
     REQ_set_window_owner,
     REQ_get_window_info,
+    REQ_get_window_shm,
     REQ_set_window_info,
     REQ_set_parent,
     REQ_get_window_parents,
@@ -6060,6 +6225,8 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
+    REQ_detach_completion,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -6102,6 +6269,7 @@ union generic_request
     struct get_process_info_request get_process_info_request;
     struct get_process_vm_counters_request get_process_vm_counters_request;
     struct set_process_info_request set_process_info_request;
+    struct get_process_shm_request get_process_shm_request;
     struct get_thread_info_request get_thread_info_request;
     struct get_thread_times_request get_thread_times_request;
     struct set_thread_info_request set_thread_info_request;
@@ -6147,10 +6315,12 @@ union generic_request
     struct accept_socket_request accept_socket_request;
     struct accept_into_socket_request accept_into_socket_request;
     struct set_socket_event_request set_socket_event_request;
+    struct get_socket_shm_request get_socket_shm_request;
     struct get_socket_event_request get_socket_event_request;
     struct get_socket_info_request get_socket_info_request;
     struct enable_socket_event_request enable_socket_event_request;
     struct set_socket_deferred_request set_socket_deferred_request;
+    struct wake_socket_asyncs_request wake_socket_asyncs_request;
     struct alloc_console_request alloc_console_request;
     struct free_console_request free_console_request;
     struct get_console_renderer_events_request get_console_renderer_events_request;
@@ -6228,6 +6398,7 @@ union generic_request
     struct get_queue_status_request get_queue_status_request;
     struct get_process_idle_event_request get_process_idle_event_request;
     struct send_message_request send_message_request;
+    struct broadcast_message_request broadcast_message_request;
     struct post_quit_message_request post_quit_message_request;
     struct send_hardware_message_request send_hardware_message_request;
     struct get_message_request get_message_request;
@@ -6253,6 +6424,7 @@ union generic_request
     struct get_desktop_window_request get_desktop_window_request;
     struct set_window_owner_request set_window_owner_request;
     struct get_window_info_request get_window_info_request;
+    struct get_window_shm_request get_window_shm_request;
     struct set_window_info_request set_window_info_request;
     struct set_parent_request set_parent_request;
     struct get_window_parents_request get_window_parents_request;
@@ -6364,6 +6536,8 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
+    struct detach_completion_request detach_completion_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -6404,6 +6578,7 @@ union generic_reply
     struct get_process_info_reply get_process_info_reply;
     struct get_process_vm_counters_reply get_process_vm_counters_reply;
     struct set_process_info_reply set_process_info_reply;
+    struct get_process_shm_reply get_process_shm_reply;
     struct get_thread_info_reply get_thread_info_reply;
     struct get_thread_times_reply get_thread_times_reply;
     struct set_thread_info_reply set_thread_info_reply;
@@ -6449,10 +6624,12 @@ union generic_reply
     struct accept_socket_reply accept_socket_reply;
     struct accept_into_socket_reply accept_into_socket_reply;
     struct set_socket_event_reply set_socket_event_reply;
+    struct get_socket_shm_reply get_socket_shm_reply;
     struct get_socket_event_reply get_socket_event_reply;
     struct get_socket_info_reply get_socket_info_reply;
     struct enable_socket_event_reply enable_socket_event_reply;
     struct set_socket_deferred_reply set_socket_deferred_reply;
+    struct wake_socket_asyncs_reply wake_socket_asyncs_reply;
     struct alloc_console_reply alloc_console_reply;
     struct free_console_reply free_console_reply;
     struct get_console_renderer_events_reply get_console_renderer_events_reply;
@@ -6530,6 +6707,7 @@ union generic_reply
     struct get_queue_status_reply get_queue_status_reply;
     struct get_process_idle_event_reply get_process_idle_event_reply;
     struct send_message_reply send_message_reply;
+    struct broadcast_message_reply broadcast_message_reply;
     struct post_quit_message_reply post_quit_message_reply;
     struct send_hardware_message_reply send_hardware_message_reply;
     struct get_message_reply get_message_reply;
@@ -6555,6 +6733,7 @@ union generic_reply
     struct get_desktop_window_reply get_desktop_window_reply;
     struct set_window_owner_reply set_window_owner_reply;
     struct get_window_info_reply get_window_info_reply;
+    struct get_window_shm_reply get_window_shm_reply;
     struct set_window_info_reply set_window_info_reply;
     struct set_parent_reply set_parent_reply;
     struct get_window_parents_reply get_window_parents_reply;
@@ -6666,6 +6845,8 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
+    struct detach_completion_reply detach_completion_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -6691,6 +6872,6 @@ union generic_reply
     struct resume_process_reply resume_process_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 588
+#define SERVER_PROTOCOL_VERSION 599
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
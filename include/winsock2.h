@@ -186,6 +186,7 @@ extern "C" {
 #define WS_SIO_ADDRESS_LIST_QUERY             _WSAIOR(WS_IOC_WS2,22)
 #define WS_SIO_ADDRESS_LIST_CHANGE            _WSAIO(WS_IOC_WS2,23)
 #define WS_SIO_QUERY_TARGET_PNP_HANDLE        _WSAIOR(WS_IOC_WS2,24)
+#define WS_SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER _WSAIORW(WS_IOC_WS2,36)
 #define WS_SIO_GET_INTERFACE_LIST             WS__IOR('t', 127, ULONG)
 #else /* USE_WS_PREFIX */
 #undef IOC_VOID
@@ -222,6 +223,7 @@ extern "C" {
 #define SIO_ADDRESS_LIST_QUERY     _WSAIOR(IOC_WS2,22)
 #define SIO_ADDRESS_LIST_CHANGE    _WSAIO(IOC_WS2,23)
 #define SIO_QUERY_TARGET_PNP_HANDLE _WSAIOR(IOC_WS2,24)
+#define SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER _WSAIORW(IOC_WS2,36)
 #define SIO_GET_INTERFACE_LIST     _IOR ('t', 127, ULONG)
 #endif /* USE_WS_PREFIX */
 
@@ -234,6 +236,7 @@ extern "C" {
 #define WSA_FLAG_ACCESS_SYSTEM_SECURITY 0x0040
 #define WSA_FLAG_NO_HANDLE_INHERIT      0x0080
 #define WSA_FLAG_REGISTERED_IO          0x0100
+#define WSA_FLAG_REGISTERED_IO          0x0100
 
 /* Constants for WSAJoinLeaf() */
 #define JL_SENDER_ONLY    0x01
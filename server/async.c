@@ -472,6 +472,18 @@ void async_wake_up( struct async_queue *queue, unsigned int status )
     }
 }
 
+/* alert all the async operations on the queue that are still waiting */
+void async_wake_up_waiting( struct async_queue *queue )
+{
+    struct list *ptr, *next;
+
+    LIST_FOR_EACH_SAFE( ptr, next, &queue->queue )
+    {
+        struct async *async = LIST_ENTRY( ptr, struct async, queue_entry );
+        if (async->status == STATUS_PENDING) async_terminate( async, STATUS_ALERTED );
+    }
+}
+
 static void iosb_dump( struct object *obj, int verbose );
 static void iosb_destroy( struct object *obj );
 
@@ -49,6 +49,7 @@ struct completion
     struct object  obj;
     struct list    queue;
     unsigned int   depth;
+    int            local;  /* queue is kept by the creator process */
 };
 
 static void completion_dump( struct object*, int );
@@ -143,12 +144,19 @@ static struct completion *create_completion( struct object *root, const struct u
         {
             list_init( &completion->queue );
             completion->depth = 0;
+            completion->local = 0;
         }
     }
 
     return completion;
 }
 
+/* check if the queue of a port is kept in the memory of its creator process */
+int is_local_completion( struct object *obj )
+{
+    return obj->ops == &completion_ops && ((struct completion *)obj)->local;
+}
+
 struct completion *get_completion_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
     return (struct completion *) get_handle_obj( process, handle, access, &completion_ops );
@@ -185,7 +193,15 @@ DECL_HANDLER(create_completion)
 
     if ((completion = create_completion( root, &name, objattr->attributes, req->concurrent, sd )))
     {
+        const unsigned int access = IO_COMPLETION_QUERY_STATE | IO_COMPLETION_MODIFY_STATE;
+        int created = get_error() != STATUS_OBJECT_NAME_EXISTS;
+
         reply->handle = alloc_handle( current->process, completion, req->access, objattr->attributes );
+        /* the client doesn't check access rights on a local queue */
+        if (reply->handle && created && req->local &&
+            (get_handle_access( current->process, reply->handle ) & access) == access)
+            completion->local = 1;
+        reply->local = completion->local;
         release_object( completion );
     }
 
@@ -241,6 +257,52 @@ DECL_HANDLER(remove_completion)
     release_object( completion );
 }
 
+/* get multiple completions from completion port */
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    struct completion_msg *msgs;
+    struct comp_msg *msg;
+    struct list *entry;
+    data_size_t i, count;
+
+    if (!completion) return;
+
+    count = min( completion->depth, get_reply_max_size() / sizeof(*msgs) );
+    if (!completion->depth) set_error( STATUS_PENDING );
+    else if (!count) set_error( STATUS_BUFFER_TOO_SMALL );
+    else if ((msgs = set_reply_data_size( count * sizeof(*msgs) )))
+    {
+        for (i = 0; i < count; i++)
+        {
+            entry = list_head( &completion->queue );
+            list_remove( entry );
+            completion->depth--;
+            msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
+            msgs[i].ckey = msg->ckey;
+            msgs[i].cvalue = msg->cvalue;
+            msgs[i].information = msg->information;
+            msgs[i].status = msg->status;
+            msgs[i].__pad = 0;
+            free( msg );
+        }
+    }
+
+    release_object( completion );
+}
+
+/* move the queue of a completion port out of the creator process */
+DECL_HANDLER(detach_completion)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, 0 );
+
+    if (!completion) return;
+
+    completion->local = 0;
+
+    release_object( completion );
+}
+
 /* get queue depth for completion port */
 DECL_HANDLER(query_completion)
 {
@@ -2527,6 +2527,8 @@ DECL_HANDLER(get_handle_fd)
         {
             reply->type = fd->fd_ops->get_fd_type( fd );
             reply->options = fd->options;
+            /* the client can only keep track of completion ports set through its own handle */
+            reply->completion = (fd->completion != NULL || is_handle_shared( current->process, req->handle ));
             reply->access = get_handle_access( current->process, req->handle );
             send_client_fd( current->process, unix_fd, req->handle );
         }
@@ -157,6 +157,7 @@ extern struct mapping *get_mapping_obj( struct process *process, obj_handle_t ha
 extern struct file *get_mapping_file( struct process *process, client_ptr_t base,
                                       unsigned int access, unsigned int sharing );
 extern void free_mapped_views( struct process *process );
+extern struct object *create_anonymous_mapping( mem_size_t size, void **ptr );
 extern int get_page_size(void);
 
 /* device functions */
@@ -176,6 +177,7 @@ extern struct dir *get_dir_obj( struct process *process, obj_handle_t handle, un
 /* completion */
 
 extern struct completion *get_completion_obj( struct process *process, obj_handle_t handle, unsigned int access );
+extern int is_local_completion( struct object *obj );
 extern void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
                             unsigned int status, apc_param_t information );
 
@@ -196,6 +198,7 @@ extern void set_async_pending( struct async *async, int signal );
 extern int async_waiting( struct async_queue *queue );
 extern void async_terminate( struct async *async, unsigned int status );
 extern void async_wake_up( struct async_queue *queue, unsigned int status );
+extern void async_wake_up_waiting( struct async_queue *queue );
 extern struct completion *fd_get_completion( struct fd *fd, apc_param_t *p_key );
 extern void fd_copy_completion( struct fd *src, struct fd *dst );
 extern struct iosb *create_iosb( const void *in_data, data_size_t in_size, data_size_t out_size );
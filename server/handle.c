@@ -33,6 +33,7 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "process.h"
 #include "thread.h"
@@ -467,6 +468,16 @@ unsigned int get_handle_access( struct process *process, obj_handle_t handle )
     return entry->access & ~RESERVED_ALL;
 }
 
+/* check whether the object of a handle may be reached from another handle or process */
+int is_handle_shared( struct process *process, obj_handle_t handle )
+{
+    struct handle_entry *entry;
+
+    if (get_magic_handle( handle )) return 1;
+    if (!(entry = get_handle( process, handle ))) return 1;
+    return (entry->access & RESERVED_INHERIT) || entry->ptr->handle_count > 1;
+}
+
 /* find the first inherited handle of the given type */
 /* this is needed for window stations and desktops (don't ask...) */
 obj_handle_t find_inherited_handle( struct process *process, const struct object_ops *ops )
@@ -636,10 +647,27 @@ DECL_HANDLER(set_handle_info)
 DECL_HANDLER(dup_handle)
 {
     struct process *src, *dst = NULL;
+    struct object *obj;
+    int local = 0;
 
     reply->handle = 0;
     if ((src = get_process_from_handle( req->src_process, PROCESS_DUP_HANDLE )))
     {
+        if ((obj = get_handle_obj( src, req->src_handle, 0, NULL )))
+        {
+            local = is_local_completion( obj );
+            release_object( obj );
+        }
+
+        /* the queue of the port is in the memory of its process,
+         * which moves it to the server before duplicating the handle */
+        if (local)
+        {
+            set_error( STATUS_NOT_SUPPORTED );
+            release_object( src );
+            return;
+        }
+
         if (req->options & DUP_HANDLE_MAKE_GLOBAL)
         {
             reply->handle = duplicate_handle( src, req->src_handle, NULL,
@@ -649,8 +677,13 @@ DECL_HANDLER(dup_handle)
         {
             reply->handle = duplicate_handle( src, req->src_handle, dst,
                                               req->access, req->attributes, req->options );
+            /* the client caches whether its handles are shared,
+             * let it know when they may have become shared behind its back */
+            if (reply->handle && dst != current->process && dst != src && dst->shm)
+                dst->shm->dup_serial++;
             release_object( dst );
         }
+        if (reply->handle && src != current->process && src->shm) src->shm->dup_serial++;
         /* close the handle no matter what happened */
         if ((req->options & DUP_HANDLE_CLOSE_SOURCE) && (src != dst || req->src_handle != reply->handle))
             reply->closed = !close_handle( src, req->src_handle );
@@ -42,6 +42,7 @@ extern unsigned int close_handle( struct process *process, obj_handle_t handle )
 extern struct object *get_handle_obj( struct process *process, obj_handle_t handle,
                                       unsigned int access, const struct object_ops *ops );
 extern unsigned int get_handle_access( struct process *process, obj_handle_t handle );
+extern int is_handle_shared( struct process *process, obj_handle_t handle );
 extern obj_handle_t duplicate_handle( struct process *src, obj_handle_t src_handle, struct process *dst,
                                       unsigned int access, unsigned int attr, unsigned int options );
 extern obj_handle_t open_object( struct process *process, obj_handle_t parent, unsigned int access,
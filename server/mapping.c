@@ -877,6 +877,27 @@ static struct object *create_mapping( struct object *root, const struct unicode_
     return NULL;
 }
 
+/* create an anonymous mapping that is also mapped read-write in the server address space */
+struct object *create_anonymous_mapping( mem_size_t size, void **ptr )
+{
+    struct mapping *mapping;
+    int unix_fd;
+
+    if (!(mapping = (struct mapping *)create_mapping( NULL, NULL, 0, size, SEC_COMMIT, 0, 0, NULL )))
+        return NULL;
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1) goto error;
+    if ((*ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, unix_fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        goto error;
+    }
+    return &mapping->obj;
+
+ error:
+    release_object( mapping );
+    return NULL;
+}
+
 struct mapping *get_mapping_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
     return (struct mapping *)get_handle_obj( process, handle, access, &mapping_ops );
@@ -36,6 +36,9 @@
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -529,6 +532,8 @@ struct process *create_process( int fd, struct process *parent, int inherit_all,
     process->trace_data      = 0;
     process->rawinput_mouse  = NULL;
     process->rawinput_kbd    = NULL;
+    process->shm_mapping     = NULL;
+    process->shm             = NULL;
     list_init( &process->kernel_object );
     list_init( &process->thread_list );
     list_init( &process->locks );
@@ -626,6 +631,8 @@ static void process_destroy( struct object *obj )
     if (process->exe_file) release_object( process->exe_file );
     if (process->id) free_ptid( process->id );
     if (process->token) release_object( process->token );
+    if (process->shm) munmap( process->shm, sizeof(*process->shm) );
+    if (process->shm_mapping) release_object( process->shm_mapping );
     free( process->dir_cache );
 }
 
@@ -1496,6 +1503,21 @@ DECL_HANDLER(set_process_info)
     }
 }
 
+/* get the section holding the shared state of the current process */
+DECL_HANDLER(get_process_shm)
+{
+    struct process *process = current->process;
+
+    if (!process->shm_mapping)
+    {
+        void *ptr;
+
+        if (!(process->shm_mapping = create_anonymous_mapping( sizeof(*process->shm), &ptr ))) return;
+        process->shm = ptr;
+    }
+    reply->handle = alloc_handle( process, process->shm_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 );
+}
+
 /* read data from a process address space */
 DECL_HANDLER(read_process_memory)
 {
@@ -98,6 +98,8 @@ struct process
     const struct rawinput_device *rawinput_mouse; /* rawinput mouse device, if any */
     const struct rawinput_device *rawinput_kbd;   /* rawinput keyboard device, if any */
     struct list          kernel_object;   /* list of kernel object pointers */
+    struct object       *shm_mapping;     /* mapping for the state shared with the client */
+    struct process_shm  *shm;             /* server view of the shared state */
 };
 
 struct process_snapshot
@@ -28,6 +28,9 @@
 #ifdef HAVE_POLL_H
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -140,6 +143,8 @@ struct msg_queue
     struct thread_input   *input;           /* thread input descriptor */
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
+    struct object         *shm_mapping;     /* mapping for the state shared with the client */
+    struct queue_shm      *shm;             /* server view of the shared state */
 };
 
 struct hotkey
@@ -300,6 +305,8 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->input           = (struct thread_input *)grab_object( input );
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
+        queue->shm_mapping     = NULL;
+        queue->shm             = NULL;
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -448,11 +455,20 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
+/* publish the queue bits to the client */
+static inline void update_shared_bits( struct msg_queue *queue )
+{
+    if (!queue->shm) return;
+    queue->shm->wake_bits    = queue->wake_bits;
+    queue->shm->changed_bits = queue->changed_bits;
+}
+
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_shared_bits( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -461,6 +477,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_shared_bits( queue );
 }
 
 /* check whether msg is a keyboard message */
@@ -1008,6 +1025,8 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    if (queue->shm) munmap( queue->shm, sizeof(*queue->shm) );
+    if (queue->shm_mapping) release_object( queue->shm_mapping );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -2179,7 +2198,23 @@ DECL_HANDLER(get_msg_queue)
     struct msg_queue *queue = get_current_queue();
 
     reply->handle = 0;
-    if (queue) reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+    reply->shm_handle = 0;
+    if (!queue) return;
+    reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+
+    if (!queue->shm_mapping)
+    {
+        void *ptr;
+
+        if ((queue->shm_mapping = create_anonymous_mapping( sizeof(*queue->shm), &ptr )))
+        {
+            queue->shm = ptr;
+            update_shared_bits( queue );
+        }
+        else clear_error();  /* the shared state is optional */
+    }
+    if (queue->shm_mapping)
+        reply->shm_handle = alloc_handle( current->process, queue->shm_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 );
 }
 
 
@@ -2238,6 +2273,7 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_shared_bits( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
@@ -2323,6 +2359,76 @@ DECL_HANDLER(send_message)
     release_object( thread );
 }
 
+/* send a message to the queues of a list of windows */
+DECL_HANDLER(broadcast_message)
+{
+    struct msg_queue *send_queue = get_current_queue();
+    const user_handle_t *wins = get_req_data();
+    const void *data = (const char *)get_req_data() + req->wins_size;
+    data_size_t data_size;
+    unsigned int i;
+
+    reply->count = 0;
+    if (req->wins_size > get_req_data_size() || req->wins_size % sizeof(*wins))
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    switch (req->type)
+    {
+    case MSG_OTHER_PROCESS:
+    case MSG_ASCII:
+    case MSG_UNICODE:
+        break;
+    default:  /* messages that don't wait for a reply don't need batching */
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    if (!send_queue) return;
+    data_size = get_req_data_size() - req->wins_size;
+
+    for (i = 0; i < req->wins_size / sizeof(*wins); i++)
+    {
+        struct thread *thread;
+        struct message *msg;
+
+        if (!(thread = get_window_thread( wins[i] ))) continue;
+        if (thread == current || !thread->queue ||
+            ((req->flags & SEND_MSG_ABORT_IF_HUNG) && is_queue_hung( thread->queue )))
+        {
+            release_object( thread );
+            continue;
+        }
+        if (!(msg = mem_alloc( sizeof(*msg) )))
+        {
+            release_object( thread );
+            break;
+        }
+        msg->type      = req->type;
+        msg->win       = get_user_full_handle( wins[i] );
+        msg->msg       = req->msg;
+        msg->wparam    = req->wparam;
+        msg->lparam    = req->lparam;
+        msg->result    = NULL;
+        msg->data      = NULL;
+        msg->data_size = data_size;
+
+        get_message_defaults( thread->queue, &msg->x, &msg->y, &msg->time );
+
+        if ((msg->data_size && !(msg->data = memdup( data, msg->data_size ))) ||
+            !(msg->result = alloc_message_result( send_queue, thread->queue, msg, req->timeout )))
+        {
+            free_message( msg );
+            release_object( thread );
+            break;
+        }
+        list_add_tail( &thread->queue->msg_list[SEND_MESSAGE], &msg->entry );
+        set_queue_bits( thread->queue, QS_SENDMESSAGE );
+        reply->count++;
+        release_object( thread );
+    }
+}
+
 /* send a hardware message to a thread queue */
 DECL_HANDLER(send_hardware_message)
 {
@@ -2414,6 +2520,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_shared_bits( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -124,6 +124,7 @@ DECL_HANDLER(terminate_thread);
 DECL_HANDLER(get_process_info);
 DECL_HANDLER(get_process_vm_counters);
 DECL_HANDLER(set_process_info);
+DECL_HANDLER(get_process_shm);
 DECL_HANDLER(get_thread_info);
 DECL_HANDLER(get_thread_times);
 DECL_HANDLER(set_thread_info);
@@ -169,10 +170,12 @@ DECL_HANDLER(create_socket);
 DECL_HANDLER(accept_socket);
 DECL_HANDLER(accept_into_socket);
 DECL_HANDLER(set_socket_event);
+DECL_HANDLER(get_socket_shm);
 DECL_HANDLER(get_socket_event);
 DECL_HANDLER(get_socket_info);
 DECL_HANDLER(enable_socket_event);
 DECL_HANDLER(set_socket_deferred);
+DECL_HANDLER(wake_socket_asyncs);
 DECL_HANDLER(alloc_console);
 DECL_HANDLER(free_console);
 DECL_HANDLER(get_console_renderer_events);
@@ -250,6 +253,7 @@ DECL_HANDLER(set_queue_mask);
 DECL_HANDLER(get_queue_status);
 DECL_HANDLER(get_process_idle_event);
 DECL_HANDLER(send_message);
+DECL_HANDLER(broadcast_message);
 DECL_HANDLER(post_quit_message);
 DECL_HANDLER(send_hardware_message);
 DECL_HANDLER(get_message);
@@ -275,6 +279,7 @@ DECL_HANDLER(destroy_window);
 DECL_HANDLER(get_desktop_window);
 DECL_HANDLER(set_window_owner);
 DECL_HANDLER(get_window_info);
+DECL_HANDLER(get_window_shm);
 DECL_HANDLER(set_window_info);
 DECL_HANDLER(set_parent);
 DECL_HANDLER(get_window_parents);
@@ -386,6 +391,8 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
+DECL_HANDLER(detach_completion);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
@@ -427,6 +434,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_process_info,
     (req_handler)req_get_process_vm_counters,
     (req_handler)req_set_process_info,
+    (req_handler)req_get_process_shm,
     (req_handler)req_get_thread_info,
     (req_handler)req_get_thread_times,
     (req_handler)req_set_thread_info,
@@ -472,10 +480,12 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_accept_socket,
     (req_handler)req_accept_into_socket,
     (req_handler)req_set_socket_event,
+    (req_handler)req_get_socket_shm,
     (req_handler)req_get_socket_event,
     (req_handler)req_get_socket_info,
     (req_handler)req_enable_socket_event,
     (req_handler)req_set_socket_deferred,
+    (req_handler)req_wake_socket_asyncs,
     (req_handler)req_alloc_console,
     (req_handler)req_free_console,
     (req_handler)req_get_console_renderer_events,
@@ -553,6 +563,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_queue_status,
     (req_handler)req_get_process_idle_event,
     (req_handler)req_send_message,
+    (req_handler)req_broadcast_message,
     (req_handler)req_post_quit_message,
     (req_handler)req_send_hardware_message,
     (req_handler)req_get_message,
@@ -578,6 +589,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_desktop_window,
     (req_handler)req_set_window_owner,
     (req_handler)req_get_window_info,
+    (req_handler)req_get_window_shm,
     (req_handler)req_set_window_info,
     (req_handler)req_set_parent,
     (req_handler)req_get_window_parents,
@@ -689,6 +701,8 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
+    (req_handler)req_detach_completion,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
@@ -839,6 +853,9 @@ C_ASSERT( FIELD_OFFSET(struct set_process_info_request, mask) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_process_info_request, priority) == 20 );
 C_ASSERT( FIELD_OFFSET(struct set_process_info_request, affinity) == 24 );
 C_ASSERT( sizeof(struct set_process_info_request) == 32 );
+C_ASSERT( sizeof(struct get_process_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_process_shm_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_process_shm_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_info_request, tid_in) == 16 );
 C_ASSERT( sizeof(struct get_thread_info_request) == 24 );
@@ -1041,7 +1058,8 @@ C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, cacheable) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, access) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, options) == 20 );
-C_ASSERT( sizeof(struct get_handle_fd_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, completion) == 24 );
+C_ASSERT( sizeof(struct get_handle_fd_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_directory_cache_entry_request, handle) == 12 );
 C_ASSERT( sizeof(struct get_directory_cache_entry_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_directory_cache_entry_reply, entry) == 8 );
@@ -1095,6 +1113,12 @@ C_ASSERT( FIELD_OFFSET(struct set_socket_event_request, event) == 20 );
 C_ASSERT( FIELD_OFFSET(struct set_socket_event_request, window) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_socket_event_request, msg) == 28 );
 C_ASSERT( sizeof(struct set_socket_event_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct set_socket_event_reply, shm_index) == 8 );
+C_ASSERT( FIELD_OFFSET(struct set_socket_event_reply, shm_serial) == 12 );
+C_ASSERT( sizeof(struct set_socket_event_reply) == 16 );
+C_ASSERT( sizeof(struct get_socket_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_socket_shm_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_socket_shm_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_socket_event_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_socket_event_request, service) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_socket_event_request, c_event) == 20 );
@@ -1117,6 +1141,9 @@ C_ASSERT( sizeof(struct enable_socket_event_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct set_socket_deferred_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_socket_deferred_request, deferred) == 16 );
 C_ASSERT( sizeof(struct set_socket_deferred_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct wake_socket_asyncs_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct wake_socket_asyncs_request, type) == 16 );
+C_ASSERT( sizeof(struct wake_socket_asyncs_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct alloc_console_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct alloc_console_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct alloc_console_request, pid) == 20 );
@@ -1521,6 +1548,7 @@ C_ASSERT( FIELD_OFFSET(struct init_atom_table_reply, table) == 8 );
 C_ASSERT( sizeof(struct init_atom_table_reply) == 16 );
 C_ASSERT( sizeof(struct get_msg_queue_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, shm_handle) == 12 );
 C_ASSERT( sizeof(struct get_msg_queue_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_fd_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_queue_fd_request) == 16 );
@@ -1549,6 +1577,16 @@ C_ASSERT( FIELD_OFFSET(struct send_message_request, wparam) == 32 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, lparam) == 40 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, timeout) == 48 );
 C_ASSERT( sizeof(struct send_message_request) == 56 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_request, type) == 12 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_request, flags) == 16 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_request, msg) == 20 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_request, wparam) == 24 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_request, lparam) == 32 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_request, timeout) == 40 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_request, wins_size) == 48 );
+C_ASSERT( sizeof(struct broadcast_message_request) == 56 );
+C_ASSERT( FIELD_OFFSET(struct broadcast_message_reply, count) == 8 );
+C_ASSERT( sizeof(struct broadcast_message_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct post_quit_message_request, exit_code) == 12 );
 C_ASSERT( sizeof(struct post_quit_message_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct send_hardware_message_request, win) == 12 );
@@ -1704,6 +1742,9 @@ C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, is_unicode) == 28 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, dpi) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, awareness) == 36 );
 C_ASSERT( sizeof(struct get_window_info_reply) == 40 );
+C_ASSERT( sizeof(struct get_window_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_window_shm_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_window_shm_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, flags) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, is_unicode) == 14 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, handle) == 16 );
@@ -2324,8 +2365,10 @@ C_ASSERT( FIELD_OFFSET(struct get_token_statistics_reply, privilege_count) == 36
 C_ASSERT( sizeof(struct get_token_statistics_reply) == 40 );
 C_ASSERT( FIELD_OFFSET(struct create_completion_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_completion_request, concurrent) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_completion_request, local) == 20 );
 C_ASSERT( sizeof(struct create_completion_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_completion_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct create_completion_reply, local) == 12 );
 C_ASSERT( sizeof(struct create_completion_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_completion_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct open_completion_request, attributes) == 16 );
@@ -2346,6 +2389,11 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
+C_ASSERT( FIELD_OFFSET(struct detach_completion_request, handle) == 12 );
+C_ASSERT( sizeof(struct detach_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
@@ -22,6 +22,7 @@
  */
 
 #include "config.h"
+#include "wine/port.h"
 
 #include <assert.h>
 #include <fcntl.h>
@@ -117,8 +118,20 @@ struct sock
     struct async_queue  ifchange_q;  /* queue for interface change notifications */
     struct object      *ifchange_obj; /* the interface change notification object */
     struct list         ifchange_entry; /* entry in ifchange notification list */
+    unsigned int        shm_index;   /* index of the entry in the shared section + 1, or 0 */
+    unsigned int        signaled;    /* event signaled since it was last serviced? */
 };
 
+/* section holding the socket event state shared with the clients */
+#define SOCKET_SHM_ENTRIES 65536
+
+static struct object *socket_shm_mapping;
+static struct socket_shm *socket_shm;
+static unsigned int *socket_shm_free;       /* stack of free entries */
+static unsigned int socket_shm_free_count;
+static unsigned int socket_shm_used;        /* number of entries used so far */
+static unsigned int socket_shm_serial;      /* last serial number given to a socket */
+
 static void sock_dump( struct object *obj, int verbose );
 static int sock_signaled( struct object *obj, struct wait_queue_entry *entry );
 static struct fd *sock_get_fd( struct object *obj );
@@ -251,10 +264,78 @@ void sock_init(void)
     }
 }
 
+/* publish the event state of a socket to the clients */
+static void sock_update_shm( struct sock *sock )
+{
+    struct socket_shm *shm;
+
+    if (!sock->shm_index) return;
+    shm = &socket_shm[sock->shm_index - 1];
+
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    shm->mask     = sock->mask;
+    shm->pmask    = sock->pmask;
+    shm->state    = sock->state;
+    shm->signaled = sock->signaled;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+}
+
+/* allocate an entry for the socket in the shared section */
+static void sock_alloc_shm( struct sock *sock )
+{
+    struct socket_shm *shm;
+    unsigned int index;
+    void *ptr;
+
+    if (sock->shm_index) return;
+
+    if (!socket_shm_mapping)
+    {
+        if (!(socket_shm_free = malloc( SOCKET_SHM_ENTRIES * sizeof(*socket_shm_free) ))) return;
+        if (!(socket_shm_mapping = create_anonymous_mapping( SOCKET_SHM_ENTRIES * sizeof(*socket_shm), &ptr )))
+        {
+            free( socket_shm_free );
+            socket_shm_free = NULL;
+            clear_error();
+            return;
+        }
+        socket_shm = ptr;
+    }
+
+    if (socket_shm_free_count) index = socket_shm_free[--socket_shm_free_count];
+    else if (socket_shm_used < SOCKET_SHM_ENTRIES) index = socket_shm_used++;
+    else return;  /* the shared state is optional */
+
+    if (!++socket_shm_serial) socket_shm_serial++;
+    shm = &socket_shm[index];
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    shm->serial = socket_shm_serial;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    sock->shm_index = index + 1;
+    sock_update_shm( sock );
+}
+
+/* release the entry of the socket in the shared section */
+static void sock_free_shm( struct sock *sock )
+{
+    struct socket_shm *shm;
+
+    if (!sock->shm_index) return;
+    shm = &socket_shm[sock->shm_index - 1];
+
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    shm->serial = 0;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    socket_shm_free[socket_shm_free_count++] = sock->shm_index - 1;
+    sock->shm_index = 0;
+}
+
 static int sock_reselect( struct sock *sock )
 {
     int ev = sock_get_poll_events( sock->fd );
 
+    sock_update_shm( sock );
+
     if (debug_level)
         fprintf(stderr,"sock_reselect(%p): new mask %x\n", sock, ev);
 
@@ -283,6 +364,8 @@ static void sock_wake_up( struct sock *sock )
     {
         if (debug_level) fprintf(stderr, "signalling events %x ptr %p\n", events, sock->event );
         set_event( sock->event );
+        sock->signaled = 1;
+        sock_update_shm( sock );
     }
     if (sock->window)
     {
@@ -623,6 +706,7 @@ static void sock_destroy( struct object *obj )
     free_async_queue( &sock->write_q );
     free_async_queue( &sock->ifchange_q );
     if (sock->event) release_object( sock->event );
+    sock_free_shm( sock );
     if (sock->fd)
     {
         /* shut the socket down to force pending poll() calls in the client to return */
@@ -648,6 +732,8 @@ static void init_sock(struct sock *sock)
     sock->connect_time = 0;
     sock->deferred = NULL;
     sock->ifchange_obj = NULL;
+    sock->shm_index = 0;
+    sock->signaled = 0;
     init_async_queue( &sock->read_q );
     init_async_queue( &sock->write_q );
     init_async_queue( &sock->ifchange_q );
@@ -1247,6 +1333,11 @@ DECL_HANDLER(set_socket_event)
        (when dealing with Asynchronous socket)  */
     sock_wake_up( sock );
 
+    sock_alloc_shm( sock );
+    sock_update_shm( sock );
+    reply->shm_index  = sock->shm_index;
+    reply->shm_serial = sock->shm_index ? socket_shm[sock->shm_index - 1].serial : 0;
+
     if (old_event) release_object( old_event ); /* we're through with it */
     release_object( &sock->obj );
 }
@@ -1272,6 +1363,7 @@ DECL_HANDLER(get_socket_event)
             if (cevent)
             {
                 reset_event( cevent );
+                if (cevent == sock->event) sock->signaled = 0;
                 release_object( cevent );
             }
         }
@@ -1321,6 +1413,33 @@ DECL_HANDLER(set_socket_deferred)
     release_object( sock );
 }
 
+/* alert the waiting asyncs of a socket */
+DECL_HANDLER(wake_socket_asyncs)
+{
+    struct sock *sock;
+    unsigned int access = req->type == ASYNC_TYPE_WRITE ? FILE_WRITE_DATA : FILE_READ_DATA;
+
+    if (req->type != ASYNC_TYPE_READ && req->type != ASYNC_TYPE_WRITE)
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    if (!(sock = (struct sock *)get_handle_obj( current->process, req->handle, access, &sock_ops )))
+        return;
+
+    if (req->type == ASYNC_TYPE_READ) async_wake_up_waiting( &sock->read_q );
+    else async_wake_up_waiting( &sock->write_q );
+
+    release_object( &sock->obj );
+}
+
+DECL_HANDLER(get_socket_shm)
+{
+    reply->handle = 0;
+    if (socket_shm_mapping)
+        reply->handle = alloc_handle( current->process, socket_shm_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 );
+}
+
 DECL_HANDLER(get_socket_info)
 {
     struct sock *sock;
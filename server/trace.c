@@ -1235,6 +1235,25 @@ static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_completion_msgs( const char *prefix, data_size_t size )
+{
+    const struct completion_msg *msg;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*msg))
+    {
+        msg = cur_data;
+        dump_uint64( "{ckey=", &msg->ckey );
+        dump_uint64( ",cvalue=", &msg->cvalue );
+        dump_uint64( ",information=", &msg->information );
+        fprintf( stderr, ",status=%08x}", msg->status );
+        size -= sizeof(*msg);
+        remove_data( sizeof(*msg) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -1407,6 +1426,15 @@ static void dump_set_process_info_request( const struct set_process_info_request
     dump_uint64( ", affinity=", &req->affinity );
 }
 
+static void dump_get_process_shm_request( const struct get_process_shm_request *req )
+{
+}
+
+static void dump_get_process_shm_reply( const struct get_process_shm_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_get_thread_info_request( const struct get_thread_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1822,6 +1850,7 @@ static void dump_get_handle_fd_reply( const struct get_handle_fd_reply *req )
     fprintf( stderr, ", cacheable=%d", req->cacheable );
     fprintf( stderr, ", access=%08x", req->access );
     fprintf( stderr, ", options=%08x", req->options );
+    fprintf( stderr, ", completion=%d", req->completion );
 }
 
 static void dump_get_directory_cache_entry_request( const struct get_directory_cache_entry_request *req )
@@ -1931,6 +1960,21 @@ static void dump_set_socket_event_request( const struct set_socket_event_request
     fprintf( stderr, ", msg=%08x", req->msg );
 }
 
+static void dump_set_socket_event_reply( const struct set_socket_event_reply *req )
+{
+    fprintf( stderr, " shm_index=%08x", req->shm_index );
+    fprintf( stderr, ", shm_serial=%08x", req->shm_serial );
+}
+
+static void dump_get_socket_shm_request( const struct get_socket_shm_request *req )
+{
+}
+
+static void dump_get_socket_shm_reply( const struct get_socket_shm_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_get_socket_event_request( const struct get_socket_event_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1972,6 +2016,12 @@ static void dump_set_socket_deferred_request( const struct set_socket_deferred_r
     fprintf( stderr, ", deferred=%04x", req->deferred );
 }
 
+static void dump_wake_socket_asyncs_request( const struct wake_socket_asyncs_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", type=%d", req->type );
+}
+
 static void dump_alloc_console_request( const struct alloc_console_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -2768,6 +2818,7 @@ static void dump_get_msg_queue_request( const struct get_msg_queue_request *req
 static void dump_get_msg_queue_reply( const struct get_msg_queue_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_handle=%04x", req->shm_handle );
 }
 
 static void dump_set_queue_fd_request( const struct set_queue_fd_request *req )
@@ -2822,6 +2873,24 @@ static void dump_send_message_request( const struct send_message_request *req )
     dump_varargs_message_data( ", data=", cur_size );
 }
 
+static void dump_broadcast_message_request( const struct broadcast_message_request *req )
+{
+    fprintf( stderr, " type=%d", req->type );
+    fprintf( stderr, ", flags=%d", req->flags );
+    fprintf( stderr, ", msg=%08x", req->msg );
+    dump_uint64( ", wparam=", &req->wparam );
+    dump_uint64( ", lparam=", &req->lparam );
+    dump_timeout( ", timeout=", &req->timeout );
+    fprintf( stderr, ", wins_size=%u", req->wins_size );
+    dump_varargs_user_handles( ", wins=", min(cur_size,req->wins_size) );
+    dump_varargs_message_data( ", data=", cur_size );
+}
+
+static void dump_broadcast_message_reply( const struct broadcast_message_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+}
+
 static void dump_post_quit_message_request( const struct post_quit_message_request *req )
 {
     fprintf( stderr, " exit_code=%d", req->exit_code );
@@ -3109,6 +3178,15 @@ static void dump_get_window_info_reply( const struct get_window_info_reply *req
     fprintf( stderr, ", awareness=%d", req->awareness );
 }
 
+static void dump_get_window_shm_request( const struct get_window_shm_request *req )
+{
+}
+
+static void dump_get_window_shm_reply( const struct get_window_shm_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_set_window_info_request( const struct set_window_info_request *req )
 {
     fprintf( stderr, " flags=%04x", req->flags );
@@ -4366,12 +4444,14 @@ static void dump_create_completion_request( const struct create_completion_reque
 {
     fprintf( stderr, " access=%08x", req->access );
     fprintf( stderr, ", concurrent=%08x", req->concurrent );
+    fprintf( stderr, ", local=%d", req->local );
     dump_varargs_object_attributes( ", objattr=", cur_size );
 }
 
 static void dump_create_completion_reply( const struct create_completion_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", local=%d", req->local );
 }
 
 static void dump_open_completion_request( const struct open_completion_request *req )
@@ -4409,6 +4489,21 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_msgs( " msgs=", cur_size );
+}
+
+static void dump_detach_completion_request( const struct detach_completion_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4609,6 +4704,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_process_info_request,
     (dump_func)dump_get_process_vm_counters_request,
     (dump_func)dump_set_process_info_request,
+    (dump_func)dump_get_process_shm_request,
     (dump_func)dump_get_thread_info_request,
     (dump_func)dump_get_thread_times_request,
     (dump_func)dump_set_thread_info_request,
@@ -4654,10 +4750,12 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_accept_socket_request,
     (dump_func)dump_accept_into_socket_request,
     (dump_func)dump_set_socket_event_request,
+    (dump_func)dump_get_socket_shm_request,
     (dump_func)dump_get_socket_event_request,
     (dump_func)dump_get_socket_info_request,
     (dump_func)dump_enable_socket_event_request,
     (dump_func)dump_set_socket_deferred_request,
+    (dump_func)dump_wake_socket_asyncs_request,
     (dump_func)dump_alloc_console_request,
     (dump_func)dump_free_console_request,
     (dump_func)dump_get_console_renderer_events_request,
@@ -4735,6 +4833,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_queue_status_request,
     (dump_func)dump_get_process_idle_event_request,
     (dump_func)dump_send_message_request,
+    (dump_func)dump_broadcast_message_request,
     (dump_func)dump_post_quit_message_request,
     (dump_func)dump_send_hardware_message_request,
     (dump_func)dump_get_message_request,
@@ -4760,6 +4859,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_desktop_window_request,
     (dump_func)dump_set_window_owner_request,
     (dump_func)dump_get_window_info_request,
+    (dump_func)dump_get_window_shm_request,
     (dump_func)dump_set_window_info_request,
     (dump_func)dump_set_parent_request,
     (dump_func)dump_get_window_parents_request,
@@ -4871,6 +4971,8 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
+    (dump_func)dump_detach_completion_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
@@ -4909,6 +5011,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_process_info_reply,
     (dump_func)dump_get_process_vm_counters_reply,
     NULL,
+    (dump_func)dump_get_process_shm_reply,
     (dump_func)dump_get_thread_info_reply,
     (dump_func)dump_get_thread_times_reply,
     NULL,
@@ -4953,11 +5056,13 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_socket_reply,
     (dump_func)dump_accept_socket_reply,
     NULL,
-    NULL,
+    (dump_func)dump_set_socket_event_reply,
+    (dump_func)dump_get_socket_shm_reply,
     (dump_func)dump_get_socket_event_reply,
     (dump_func)dump_get_socket_info_reply,
     NULL,
     NULL,
+    NULL,
     (dump_func)dump_alloc_console_reply,
     NULL,
     (dump_func)dump_get_console_renderer_events_reply,
@@ -5035,6 +5140,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_queue_status_reply,
     (dump_func)dump_get_process_idle_event_reply,
     NULL,
+    (dump_func)dump_broadcast_message_reply,
     NULL,
     (dump_func)dump_send_hardware_message_reply,
     (dump_func)dump_get_message_reply,
@@ -5060,6 +5166,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_desktop_window_reply,
     (dump_func)dump_set_window_owner_reply,
     (dump_func)dump_get_window_info_reply,
+    (dump_func)dump_get_window_shm_reply,
     (dump_func)dump_set_window_info_reply,
     (dump_func)dump_set_parent_reply,
     (dump_func)dump_get_window_parents_reply,
@@ -5171,6 +5278,8 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
+    NULL,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
@@ -5209,6 +5318,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_process_info",
     "get_process_vm_counters",
     "set_process_info",
+    "get_process_shm",
     "get_thread_info",
     "get_thread_times",
     "set_thread_info",
@@ -5254,10 +5364,12 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "accept_socket",
     "accept_into_socket",
     "set_socket_event",
+    "get_socket_shm",
     "get_socket_event",
     "get_socket_info",
     "enable_socket_event",
     "set_socket_deferred",
+    "wake_socket_asyncs",
     "alloc_console",
     "free_console",
     "get_console_renderer_events",
@@ -5335,6 +5447,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_queue_status",
     "get_process_idle_event",
     "send_message",
+    "broadcast_message",
     "post_quit_message",
     "send_hardware_message",
     "get_message",
@@ -5360,6 +5473,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_desktop_window",
     "set_window_owner",
     "get_window_info",
+    "get_window_shm",
     "set_window_info",
     "set_parent",
     "get_window_parents",
@@ -5471,6 +5585,8 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
+    "detach_completion",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
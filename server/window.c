@@ -33,6 +33,8 @@
 #include "winternl.h"
 
 #include "object.h"
+#include "file.h"
+#include "handle.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -87,6 +89,8 @@ struct window
     unsigned int     dpi;             /* window DPI or 0 if per-monitor aware */
     DPI_AWARENESS    dpi_awareness;   /* DPI awareness mode */
     lparam_t         user_data;       /* user-specific data */
+    struct child_index *child_index;  /* spatial index of the children, built on demand */
+    unsigned int     zorder;          /* position in the parent Z-order when its index was built */
     WCHAR           *text;            /* window caption text */
     unsigned int     paint_flags;     /* various painting flags */
     int              prop_inuse;      /* number of in-use window properties */
@@ -115,6 +119,23 @@ struct user_handle_array
     int            total;
 };
 
+/* spatial index of the children of a window, used for hit-testing */
+#define CHILD_INDEX_MIN_COUNT 64  /* don't bother indexing less children than this */
+#define CHILD_INDEX_GRID      16  /* number of cells in each dimension */
+
+struct child_cell
+{
+    struct window **windows;      /* children overlapping the cell, in no particular order */
+    unsigned int    count;
+    unsigned int    size;
+};
+
+struct child_index
+{
+    rectangle_t       bounds;     /* bounding rectangle of the children when the index was built */
+    struct child_cell cells[CHILD_INDEX_GRID * CHILD_INDEX_GRID];
+};
+
 static const rectangle_t empty_rect;
 
 /* global window pointers */
@@ -143,6 +164,203 @@ static inline int is_desktop_window( const struct window *win )
     return !win->parent;  /* only desktop windows have no parent */
 }
 
+/* section holding the window state shared with the clients */
+static struct object *window_shm_mapping;
+static struct window_shm *window_shm;
+
+/* publish the current state of a window to the clients */
+static void update_window_shm( struct window *win )
+{
+    struct window_shm *shm;
+
+    if (!window_shm) return;
+    shm = &window_shm[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    shm->handle     = win->handle;
+    shm->parent     = win->parent ? win->parent->handle : 0;
+    shm->owner      = win->owner;
+    shm->pid        = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->tid        = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->style      = win->style;
+    shm->ex_style   = win->ex_style;
+    shm->id         = win->id;
+    shm->dpi        = win->dpi;
+    shm->is_unicode = win->is_unicode;
+    shm->instance   = win->instance;
+    shm->user_data  = win->user_data;
+    shm->window     = win->window_rect;
+    shm->client     = win->client_rect;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+}
+
+/* remove a window from the shared state */
+static void clear_window_shm( struct window *win )
+{
+    struct window_shm *shm;
+
+    if (!window_shm) return;
+    shm = &window_shm[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+    shm->handle = 0;
+    interlocked_xchg_add( (int *)&shm->seq, 1 );
+}
+
+/* free the spatial index of the children of a window */
+static void free_child_index( struct window *win )
+{
+    unsigned int i;
+
+    if (!win->child_index) return;
+    for (i = 0; i < CHILD_INDEX_GRID * CHILD_INDEX_GRID; i++) free( win->child_index->cells[i].windows );
+    free( win->child_index );
+    win->child_index = NULL;
+}
+
+/* get the index of the grid column or row containing a coordinate */
+static inline int get_child_cell_pos( int pos, int start, int end )
+{
+    if (pos <= start) return 0;
+    if (pos >= end) return CHILD_INDEX_GRID - 1;
+    return (long long)(pos - start) * CHILD_INDEX_GRID / (end - start);
+}
+
+/* get the range of grid cells overlapping a rectangle */
+static void get_child_cells( const struct child_index *index, const rectangle_t *rect,
+                             int *left, int *top, int *right, int *bottom )
+{
+    *left   = get_child_cell_pos( rect->left, index->bounds.left, index->bounds.right );
+    *right  = get_child_cell_pos( rect->right - 1, index->bounds.left, index->bounds.right );
+    *top    = get_child_cell_pos( rect->top, index->bounds.top, index->bounds.bottom );
+    *bottom = get_child_cell_pos( rect->bottom - 1, index->bounds.top, index->bounds.bottom );
+}
+
+/* add a window to the cells overlapping a rectangle */
+static int add_to_child_index( struct child_index *index, struct window *win, const rectangle_t *rect )
+{
+    int x, y, left, top, right, bottom;
+
+    if (is_rect_empty( rect )) return 1;  /* cannot contain any point */
+
+    get_child_cells( index, rect, &left, &top, &right, &bottom );
+    for (y = top; y <= bottom; y++)
+    {
+        for (x = left; x <= right; x++)
+        {
+            struct child_cell *cell = &index->cells[y * CHILD_INDEX_GRID + x];
+
+            if (cell->count == cell->size)
+            {
+                unsigned int new_size = max( 8, cell->size * 2 );
+                struct window **new_windows = realloc( cell->windows, new_size * sizeof(*new_windows) );
+                if (!new_windows) return 0;
+                cell->windows = new_windows;
+                cell->size = new_size;
+            }
+            cell->windows[cell->count++] = win;
+        }
+    }
+    return 1;
+}
+
+/* remove a window from the cells overlapping a rectangle */
+static void remove_from_child_index( struct child_index *index, struct window *win, const rectangle_t *rect )
+{
+    int x, y, left, top, right, bottom;
+    unsigned int i;
+
+    if (is_rect_empty( rect )) return;
+
+    get_child_cells( index, rect, &left, &top, &right, &bottom );
+    for (y = top; y <= bottom; y++)
+    {
+        for (x = left; x <= right; x++)
+        {
+            struct child_cell *cell = &index->cells[y * CHILD_INDEX_GRID + x];
+
+            for (i = 0; i < cell->count; i++)
+            {
+                if (cell->windows[i] != win) continue;
+                cell->windows[i] = cell->windows[--cell->count];
+                break;
+            }
+        }
+    }
+}
+
+/* build the spatial index of the children of a window */
+static struct child_index *get_child_index( struct window *parent )
+{
+    struct child_index *index;
+    struct window *ptr;
+    unsigned int count = 0;
+
+    if (parent->child_index) return parent->child_index;
+
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        /* hit-testing children with a different DPI requires scaling the point */
+        if (ptr->dpi != parent->dpi) return NULL;
+        count++;
+    }
+    if (count < CHILD_INDEX_MIN_COUNT) return NULL;
+
+    if (!(index = calloc( 1, sizeof(*index) ))) return NULL;
+    count = 0;
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        if (is_rect_empty( &ptr->visible_rect )) continue;
+        if (!count++) index->bounds = ptr->visible_rect;
+        else
+        {
+            index->bounds.left   = min( index->bounds.left, ptr->visible_rect.left );
+            index->bounds.top    = min( index->bounds.top, ptr->visible_rect.top );
+            index->bounds.right  = max( index->bounds.right, ptr->visible_rect.right );
+            index->bounds.bottom = max( index->bounds.bottom, ptr->visible_rect.bottom );
+        }
+    }
+
+    parent->child_index = index;
+    count = 0;
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        ptr->zorder = count++;
+        if (!add_to_child_index( index, ptr, &ptr->visible_rect ))
+        {
+            free_child_index( parent );
+            return NULL;
+        }
+    }
+    return index;
+}
+
+/* update the spatial index of the parent after a window has been moved */
+static void update_child_index( struct window *win, const rectangle_t *old_rect )
+{
+    struct child_index *index;
+
+    if (!win->parent || !(index = win->parent->child_index)) return;
+    if (!win->is_linked) return;
+    if (win->dpi != win->parent->dpi)
+    {
+        free_child_index( win->parent );
+        return;
+    }
+    if (!memcmp( old_rect, &win->visible_rect, sizeof(*old_rect) )) return;
+    remove_from_child_index( index, win, old_rect );
+    if (!add_to_child_index( index, win, &win->visible_rect )) free_child_index( win->parent );
+}
+
+/* change the DPI of a window, which invalidates the spatial indexes it is part of */
+static void set_window_dpi( struct window *win, unsigned int dpi )
+{
+    if (win->dpi == dpi) return;
+    win->dpi = dpi;
+    free_child_index( win );
+    if (win->parent) free_child_index( win->parent );
+}
+
 /* get next window in Z-order list */
 static inline struct window *get_next_window( struct window *win )
 {
@@ -190,6 +408,8 @@ static unsigned int get_monitor_dpi( struct window *win )
 /* link a window at the right place in the siblings list */
 static void link_window( struct window *win, struct window *previous )
 {
+    struct list *old_prev;
+
     if (previous == WINPTR_NOTOPMOST)
     {
         if (!(win->ex_style & WS_EX_TOPMOST) && win->is_linked) return;  /* nothing to do */
@@ -197,6 +417,7 @@ static void link_window( struct window *win, struct window *previous )
         previous = WINPTR_TOP;  /* fallback to the HWND_TOP case */
     }
 
+    old_prev = win->is_linked ? win->entry.prev : NULL;
     list_remove( &win->entry );  /* unlink it from the previous location */
 
     if (previous == WINPTR_BOTTOM)
@@ -239,7 +460,11 @@ static void link_window( struct window *win, struct window *previous )
         }
     }
 
+    /* the Z-order of the indexed children changed */
+    if (win->entry.prev != old_prev) free_child_index( win->parent );
+
     win->is_linked = 1;
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -259,14 +484,17 @@ static int set_parent_window( struct window *win, struct window *parent )
 
     if (parent)
     {
+        /* the index of the old parent still refers to the window */
+        if (win->parent && win->parent != parent) free_child_index( win->parent );
         win->parent = parent;
         link_window( win, WINPTR_TOP );
 
         if (!is_desktop_window( parent ))
         {
-            win->dpi = parent->dpi;
+            set_window_dpi( win, parent->dpi );
             win->dpi_awareness = parent->dpi_awareness;
         }
+        update_window_shm( win );
 
         /* if parent belongs to a different thread and the window isn't */
         /* top-level, attach the two threads */
@@ -280,6 +508,7 @@ static int set_parent_window( struct window *win, struct window *parent )
     {
         list_remove( &win->entry );  /* unlink it from the previous location */
         list_add_head( &win->parent->unlinked, &win->entry );
+        free_child_index( win->parent );
         win->is_linked = 0;
     }
     return 1;
@@ -420,6 +649,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -505,6 +735,8 @@ static struct window *create_window( struct window *parent, struct window *owner
     win->dpi_awareness  = DPI_AWARENESS_PER_MONITOR_AWARE;
     win->dpi            = 0;
     win->user_data      = 0;
+    win->child_index    = NULL;
+    win->zorder         = 0;
     win->text           = NULL;
     win->paint_flags    = 0;
     win->prop_inuse     = 0;
@@ -546,6 +778,7 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    update_window_shm( win );
     return win;
 
 failed:
@@ -749,51 +982,130 @@ static unsigned int get_children_windows( struct window *parent, atom_t atom, th
     return count;
 }
 
-/* find child of 'parent' that contains the given point (in parent-relative coords) */
-static struct window *child_window_from_point( struct window *parent, int x, int y )
+/* get the children of 'parent' that may contain the given point, using the spatial index */
+static struct child_cell *get_child_cell_from_point( struct window *parent, int x, int y )
 {
-    struct window *ptr;
+    struct child_index *index = get_child_index( parent );
+    int cell_x, cell_y;
+
+    if (!index) return NULL;
+    cell_x = get_child_cell_pos( x, index->bounds.left, index->bounds.right );
+    cell_y = get_child_cell_pos( y, index->bounds.top, index->bounds.bottom );
+    return &index->cells[cell_y * CHILD_INDEX_GRID + cell_x];
+}
+
+/* find the top-most child of 'parent' that contains the given point, and map the point to its DPI */
+static struct window *get_top_child_from_point( struct window *parent, int *x, int *y )
+{
+    struct child_cell *cell;
+    struct window *ptr, *found = NULL;
+    unsigned int i;
+
+    if ((cell = get_child_cell_from_point( parent, *x, *y )))
+    {
+        /* indexed children have the same DPI as the parent, the point doesn't need mapping */
+        for (i = 0; i < cell->count; i++)
+        {
+            int x_child = *x, y_child = *y;
+
+            ptr = cell->windows[i];
+            if (found && ptr->zorder > found->zorder) continue;
+            if (is_point_in_window( ptr, &x_child, &y_child, parent->dpi )) found = ptr;
+        }
+        return found;
+    }
 
     LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
     {
-        int x_child = x, y_child = y;
+        int x_child = *x, y_child = *y;
 
         if (!is_point_in_window( ptr, &x_child, &y_child, parent->dpi )) continue;  /* skip it */
+        *x = x_child;
+        *y = y_child;
+        return ptr;
+    }
+    return NULL;
+}
 
-        /* if window is minimized or disabled, return at once */
-        if (ptr->style & (WS_MINIMIZE|WS_DISABLED)) return ptr;
+/* find child of 'parent' that contains the given point (in parent-relative coords) */
+static struct window *child_window_from_point( struct window *parent, int x, int y )
+{
+    struct window *ptr;
+
+    if (!(ptr = get_top_child_from_point( parent, &x, &y ))) return parent;  /* not found any child */
 
-        /* if point is not in client area, return at once */
-        if (!point_in_rect( &ptr->client_rect, x_child, y_child )) return ptr;
+    /* if window is minimized or disabled, return at once */
+    if (ptr->style & (WS_MINIMIZE|WS_DISABLED)) return ptr;
 
-        return child_window_from_point( ptr, x_child - ptr->client_rect.left,
-                                        y_child - ptr->client_rect.top );
+    /* if point is not in client area, return at once */
+    if (!point_in_rect( &ptr->client_rect, x, y )) return ptr;
+
+    return child_window_from_point( ptr, x - ptr->client_rect.left, y - ptr->client_rect.top );
+}
+
+static int get_window_children_from_point( struct window *parent, int x, int y,
+                                           struct user_handle_array *array );
+
+/* add a child containing the given point and its own children to the array */
+static int add_child_from_point( struct window *ptr, int x_child, int y_child,
+                                 struct user_handle_array *array )
+{
+    /* if point is in client area, and window is not minimized or disabled, check children */
+    if (!(ptr->style & (WS_MINIMIZE|WS_DISABLED)) && point_in_rect( &ptr->client_rect, x_child, y_child ))
+    {
+        if (!get_window_children_from_point( ptr, x_child - ptr->client_rect.left,
+                                             y_child - ptr->client_rect.top, array ))
+            return 0;
     }
-    return parent;  /* not found any child */
+
+    /* now add window to the array */
+    return add_handle_to_array( array, ptr->handle );
+}
+
+/* sort windows in the Z-order of their parent index */
+static int compare_window_zorder( const void *a, const void *b )
+{
+    const struct window *win1 = *(struct window * const *)a;
+    const struct window *win2 = *(struct window * const *)b;
+
+    if (win1->zorder < win2->zorder) return -1;
+    return win1->zorder > win2->zorder;
 }
 
 /* find all children of 'parent' that contain the given point */
 static int get_window_children_from_point( struct window *parent, int x, int y,
                                            struct user_handle_array *array )
 {
+    struct child_cell *cell;
     struct window *ptr;
 
-    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    if ((cell = get_child_cell_from_point( parent, x, y )))
     {
-        int x_child = x, y_child = y;
+        struct window **found;
+        unsigned int i, count = 0;
+        int ret = 1;
 
-        if (!is_point_in_window( ptr, &x_child, &y_child, parent->dpi )) continue;  /* skip it */
-
-        /* if point is in client area, and window is not minimized or disabled, check children */
-        if (!(ptr->style & (WS_MINIMIZE|WS_DISABLED)) && point_in_rect( &ptr->client_rect, x_child, y_child ))
+        if (!cell->count) return 1;
+        if (!(found = mem_alloc( cell->count * sizeof(*found) ))) return 0;
+        for (i = 0; i < cell->count; i++)
         {
-            if (!get_window_children_from_point( ptr, x_child - ptr->client_rect.left,
-                                                 y_child - ptr->client_rect.top, array ))
-                return 0;
+            int x_child = x, y_child = y;
+
+            if (is_point_in_window( cell->windows[i], &x_child, &y_child, parent->dpi ))
+                found[count++] = cell->windows[i];
         }
+        qsort( found, count, sizeof(*found), compare_window_zorder );
+        for (i = 0; ret && i < count; i++) ret = add_child_from_point( found[i], x, y, array );
+        free( found );
+        return ret;
+    }
+
+    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    {
+        int x_child = x, y_child = y;
 
-        /* now add window to the array */
-        if (!add_handle_to_array( array, ptr->handle )) return 0;
+        if (!is_point_in_window( ptr, &x_child, &y_child, parent->dpi )) continue;  /* skip it */
+        if (!add_child_from_point( ptr, x_child, y_child, array )) return 0;
     }
     return 1;
 }
@@ -1700,6 +2012,8 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    update_child_index( win, &old_visible_rect );
+    update_window_shm( win );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1708,12 +2022,17 @@ static void set_window_pos( struct window *win, struct window *previous,
         int old_size = old_client_rect.right - old_client_rect.left;
         int new_size = win->client_rect.right - win->client_rect.left;
 
-        if (old_size != new_size) LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+        if (old_size != new_size)
         {
-            offset_rect( &child->window_rect, new_size - old_size, 0 );
-            offset_rect( &child->visible_rect, new_size - old_size, 0 );
-            offset_rect( &child->surface_rect, new_size - old_size, 0 );
-            offset_rect( &child->client_rect, new_size - old_size, 0 );
+            free_child_index( win );
+            LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+            {
+                offset_rect( &child->window_rect, new_size - old_size, 0 );
+                offset_rect( &child->visible_rect, new_size - old_size, 0 );
+                offset_rect( &child->surface_rect, new_size - old_size, 0 );
+                offset_rect( &child->client_rect, new_size - old_size, 0 );
+                update_window_shm( child );
+            }
         }
     }
 
@@ -1876,6 +2195,7 @@ void destroy_window( struct window *win )
     {
         struct region *vis_rgn = get_visible_region( win, DCX_WINDOW );
         win->style &= ~WS_VISIBLE;
+        update_window_shm( win );
         if (vis_rgn)
         {
             struct region *exposed_rgn = expose_window( win, &win->window_rect, vis_rgn );
@@ -1899,9 +2219,12 @@ void destroy_window( struct window *win )
     if (win == taskman_window) taskman_window = NULL;
     free_hotkeys( win->desktop, win->handle );
     cleanup_clipboard_window( win->desktop, win->handle );
+    clear_window_shm( win );
     free_user_handle( win->handle );
     destroy_properties( win );
+    free_child_index( win );
     list_remove( &win->entry );
+    if (win->parent && win->is_linked) free_child_index( win->parent );
     if (is_desktop_window(win))
     {
         struct desktop *desktop = win->desktop;
@@ -1956,13 +2279,14 @@ DECL_HANDLER(create_window)
     if (parent && !is_desktop_window( parent ))
     {
         win->dpi_awareness = parent->dpi_awareness;
-        win->dpi = parent->dpi;
+        set_window_dpi( win, parent->dpi );
     }
     else if (!parent || req->awareness != DPI_AWARENESS_PER_MONITOR_AWARE)
     {
         win->dpi_awareness = req->awareness;
-        win->dpi = req->dpi;
+        set_window_dpi( win, req->dpi );
     }
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -2025,6 +2349,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2037,6 +2362,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2072,6 +2398,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2097,6 +2424,27 @@ DECL_HANDLER(get_window_info)
 }
 
 
+/* get the section holding the shared window state */
+DECL_HANDLER(get_window_shm)
+{
+    reply->handle = 0;
+
+    if (!window_shm_mapping)
+    {
+        struct window *win;
+        user_handle_t handle = 0;
+        void *ptr;
+
+        if (!(window_shm_mapping = create_anonymous_mapping( ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1) *
+                                                             sizeof(struct window_shm), &ptr )))
+            return;
+        window_shm = ptr;
+        while ((win = next_user_handle( &handle, USER_WINDOW ))) update_window_shm( win );
+    }
+    reply->handle = alloc_handle( current->process, window_shm_mapping, SECTION_MAP_READ | SECTION_QUERY, 0 );
+}
+
+
 /* set some information in a window */
 DECL_HANDLER(set_window_info)
 {
@@ -2143,6 +2491,7 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_USERDATA) win->user_data = req->user_data;
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
+    update_window_shm( win );
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
@@ -2673,6 +3022,7 @@ DECL_HANDLER(update_window_zorder)
         {
             list_remove( &win->entry );
             list_add_before( &ptr->entry, &win->entry );
+            free_child_index( win->parent );
         }
         break;
     }